@@ -0,0 +1,939 @@
+#define _POSIX_C_SOURCE 200112L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "tensor.h"
+#include "layer.h"
+#include "loss.h"
+#include "optimizer.h"
+#include "params.h"
+#include "sparse.h"
+#include "gemm.h"
+#include "trainer.h"
+#include "threadpool.h"
+#include "inference.h"
+#include "quant.h"
+#include "profile.h"
+#include "server.h"
+#include "allocator.h"
+
+/* Prints one JSON document on stdout (or --out FILE). Every case runs its
+ * warmup iterations, then times each repetition separately and reports the
+ * median and p99 latency plus a case-specific throughput derived from the
+ * median: GFLOP/s for GEMM-bound cases, GB/s for streaming kernels and
+ * samples/s for the end-to-end MLP. */
+
+#define MAX_MLP_LAYERS 16
+
+typedef void (*bench_fn)(void *ctx);
+
+typedef struct {
+    int warmup;
+    int repetitions;
+    const char *filter;
+    FILE *out;
+    int first;
+    double *samples;
+} bench_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* Times fn and appends a result object. work is the amount of work per call
+ * in the unit's numerator (FLOPs, bytes or samples). */
+static void run_case(bench_t *bench, const char *name, const char *params,
+                     bench_fn fn, void *ctx, double work, const char *unit) {
+    if (bench->filter && !strstr(name, bench->filter)) return;
+
+    for (int i = 0; i < bench->warmup; i++) fn(ctx);
+    for (int i = 0; i < bench->repetitions; i++) {
+        double start = now_seconds();
+        fn(ctx);
+        bench->samples[i] = now_seconds() - start;
+    }
+    qsort(bench->samples, (size_t)bench->repetitions, sizeof(double), compare_double);
+
+    int n = bench->repetitions;
+    double median = n % 2 ? bench->samples[n / 2]
+                          : 0.5 * (bench->samples[n / 2 - 1] + bench->samples[n / 2]);
+    int p99_index = (int)((n - 1) * 0.99 + 0.5);
+    double p99 = bench->samples[p99_index];
+    double scale = strcmp(unit, "samples/s") == 0 ? 1.0 : 1e-9;
+
+    fprintf(bench->out, "%s\n    {\"name\": \"%s\", \"params\": {%s}, "
+            "\"median_us\": %.3f, \"p99_us\": %.3f, \"min_us\": %.3f, \"%s\": %.3f}",
+            bench->first ? "" : ",", name, params,
+            median * 1e6, p99 * 1e6, bench->samples[0] * 1e6, unit, work * scale / median);
+    bench->first = 0;
+    fflush(bench->out);
+}
+
+typedef struct {
+    tensor_t *a, *b, *c;
+} matmul_ctx_t;
+
+static void matmul_case(void *ctx) {
+    matmul_ctx_t *m = (matmul_ctx_t*)ctx;
+    tensor_matmul_into(m->a, m->b, m->c);
+}
+
+static void bench_matmul(bench_t *bench) {
+    static const size_t shapes[][3] = {
+        {64, 64, 64}, {128, 128, 128}, {256, 256, 256}, {512, 512, 512},
+        {1024, 1024, 1024}, {64, 784, 256}, {256, 256, 1024}, {1, 1024, 1024}
+    };
+
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        size_t m = shapes[s][0], k = shapes[s][1], n = shapes[s][2];
+        matmul_ctx_t ctx = {tensor_create(m, k), tensor_create(k, n), tensor_create(m, n)};
+        tensor_random(ctx.a, -1.0f, 1.0f);
+        tensor_random(ctx.b, -1.0f, 1.0f);
+
+        char params[128];
+        snprintf(params, sizeof(params), "\"m\": %zu, \"k\": %zu, \"n\": %zu", m, k, n);
+        run_case(bench, "matmul", params, matmul_case, &ctx, 2.0 * m * n * k, "gflops");
+
+        tensor_destroy(ctx.a);
+        tensor_destroy(ctx.b);
+        tensor_destroy(ctx.c);
+    }
+}
+
+typedef struct {
+    dense_layer_t *layer;
+    tensor_t *input;
+    tensor_t *grad;
+} layer_ctx_t;
+
+static void layer_forward_case(void *ctx) {
+    layer_ctx_t *l = (layer_ctx_t*)ctx;
+    layer_forward(l->layer, l->input);
+}
+
+/* What every forward cost before the panels were cached. */
+static void layer_forward_repack_case(void *ctx) {
+    layer_ctx_t *l = (layer_ctx_t*)ctx;
+    layer_weights_changed(l->layer);
+    layer_forward(l->layer, l->input);
+}
+
+static void layer_backward_case(void *ctx) {
+    layer_ctx_t *l = (layer_ctx_t*)ctx;
+    layer_backward(l->layer, l->grad);
+}
+
+static void bench_layers(bench_t *bench) {
+    static const size_t sizes[][2] = {{784, 256}, {256, 256}, {256, 10}, {1024, 1024}};
+    static const size_t batches[] = {1, 32, 256};
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+            size_t in = sizes[s][0], out = sizes[s][1], batch = batches[b];
+            layer_ctx_t ctx;
+            ctx.layer = layer_create(in, out, ACTIVATION_RELU);
+            ctx.input = tensor_create(batch, in);
+            ctx.grad = tensor_create(batch, out);
+            layer_reserve(ctx.layer, batch);
+            tensor_random(ctx.input, -1.0f, 1.0f);
+            tensor_random(ctx.grad, -1.0f, 1.0f);
+
+            char params[128];
+            snprintf(params, sizeof(params), "\"in\": %zu, \"out\": %zu, \"batch\": %zu", in, out, batch);
+            double flops = 2.0 * batch * in * out;
+            run_case(bench, "layer_forward", params, layer_forward_case, &ctx, flops, "gflops");
+            run_case(bench, "layer_forward_repack", params, layer_forward_repack_case, &ctx, flops, "gflops");
+            layer_forward(ctx.layer, ctx.input);
+            run_case(bench, "layer_backward", params, layer_backward_case, &ctx, 2.0 * flops, "gflops");
+
+            layer_destroy(ctx.layer);
+            tensor_destroy(ctx.input);
+            tensor_destroy(ctx.grad);
+        }
+    }
+}
+
+typedef struct {
+    dense_layer_t *layer;
+    tensor_t *input;
+    sparse_tensor_t *sparse;
+    tensor_t *grad;
+    sgd_optimizer_t *sgd;
+} sparse_ctx_t;
+
+static void dense_first_layer_case(void *ctx) {
+    sparse_ctx_t *l = (sparse_ctx_t*)ctx;
+    layer_forward(l->layer, l->input);
+    layer_backward(l->layer, l->grad);
+    sgd_step(l->sgd, l->layer);
+}
+
+static void sparse_first_layer_case(void *ctx) {
+    sparse_ctx_t *l = (sparse_ctx_t*)ctx;
+    layer_forward_sparse(l->layer, l->sparse);
+    layer_backward(l->layer, l->grad);
+    sgd_step(l->sgd, l->layer);
+}
+
+/* A first layer over hashed features with a few dozen nonzeros per row,
+ * trained from the same batch as a dense and as a CSR input. */
+static void bench_sparse(bench_t *bench) {
+    static const size_t nnz_per_row[] = {8, 64};
+    const size_t in = 32768, out = 128, batch = 128;
+
+    for (size_t s = 0; s < sizeof(nnz_per_row) / sizeof(nnz_per_row[0]); s++) {
+        sparse_ctx_t ctx;
+        ctx.layer = layer_create(in, out, ACTIVATION_RELU);
+        ctx.input = tensor_create(batch, in);
+        ctx.grad = tensor_create(batch, out);
+        ctx.sgd = sgd_create(1e-4f);
+        layer_reserve(ctx.layer, batch);
+        for (size_t i = 0; i < batch; i++) {
+            for (size_t k = 0; k < nnz_per_row[s]; k++) {
+                ctx.input->data[i * in + (size_t)rand() % in] = 1.0f;
+            }
+        }
+        ctx.sparse = sparse_from_dense(ctx.input);
+        tensor_random(ctx.grad, -1.0f, 1.0f);
+
+        char params[128];
+        snprintf(params, sizeof(params), "\"in\": %zu, \"out\": %zu, \"batch\": %zu, \"nnz\": %zu",
+                 in, out, batch, sparse_nnz(ctx.sparse));
+        run_case(bench, "first_layer_dense", params, dense_first_layer_case, &ctx, (double)batch, "samples/s");
+        run_case(bench, "first_layer_sparse", params, sparse_first_layer_case, &ctx, (double)batch, "samples/s");
+
+        layer_destroy(ctx.layer);
+        tensor_destroy(ctx.input);
+        tensor_destroy(ctx.grad);
+        sparse_destroy(ctx.sparse);
+        sgd_destroy(ctx.sgd);
+    }
+}
+
+typedef struct {
+    dense_layer_t *layer;
+    param_arena_t *params;
+    adam_optimizer_t *adam;
+    sgd_optimizer_t *sgd;
+} optimizer_ctx_t;
+
+static void adam_case(void *ctx) {
+    optimizer_ctx_t *o = (optimizer_ctx_t*)ctx;
+    adam_step(o->adam, &o->layer, 1);
+}
+
+static void adam_params_case(void *ctx) {
+    optimizer_ctx_t *o = (optimizer_ctx_t*)ctx;
+    adam_step_params(o->adam, o->params);
+}
+
+static void sgd_case(void *ctx) {
+    optimizer_ctx_t *o = (optimizer_ctx_t*)ctx;
+    sgd_step(o->sgd, o->layer);
+}
+
+static void sgd_params_case(void *ctx) {
+    optimizer_ctx_t *o = (optimizer_ctx_t*)ctx;
+    sgd_step_params(o->sgd, o->params);
+}
+
+static void bench_optimizers(bench_t *bench) {
+    static const size_t sizes[][2] = {{256, 256}, {1024, 1024}, {4096, 1024}};
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        optimizer_ctx_t ctx;
+        ctx.layer = layer_create(sizes[s][0], sizes[s][1], ACTIVATION_NONE);
+        size_t count = layer_param_count(ctx.layer);
+        tensor_random(ctx.layer->grad_weights, -1.0f, 1.0f);
+        tensor_random(ctx.layer->grad_bias, -1.0f, 1.0f);
+
+        char params[96];
+        snprintf(params, sizeof(params), "\"params\": %zu", count);
+        /* Adam streams p, g, m, v in and p, m, v out; SGD streams p, g in and p out. */
+        double adam_bytes = 7.0 * sizeof(float) * count;
+        double sgd_bytes = 3.0 * sizeof(float) * count;
+
+        ctx.adam = adam_create(1e-6f, 1);
+        ctx.sgd = sgd_create(1e-6f);
+        run_case(bench, "adam_step", params, adam_case, &ctx, adam_bytes, "gbps");
+        run_case(bench, "sgd_step", params, sgd_case, &ctx, sgd_bytes, "gbps");
+        adam_destroy(ctx.adam);
+
+        ctx.params = param_arena_create(&ctx.layer, 1);
+        ctx.adam = adam_create(1e-6f, 1);
+        run_case(bench, "adam_step_params", params, adam_params_case, &ctx, adam_bytes, "gbps");
+        run_case(bench, "sgd_step_params", params, sgd_params_case, &ctx, sgd_bytes, "gbps");
+
+        adam_destroy(ctx.adam);
+        sgd_destroy(ctx.sgd);
+        layer_destroy(ctx.layer);
+        param_arena_destroy(ctx.params);
+    }
+}
+
+typedef struct {
+    optimizer_ctx_t opt;
+    tensor_t *a, *b, *c;
+    size_t rows, cols;
+} allocator_ctx_t;
+
+static void create_case(void *ctx) {
+    allocator_ctx_t *x = (allocator_ctx_t*)ctx;
+    tensor_destroy(tensor_create(x->rows, x->cols));
+}
+
+static void allocator_matmul_case(void *ctx) {
+    allocator_ctx_t *x = (allocator_ctx_t*)ctx;
+    tensor_matmul_into(x->a, x->b, x->c);
+}
+
+/* The same large tensors and optimizer state from the default allocator and
+ * from 2 MiB pages placed by first touch. */
+static void bench_allocators(bench_t *bench) {
+    static const char *names[] = {"system", "huge_pages"};
+    allocator_t *allocators[] = {allocator_system(),
+                                 allocator_create_linux(ALLOCATOR_HUGE_PAGES | ALLOCATOR_FIRST_TOUCH, 0)};
+    if (!allocators[1]) return;
+
+    for (size_t i = 0; i < 2; i++) {
+        allocator_set_tensor(allocators[i]);
+        allocator_ctx_t ctx;
+        ctx.rows = 4096;
+        ctx.cols = 4096;
+        ctx.opt.layer = layer_create(ctx.rows, ctx.cols, ACTIVATION_NONE);
+        ctx.opt.params = param_arena_create(&ctx.opt.layer, 1);
+        ctx.opt.adam = adam_create(1e-6f, 1);
+        tensor_random(ctx.opt.layer->grad_weights, -1.0f, 1.0f);
+        ctx.a = tensor_create(1024, 2048);
+        ctx.b = tensor_create(2048, 1024);
+        ctx.c = tensor_create(1024, 1024);
+        tensor_random(ctx.a, -1.0f, 1.0f);
+        tensor_random(ctx.b, -1.0f, 1.0f);
+
+        size_t count = layer_param_count(ctx.opt.layer);
+        char params[96];
+        snprintf(params, sizeof(params), "\"allocator\": \"%s\", \"params\": %zu", names[i], count);
+        run_case(bench, "alloc_adam_step_params", params, adam_params_case, &ctx.opt,
+                 7.0 * sizeof(float) * count, "gbps");
+        run_case(bench, "alloc_tensor_create", params, create_case, &ctx,
+                 (double)ctx.rows * ctx.cols * sizeof(float), "gbps");
+        snprintf(params, sizeof(params), "\"allocator\": \"%s\", \"m\": 1024, \"n\": 1024, \"k\": 2048",
+                 names[i]);
+        run_case(bench, "alloc_matmul", params, allocator_matmul_case, &ctx, 2.0 * 1024 * 1024 * 2048, "gflops");
+
+        adam_destroy(ctx.opt.adam);
+        layer_destroy(ctx.opt.layer);
+        param_arena_destroy(ctx.opt.params);
+        tensor_destroy(ctx.a);
+        tensor_destroy(ctx.b);
+        tensor_destroy(ctx.c);
+    }
+    allocator_set_tensor(NULL);
+    allocator_destroy(allocators[1]);
+}
+
+static void random_case(void *ctx) {
+    tensor_random((tensor_t*)ctx, -1.0f, 1.0f);
+}
+
+static void random_normal_case(void *ctx) {
+    tensor_random_normal((tensor_t*)ctx, 0.0f, 1.0f);
+}
+
+/* The libc rand() loop tensor_random used to run, for reference. */
+static void libc_rand_case(void *ctx) {
+    tensor_t *t = (tensor_t*)ctx;
+    for (size_t i = 0; i < t->rows * t->cols; i++) t->data[i] = -1.0f + 2.0f * ((float)rand() / RAND_MAX);
+}
+
+static void bench_random(bench_t *bench) {
+    static const size_t shapes[][2] = {{256, 256}, {4096, 1024}};
+
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        tensor_t *t = tensor_create(shapes[s][0], shapes[s][1]);
+        char params[96];
+        snprintf(params, sizeof(params), "\"rows\": %zu, \"cols\": %zu", shapes[s][0], shapes[s][1]);
+        double n = (double)(shapes[s][0] * shapes[s][1]) * sizeof(float);
+        run_case(bench, "tensor_random", params, random_case, t, n, "gbps");
+        run_case(bench, "tensor_random_normal", params, random_normal_case, t, n, "gbps");
+        run_case(bench, "libc_rand", params, libc_rand_case, t, n, "gbps");
+        tensor_destroy(t);
+    }
+}
+
+typedef struct {
+    tensor_t *predictions, *targets, *grad;
+} loss_ctx_t;
+
+static void mse_case(void *ctx) {
+    loss_ctx_t *l = (loss_ctx_t*)ctx;
+    volatile float loss = loss_mse(l->predictions, l->targets);
+    (void)loss;
+}
+
+static void mse_grad_case(void *ctx) {
+    loss_ctx_t *l = (loss_ctx_t*)ctx;
+    loss_mse_derivative(l->predictions, l->targets, l->grad);
+}
+
+static void bce_case(void *ctx) {
+    loss_ctx_t *l = (loss_ctx_t*)ctx;
+    volatile float loss = loss_binary_crossentropy(l->predictions, l->targets);
+    (void)loss;
+}
+
+static void bce_grad_case(void *ctx) {
+    loss_ctx_t *l = (loss_ctx_t*)ctx;
+    loss_bce_derivative(l->predictions, l->targets, l->grad);
+}
+
+/* The chain a sigmoid head trains through today, against the fused loss on
+ * the logits at either accuracy. */
+static void bce_chain_case(void *ctx) {
+    loss_ctx_t *l = (loss_ctx_t*)ctx;
+    tensor_sigmoid(l->predictions, l->grad);
+    volatile float loss = loss_binary_crossentropy(l->grad, l->targets);
+    (void)loss;
+    loss_bce_derivative(l->grad, l->targets, l->grad);
+}
+
+static void bce_logits_case(void *ctx) {
+    loss_ctx_t *l = (loss_ctx_t*)ctx;
+    volatile float loss = loss_bce_with_logits(l->predictions, l->targets, MATH_PRECISE);
+    (void)loss;
+    loss_bce_with_logits_derivative(l->predictions, l->targets, l->grad, MATH_PRECISE);
+}
+
+static void bce_logits_fast_case(void *ctx) {
+    loss_ctx_t *l = (loss_ctx_t*)ctx;
+    volatile float loss = loss_bce_with_logits(l->predictions, l->targets, MATH_FAST);
+    (void)loss;
+    loss_bce_with_logits_derivative(l->predictions, l->targets, l->grad, MATH_FAST);
+}
+
+/* Loss then derivative, two sweeps over the operands, against the fused
+ * single sweep. */
+static void mse_two_pass_case(void *ctx) {
+    loss_ctx_t *l = (loss_ctx_t*)ctx;
+    volatile float loss = loss_mse(l->predictions, l->targets);
+    (void)loss;
+    loss_mse_derivative(l->predictions, l->targets, l->grad);
+}
+
+static void mse_fused_case(void *ctx) {
+    loss_ctx_t *l = (loss_ctx_t*)ctx;
+    volatile float loss = loss_mse_with_grad(l->predictions, l->targets, l->grad);
+    (void)loss;
+}
+
+static void bce_logits_fused_case(void *ctx) {
+    loss_ctx_t *l = (loss_ctx_t*)ctx;
+    volatile float loss = loss_bce_logits_with_grad(l->predictions, l->targets, l->grad, MATH_PRECISE);
+    (void)loss;
+}
+
+static void softmax_ce_case(void *ctx) {
+    loss_ctx_t *l = (loss_ctx_t*)ctx;
+    volatile float loss = loss_softmax_crossentropy_with_grad(l->predictions, l->targets, l->grad, MATH_PRECISE);
+    (void)loss;
+}
+
+static void sigmoid_case(void *ctx) {
+    loss_ctx_t *l = (loss_ctx_t*)ctx;
+    tensor_sigmoid_mode(l->predictions, l->grad, MATH_PRECISE);
+}
+
+static void sigmoid_fast_case(void *ctx) {
+    loss_ctx_t *l = (loss_ctx_t*)ctx;
+    tensor_sigmoid_mode(l->predictions, l->grad, MATH_FAST);
+}
+
+static void bench_losses(bench_t *bench) {
+    static const size_t shapes[][2] = {{256, 10}, {4096, 256}};
+
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        size_t rows = shapes[s][0], cols = shapes[s][1];
+        loss_ctx_t ctx = {tensor_create(rows, cols), tensor_create(rows, cols), tensor_create(rows, cols)};
+        tensor_random(ctx.predictions, 0.01f, 0.99f);
+        tensor_random(ctx.targets, 0.0f, 1.0f);
+
+        char params[96];
+        snprintf(params, sizeof(params), "\"rows\": %zu, \"cols\": %zu", rows, cols);
+        double n = (double)(rows * cols) * sizeof(float);
+        run_case(bench, "loss_mse", params, mse_case, &ctx, 2.0 * n, "gbps");
+        run_case(bench, "loss_mse_derivative", params, mse_grad_case, &ctx, 3.0 * n, "gbps");
+        run_case(bench, "loss_bce", params, bce_case, &ctx, 2.0 * n, "gbps");
+        run_case(bench, "loss_bce_derivative", params, bce_grad_case, &ctx, 3.0 * n, "gbps");
+        run_case(bench, "sigmoid", params, sigmoid_case, &ctx, 2.0 * n, "gbps");
+        run_case(bench, "sigmoid_fast", params, sigmoid_fast_case, &ctx, 2.0 * n, "gbps");
+        run_case(bench, "bce_sigmoid_chain", params, bce_chain_case, &ctx, 3.0 * n, "gbps");
+        run_case(bench, "bce_logits", params, bce_logits_case, &ctx, 3.0 * n, "gbps");
+        run_case(bench, "bce_logits_fast", params, bce_logits_fast_case, &ctx, 3.0 * n, "gbps");
+        run_case(bench, "mse_two_pass", params, mse_two_pass_case, &ctx, 3.0 * n, "gbps");
+        run_case(bench, "mse_with_grad", params, mse_fused_case, &ctx, 3.0 * n, "gbps");
+        run_case(bench, "bce_logits_with_grad", params, bce_logits_fused_case, &ctx, 3.0 * n, "gbps");
+        run_case(bench, "softmax_ce_with_grad", params, softmax_ce_case, &ctx, 3.0 * n, "gbps");
+
+        tensor_destroy(ctx.predictions);
+        tensor_destroy(ctx.targets);
+        tensor_destroy(ctx.grad);
+    }
+}
+
+typedef struct {
+    dense_layer_t *layers[MAX_MLP_LAYERS];
+    size_t num_layers;
+    param_arena_t *params;
+    adam_optimizer_t *optimizer;
+    tensor_t *input, *targets, *grad;
+    inference_model_t *model;
+    quant_model_t *quantized;
+    tensor_t *predictions;
+} mlp_ctx_t;
+
+static void mlp_step_case(void *ctx) {
+    mlp_ctx_t *m = (mlp_ctx_t*)ctx;
+
+    const tensor_t *x = m->input;
+    for (size_t i = 0; i < m->num_layers; i++) x = layer_forward(m->layers[i], x);
+    loss_mse_derivative(x, m->targets, m->grad);
+
+    const tensor_t *g = m->grad;
+    for (size_t i = m->num_layers; i-- > 0;) g = layer_backward(m->layers[i], g);
+    adam_step_params(m->optimizer, m->params);
+}
+
+static void mlp_forward_case(void *ctx) {
+    mlp_ctx_t *m = (mlp_ctx_t*)ctx;
+
+    const tensor_t *x = m->input;
+    for (size_t i = 0; i < m->num_layers; i++) x = layer_forward(m->layers[i], x);
+}
+
+static void mlp_inference_case(void *ctx) {
+    mlp_ctx_t *m = (mlp_ctx_t*)ctx;
+    inference_forward(m->model, m->input, m->predictions, NULL);
+}
+
+static void mlp_int8_case(void *ctx) {
+    mlp_ctx_t *m = (mlp_ctx_t*)ctx;
+    quant_forward(m->quantized, m->input, m->predictions);
+}
+
+static size_t parse_sizes(const char *spec, size_t *sizes, size_t max) {
+    size_t count = 0;
+    const char *p = spec;
+    while (*p && count < max) {
+        char *end;
+        unsigned long value = strtoul(p, &end, 10);
+        if (end == p || value == 0) return 0;
+        sizes[count++] = value;
+        p = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') return 0;
+    }
+    return count;
+}
+
+static int bench_mlp(bench_t *bench, const char *spec, size_t batch) {
+    size_t sizes[MAX_MLP_LAYERS + 1];
+    size_t count = parse_sizes(spec, sizes, MAX_MLP_LAYERS + 1);
+    if (count < 2) {
+        fprintf(stderr, "Invalid --mlp layer sizes: %s\n", spec);
+        return 0;
+    }
+
+    mlp_ctx_t ctx;
+    ctx.num_layers = count - 1;
+    for (size_t i = 0; i < ctx.num_layers; i++) {
+        activation_type_t act = i + 1 == ctx.num_layers ? ACTIVATION_NONE : ACTIVATION_RELU;
+        ctx.layers[i] = layer_create(sizes[i], sizes[i + 1], act);
+        layer_reserve(ctx.layers[i], batch);
+    }
+    ctx.params = param_arena_create(ctx.layers, ctx.num_layers);
+    ctx.optimizer = adam_create(1e-4f, ctx.num_layers);
+    ctx.input = tensor_create(batch, sizes[0]);
+    ctx.targets = tensor_create(batch, sizes[count - 1]);
+    ctx.grad = tensor_create(batch, sizes[count - 1]);
+    tensor_random(ctx.input, -1.0f, 1.0f);
+    tensor_random(ctx.targets, 0.0f, 1.0f);
+
+    char params[192];
+    snprintf(params, sizeof(params), "\"layers\": \"%s\", \"batch\": %zu", spec, batch);
+    run_case(bench, "mlp_train_step", params, mlp_step_case, &ctx, (double)batch, "samples/s");
+    run_case(bench, "mlp_forward", params, mlp_forward_case, &ctx, (double)batch, "samples/s");
+    ctx.model = inference_model_create(ctx.layers, ctx.num_layers);
+    ctx.predictions = tensor_create(batch, sizes[count - 1]);
+    run_case(bench, "mlp_inference", params, mlp_inference_case, &ctx, (double)batch, "samples/s");
+    ctx.quantized = quant_model_from_inference(ctx.model);
+    run_case(bench, "mlp_inference_int8", params, mlp_int8_case, &ctx, (double)batch, "samples/s");
+
+    precision_t halves[] = {PRECISION_BF16, PRECISION_FP16};
+    for (size_t t = 0; t < 2; t++) {
+        char name[64];
+        inference_model_t *full = ctx.model;
+        ctx.model = inference_model_create_precision(ctx.layers, ctx.num_layers, halves[t]);
+        snprintf(name, sizeof(name), "mlp_inference_%s", precision_name(halves[t]));
+        run_case(bench, name, params, mlp_inference_case, &ctx, (double)batch, "samples/s");
+        inference_model_destroy(ctx.model);
+        ctx.model = full;
+
+        param_arena_set_precision(ctx.params, ctx.layers, ctx.num_layers, halves[t]);
+        snprintf(name, sizeof(name), "mlp_train_step_%s", precision_name(halves[t]));
+        run_case(bench, name, params, mlp_step_case, &ctx, (double)batch, "samples/s");
+    }
+    param_arena_set_precision(ctx.params, ctx.layers, ctx.num_layers, PRECISION_FP32);
+
+    for (size_t i = 0; i < ctx.num_layers; i++) layer_destroy(ctx.layers[i]);
+    param_arena_destroy(ctx.params);
+    adam_destroy(ctx.optimizer);
+    tensor_destroy(ctx.input);
+    tensor_destroy(ctx.targets);
+    tensor_destroy(ctx.grad);
+    tensor_destroy(ctx.predictions);
+    inference_model_destroy(ctx.model);
+    quant_model_destroy(ctx.quantized);
+    return 1;
+}
+
+typedef struct {
+    network_t *network;
+    trainer_t *trainer;
+    adam_optimizer_t *optimizer;
+    tensor_t *input, *targets;
+} data_parallel_ctx_t;
+
+static void network_step_case(void *ctx) {
+    data_parallel_ctx_t *d = (data_parallel_ctx_t*)ctx;
+    network_train_step(d->network, d->input, d->targets, NETWORK_LOSS_MSE, d->optimizer);
+}
+
+static void trainer_step_case(void *ctx) {
+    data_parallel_ctx_t *d = (data_parallel_ctx_t*)ctx;
+    trainer_step(d->trainer, d->input, d->targets, NETWORK_LOSS_MSE, d->optimizer);
+}
+
+/* The same MLP step run whole (kernels split across the pool) and split by
+ * rows into one data-parallel worker per pool thread. */
+static void bench_data_parallel(bench_t *bench, const char *spec, size_t batch) {
+    size_t sizes[MAX_MLP_LAYERS + 1];
+    size_t count = parse_sizes(spec, sizes, MAX_MLP_LAYERS + 1);
+    if (count < 2) return;
+
+    data_parallel_ctx_t ctx;
+    ctx.network = network_create();
+    for (size_t i = 0; i + 1 < count; i++) {
+        network_add_dense(ctx.network, sizes[i], sizes[i + 1], i + 2 == count ? ACTIVATION_NONE : ACTIVATION_RELU);
+    }
+    network_build(ctx.network, batch);
+    ctx.trainer = trainer_create(ctx.network, 0);
+    ctx.optimizer = adam_create(1e-4f, count - 1);
+    ctx.input = tensor_create(batch, sizes[0]);
+    ctx.targets = tensor_create(batch, sizes[count - 1]);
+    tensor_random(ctx.input, -1.0f, 1.0f);
+    tensor_random(ctx.targets, 0.0f, 1.0f);
+
+    char params[192];
+    snprintf(params, sizeof(params), "\"layers\": \"%s\", \"batch\": %zu, \"workers\": %zu",
+             spec, batch, ctx.trainer->num_workers);
+    run_case(bench, "network_train_step", params, network_step_case, &ctx, (double)batch, "samples/s");
+    run_case(bench, "trainer_step", params, trainer_step_case, &ctx, (double)batch, "samples/s");
+
+    trainer_destroy(ctx.trainer);
+    network_destroy(ctx.network);
+    adam_destroy(ctx.optimizer);
+    tensor_destroy(ctx.input);
+    tensor_destroy(ctx.targets);
+}
+
+/* A deep stack of equal layers trained with every output kept and with
+ * checkpoints every 2, sqrt(N) and 8 layers. The overhead is the recomputed
+ * forward work over a step's forward and backward FLOPs. */
+static void bench_checkpoint(bench_t *bench) {
+    static const size_t intervals[] = {1, 2, NETWORK_CHECKPOINT_SQRT, 8};
+    const size_t depth = 16, width = 512, batch = 256;
+
+    for (size_t c = 0; c < sizeof(intervals) / sizeof(intervals[0]); c++) {
+        data_parallel_ctx_t ctx;
+        ctx.network = network_create();
+        for (size_t i = 0; i < depth; i++) network_add_dense(ctx.network, width, width, ACTIVATION_RELU);
+        network_checkpoint(ctx.network, intervals[c]);
+        network_build(ctx.network, batch);
+        ctx.trainer = NULL;
+        ctx.optimizer = adam_create(1e-4f, depth);
+        ctx.input = tensor_create(batch, width);
+        ctx.targets = tensor_create(batch, width);
+        tensor_random(ctx.input, -1.0f, 1.0f);
+        tensor_random(ctx.targets, 0.0f, 1.0f);
+
+        double step_flops = 3.0 * depth * (2.0 * width + 2.0) * width;
+        char params[256];
+        snprintf(params, sizeof(params), "\"layers\": %zu, \"width\": %zu, \"batch\": %zu, "
+                 "\"interval\": %zu, \"activation_mb\": %.2f, \"recompute_overhead\": %.3f",
+                 depth, width, batch, ctx.network->checkpoint_interval,
+                 ctx.network->arena_bytes / (1024.0 * 1024.0), ctx.network->recompute_flops / step_flops);
+        run_case(bench, "checkpoint_train_step", params, network_step_case, &ctx, (double)batch, "samples/s");
+
+        network_destroy(ctx.network);
+        adam_destroy(ctx.optimizer);
+        tensor_destroy(ctx.input);
+        tensor_destroy(ctx.targets);
+    }
+}
+
+#define HOGWILD_EPOCHS 5
+#define HOGWILD_SAMPLES 4096
+
+static void print_curve(FILE *out, const char *key, const float *losses) {
+    fprintf(out, ", \"%s\": [", key);
+    for (int e = 0; e < HOGWILD_EPOCHS; e++) fprintf(out, "%s%.6f", e ? ", " : "", losses[e]);
+    fprintf(out, "]");
+}
+
+/* Synchronous SGD on batches of workers * batch rows against Hogwild with
+ * batch rows per worker, from the same initial weights over the same data:
+ * epoch throughput and the mean loss of each epoch. Targets come from a
+ * random linear teacher so the loss has somewhere to go. */
+static void bench_hogwild(bench_t *bench, const char *spec, size_t batch) {
+    if (bench->filter && !strstr("hogwild", bench->filter)) return;
+    size_t sizes[MAX_MLP_LAYERS + 1];
+    size_t count = parse_sizes(spec, sizes, MAX_MLP_LAYERS + 1);
+    if (count < 2) return;
+
+    size_t workers = threadpool_num_threads();
+    network_t *network = network_create();
+    for (size_t i = 0; i + 1 < count; i++) {
+        network_add_dense(network, sizes[i], sizes[i + 1], i + 2 == count ? ACTIVATION_NONE : ACTIVATION_RELU);
+    }
+    if (!network_build(network, workers * batch)) {
+        network_destroy(network);
+        return;
+    }
+    trainer_t *trainer = trainer_create(network, workers);
+    sgd_optimizer_t *sync = sgd_create_momentum(0.01f, 0.9f, 0.0f);
+    size_t count_params = network->params->count;
+    float *initial = (float*)malloc(count_params * sizeof(float));
+    tensor_t *x = tensor_create(HOGWILD_SAMPLES, sizes[0]);
+    tensor_t *teacher = tensor_create(sizes[0], sizes[count - 1]);
+    tensor_t *y = tensor_create(HOGWILD_SAMPLES, sizes[count - 1]);
+    if (!trainer || !sync || !initial || !x || !teacher || !y) goto done;
+
+    memcpy(initial, network->params->values, count_params * sizeof(float));
+    tensor_random(x, -1.0f, 1.0f);
+    tensor_random(teacher, -1.0f, 1.0f);
+    tensor_scale(teacher, 1.0f / (float)sizes[0]);
+    tensor_matmul_into(x, teacher, y);
+
+    float sync_loss[HOGWILD_EPOCHS], hogwild_loss[HOGWILD_EPOCHS];
+    double sync_seconds = 0.0, hogwild_seconds = 0.0;
+    size_t rows = workers * batch;
+    for (int e = 0; e < HOGWILD_EPOCHS; e++) {
+        float total = 0.0f;
+        size_t steps = 0;
+        double start = now_seconds();
+        for (size_t row = 0; row < HOGWILD_SAMPLES; row += rows, steps++) {
+            size_t n = HOGWILD_SAMPLES - row < rows ? HOGWILD_SAMPLES - row : rows;
+            tensor_t xb = tensor_rows(x, row, n), yb = tensor_rows(y, row, n);
+            total += trainer_step_sgd(trainer, &xb, &yb, NETWORK_LOSS_MSE, sync);
+        }
+        sync_seconds += now_seconds() - start;
+        sync_loss[e] = total / (float)steps;
+    }
+
+    memcpy(network->params->values, initial, count_params * sizeof(float));
+    for (int e = 0; e < HOGWILD_EPOCHS; e++) {
+        trainer_stats_t stats;
+        trainer_hogwild_epoch(trainer, x, y, batch, NETWORK_LOSS_MSE, sync, &stats);
+        hogwild_seconds += stats.seconds;
+        hogwild_loss[e] = stats.loss;
+    }
+
+    double samples = (double)HOGWILD_SAMPLES * HOGWILD_EPOCHS;
+    fprintf(bench->out, "%s\n    {\"name\": \"hogwild\", \"params\": {\"layers\": \"%s\", "
+            "\"batch\": %zu, \"workers\": %zu, \"samples\": %d, \"epochs\": %d}, "
+            "\"sync_samples/s\": %.3f, \"hogwild_samples/s\": %.3f",
+            bench->first ? "" : ",", spec, batch, workers, HOGWILD_SAMPLES, HOGWILD_EPOCHS,
+            samples / sync_seconds, samples / hogwild_seconds);
+    print_curve(bench->out, "sync_loss", sync_loss);
+    print_curve(bench->out, "hogwild_loss", hogwild_loss);
+    fprintf(bench->out, "}");
+    bench->first = 0;
+    fflush(bench->out);
+
+done:
+    trainer_destroy(trainer);
+    network_destroy(network);
+    sgd_destroy(sync);
+    free(initial);
+    tensor_destroy(x);
+    tensor_destroy(teacher);
+    tensor_destroy(y);
+}
+
+#define SERVE_CLIENTS 16
+#define SERVE_REQUESTS 200
+
+typedef struct {
+    const char *path;
+    size_t cols, out_cols;
+    int failures;
+} serve_client_t;
+
+static void* serve_client(void *arg) {
+    serve_client_t *c = (serve_client_t*)arg;
+    float *x = (float*)calloc(c->cols, sizeof(float));
+    float *y = (float*)calloc(c->out_cols, sizeof(float));
+    int fd = server_connect(c->path);
+    for (uint32_t i = 0; i < SERVE_REQUESTS; i++) {
+        x[i % c->cols] = (float)i;
+        if (fd < 0 || !server_infer(fd, i, x, 1, c->cols, y, c->out_cols)) c->failures++;
+    }
+    if (fd >= 0) close(fd);
+    free(x);
+    free(y);
+    return NULL;
+}
+
+static void* serve_main(void *arg) {
+    server_run((server_t*)arg);
+    return NULL;
+}
+
+/* SERVE_CLIENTS concurrent clients sending single-row requests to a server
+ * with max_batch 1 (no batching) and with dynamic batching up to batch. */
+static void bench_serve(bench_t *bench, const char *spec, size_t batch) {
+    if (bench->filter && !strstr("serve", bench->filter)) return;
+    size_t sizes[MAX_MLP_LAYERS + 1];
+    size_t count = parse_sizes(spec, sizes, MAX_MLP_LAYERS + 1);
+    if (count < 2) return;
+
+    dense_layer_t *layers[MAX_MLP_LAYERS];
+    for (size_t i = 0; i + 1 < count; i++) {
+        layers[i] = layer_create(sizes[i], sizes[i + 1], i + 2 == count ? ACTIVATION_NONE : ACTIVATION_RELU);
+    }
+    inference_model_t *model = inference_model_create(layers, count - 1);
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/tiny_nn_bench_%d.sock", (int)getpid());
+
+    size_t limits[2] = {1, batch};
+    for (int k = 0; k < 2 && model; k++) {
+        server_config_t config = {path, limits[k], 200};
+        server_t *server = server_create(model, &config);
+        if (!server) break;
+        pthread_t thread, clients[SERVE_CLIENTS];
+        serve_client_t ctx[SERVE_CLIENTS];
+        pthread_create(&thread, NULL, serve_main, server);
+
+        double start = now_seconds();
+        for (int c = 0; c < SERVE_CLIENTS; c++) {
+            ctx[c] = (serve_client_t){path, sizes[0], sizes[count - 1], 0};
+            pthread_create(&clients[c], NULL, serve_client, &ctx[c]);
+        }
+        int failures = 0;
+        for (int c = 0; c < SERVE_CLIENTS; c++) {
+            pthread_join(clients[c], NULL);
+            failures += ctx[c].failures;
+        }
+        double seconds = now_seconds() - start;
+        server_stop(server);
+        pthread_join(thread, NULL);
+
+        server_stats_t stats;
+        server_get_stats(server, &stats);
+        char json[4096];
+        server_format_stats(&stats, json, sizeof(json));
+        fprintf(bench->out, "%s\n    {\"name\": \"serve\", \"params\": {\"layers\": \"%s\", "
+                "\"max_batch\": %zu, \"max_wait_us\": %u, \"clients\": %d}, \"failures\": %d, "
+                "\"requests/s\": %.3f, \"server\": %s}",
+                bench->first ? "" : ",", spec, config.max_batch, config.max_wait_us, SERVE_CLIENTS,
+                failures, (double)stats.requests / seconds, json);
+        bench->first = 0;
+        fflush(bench->out);
+        server_destroy(server);
+    }
+
+    inference_model_destroy(model);
+    for (size_t i = 0; i + 1 < count; i++) layer_destroy(layers[i]);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--reps N] [--warmup N] [--filter NAME] [--out FILE]\n"
+            "          [--mlp 784,256,128,10] [--batch N] [--trace FILE]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    bench_t bench = {5, 50, NULL, stdout, 1, NULL};
+    const char *mlp = "784,256,128,10";
+    const char *trace = NULL;
+    size_t batch = 128;
+
+    for (int i = 1; i < argc; i++) {
+        int has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--reps") == 0 && has_value) bench.repetitions = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0 && has_value) bench.warmup = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--filter") == 0 && has_value) bench.filter = argv[++i];
+        else if (strcmp(argv[i], "--mlp") == 0 && has_value) mlp = argv[++i];
+        else if (strcmp(argv[i], "--batch") == 0 && has_value) batch = (size_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "--trace") == 0 && has_value) trace = argv[++i];
+        else if (strcmp(argv[i], "--out") == 0 && has_value) {
+            bench.out = fopen(argv[++i], "w");
+            if (!bench.out) {
+                fprintf(stderr, "Failed to open %s\n", argv[i]);
+                return 1;
+            }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (bench.repetitions < 1 || bench.warmup < 0 || batch == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (trace && !profile_enabled()) {
+        fprintf(stderr, "--trace needs a build with make clean && make PROFILE=1\n");
+        return 1;
+    }
+
+    threadpool_init(0);
+    bench.samples = (double*)malloc((size_t)bench.repetitions * sizeof(double));
+    if (!bench.samples) return 1;
+
+    fprintf(bench.out, "{\n  \"isa\": \"%s\",\n  \"int8_kernel\": \"%s\",\n  \"threads\": %zu,\n"
+            "  \"warmup\": %d,\n  \"repetitions\": %d,\n  \"results\": [",
+            gemm_isa_name(gemm_get_isa()), quant_kernel_name(quant_get_kernel()), threadpool_num_threads(), bench.warmup, bench.repetitions);
+
+    bench_matmul(&bench);
+    bench_layers(&bench);
+    bench_sparse(&bench);
+    bench_optimizers(&bench);
+    bench_allocators(&bench);
+    bench_random(&bench);
+    bench_losses(&bench);
+    int ok = bench_mlp(&bench, mlp, batch);
+    if (ok) bench_data_parallel(&bench, mlp, batch);
+    bench_checkpoint(&bench);
+    if (ok) bench_hogwild(&bench, mlp, batch);
+    if (ok) bench_serve(&bench, mlp, batch);
+
+    fprintf(bench.out, "\n  ]\n}\n");
+    /* Per-op totals go to stderr so the JSON report stays clean. */
+    if (trace) {
+        profile_report(stderr);
+        if (!profile_write_trace(trace)) ok = 0;
+    }
+    if (bench.out != stdout) fclose(bench.out);
+    free(bench.samples);
+    threadpool_shutdown();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Where tensor storage, parameter arenas, optimizer state and network
+ * activation arenas get their memory. An allocator is a backend (alloc and
+ * release of zeroed, 64-byte aligned blocks) plus statistics kept by
+ * allocator_alloc and allocator_free. Every block remembers its allocator,
+ * so switching the tensor allocator never frees memory through the wrong
+ * backend.
+ *
+ * The built-in Linux backend (allocator_create_linux) maps blocks of at
+ * least huge_threshold bytes on their own 2 MiB boundary and asks for
+ * transparent huge pages there (madvise MADV_HUGEPAGE), or for hugetlbfs
+ * pages first with ALLOCATOR_HUGETLB. With ALLOCATOR_FIRST_TOUCH blocks are
+ * zeroed on the thread pool in the chunks threadpool_parallel_for gives a
+ * sweep over the same floats, so on a NUMA host each page lands on the node
+ * of the worker that updates it in elementwise and optimizer loops. That
+ * placement holds while workers stay on their nodes (pin them with taskset
+ * or numactl). */
+
+#define ALLOCATOR_ALIGN 64
+#define ALLOCATOR_HUGE_PAGE_SIZE ((size_t)2 << 20)
+/* Smaller blocks would waste too much of their last huge page. */
+#define ALLOCATOR_HUGE_THRESHOLD ((size_t)4 << 20)
+
+typedef enum {
+    ALLOCATOR_HUGE_PAGES = 1,   /* THP-advised mappings at or above the threshold */
+    ALLOCATOR_HUGETLB = 2,      /* try reserved hugetlbfs pages before THP */
+    ALLOCATOR_FIRST_TOUCH = 4   /* zero blocks on the pool, partitioned like its sweeps */
+} allocator_flags_t;
+
+typedef struct {
+    size_t bytes_in_use;        /* requested bytes of live blocks */
+    size_t peak_bytes;          /* high-water mark of bytes_in_use */
+    size_t huge_bytes;          /* mapped for live huge-page blocks, in whole 2 MiB pages */
+    uint64_t allocations;       /* blocks handed out so far */
+} allocator_stats_t;
+
+typedef struct allocator allocator_t;
+struct allocator {
+    /* Backend: bytes of zeroed memory aligned to ALLOCATOR_ALIGN, or NULL;
+     * release gets the same byte count back. Both may run on any thread. */
+    void* (*alloc)(allocator_t *self, size_t bytes);
+    void (*release)(allocator_t *self, void *block, size_t bytes);
+    void *ctx;
+    unsigned flags;             /* allocator_flags_t, for the built-in backend */
+    size_t huge_threshold;
+    allocator_stats_t stats;    /* updated atomically; read with allocator_stats */
+};
+
+/* posix_memalign and memset: what tensors used before allocators. */
+allocator_t* allocator_system(void);
+/* The Linux backend with the given flags; huge_threshold 0 picks
+ * ALLOCATOR_HUGE_THRESHOLD. Flags it cannot honour on this platform are
+ * ignored. */
+allocator_t* allocator_create_linux(unsigned flags, size_t huge_threshold);
+/* A custom backend; stats start at zero. */
+allocator_t* allocator_create(void* (*alloc)(allocator_t*, size_t),
+                              void (*release)(allocator_t*, void*, size_t), void *ctx);
+/* Only once every block from the allocator has been freed. */
+void allocator_destroy(allocator_t *allocator);
+
+/* bytes of zeroed memory aligned to ALLOCATOR_ALIGN. */
+void* allocator_alloc(allocator_t *allocator, size_t bytes);
+/* Returns a block to the allocator it came from; NULL is ignored. */
+void allocator_free(void *data);
+
+allocator_stats_t allocator_stats(const allocator_t *allocator);
+/* Restarts peak_bytes from the current bytes_in_use. */
+void allocator_reset_peak(allocator_t *allocator);
+
+/* The allocator tensor_create, param arenas, optimizer state and network
+ * arenas draw from; NULL restores allocator_system. Blocks already handed
+ * out stay with their allocator. */
+void allocator_set_tensor(allocator_t *allocator);
+allocator_t* allocator_tensor(void);
+
+#endif
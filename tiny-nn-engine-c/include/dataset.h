@@ -0,0 +1,59 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tensor.h"
+
+/* On-disk layout (little-endian):
+ *   bytes 0..63   header: magic "TNNDATA", version, sample/feature/target counts
+ *   features      num_samples x num_features float32, row-major, 64-byte aligned
+ *   targets       num_samples x num_targets float32, row-major, 64-byte aligned
+ * Features and targets are separate blocks so any contiguous range of samples
+ * can be viewed straight out of the mapping. */
+#define DATASET_MAGIC "TNNDATA"
+#define DATASET_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t num_samples;
+    uint64_t num_features;
+    uint64_t num_targets;
+    uint64_t features_offset;
+    uint64_t targets_offset;
+    uint8_t reserved[8];
+} dataset_header_t;
+
+typedef struct {
+    size_t num_samples;
+    size_t num_features;
+    size_t num_targets;
+    const float *features;
+    const float *targets;
+    void *map;
+    size_t map_size;
+} dataset_t;
+
+int dataset_write(const char *path, const tensor_t *features, const tensor_t *targets);
+dataset_t* dataset_open(const char *path);
+void dataset_close(dataset_t *dataset);
+
+typedef struct dataset_loader dataset_loader_t;
+
+/* Iterates mini-batches of up to batch_size rows. A background thread prepares
+ * the next batch while the current one is in use: sequential loaders return
+ * zero-copy views into the mapping and only prefetch its pages, shuffled
+ * loaders gather rows of a per-epoch permutation into one of two buffers. */
+dataset_loader_t* dataset_loader_create(const dataset_t *dataset, size_t batch_size,
+                                        int shuffle, uint64_t seed);
+/* Returns 1 and sets x/y (valid until the next call), or 0 once the epoch is
+ * exhausted; the following call starts the next epoch. Batches are
+ * read-only: sequential ones point into the PROT_READ mapping, so copy a
+ * batch (tensor_copy) before transforming it in place. */
+int dataset_loader_next(dataset_loader_t *loader, const tensor_t **x, const tensor_t **y);
+size_t dataset_loader_batches_per_epoch(const dataset_loader_t *loader);
+void dataset_loader_destroy(dataset_loader_t *loader);
+
+#endif
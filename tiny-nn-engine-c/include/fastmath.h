@@ -0,0 +1,40 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include <stddef.h>
+
+/* Accuracy of a transcendental, chosen per call.
+ *   MATH_PRECISE  libm expf/logf/tanhf, one element at a time.
+ *   MATH_FAST     range reduction plus a minimax polynomial, 8 or 16 lanes at
+ *                 a time on AVX2 / AVX-512. The vector and scalar code run the
+ *                 same operations in the same order, so results are
+ *                 bit-identical on every ISA and for any array split.
+ *
+ * MATH_FAST error against libm in double precision, measured over every
+ * float (tests/test_fastmath.c checks a sample against the same bounds):
+ *   exp      relative 8.2e-8 on [-87.3, 88]. Inputs are clamped to that
+ *            range, so exp(x > 88) is 1.65e38 rather than infinity.
+ *   log      relative 8.2e-8 on positive normals; 0 and denormals give -inf,
+ *            negatives NaN, +inf itself.
+ *   sigmoid  relative 1.5e-7, absolute 9e-8.
+ *   tanh     absolute 8e-8, relative 1.5e-7 for |x| >= 1e-3.
+ * That is about one unit in the last place (FLT_EPSILON is 1.19e-7).
+ * NaN inputs give NaN. */
+typedef enum {
+    MATH_PRECISE,
+    MATH_FAST
+} math_mode_t;
+
+/* dst may alias src. */
+void math_exp(float *dst, const float *src, size_t n, math_mode_t mode);
+void math_log(float *dst, const float *src, size_t n, math_mode_t mode);
+void math_sigmoid(float *dst, const float *src, size_t n, math_mode_t mode);
+void math_tanh(float *dst, const float *src, size_t n, math_mode_t mode);
+
+/* Scalar forms of the MATH_FAST kernels. */
+float math_fast_expf(float x);
+float math_fast_logf(float x);
+float math_fast_sigmoidf(float x);
+float math_fast_tanhf(float x);
+
+#endif
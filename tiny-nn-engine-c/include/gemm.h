@@ -0,0 +1,101 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <stddef.h>
+#include "half.h"
+
+typedef enum {
+    GEMM_ISA_SCALAR,
+    GEMM_ISA_SSE,
+    GEMM_ISA_AVX2,
+    GEMM_ISA_AVX512
+} gemm_isa_t;
+
+typedef enum {
+    GEMM_NO_TRANS,
+    GEMM_TRANS
+} gemm_trans_t;
+
+typedef enum {
+    GEMM_ACT_NONE,
+    GEMM_ACT_RELU,
+    GEMM_ACT_SIGMOID
+} gemm_activation_t;
+
+/* Applied to each output tile after the last K block: C = act(C + bias). */
+typedef struct {
+    const float *bias;              /* n entries broadcast over rows, or NULL */
+    gemm_activation_t activation;
+} gemm_epilogue_t;
+
+/* C = alpha * op(A) * op(B) + beta * C, all row-major. op(A) is m x k, op(B) is
+ * k x n, C is m x n. With GEMM_TRANS the operand is read in its stored layout
+ * (A stored k x m, B stored n x k), so no transposed copy is needed.
+ * When beta is 0, C is never read. */
+void gemm_sgemm(gemm_trans_t trans_a, gemm_trans_t trans_b,
+                size_t m, size_t n, size_t k,
+                float alpha,
+                const float *a, size_t lda,
+                const float *b, size_t ldb,
+                float beta,
+                float *c, size_t ldc);
+
+/* gemm_sgemm followed by a fused epilogue. Bias and ReLU are applied in the
+ * micro-kernel registers; sigmoid runs on the tile while it is still in L1. */
+void gemm_sgemm_fused(gemm_trans_t trans_a, gemm_trans_t trans_b,
+                      size_t m, size_t n, size_t k,
+                      float alpha,
+                      const float *a, size_t lda,
+                      const float *b, size_t ldb,
+                      float beta,
+                      float *c, size_t ldc,
+                      const gemm_epilogue_t *epilogue);
+
+/* gemm_sgemm_fused over operands stored in any precision. A and B are
+ * widened to fp32 while they are packed; accumulation and C stay fp32. */
+void gemm_mixed_fused(gemm_trans_t trans_a, gemm_trans_t trans_b,
+                      size_t m, size_t n, size_t k,
+                      float alpha,
+                      const void *a, precision_t a_type, size_t lda,
+                      const void *b, precision_t b_type, size_t ldb,
+                      float beta,
+                      float *c, size_t ldc,
+                      const gemm_epilogue_t *epilogue);
+
+/* op(B) packed once into the column panels the micro-kernel reads, for an
+ * operand multiplied many times over, such as layer weights. Each panel of
+ * nr columns runs over all k rows, so the layout depends only on the panel
+ * width of the kernel selected when packing. A zeroed struct is empty. */
+typedef struct {
+    float *data;
+    size_t k, n;
+    size_t nr;                  /* 0 while empty */
+    size_t capacity;            /* floats allocated */
+} gemm_packed_t;
+
+/* Packs op(B), k x n and stored in b_type, widening it to fp32. Reuses the
+ * allocation when it is large enough; returns 0 when allocation fails. */
+int gemm_pack_b(gemm_packed_t *packed, gemm_trans_t trans_b, size_t k, size_t n,
+                const void *b, precision_t b_type, size_t ldb);
+/* 1 when packed holds panels for the micro-kernel selected now; panels
+ * packed before a gemm_set_isa to a kernel of another width are stale. */
+int gemm_packed_current(const gemm_packed_t *packed);
+void gemm_packed_release(gemm_packed_t *packed);
+
+/* gemm_mixed_fused with B taken from current panels: m x packed->n output
+ * over packed->k. Skips packing B, and reads it with unit stride. */
+void gemm_packed_fused(gemm_trans_t trans_a, size_t m, float alpha,
+                       const void *a, precision_t a_type, size_t lda,
+                       const gemm_packed_t *b,
+                       float beta,
+                       float *c, size_t ldc,
+                       const gemm_epilogue_t *epilogue);
+
+/* Best ISA supported by this CPU, or the one forced through TINY_NN_GEMM_ISA. */
+gemm_isa_t gemm_get_isa(void);
+/* Forces a micro-kernel. Requests above what the CPU supports are clamped;
+ * returns the ISA actually selected. */
+gemm_isa_t gemm_set_isa(gemm_isa_t isa);
+const char* gemm_isa_name(gemm_isa_t isa);
+
+#endif
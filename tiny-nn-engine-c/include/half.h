@@ -0,0 +1,31 @@
+#ifndef HALF_H
+#define HALF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Storage precisions. Arithmetic is always fp32; the 16-bit formats only
+ * change how values are kept in memory.
+ *   bf16  the top half of an fp32: same range, 8-bit mantissa. Rounded to
+ *         nearest even; fp32 denormals become zero and NaNs stay quiet NaNs,
+ *         matching the AVX512-BF16 instructions.
+ *   fp16  IEEE binary16: range +-65504, 11-bit mantissa, with denormals.
+ *         Rounded to nearest even, overflow goes to infinity (as F16C). */
+typedef enum {
+    PRECISION_FP32,
+    PRECISION_BF16,
+    PRECISION_FP16
+} precision_t;
+
+size_t precision_size(precision_t precision);
+const char* precision_name(precision_t precision);
+
+uint16_t half_from_float(float value, precision_t precision);
+float half_to_float(uint16_t value, precision_t precision);
+
+/* Bulk conversions, vectorized with F16C / AVX512-BF16 / AVX2 when the CPU
+ * has them. Results are bit-identical to the scalar functions. */
+void half_convert_from_float(uint16_t *dst, const float *src, size_t n, precision_t precision);
+void half_convert_to_float(float *dst, const uint16_t *src, size_t n, precision_t precision);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef INFERENCE_H
+#define INFERENCE_H
+
+#include "layer.h"
+
+/* Forward-only view of a trained network. Weights are frozen at creation and
+ * never written again, and the model keeps no per-call state: activations
+ * live in a scratch buffer supplied per call, so any number of threads may
+ * run inference_forward on one model at the same time. */
+typedef struct {
+    size_t input_size;
+    size_t output_size;
+    const void *weights;        /* input x output, row-major, stored in precision */
+    const float *bias;
+    precision_t precision;
+    activation_type_t activation;
+    gemm_packed_t packed;       /* fp32 weights in GEMM panels, see inference_model_pack */
+} inference_layer_t;
+
+typedef struct {
+    inference_layer_t *layers;
+    size_t num_layers;
+    size_t input_size;
+    size_t output_size;
+    size_t max_hidden;      /* widest intermediate activation */
+    precision_t precision;  /* storage of hidden activations between layers */
+    void *storage;          /* owned copy of every weight and bias */
+    void *map;              /* read-only file mapping instead, see model_load */
+    size_t map_size;
+} inference_model_t;
+
+/* Ping-pong activation buffers for batches of up to max_batch rows, plus an
+ * fp32 tile of INFERENCE_ROW_BLOCK rows when activations are kept in 16 bits. */
+#define INFERENCE_ROW_BLOCK 256
+
+typedef struct {
+    float *data;
+    size_t max_batch;
+    size_t capacity;        /* floats */
+} inference_scratch_t;
+
+/* Copies the layers' current parameters into one 64-byte aligned block, so
+ * the training layers can keep training or be destroyed afterwards. */
+inference_model_t* inference_model_create(dense_layer_t **layers, size_t num_layers);
+/* Same, with weights and hidden activations stored as bf16 or fp16. Every
+ * GEMM still accumulates in fp32; biases and the output stay fp32. */
+inference_model_t* inference_model_create_precision(dense_layer_t **layers, size_t num_layers,
+                                                    precision_t precision);
+void inference_model_destroy(inference_model_t *model);
+
+/* Packs the weights of every fp32 layer into the selected GEMM kernel's
+ * panels, which inference_forward then reads instead of packing them on
+ * every call. Creation already does this; model_load does not, so mapped
+ * models keep sharing the file's pages unless this is called. Call it again
+ * after gemm_set_isa, until then the unpacked weights are used. 16-bit layers are
+ * left as they are: they are read at half the bytes. Not safe while other
+ * threads run the model. Returns 0 when allocation fails. */
+int inference_model_pack(inference_model_t *model);
+
+inference_scratch_t* inference_scratch_create(const inference_model_t *model, size_t max_batch);
+void inference_scratch_destroy(inference_scratch_t *scratch);
+
+/* Writes the network output for input (batch x input_size) into output
+ * (batch x output_size), both owned by the caller. With scratch == NULL a
+ * grow-only thread-local buffer is used. Returns 0 on a shape mismatch. */
+int inference_forward(const inference_model_t *model, const tensor_t *input,
+                      tensor_t *output, inference_scratch_t *scratch);
+
+#endif
@@ -1,6 +1,9 @@
 #ifndef LAYER_H
 #define LAYER_H
+#include <pthread.h>
 #include "tensor.h"
+#include "gemm.h"
+#include "sparse.h"
 
 typedef enum {
     ACTIVATION_NONE,
@@ -8,28 +11,99 @@ typedef enum {
     ACTIVATION_SIGMOID
 } activation_type_t;
 
+/* Forward panels of fp32 weights. A layer and every layer created from it
+ * with layer_create_shared use one set, rebuilt once per weights version by
+ * whichever forward first sees the version move. */
+typedef struct {
+    pthread_mutex_t lock;       /* held while checking and repacking */
+    gemm_packed_t panels;
+    uint64_t version;           /* *weights_version when they were packed */
+} layer_packed_t;
+
 typedef struct {
     tensor_t *weights;
     tensor_t *bias;
-    tensor_t *input;
-    tensor_t *output;
-    tensor_t *pre_activation;
+    const tensor_t *input;      /* borrowed: must stay alive until layer_backward */
+    tensor_t *output;           /* activation derivatives are taken from here */
+    tensor_t *grad_activation;
+    tensor_t *grad_input;
     tensor_t *grad_weights;
     tensor_t *grad_bias;
     
     activation_type_t activation;
+    size_t max_batch;           /* 0 until layer_reserve, buffers reallocated per call */
+
+    precision_t precision;      /* storage of half_weights, FP32 when there is none */
+    uint16_t *half_weights;     /* 16-bit copy of weights read by forward and backward */
+    int owns_half_weights;      /* 0 when the copy lives in a param arena */
+
+    const sparse_tensor_t *sparse_input;    /* set instead of input by layer_forward_sparse */
+    uint32_t *grad_rows;        /* weight-gradient rows written by the last sparse backward */
+    size_t num_grad_rows;
+    unsigned char *row_marks;   /* input_size scratch flags for sparse_columns */
+    int sparse_grad;            /* grad_weights is zero outside grad_rows */
+
+    uint64_t version;           /* weights_version of a standalone layer */
+    uint64_t *weights_version;  /* bumped on every weight change; shared with
+                                   the source layer or param arena */
+    layer_packed_t packed;      /* unused by shared layers */
+    layer_packed_t *packed_weights; /* &packed, or the source layer's */
+    int packing;                /* 0 makes layer_forward read the plain weights */
 } dense_layer_t;
 
 dense_layer_t* layer_create(size_t input_size, size_t output_size, activation_type_t activation);
+/* A layer that reads source's weights, bias, 16-bit copy and forward panels
+ * in place, with its own gradients and workspaces, for running one model on
+ * several threads. source must outlive it. */
+dense_layer_t* layer_create_shared(const dense_layer_t *source);
 void layer_destroy(dense_layer_t *layer);
 
+/* Sizes output and gradient workspaces once for up to max_batch rows.
+ * Afterwards forward and backward make no heap allocations, and the tensor
+ * returned by layer_backward is owned by the layer instead of the caller. */
+int layer_reserve(dense_layer_t *layer, size_t max_batch);
+/* layer_reserve with the three workspaces placed in caller-owned memory of
+ * max_batch rows each (output and grad_activation are max_batch x output,
+ * grad_input max_batch x input). The buffers may alias other layers' as long
+ * as their contents are not needed at the same time; see network_build. */
+int layer_bind(dense_layer_t *layer, float *output, float *grad_activation, float *grad_input,
+               size_t max_batch);
+
+/* Keeps a bf16 or fp16 copy of the weights for the forward and input-gradient
+ * GEMMs, which widen it back to fp32 while packing. The fp32 weights stay the
+ * master copy: optimizers update them and refresh the 16-bit copy in the same
+ * pass. After changing weights any other way call layer_sync_weights.
+ * PRECISION_FP32 drops the copy. */
+int layer_set_precision(dense_layer_t *layer, precision_t precision);
+void layer_sync_weights(dense_layer_t *layer);
+
+/* FP32 layers keep their weights packed into the GEMM kernel's panels
+ * between updates, so layer_forward skips packing them. The panels are
+ * rebuilt on the first forward after the weights' version moves: optimizers,
+ * layer_set_precision and layer_sync_weights bump it through this call, so
+ * direct writes to weights also need layer_sync_weights. Clearing packing
+ * skips the panels, for callers that update weights while other threads run
+ * forward (Hogwild). */
+void layer_weights_changed(dense_layer_t *layer);
+
+/* Xavier draws uniform weights in +-sqrt(6 / (in + out)); He draws normal
+ * weights with stddev sqrt(2 / in), for ReLU layers. */
 void layer_xavier_init(dense_layer_t *layer);
 void layer_he_init(dense_layer_t *layer);
 
 tensor_t* layer_forward(dense_layer_t *layer, const tensor_t *input);
+/* layer_forward for a CSR batch, at O(nnz * output) instead of
+ * O(batch * input * output). The following layer_backward then builds the
+ * weight gradient only in the rows of features the batch uses (grad_rows),
+ * zeroing the rows the previous sparse batch used, and returns NULL: the
+ * gradient with respect to a sparse input is not formed. Scratch for the row
+ * list is allocated on the first sparse backward. */
+tensor_t* layer_forward_sparse(dense_layer_t *layer, const sparse_tensor_t *input);
 
 tensor_t* layer_backward(dense_layer_t *layer, const tensor_t *grad_output);
 
 size_t layer_param_count(const dense_layer_t *layer);
+/* GEMM epilogue activation matching a layer activation. */
+gemm_activation_t layer_gemm_activation(activation_type_t activation);
 
 #endif
\ No newline at end of file
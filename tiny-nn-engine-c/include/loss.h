@@ -6,4 +6,30 @@ float loss_mse(const tensor_t *predictions, const tensor_t *targets);
 float loss_binary_crossentropy(const tensor_t *predictions, const tensor_t *targets);
 void loss_mse_derivative(const tensor_t *predictions, const tensor_t *targets, tensor_t *grad);
 void loss_bce_derivative(const tensor_t *predictions, const tensor_t *targets, tensor_t *grad);
+
+/* Binary cross-entropy of sigmoid(logits), for a linear output layer. The
+ * loss never forms the probabilities, so it stays finite for any logit, and
+ * the gradient with respect to the logits is (sigmoid(z) - t) / n directly,
+ * instead of the BCE gradient divided back through s * (1 - s). */
+float loss_bce_with_logits(const tensor_t *logits, const tensor_t *targets, math_mode_t mode);
+void loss_bce_with_logits_derivative(const tensor_t *logits, const tensor_t *targets,
+                                     tensor_t *grad, math_mode_t mode);
+
+/* Loss and gradient in one sweep: each returns the loss of the matching
+ * function above and writes the matching derivative into grad, reading the
+ * operands once. Every loss sums in vector lanes with blocked pairwise
+ * summation, split over the thread pool for large outputs, so the value
+ * does not depend on the thread count and its error grows with log(n). */
+float loss_mse_with_grad(const tensor_t *predictions, const tensor_t *targets, tensor_t *grad);
+float loss_bce_with_grad(const tensor_t *predictions, const tensor_t *targets, tensor_t *grad);
+float loss_bce_logits_with_grad(const tensor_t *logits, const tensor_t *targets,
+                                tensor_t *grad, math_mode_t mode);
+
+/* Cross-entropy of softmax over each row of logits against target
+ * distributions (one-hot rows for class labels), averaged over rows. Like
+ * the logits BCE it never forms log(0): the row max is subtracted before
+ * exp. The gradient with respect to the logits is (softmax(z) - t) / rows. */
+float loss_softmax_crossentropy(const tensor_t *logits, const tensor_t *targets, math_mode_t mode);
+float loss_softmax_crossentropy_with_grad(const tensor_t *logits, const tensor_t *targets,
+                                          tensor_t *grad, math_mode_t mode);
 #endif
\ No newline at end of file
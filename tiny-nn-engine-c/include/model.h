@@ -0,0 +1,52 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include <stdint.h>
+#include "layer.h"
+#include "inference.h"
+
+/* On-disk layout (little-endian):
+ *   bytes 0..63   header: magic "TNNMODEL", version, layer count, file size
+ *   layer table   num_layers model_layer_record_t, directly after the header
+ *   blobs         per layer: weights (input x output, row-major) in the
+ *                 record's precision, then the float32 bias, each starting
+ *                 on a 64-byte boundary
+ * Version 1 files predate the precision field and are always float32.
+ * Loading maps the file read-only and points the model's layers straight at
+ * the blobs, so processes serving the same file share one page-cache copy
+ * and only fault in what they read. The fp32 weights are left unpacked and
+ * inference_forward packs them per call; inference_model_pack opts out of
+ * that at the cost of a private copy of every fp32 weight in each process,
+ * built by reading the whole file at once. */
+#define MODEL_MAGIC "TNNMODEL"
+#define MODEL_VERSION 2
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t num_layers;
+    uint32_t record_size;
+    uint64_t file_size;
+    uint8_t reserved[32];
+} model_header_t;
+
+typedef struct {
+    uint64_t input_size;
+    uint64_t output_size;
+    uint64_t weights_offset;
+    uint64_t bias_offset;
+    uint32_t activation;
+    uint32_t precision;         /* precision_t of the weights blob */
+    uint8_t reserved[8];
+} model_layer_record_t;
+
+int model_save(const char *path, dense_layer_t **layers, size_t num_layers);
+/* Stores the weights as bf16 or fp16; the loaded model also keeps its hidden
+ * activations in that precision. */
+int model_save_precision(const char *path, dense_layer_t **layers, size_t num_layers,
+                         precision_t precision);
+/* Returns a frozen model backed by the mapping; inference_model_destroy unmaps it. */
+inference_model_t* model_load(const char *path);
+
+#endif
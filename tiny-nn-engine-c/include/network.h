@@ -0,0 +1,99 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include "layer.h"
+#include "params.h"
+#include "optimizer.h"
+
+/* NETWORK_LOSS_BCE_LOGITS is binary cross-entropy for a linear
+ * (ACTIVATION_NONE) last layer, see loss_bce_with_logits; apply
+ * tensor_sigmoid to the output to read probabilities.
+ * NETWORK_LOSS_SOFTMAX_CE is the multi-class form over one-hot target rows,
+ * also on a linear last layer; the largest output is the predicted class. */
+typedef enum {
+    NETWORK_LOSS_MSE,
+    NETWORK_LOSS_BCE,
+    NETWORK_LOSS_BCE_LOGITS,
+    NETWORK_LOSS_SOFTMAX_CE
+} network_loss_t;
+
+/* An ordered stack of dense layers trained as one model.
+ *
+ * network_build plans every activation and gradient buffer of a training step
+ * for max_batch rows. Each buffer's lifetime runs from the step that writes it
+ * to the last step that reads it:
+ *   output i          forward i .. activation backward of layer i
+ *   loss gradient     loss .. activation backward of the last layer
+ *   grad_activation i activation backward i .. input gradient of layer i
+ *   grad_input i      input gradient i .. activation backward of layer i - 1
+ * Buffers whose lifetimes do not overlap share memory in a single arena, so a
+ * training step makes no allocations and its footprint is fixed at build.
+ *
+ * With checkpointing (network_checkpoint) only the output of every
+ * checkpoint_interval-th layer, and the last, is kept until backward. The
+ * others only live until the next layer has read them, and network_backward
+ * recomputes them from the segment's kept input just before that segment's
+ * backward. Activation memory drops from O(layers) to
+ * O(layers / interval + interval) outputs, at the cost of recompute_flops per
+ * sample. */
+typedef struct {
+    dense_layer_t **layers;
+    size_t num_layers;
+    size_t capacity;
+    size_t max_batch;           /* 0 until network_build */
+    param_arena_t *params;
+    float *arena;
+    size_t arena_bytes;         /* planned activation and gradient memory */
+    size_t unplanned_bytes;     /* the same buffers without sharing */
+    tensor_t *loss_grad;        /* view into the arena */
+    math_mode_t math;           /* loss transcendentals; MATH_PRECISE by default */
+    size_t checkpoint_interval; /* 1 (the default) keeps every output */
+    double recompute_flops;     /* extra forward FLOPs per sample in each backward */
+} network_t;
+
+/* network_checkpoint interval that keeps round(sqrt(layers)) outputs apart. */
+#define NETWORK_CHECKPOINT_SQRT 0
+
+network_t* network_create(void);
+/* Destroys the network and every layer it owns. */
+void network_destroy(network_t *network);
+
+/* Appends a layer and takes ownership of it. Only valid before network_build. */
+int network_add(network_t *network, dense_layer_t *layer);
+dense_layer_t* network_add_dense(network_t *network, size_t input_size, size_t output_size,
+                                 activation_type_t activation);
+
+/* Keeps one layer output in every interval, NETWORK_CHECKPOINT_SQRT picking
+ * round(sqrt(layers)). Only valid before network_build; replicas inherit it. */
+int network_checkpoint(network_t *network, size_t interval);
+
+/* Checks layer widths, moves the parameters into a param arena and lays out
+ * the activation arena for batches of up to max_batch rows. */
+int network_build(network_t *network, size_t max_batch);
+
+/* A network over the same parameters as a built network, with its own
+ * gradient block and an activation arena planned for max_batch rows. Weight
+ * updates made through either are seen by both; network must outlive it. */
+network_t* network_replicate(const network_t *network, size_t max_batch);
+
+/* The returned tensors live in the arena and stay valid until the next
+ * network_backward. */
+const tensor_t* network_forward(network_t *network, const tensor_t *input);
+/* network_forward with a CSR batch fed to the first layer (see
+ * layer_forward_sparse); network_backward then returns NULL. */
+const tensor_t* network_forward_sparse(network_t *network, const sparse_tensor_t *input);
+/* Loss of the last forward output against targets; also writes its gradient,
+ * in the same pass, which network_backward(network, NULL) then uses. */
+float network_loss(network_t *network, const tensor_t *targets, network_loss_t loss);
+/* Backpropagates grad_output, or the gradient left by network_loss when NULL.
+ * Returns the gradient with respect to the network input. */
+const tensor_t* network_backward(network_t *network, const tensor_t *grad_output);
+
+/* Forward, loss, backward and one adam_step_params over the whole model. */
+float network_train_step(network_t *network, const tensor_t *input, const tensor_t *targets,
+                         network_loss_t loss, adam_optimizer_t *optimizer);
+
+size_t network_input_size(const network_t *network);
+size_t network_output_size(const network_t *network);
+
+#endif
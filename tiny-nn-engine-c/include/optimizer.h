@@ -2,9 +2,14 @@
 #define OPTIMIZER_H
 
 #include "layer.h"
+#include "params.h"
 
 typedef struct {
     float learning_rate;
+    float momentum;
+    float weight_decay;
+    float *velocity;        /* whole-model momentum, allocated on the first sgd_step_params */
+    size_t size;
 } sgd_optimizer_t;
 
 typedef struct {
@@ -12,22 +17,35 @@ typedef struct {
     float beta1;
     float beta2;
     float epsilon;
+    float weight_decay;     /* decoupled (AdamW) when non-zero */
     int timestep;
     tensor_t **m_weights;
     tensor_t **v_weights;
     tensor_t **m_bias;
     tensor_t **v_bias;
-    
+
     size_t num_layers;
+
+    float *m;               /* whole-model moments used by adam_step_params */
+    float *v;
+    size_t size;
 } adam_optimizer_t;
 
 
 sgd_optimizer_t* sgd_create(float learning_rate);
+sgd_optimizer_t* sgd_create_momentum(float learning_rate, float momentum, float weight_decay);
+/* Per-layer update. Momentum state is kept per model, so momentum SGD needs sgd_step_params.
+ * After a sparse-input backward without weight decay only the weight rows in
+ * the layer's grad_rows are updated. */
 void sgd_step(sgd_optimizer_t *opt, dense_layer_t *layer);
+void sgd_step_params(sgd_optimizer_t *opt, param_arena_t *params);
 void sgd_destroy(sgd_optimizer_t *opt);
 
 adam_optimizer_t* adam_create(float learning_rate, size_t num_layers);
+adam_optimizer_t* adamw_create(float learning_rate, float weight_decay, size_t num_layers);
 void adam_step(adam_optimizer_t *opt, dense_layer_t **layers, size_t num_layers);
+/* One vectorized sweep over every parameter in the arena. */
+void adam_step_params(adam_optimizer_t *opt, param_arena_t *params);
 void adam_destroy(adam_optimizer_t *opt);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,39 @@
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include "layer.h"
+
+/* Every weight and bias of a model in one 64-byte aligned block, with the
+ * gradients in a second block of the same layout. After param_arena_create
+ * the layers' weights/bias/grad tensors are views into these blocks, so an
+ * optimizer can update the whole model in one sweep. */
+typedef struct {
+    float *values;
+    float *grads;
+    uint16_t *half_values;  /* 16-bit copy of values, see param_arena_set_precision */
+    precision_t precision;
+    size_t count;           /* floats per block, including alignment padding */
+    size_t num_layers;
+    int owns_values;        /* 0 for param_arena_share: values belong to the source */
+    uint64_t version;       /* values_version of an arena that owns its values */
+    uint64_t *values_version;   /* the layers' weights_version; optimizers bump it */
+} param_arena_t;
+
+/* Moves the current parameters of the layers into a new arena. The arena must
+ * outlive any use of the layers; destroying either first is safe. */
+param_arena_t* param_arena_create(dense_layer_t **layers, size_t num_layers);
+/* An arena over the same values (and 16-bit copy) as source with its own
+ * zeroed gradient block of the same layout. The layers, which must have the
+ * source layers' shapes, are pointed at it, so each can accumulate private
+ * gradients against shared weights. source must outlive the result. */
+param_arena_t* param_arena_share(const param_arena_t *source, dense_layer_t **layers,
+                                 size_t num_layers);
+void param_arena_destroy(param_arena_t *arena);
+
+/* Gives every layer of the arena a bf16/fp16 weight copy (layer_set_precision)
+ * held in one block of the same layout, which sgd_step_params and
+ * adam_step_params refresh while they update the fp32 values. */
+int param_arena_set_precision(param_arena_t *arena, dense_layer_t **layers, size_t num_layers,
+                              precision_t precision);
+
+#endif
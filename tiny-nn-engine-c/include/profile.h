@@ -0,0 +1,123 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Hot-path profiler for the public ops in tensor.c, layer.c, loss.c and
+ * optimizer.c.
+ *
+ * Built only with -DTINY_NN_PROFILE (make PROFILE=1 after a make clean).
+ * Without it the PROFILE_* macros expand to nothing: the ops carry no
+ * timestamps, calls or argument evaluation, and the query functions below
+ * report zeros.
+ *
+ * Every thread records into its own buffer, so recording takes no locks.
+ * A call adds to its op's counters and appends one trace event; events past
+ * PROFILE_MAX_EVENTS per thread are dropped and counted, the counters keep
+ * going. Times come from CLOCK_MONOTONIC.
+ *
+ * seconds is inclusive; self_seconds leaves out time spent in profiled ops
+ * called from inside it on the same thread. FLOPs and bytes are estimates
+ * from the shapes (a transcendental counts as one FLOP) and are charged to
+ * the op that does the work, never to its callers, so they add up across
+ * ops. Calls that fail validation are not recorded, and thin wrappers such
+ * as tensor_matmul or tensor_copy show up as the ops they call.
+ *
+ * Query, reset and write while no profiled op is running. */
+
+#define PROFILE_MAX_EVENTS 65536
+
+typedef enum {
+    PROFILE_TENSOR_CREATE,
+    PROFILE_TENSOR_FILL,
+    PROFILE_TENSOR_RANDOM,
+    PROFILE_TENSOR_RANDOM_NORMAL,
+    PROFILE_TENSOR_COPY_DATA,
+    PROFILE_TENSOR_ADD,
+    PROFILE_TENSOR_SUBTRACT,
+    PROFILE_TENSOR_MULTIPLY,
+    PROFILE_TENSOR_SCALE,
+    PROFILE_TENSOR_MATMUL,
+    PROFILE_TENSOR_MATMUL_TN,
+    PROFILE_TENSOR_MATMUL_NT,
+    PROFILE_TENSOR_TRANSPOSE,
+    PROFILE_TENSOR_RELU,
+    PROFILE_TENSOR_RELU_DERIVATIVE,
+    PROFILE_TENSOR_SIGMOID,
+    PROFILE_TENSOR_SIGMOID_DERIVATIVE,
+    PROFILE_TENSOR_TANH,
+    PROFILE_TENSOR_EXP,
+    PROFILE_TENSOR_LOG,
+    PROFILE_LAYER_CREATE,
+    PROFILE_LAYER_RESERVE,
+    PROFILE_LAYER_SET_PRECISION,
+    PROFILE_LAYER_SYNC_WEIGHTS,
+    PROFILE_LAYER_PACK_WEIGHTS,
+    PROFILE_LAYER_INIT,
+    PROFILE_LAYER_FORWARD,
+    PROFILE_LAYER_BACKWARD,
+    PROFILE_LOSS_MSE,
+    PROFILE_LOSS_BCE,
+    PROFILE_LOSS_BCE_LOGITS,
+    PROFILE_LOSS_MSE_DERIVATIVE,
+    PROFILE_LOSS_BCE_DERIVATIVE,
+    PROFILE_LOSS_BCE_LOGITS_DERIVATIVE,
+    PROFILE_LOSS_MSE_WITH_GRAD,
+    PROFILE_LOSS_BCE_WITH_GRAD,
+    PROFILE_LOSS_BCE_LOGITS_WITH_GRAD,
+    PROFILE_LOSS_SOFTMAX_CE,
+    PROFILE_OPTIMIZER_CREATE,
+    PROFILE_SGD_STEP,
+    PROFILE_ADAM_STEP,
+    PROFILE_NUM_OPS
+} profile_op_t;
+
+typedef struct {
+    uint64_t calls;
+    double seconds;
+    double self_seconds;
+    double flops;
+    double bytes;               /* read plus written */
+    double allocated;
+} profile_stats_t;
+
+/* 1 when built with TINY_NN_PROFILE. */
+int profile_enabled(void);
+const char* profile_op_name(profile_op_t op);
+
+/* Clears every thread's counters and events and restarts the trace clock. */
+void profile_reset(void);
+/* One op summed over all threads. */
+profile_stats_t profile_query(profile_op_t op);
+/* Events dropped because a thread's buffer was full. */
+uint64_t profile_dropped_events(void);
+/* A table of the ops that ran, in op order. */
+void profile_report(FILE *out);
+/* Chrome / Perfetto trace JSON: one complete ("X") event per call, one
+ * track per thread. Returns 1 on success. */
+int profile_write_trace(const char *path);
+
+/* Used by the macros. */
+typedef struct {
+    uint64_t start;
+    int depth;
+} profile_mark_t;
+
+profile_mark_t profile_begin(void);
+void profile_end(profile_op_t op, profile_mark_t mark, double flops, double bytes);
+void profile_alloc(profile_op_t op, double bytes);
+
+/* PROFILE_BEGIN(mark) opens a call; PROFILE_END closes it and charges it.
+ * An early return between the two simply leaves the call unrecorded. */
+#ifdef TINY_NN_PROFILE
+#define PROFILE_BEGIN(mark) profile_mark_t mark = profile_begin()
+#define PROFILE_END(op, mark, flops, bytes) profile_end((op), (mark), (double)(flops), (double)(bytes))
+#define PROFILE_ALLOC(op, bytes) profile_alloc((op), (double)(bytes))
+#else
+#define PROFILE_BEGIN(mark) ((void)0)
+#define PROFILE_END(op, mark, flops, bytes) ((void)0)
+#define PROFILE_ALLOC(op, bytes) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef QUANT_H
+#define QUANT_H
+
+#include <stdint.h>
+#include "layer.h"
+#include "inference.h"
+
+/* Symmetric int8 quantization for inference. Weights get one scale per output
+ * column, w ~= q * scale[n] with q in [-127, 127]. Activations are quantized
+ * per batch with a single dynamic scale taken from the batch's largest
+ * magnitude. Products accumulate exactly in int32; the epilogue dequantizes,
+ * adds the fp32 bias and applies the activation in one pass. */
+typedef enum {
+    QUANT_KERNEL_SCALAR,
+    QUANT_KERNEL_AVX2,          /* maddubs on |a| and sign(w, a) */
+    QUANT_KERNEL_AVX512_VNNI    /* vpdpbusd on a + 128 with a column-sum correction */
+} quant_kernel_t;
+
+#define QUANT_PANEL 16          /* output columns per packed weight panel */
+
+typedef struct {
+    size_t input_size;
+    size_t output_size;
+    size_t k_padded;            /* input_size rounded up to a multiple of 4 */
+    int8_t *weights;            /* panels of QUANT_PANEL columns, 4 inputs interleaved */
+    float *scales;              /* per output column */
+    int32_t *column_sums;       /* 128 * sum of each column's q, for the VNNI offset */
+    float *bias;
+    activation_type_t activation;
+} quant_layer_t;
+
+typedef struct {
+    quant_layer_t *layers;
+    size_t num_layers;
+    size_t input_size;
+    size_t output_size;
+    size_t max_width;           /* widest layer input or hidden output */
+} quant_model_t;
+
+typedef struct {
+    size_t samples;
+    float max_abs_error;        /* largest |int8 - fp32| over all outputs */
+    float mean_abs_error;
+    float fp32_accuracy;        /* against targets: argmax, or for one output > 0.5
+                                   (> 0 for a linear last layer; targets are 0/1) */
+    float int8_accuracy;
+    float accuracy_delta;       /* int8_accuracy - fp32_accuracy */
+    float agreement;            /* fraction of samples with the same predicted class */
+} quant_report_t;
+
+quant_model_t* quant_model_create(dense_layer_t **layers, size_t num_layers);
+quant_model_t* quant_model_from_inference(const inference_model_t *model);
+void quant_model_destroy(quant_model_t *model);
+
+/* Same contract as inference_forward: re-entrant, thread-local scratch,
+ * output (batch x output_size) owned by the caller. */
+int quant_forward(const quant_model_t *model, const tensor_t *input, tensor_t *output);
+
+/* Runs inputs through an fp32 inference_model_create copy of the layers and
+ * through the quantized model, and compares outputs and, when targets is
+ * non-NULL, accuracy. The copy is built on every call, which leaves the
+ * layers' own buffers alone and accepts any batch size; it costs one pass
+ * over the weights, small next to the forward passes it serves. */
+int quant_calibrate(const quant_model_t *model, dense_layer_t **layers, size_t num_layers,
+                    const tensor_t *inputs, const tensor_t *targets, quant_report_t *report);
+
+/* Kernel picked from the active GEMM ISA (see gemm_set_isa) and CPU features. */
+quant_kernel_t quant_get_kernel(void);
+const char* quant_kernel_name(quant_kernel_t kernel);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+#include "tensor.h"
+
+/* Counter-based random numbers: Philox4x32-10 (Salmon et al., "Parallel
+ * random numbers: as easy as 1, 2, 3"). A block is ten rounds of multiply
+ * and xor over a 128-bit counter under a 64-bit key, so value i of a stream
+ * is a pure function of (seed, stream, i). Nothing is shared between calls,
+ * any range can be generated on any thread, and a fill gives the same bits
+ * for every thread count and on every ISA; the AVX2 path runs eight blocks
+ * per instruction.
+ *
+ * The seed is the key and the stream fills the upper half of the counter,
+ * so each (seed, stream) pair is its own sequence of 2^64 blocks. Give each
+ * tensor, epoch or worker its own stream. */
+
+/* Runs the ten rounds on counter in place: the four output words. */
+void rng_philox4x32(uint32_t counter[4], const uint32_t key[2]);
+
+/* A sequential reader over one stream, for draws one at a time. */
+typedef struct {
+    uint32_t key[2];
+    uint64_t stream;
+    uint64_t block;             /* next counter block */
+    uint32_t words[4];
+    unsigned used;              /* words already returned from words */
+} rng_t;
+
+void rng_init(rng_t *rng, uint64_t seed, uint64_t stream);
+uint32_t rng_u32(rng_t *rng);
+/* Uniform in [0, 1), in steps of 2^-24. */
+float rng_uniform(rng_t *rng);
+/* Uniform integer in [0, n); n must be nonzero. */
+uint64_t rng_below(rng_t *rng, uint64_t n);
+
+/* Fills the tensor with min + (max - min) * u, u uniform in [0, 1), or with
+ * mean + stddev * z, z standard normal by Box-Muller from the same words
+ * (|z| stays below 5.8). Element (i, j) takes value i * cols + j of the
+ * stream whatever the stride, so a view and a contiguous copy of the same
+ * shape get the same values. Large tensors are filled on the thread pool. */
+void rng_fill_uniform(tensor_t *tensor, float min, float max, uint64_t seed, uint64_t stream);
+void rng_fill_normal(tensor_t *tensor, float mean, float stddev, uint64_t seed, uint64_t stream);
+
+/* The process-wide seed tensor_random and the layer initializers use; each
+ * call takes the next stream from a shared counter. Setting the seed also
+ * restarts the stream count, so the same seed and the same sequence of
+ * calls reproduce every value. The default seed is RNG_DEFAULT_SEED. */
+#define RNG_DEFAULT_SEED 0x5EEDull
+void rng_set_seed(uint64_t seed);
+uint64_t rng_seed(void);
+uint64_t rng_next_stream(void);
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "inference.h"
+
+/* Wire format on a Unix stream socket, native byte order. Every message is a
+ * 16-byte server_frame_t followed by its payload:
+ *   request    SERVER_REQUEST, rows x cols float32 inputs (cols = model input)
+ *   response   SERVER_RESPONSE, rows x cols float32 outputs (cols = model output)
+ *   error      SERVER_ERROR, no payload; rows and cols are 0
+ *   stats      SERVER_STATS with no payload asks for statistics; the reply is
+ *              SERVER_STATS with rows bytes of JSON (server_format_stats)
+ * Replies carry the request's id. A connection has one request in flight at
+ * a time, so replies arrive in order. */
+#define SERVER_REQUEST  0x514e4e54u     /* "TNNQ" */
+#define SERVER_RESPONSE 0x524e4e54u     /* "TNNR" */
+#define SERVER_ERROR    0x454e4e54u     /* "TNNE" */
+#define SERVER_STATS    0x534e4e54u     /* "TNNS" */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t id;
+    uint32_t rows;
+    uint32_t cols;
+} server_frame_t;
+
+typedef struct {
+    const char *socket_path;
+    size_t max_batch;           /* rows per forward pass, and per request */
+    unsigned max_wait_us;       /* how long a batch waits for more rows */
+} server_config_t;
+
+/* Bucket b of the latency histogram counts requests answered in
+ * [2^b, 2^(b+1)) microseconds (bucket 0 includes anything faster); bucket b
+ * of the batch histogram counts forward passes of [2^b, 2^(b+1)) rows. */
+#define SERVER_LATENCY_BUCKETS 32
+#define SERVER_BATCH_BUCKETS 24
+
+typedef struct {
+    uint64_t requests;
+    uint64_t rows;
+    uint64_t batches;
+    uint64_t errors;            /* malformed or oversized requests */
+    uint64_t max_batch_rows;
+    double forward_seconds;
+    uint64_t latency[SERVER_LATENCY_BUCKETS];
+    uint64_t batch_rows[SERVER_BATCH_BUCKETS];
+} server_stats_t;
+
+typedef struct server server_t;
+
+/* Serves a model over socket_path with dynamic batching.
+ *
+ * One thread per connection reads requests and queues them. A single
+ * batcher thread takes the queue in arrival order. Once the oldest request
+ * has waited max_wait_us, the queue holds max_batch rows, or every open
+ * connection has a request queued (so no more can arrive), it copies as
+ * many whole requests as fit into one input block and runs one
+ * inference_forward on it. The batcher copies each request's rows of the
+ * output into its connection, and the connection's own thread sends the
+ * reply, so a client that is slow to read never stalls the others. Latency
+ * runs from the moment a request has been read until its reply is ready to
+ * send, and a request is counted before its reply goes out.
+ *
+ * The model is borrowed. Creating binds and listens, replacing a stale
+ * socket file. */
+server_t* server_create(const inference_model_t *model, const server_config_t *config);
+/* Accepts connections until server_stop, then drains and joins every thread.
+ * Returns 1 on a clean stop. */
+int server_run(server_t *server);
+/* Async-signal-safe: makes server_run return. */
+void server_stop(server_t *server);
+/* Removes the socket file. Call after server_run has returned. */
+void server_destroy(server_t *server);
+
+void server_get_stats(server_t *server, server_stats_t *stats);
+/* Upper edge of the bucket holding the p-th percentile latency, in us. */
+double server_latency_percentile(const server_stats_t *stats, double p);
+/* JSON with the counters and both histograms; returns the length it needed,
+ * like snprintf. */
+size_t server_format_stats(const server_stats_t *stats, char *buffer, size_t size);
+
+/* Client side. server_connect returns a socket or -1. server_infer sends
+ * rows x cols inputs and waits for rows x out_cols outputs; returns 0 on an
+ * error reply or a broken connection. */
+int server_connect(const char *socket_path);
+int server_infer(int fd, uint32_t id, const float *input, size_t rows, size_t cols,
+                 float *output, size_t out_cols);
+/* Fetches the server's statistics JSON into buffer (NUL-terminated).
+ * Returns 0 when it does not fit or the connection fails. */
+int server_query_stats(int fd, char *buffer, size_t size);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tensor.h"
+#include "gemm.h"
+
+/* Compressed sparse rows. The nonzeros of row i are col_idx[k], values[k]
+ * for k in [row_ptr[i], row_ptr[i + 1]), with columns in increasing order.
+ * row_ptr indexes col_idx and values from their start, so a row range is a
+ * view that just starts row_ptr later (see sparse_rows). */
+typedef struct {
+    size_t *row_ptr;        /* rows + 1 entries */
+    uint32_t *col_idx;
+    float *values;
+    size_t rows;
+    size_t cols;
+    size_t capacity;        /* nonzeros col_idx and values have room for */
+    int owns_data;
+} sparse_tensor_t;
+
+/* rows x cols with no nonzeros and room for capacity of them. */
+sparse_tensor_t* sparse_create(size_t rows, size_t cols, size_t capacity);
+void sparse_destroy(sparse_tensor_t *sparse);
+/* The nonzeros of a dense tensor. */
+sparse_tensor_t* sparse_from_dense(const tensor_t *dense);
+void sparse_to_dense(const sparse_tensor_t *sparse, tensor_t *dense);
+
+/* A mini-batch of rows, returned by value like tensor_rows: nothing is
+ * allocated and it must not outlive sparse. */
+sparse_tensor_t sparse_rows(const sparse_tensor_t *sparse, size_t row, size_t rows);
+size_t sparse_nnz(const sparse_tensor_t *sparse);
+
+/* Reads a libsvm / svmlight text file, one sample per line:
+ *   <target> <index>:<value> <index>:<value> ...
+ * with 1-based increasing indices. num_features 0 takes the largest index
+ * seen. Targets come back as a num_samples x 1 tensor. */
+sparse_tensor_t* sparse_load_libsvm(const char *path, size_t num_features, tensor_t **targets);
+
+/* result = a * b for sparse a (m x k) and dense b (k x n), in O(nnz * n):
+ * every nonzero adds its scaled row of b into its output row. */
+void sparse_matmul_into(const sparse_tensor_t *a, const tensor_t *b, tensor_t *result);
+/* sparse_matmul_into with the bias and activation of a GEMM epilogue, which
+ * are applied while each output row is still in cache. */
+void sparse_matmul_fused(const sparse_tensor_t *a, const tensor_t *b, tensor_t *result,
+                         const gemm_epilogue_t *epilogue);
+
+/* The distinct columns a has nonzeros in, in first-seen order. marks has
+ * a->cols entries, must be zero and is left zero. Returns the count. */
+size_t sparse_columns(const sparse_tensor_t *a, uint32_t *columns, unsigned char *marks);
+/* Rows columns[0..count) of result = a^T * b, for the columns of a found by
+ * sparse_columns. Those are the only rows of a^T * b that can be nonzero;
+ * the rest of result is not touched, so this costs O(nnz * n). */
+void sparse_matmul_tn_rows(const sparse_tensor_t *a, const tensor_t *b, tensor_t *result,
+                           const uint32_t *columns, size_t count);
+
+#endif
@@ -2,18 +2,40 @@
 #define TENSOR_H
 
 #include <stddef.h>
+#include "fastmath.h"
 
+/* Row-major with a leading dimension: element (i, j) is data[i * stride + j].
+ * Tensors from tensor_create are contiguous (stride == cols) and their data is
+ * 64-byte aligned; views may have a wider stride and any alignment. */
 typedef struct {
     float *data;
     size_t rows;
     size_t cols;
+    size_t stride;
+    int owns_data;
 } tensor_t;
 
 tensor_t* tensor_create(size_t rows, size_t cols);
+/* Non-owning tensor over existing memory; tensor_destroy leaves data alone. */
+tensor_t* tensor_wrap(float *data, size_t rows, size_t cols);
+tensor_t* tensor_wrap_strided(float *data, size_t rows, size_t cols, size_t stride);
 void tensor_destroy(tensor_t *tensor);
 
+/* Views returned by value: nothing is allocated, so they are never passed to
+ * tensor_destroy and must not outlive the memory they point into. */
+tensor_t tensor_view(float *data, size_t rows, size_t cols, size_t stride);
+/* rows x cols starting at (row, col) of tensor; a mini-batch, row range or
+ * column block. Out-of-range requests print an error and return an empty view. */
+tensor_t tensor_block(const tensor_t *tensor, size_t row, size_t rows, size_t col, size_t cols);
+tensor_t tensor_rows(const tensor_t *tensor, size_t row, size_t rows);
+int tensor_is_contiguous(const tensor_t *tensor);
+
 void tensor_fill(tensor_t *tensor, float value);
+/* Uniform in [min, max) and normal draws from the process-wide seed, each
+ * call on its own stream (rng.h): reproducible for a given rng_set_seed and
+ * call order, and filled in parallel. */
 void tensor_random(tensor_t *tensor, float min, float max);
+void tensor_random_normal(tensor_t *tensor, float mean, float stddev);
 void tensor_zeros(tensor_t *tensor);
 void tensor_ones(tensor_t *tensor);
 
@@ -27,6 +49,11 @@ void tensor_multiply(const tensor_t *a, const tensor_t *b, tensor_t *result);
 void tensor_scale(tensor_t *tensor, float scalar);
 
 tensor_t* tensor_matmul(const tensor_t *a, const tensor_t *b);
+tensor_t* tensor_matmul_tn(const tensor_t *a, const tensor_t *b);
+tensor_t* tensor_matmul_nt(const tensor_t *a, const tensor_t *b);
+void tensor_matmul_into(const tensor_t *a, const tensor_t *b, tensor_t *result);
+void tensor_matmul_tn_into(const tensor_t *a, const tensor_t *b, tensor_t *result);
+void tensor_matmul_nt_into(const tensor_t *a, const tensor_t *b, tensor_t *result);
 tensor_t* tensor_transpose(const tensor_t *tensor);
 
 
@@ -35,4 +62,11 @@ void tensor_relu_derivative(const tensor_t *input, tensor_t *output);
 void tensor_sigmoid(const tensor_t *input, tensor_t *output);
 void tensor_sigmoid_derivative(const tensor_t *input, tensor_t *output);
 
+/* Elementwise transcendentals at the accuracy chosen by mode (fastmath.h).
+ * tensor_sigmoid is tensor_sigmoid_mode with MATH_PRECISE. */
+void tensor_sigmoid_mode(const tensor_t *input, tensor_t *output, math_mode_t mode);
+void tensor_tanh(const tensor_t *input, tensor_t *output, math_mode_t mode);
+void tensor_exp(const tensor_t *input, tensor_t *output, math_mode_t mode);
+void tensor_log(const tensor_t *input, tensor_t *output, math_mode_t mode);
+
 #endif
\ No newline at end of file
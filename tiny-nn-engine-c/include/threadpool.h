@@ -0,0 +1,30 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stddef.h>
+
+/* Element counts below this run inline on the calling thread. */
+#define THREADPOOL_GRAIN 16384
+
+typedef void (*threadpool_task_fn)(void *ctx, size_t begin, size_t end);
+typedef float (*threadpool_reduce_fn)(void *ctx, size_t begin, size_t end);
+
+/* Starts the global pool. 0 picks TINY_NN_THREADS or the online CPU count.
+ * Calling it again resizes the pool. Returns 1 on success. */
+int threadpool_init(size_t num_threads);
+void threadpool_shutdown(void);
+size_t threadpool_num_threads(void);
+
+/* Runs fn over [0, count) in contiguous ranges of at least grain items.
+ * Runs inline when the range is small, the pool has one thread, or the pool
+ * is already busy (nested or concurrent callers). Range i goes to the same
+ * pool thread on every call with the same count and grain, unless that
+ * thread is late and another takes it over. */
+void threadpool_parallel_for(size_t count, size_t grain, threadpool_task_fn fn, void *ctx);
+
+/* Sums fn over fixed blocks of [0, count), adding the partial sums pairwise.
+ * Block boundaries and the order in which partial sums are combined depend
+ * only on count, so the result is identical for every thread count. */
+float threadpool_reduce_sum(size_t count, threadpool_reduce_fn fn, void *ctx);
+
+#endif
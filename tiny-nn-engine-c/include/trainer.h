@@ -0,0 +1,72 @@
+#ifndef TRAINER_H
+#define TRAINER_H
+
+#include "network.h"
+
+/* Data-parallel training of one network on the thread pool.
+ *
+ * A step splits the batch into num_workers contiguous row shards. Worker 0
+ * runs the network itself; the others run network_replicate copies that read
+ * the same weights and keep their own activations and gradient blocks. Each
+ * worker is one pool task, so the kernels inside it stay on its thread.
+ *
+ * Every worker's gradients are weighted by its share of the batch, then
+ * summed into the network's gradient block by a pairwise tree in a fixed
+ * order: w += w + 1 for even w, then w += w + 2 for multiples of 4, and so
+ * on. The block is split across threads on cache-line boundaries and each
+ * thread runs the whole tree over one L1-sized tile at a time. A single
+ * adam_step_params then updates the shared weights.
+ *
+ * Shard boundaries and summation order depend only on num_workers and the
+ * batch size, so a step is bit-reproducible for a given worker count on any
+ * pool size. With one worker it matches network_train_step exactly. */
+typedef struct {
+    network_t *network;         /* borrowed */
+    network_t **workers;        /* workers[0] is network */
+    size_t num_workers;
+    float *losses;              /* per worker, last step or loss sum of the last pass */
+    size_t *batches;            /* per worker, mini-batches of the last Hogwild pass */
+    sgd_optimizer_t **sgd;      /* per worker Hogwild state, created on first use */
+} trainer_t;
+
+typedef struct {
+    size_t batches;
+    size_t samples;
+    double seconds;
+    float loss;                 /* mean mini-batch loss over the pass */
+} trainer_stats_t;
+
+/* num_workers 0 uses one per pool thread. network must be built; each
+ * replica plans activations for max_batch / num_workers rows (rounded up). */
+trainer_t* trainer_create(network_t *network, size_t num_workers);
+/* Destroys the replicas; the network is left alone. */
+void trainer_destroy(trainer_t *trainer);
+
+/* network_train_step over the workers: returns the loss of the whole batch. */
+float trainer_step(trainer_t *trainer, const tensor_t *input, const tensor_t *targets,
+                   network_loss_t loss, adam_optimizer_t *optimizer);
+/* The same step finished by one sgd_step_params. */
+float trainer_step_sgd(trainer_t *trainer, const tensor_t *input, const tensor_t *targets,
+                       network_loss_t loss, sgd_optimizer_t *optimizer);
+
+/* One asynchronous (Hogwild) pass over inputs/targets in order.
+ *
+ * Every worker claims the next batch_size rows with a relaxed atomic
+ * counter, runs forward and backward on its own buffers, and applies
+ * sgd_step_params with its own momentum state straight to the shared
+ * weights. Forward passes read the plain weights rather than the cached
+ * panels of layer_forward, which would have to be locked and repacked after
+ * every step, so nothing is locked and no worker waits for another. Updates
+ * are plain vector read-modify-writes: an aligned float is never torn, but
+ * two workers writing the same weight can lose one update, and forward
+ * passes read weights mid-update. SGD tolerates this on sparse-ish gradients, and
+ * results vary run to run.
+ *
+ * settings supplies learning rate, momentum and weight decay. batch_size is
+ * at most the replicas' max_batch, so build the network for num_workers
+ * times the per-worker batch. Returns 1 when every batch was applied. */
+int trainer_hogwild_epoch(trainer_t *trainer, const tensor_t *inputs, const tensor_t *targets,
+                          size_t batch_size, network_loss_t loss, const sgd_optimizer_t *settings,
+                          trainer_stats_t *stats);
+
+#endif
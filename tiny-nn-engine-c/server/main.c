@@ -0,0 +1,82 @@
+#define _POSIX_C_SOURCE 200112L
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "model.h"
+#include "server.h"
+#include "threadpool.h"
+
+static server_t *running_server = NULL;
+
+static void handle_stop(int signal) {
+    (void)signal;
+    if (running_server) server_stop(running_server);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s MODEL SOCKET [--max-batch N] [--max-wait-us N] [--threads N] [--pack]\n"
+            "Serves a model saved by tiny_nn until SIGINT or SIGTERM, then prints\n"
+            "latency and batch statistics as JSON. --pack keeps a private packed\n"
+            "copy of the fp32 weights instead of packing them on every batch.\n", prog);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    server_config_t config = {argv[2], 64, 200};
+    size_t threads = 0;
+    int pack = 0;
+    for (int i = 3; i < argc; i++) {
+        int has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--max-batch") == 0 && has_value) config.max_batch = (size_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "--max-wait-us") == 0 && has_value) config.max_wait_us = (unsigned)atol(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && has_value) threads = (size_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "--pack") == 0) pack = 1;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    inference_model_t *model = model_load(argv[1]);
+    if (!model) return 1;
+    if (pack && !inference_model_pack(model)) fprintf(stderr, "Packing failed; serving unpacked weights\n");
+    threadpool_init(threads);
+    server_t *server = server_create(model, &config);
+    if (!server) {
+        inference_model_destroy(model);
+        threadpool_shutdown();
+        return 1;
+    }
+
+    /* Without SA_RESTART so a signal also interrupts accept. */
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_stop;
+    sigemptyset(&action.sa_mask);
+    running_server = server;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    fprintf(stderr, "Serving %s on %s: %zu -> %zu, max batch %zu, max wait %u us\n",
+            argv[1], config.socket_path, model->input_size, model->output_size,
+            config.max_batch, config.max_wait_us);
+    int ok = server_run(server);
+
+    server_stats_t stats;
+    server_get_stats(server, &stats);
+    char json[4096];
+    server_format_stats(&stats, json, sizeof(json));
+    printf("%s\n", json);
+
+    running_server = NULL;
+    server_destroy(server);
+    inference_model_destroy(model);
+    threadpool_shutdown();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+#define _DEFAULT_SOURCE
+#include "allocator.h"
+#include "threadpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+/* Each block starts with a header naming its allocator, one alignment unit
+ * before the data handed out. */
+typedef struct {
+    allocator_t *owner;
+    size_t bytes;               /* as passed to the backend */
+} block_header_t;
+
+typedef char header_fits[sizeof(block_header_t) <= ALLOCATOR_ALIGN ? 1 : -1];
+
+/* Blocks starting on 2 MiB boundaries would put the streams of one sweep
+ * (values, gradients, both Adam moments) in the same cache sets. Successive
+ * huge-page blocks start a page and a line further in, cycling through
+ * HUGE_COLORS offsets. */
+#define HUGE_COLOR_STEP (4096 + ALLOCATOR_ALIGN)
+#define HUGE_COLORS 16
+
+static size_t next_color = 0;
+
+static size_t round_up(size_t bytes, size_t unit) {
+    return (bytes + unit - 1) / unit * unit;
+}
+
+/* Zeroes a block in the chunks a pool sweep over the same floats uses, so
+ * each page is first written by the worker that will process it. */
+static void zero_task(void *ctx, size_t begin, size_t end) {
+    memset((float*)ctx + begin, 0, (end - begin) * sizeof(float));
+}
+
+static void zero_block(const allocator_t *self, void *block, size_t bytes) {
+    if (self->flags & ALLOCATOR_FIRST_TOUCH) {
+        threadpool_parallel_for(bytes / sizeof(float), THREADPOOL_GRAIN, zero_task, block);
+        memset((char*)block + bytes / sizeof(float) * sizeof(float), 0, bytes % sizeof(float));
+    } else {
+        memset(block, 0, bytes);
+    }
+}
+
+/* Blocks the backend maps itself rather than taking from malloc. */
+static int huge_block(const allocator_t *self, size_t bytes) {
+#ifdef __linux__
+    return (self->flags & (ALLOCATOR_HUGE_PAGES | ALLOCATOR_HUGETLB)) && bytes >= self->huge_threshold;
+#else
+    (void)self;
+    (void)bytes;
+    return 0;
+#endif
+}
+
+#ifdef __linux__
+/* A 2 MiB aligned anonymous mapping, from hugetlbfs when asked and
+ * available, otherwise advised for transparent huge pages. The pages are
+ * not touched here. */
+static void* map_huge(const allocator_t *self, size_t size) {
+#ifdef MAP_HUGETLB
+    if (self->flags & ALLOCATOR_HUGETLB) {
+        void *block = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (block != MAP_FAILED) return block;
+    }
+#endif
+    /* Over-map by a huge page and trim both ends to the boundary. */
+    size_t span = size + ALLOCATOR_HUGE_PAGE_SIZE;
+    char *raw = (char*)mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == (char*)MAP_FAILED) return NULL;
+    char *block = (char*)round_up((size_t)raw, ALLOCATOR_HUGE_PAGE_SIZE);
+    if (block > raw) munmap(raw, (size_t)(block - raw));
+    if (raw + span > block + size) munmap(block + size, (size_t)(raw + span - (block + size)));
+#ifdef MADV_HUGEPAGE
+    madvise(block, size, MADV_HUGEPAGE);
+#endif
+    return block;
+}
+#endif
+
+static void* builtin_alloc(allocator_t *self, size_t bytes) {
+#ifdef __linux__
+    if (huge_block(self, bytes)) {
+        size_t color = __atomic_fetch_add(&next_color, 1, __ATOMIC_RELAXED) % HUGE_COLORS * HUGE_COLOR_STEP;
+        size_t size = round_up(bytes + color, ALLOCATOR_HUGE_PAGE_SIZE);
+        char *base = (char*)map_huge(self, size);
+        if (!base) return NULL;
+        void *block = base + color;
+        /* Fresh mappings are already zero; this only places the pages. */
+        if (self->flags & ALLOCATOR_FIRST_TOUCH) zero_block(self, block, bytes);
+        __atomic_add_fetch(&self->stats.huge_bytes, size, __ATOMIC_RELAXED);
+        return block;
+    }
+#endif
+    void *block = NULL;
+    if (posix_memalign(&block, ALLOCATOR_ALIGN, bytes ? bytes : ALLOCATOR_ALIGN) != 0) return NULL;
+    zero_block(self, block, bytes);
+    return block;
+}
+
+static void builtin_release(allocator_t *self, void *block, size_t bytes) {
+#ifdef __linux__
+    if (huge_block(self, bytes)) {
+        /* The color is less than a huge page, so the mapping starts at the
+         * boundary below the block. */
+        char *base = (char*)((size_t)block / ALLOCATOR_HUGE_PAGE_SIZE * ALLOCATOR_HUGE_PAGE_SIZE);
+        size_t size = round_up(bytes + (size_t)((char*)block - base), ALLOCATOR_HUGE_PAGE_SIZE);
+        munmap(base, size);
+        __atomic_sub_fetch(&self->stats.huge_bytes, size, __ATOMIC_RELAXED);
+        return;
+    }
+#endif
+    free(block);
+}
+
+static allocator_t system_allocator = {builtin_alloc, builtin_release, NULL, 0, 0, {0, 0, 0, 0}};
+static allocator_t *tensor_allocator = NULL;
+
+allocator_t* allocator_system(void) {
+    return &system_allocator;
+}
+
+allocator_t* allocator_create(void* (*alloc)(allocator_t*, size_t),
+                              void (*release)(allocator_t*, void*, size_t), void *ctx) {
+    allocator_t *allocator = (allocator_t*)calloc(1, sizeof(allocator_t));
+    if (!allocator) {
+        fprintf(stderr, "Failed to allocate allocator\n");
+        return NULL;
+    }
+    allocator->alloc = alloc;
+    allocator->release = release;
+    allocator->ctx = ctx;
+    return allocator;
+}
+
+allocator_t* allocator_create_linux(unsigned flags, size_t huge_threshold) {
+    allocator_t *allocator = allocator_create(builtin_alloc, builtin_release, NULL);
+    if (!allocator) return NULL;
+    allocator->flags = flags;
+    allocator->huge_threshold = huge_threshold ? huge_threshold : ALLOCATOR_HUGE_THRESHOLD;
+    return allocator;
+}
+
+void allocator_destroy(allocator_t *allocator) {
+    if (!allocator || allocator == &system_allocator) return;
+    if (allocator_stats(allocator).bytes_in_use) {
+        fprintf(stderr, "Destroying an allocator with live blocks\n");
+    }
+    if (allocator_tensor() == allocator) allocator_set_tensor(NULL);
+    free(allocator);
+}
+
+void* allocator_alloc(allocator_t *allocator, size_t bytes) {
+    size_t total = ALLOCATOR_ALIGN + bytes;
+    char *block = (char*)allocator->alloc(allocator, total);
+    if (!block) {
+        fprintf(stderr, "Failed to allocate %zu bytes\n", bytes);
+        return NULL;
+    }
+
+    block_header_t *header = (block_header_t*)block;
+    header->owner = allocator;
+    header->bytes = total;
+
+    allocator_stats_t *stats = &allocator->stats;
+    size_t in_use = __atomic_add_fetch(&stats->bytes_in_use, bytes, __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&stats->peak_bytes, __ATOMIC_RELAXED);
+    while (in_use > peak &&
+           !__atomic_compare_exchange_n(&stats->peak_bytes, &peak, in_use, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    __atomic_add_fetch(&stats->allocations, 1, __ATOMIC_RELAXED);
+    return block + ALLOCATOR_ALIGN;
+}
+
+void allocator_free(void *data) {
+    if (!data) return;
+    char *block = (char*)data - ALLOCATOR_ALIGN;
+    const block_header_t *header = (const block_header_t*)block;
+    allocator_t *allocator = header->owner;
+    size_t total = header->bytes;
+
+    __atomic_sub_fetch(&allocator->stats.bytes_in_use, total - ALLOCATOR_ALIGN, __ATOMIC_RELAXED);
+    allocator->release(allocator, block, total);
+}
+
+allocator_stats_t allocator_stats(const allocator_t *allocator) {
+    allocator_stats_t stats;
+    stats.bytes_in_use = __atomic_load_n(&allocator->stats.bytes_in_use, __ATOMIC_RELAXED);
+    stats.peak_bytes = __atomic_load_n(&allocator->stats.peak_bytes, __ATOMIC_RELAXED);
+    stats.huge_bytes = __atomic_load_n(&allocator->stats.huge_bytes, __ATOMIC_RELAXED);
+    stats.allocations = __atomic_load_n(&allocator->stats.allocations, __ATOMIC_RELAXED);
+    return stats;
+}
+
+void allocator_reset_peak(allocator_t *allocator) {
+    __atomic_store_n(&allocator->stats.peak_bytes,
+                     __atomic_load_n(&allocator->stats.bytes_in_use, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+void allocator_set_tensor(allocator_t *allocator) {
+    __atomic_store_n(&tensor_allocator, allocator, __ATOMIC_RELEASE);
+}
+
+allocator_t* allocator_tensor(void) {
+    allocator_t *allocator = __atomic_load_n(&tensor_allocator, __ATOMIC_ACQUIRE);
+    return allocator ? allocator : &system_allocator;
+}
@@ -0,0 +1,346 @@
+#define _POSIX_C_SOURCE 200112L
+#include "dataset.h"
+#include "rng.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DATASET_ALIGN 64
+
+static uint64_t align_up(uint64_t value) {
+    return (value + DATASET_ALIGN - 1) / DATASET_ALIGN * DATASET_ALIGN;
+}
+
+/* Writes a tensor's rows back to back, so views with a wider stride are
+ * stored as the contiguous block the header describes. */
+static int write_block(FILE *file, uint64_t offset, const tensor_t *tensor) {
+    if (fseek(file, (long)offset, SEEK_SET) != 0) return 0;
+    if (tensor_is_contiguous(tensor)) {
+        size_t count = tensor->rows * tensor->cols;
+        return fwrite(tensor->data, sizeof(float), count, file) == count;
+    }
+    for (size_t i = 0; i < tensor->rows; i++) {
+        if (fwrite(tensor->data + i * tensor->stride, sizeof(float), tensor->cols, file) != tensor->cols) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int dataset_write(const char *path, const tensor_t *features, const tensor_t *targets) {
+    if (features->rows != targets->rows) {
+        fprintf(stderr, "Dataset features and targets have different sample counts\n");
+        return 0;
+    }
+
+    dataset_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DATASET_MAGIC, sizeof(DATASET_MAGIC));
+    header.version = DATASET_VERSION;
+    header.header_size = sizeof(header);
+    header.num_samples = features->rows;
+    header.num_features = features->cols;
+    header.num_targets = targets->cols;
+    header.features_offset = align_up(sizeof(header));
+    header.targets_offset = align_up(header.features_offset +
+                                     header.num_samples * header.num_features * sizeof(float));
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open dataset %s for writing\n", path);
+        return 0;
+    }
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             write_block(file, header.features_offset, features) &&
+             write_block(file, header.targets_offset, targets);
+    if (fclose(file) != 0) ok = 0;
+
+    if (!ok) fprintf(stderr, "Failed to write dataset %s\n", path);
+    return ok;
+}
+
+/* Checks that a rows x cols float block lies inside the file on an aligned
+ * offset. Header fields come from the file, so the product is checked with a
+ * division before it is formed and the offset before it is subtracted. */
+static int block_valid(uint64_t offset, uint64_t rows, uint64_t cols, uint64_t file_size) {
+    if (offset % DATASET_ALIGN != 0 || offset > file_size) return 0;
+    if (cols != 0 && rows > UINT64_MAX / cols) return 0;
+    return rows * cols <= (file_size - offset) / sizeof(float);
+}
+
+dataset_t* dataset_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open dataset %s\n", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(dataset_header_t)) {
+        fprintf(stderr, "Dataset %s is too small\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map dataset %s\n", path);
+        return NULL;
+    }
+
+    const dataset_header_t *header = (const dataset_header_t*)map;
+    if (memcmp(header->magic, DATASET_MAGIC, sizeof(DATASET_MAGIC)) != 0 ||
+        header->version != DATASET_VERSION ||
+        !block_valid(header->features_offset, header->num_samples, header->num_features,
+                     (uint64_t)st.st_size) ||
+        !block_valid(header->targets_offset, header->num_samples, header->num_targets,
+                     (uint64_t)st.st_size)) {
+        fprintf(stderr, "Dataset %s has an invalid header\n", path);
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    dataset_t *dataset = (dataset_t*)malloc(sizeof(dataset_t));
+    if (!dataset) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    dataset->num_samples = header->num_samples;
+    dataset->num_features = header->num_features;
+    dataset->num_targets = header->num_targets;
+    dataset->features = (const float*)((const char*)map + header->features_offset);
+    dataset->targets = (const float*)((const char*)map + header->targets_offset);
+    dataset->map = map;
+    dataset->map_size = (size_t)st.st_size;
+    return dataset;
+}
+
+void dataset_close(dataset_t *dataset) {
+    if (!dataset) return;
+
+    munmap(dataset->map, dataset->map_size);
+    free(dataset);
+}
+
+typedef struct {
+    float *features;        /* gather buffers, NULL for sequential loaders */
+    float *targets;
+    tensor_t *x;
+    tensor_t *y;
+    int ready;
+} batch_slot_t;
+
+struct dataset_loader {
+    const dataset_t *dataset;
+    size_t batch_size;
+    size_t batches_per_epoch;
+    int shuffle;
+    uint64_t seed;
+    size_t *order;
+
+    batch_slot_t slots[2];
+    size_t fill_slot;
+    size_t take_slot;
+    int holding;
+    size_t position;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t slot_ready;
+    pthread_cond_t slot_free;
+    int stop;
+};
+
+/* Each epoch's order is its own stream under the loader's seed. */
+static void shuffle_order(dataset_loader_t *loader, uint64_t epoch) {
+    size_t n = loader->dataset->num_samples;
+    rng_t rng;
+    rng_init(&rng, loader->seed, epoch);
+
+    for (size_t i = 0; i < n; i++) loader->order[i] = i;
+    for (size_t i = n; i > 1; i--) {
+        size_t j = (size_t)rng_below(&rng, i);
+        size_t tmp = loader->order[i - 1];
+        loader->order[i - 1] = loader->order[j];
+        loader->order[j] = tmp;
+    }
+}
+
+/* Asks the kernel to start reading the pages behind the next view. */
+static void will_need(const void *addr, size_t bytes) {
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)addr & ~(page - 1);
+    posix_madvise((void*)start, bytes + ((uintptr_t)addr - start), POSIX_MADV_WILLNEED);
+}
+
+static void fill_slot(dataset_loader_t *loader, batch_slot_t *slot, size_t batch) {
+    const dataset_t *ds = loader->dataset;
+    size_t first = batch * loader->batch_size;
+    size_t rows = ds->num_samples - first < loader->batch_size ? ds->num_samples - first : loader->batch_size;
+
+    slot->x->rows = rows;
+    slot->y->rows = rows;
+
+    if (!loader->shuffle) {
+        const float *x = ds->features + first * ds->num_features;
+        const float *y = ds->targets + first * ds->num_targets;
+        /* Handed out as const; the mapping is read-only. */
+        slot->x->data = (float*)x;
+        slot->y->data = (float*)y;
+        will_need(x, rows * ds->num_features * sizeof(float));
+        will_need(y, rows * ds->num_targets * sizeof(float));
+        return;
+    }
+
+    for (size_t r = 0; r < rows; r++) {
+        size_t sample = loader->order[first + r];
+        memcpy(slot->features + r * ds->num_features, ds->features + sample * ds->num_features,
+               ds->num_features * sizeof(float));
+        memcpy(slot->targets + r * ds->num_targets, ds->targets + sample * ds->num_targets,
+               ds->num_targets * sizeof(float));
+    }
+}
+
+static void* prefetch_main(void *arg) {
+    dataset_loader_t *loader = (dataset_loader_t*)arg;
+    uint64_t epoch = 0;
+    size_t batch = 0;
+
+    for (;;) {
+        if (batch == 0 && loader->shuffle) shuffle_order(loader, epoch);
+
+        batch_slot_t *slot = &loader->slots[loader->fill_slot];
+        pthread_mutex_lock(&loader->lock);
+        while (slot->ready && !loader->stop) {
+            pthread_cond_wait(&loader->slot_free, &loader->lock);
+        }
+        int stop = loader->stop;
+        pthread_mutex_unlock(&loader->lock);
+        if (stop) break;
+
+        fill_slot(loader, slot, batch);
+
+        pthread_mutex_lock(&loader->lock);
+        slot->ready = 1;
+        pthread_cond_signal(&loader->slot_ready);
+        pthread_mutex_unlock(&loader->lock);
+
+        loader->fill_slot ^= 1;
+        if (++batch == loader->batches_per_epoch) {
+            batch = 0;
+            epoch++;
+        }
+    }
+    return NULL;
+}
+
+dataset_loader_t* dataset_loader_create(const dataset_t *dataset, size_t batch_size,
+                                        int shuffle, uint64_t seed) {
+    if (batch_size == 0 || dataset->num_samples == 0) {
+        fprintf(stderr, "Dataset loader needs a non-empty dataset and batch size\n");
+        return NULL;
+    }
+
+    dataset_loader_t *loader = (dataset_loader_t*)calloc(1, sizeof(dataset_loader_t));
+    if (!loader) return NULL;
+
+    loader->dataset = dataset;
+    loader->batch_size = batch_size;
+    loader->batches_per_epoch = (dataset->num_samples + batch_size - 1) / batch_size;
+    loader->shuffle = shuffle;
+    loader->seed = seed;
+
+    int ok = 1;
+    if (shuffle) {
+        loader->order = (size_t*)malloc(dataset->num_samples * sizeof(size_t));
+        ok = loader->order != NULL;
+    }
+    for (int s = 0; s < 2 && ok; s++) {
+        batch_slot_t *slot = &loader->slots[s];
+        if (shuffle) {
+            slot->features = (float*)malloc(batch_size * dataset->num_features * sizeof(float));
+            slot->targets = (float*)malloc(batch_size * dataset->num_targets * sizeof(float));
+            ok = slot->features && slot->targets;
+        }
+        slot->x = tensor_wrap(slot->features, batch_size, dataset->num_features);
+        slot->y = tensor_wrap(slot->targets, batch_size, dataset->num_targets);
+        ok = ok && slot->x && slot->y;
+    }
+
+    pthread_mutex_init(&loader->lock, NULL);
+    pthread_cond_init(&loader->slot_ready, NULL);
+    pthread_cond_init(&loader->slot_free, NULL);
+    if (!ok || pthread_create(&loader->thread, NULL, prefetch_main, loader) != 0) {
+        fprintf(stderr, "Failed to start dataset loader\n");
+        loader->stop = 1;
+        loader->thread = pthread_self();
+        dataset_loader_destroy(loader);
+        return NULL;
+    }
+
+    return loader;
+}
+
+int dataset_loader_next(dataset_loader_t *loader, const tensor_t **x, const tensor_t **y) {
+    pthread_mutex_lock(&loader->lock);
+
+    if (loader->holding) {
+        loader->slots[loader->take_slot ^ 1].ready = 0;
+        loader->holding = 0;
+        pthread_cond_signal(&loader->slot_free);
+    }
+    if (loader->position == loader->batches_per_epoch) {
+        loader->position = 0;
+        pthread_mutex_unlock(&loader->lock);
+        return 0;
+    }
+
+    batch_slot_t *slot = &loader->slots[loader->take_slot];
+    while (!slot->ready) {
+        pthread_cond_wait(&loader->slot_ready, &loader->lock);
+    }
+    loader->take_slot ^= 1;
+    loader->holding = 1;
+    loader->position++;
+    pthread_mutex_unlock(&loader->lock);
+
+    *x = slot->x;
+    *y = slot->y;
+    return 1;
+}
+
+size_t dataset_loader_batches_per_epoch(const dataset_loader_t *loader) {
+    return loader->batches_per_epoch;
+}
+
+void dataset_loader_destroy(dataset_loader_t *loader) {
+    if (!loader) return;
+
+    pthread_mutex_lock(&loader->lock);
+    loader->stop = 1;
+    pthread_cond_broadcast(&loader->slot_free);
+    pthread_mutex_unlock(&loader->lock);
+    if (!pthread_equal(loader->thread, pthread_self())) {
+        pthread_join(loader->thread, NULL);
+    }
+
+    for (int s = 0; s < 2; s++) {
+        tensor_destroy(loader->slots[s].x);
+        tensor_destroy(loader->slots[s].y);
+        free(loader->slots[s].features);
+        free(loader->slots[s].targets);
+    }
+    pthread_mutex_destroy(&loader->lock);
+    pthread_cond_destroy(&loader->slot_ready);
+    pthread_cond_destroy(&loader->slot_free);
+    free(loader->order);
+    free(loader);
+}
@@ -0,0 +1,400 @@
+#include "fastmath.h"
+#include "gemm.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FASTMATH_X86 1
+#include <immintrin.h>
+#endif
+
+/* exp(x) = 2^n * exp(r) with n = round(x / ln2) and |r| <= ln2 / 2. ln2 is
+ * split in two (C1 exact in a few bits) so x - n * ln2 loses nothing. Adding
+ * and removing 1.5 * 2^23 rounds to the nearest integer on every ISA. */
+#define EXP_HI 88.0f
+#define EXP_LO -87.33654f
+#define EXP_LOG2E 1.44269504088896341f
+#define EXP_C1 0.693359375f
+#define EXP_C2 -2.12194440e-4f
+#define ROUND_MAGIC 12582912.0f
+#define EXP_P0 1.9875691500e-4f
+#define EXP_P1 1.3981999507e-3f
+#define EXP_P2 8.3334519073e-3f
+#define EXP_P3 4.1665795894e-2f
+#define EXP_P4 1.6666665459e-1f
+#define EXP_P5 5.0000001201e-1f
+
+/* log(x) = e * ln2 + log(m) with m in [sqrt(1/2), sqrt(2)). */
+#define LOG_SQRTHF 0.707106781186547524f
+#define LOG_MIN_NORMAL 1.17549435e-38f
+#define LOG_P0 7.0376836292e-2f
+#define LOG_P1 -1.1514610310e-1f
+#define LOG_P2 1.1676998740e-1f
+#define LOG_P3 -1.2420140846e-1f
+#define LOG_P4 1.4249322787e-1f
+#define LOG_P5 -1.6668057665e-1f
+#define LOG_P6 2.0000714765e-1f
+#define LOG_P7 -2.4999993993e-1f
+#define LOG_P8 3.3333331174e-1f
+
+/* tanh(|x|) is an odd polynomial below 0.625 and 1 - 2 / (exp(2|x|) + 1)
+ * above; the sign of x is copied on afterwards. */
+#define TANH_SMALL 0.625f
+#define TANH_P0 -5.70498872745e-3f
+#define TANH_P1 2.06390887954e-2f
+#define TANH_P2 -5.37397155531e-2f
+#define TANH_P3 1.33314422036e-1f
+#define TANH_P4 -3.33332819422e-1f
+
+static uint32_t float_bits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+float math_fast_expf(float x) {
+    if (x != x) return x;
+    if (x > EXP_HI) x = EXP_HI;
+    if (x < EXP_LO) x = EXP_LO;
+
+    float n = (x * EXP_LOG2E + ROUND_MAGIC) - ROUND_MAGIC;
+    float r = x - n * EXP_C1;
+    r = r - n * EXP_C2;
+    float z = r * r;
+
+    float p = EXP_P0;
+    p = p * r + EXP_P1;
+    p = p * r + EXP_P2;
+    p = p * r + EXP_P3;
+    p = p * r + EXP_P4;
+    p = p * r + EXP_P5;
+    float y = p * z;
+    y = y + r;
+    y = y + 1.0f;
+
+    return y * bits_float((uint32_t)((int32_t)n + 127) << 23);
+}
+
+float math_fast_logf(float x) {
+    if (x != x) return x;
+    if (x < LOG_MIN_NORMAL) return x < 0.0f ? NAN : -INFINITY;
+    if (x == INFINITY) return x;
+
+    uint32_t bits = float_bits(x);
+    int32_t e = (int32_t)(bits >> 23) - 126;
+    float m = bits_float((bits & 0x007fffffu) | 0x3f000000u);
+    float f;
+    if (m < LOG_SQRTHF) {
+        e -= 1;
+        f = (m + m) - 1.0f;
+    } else {
+        f = m - 1.0f;
+    }
+    float fe = (float)e;
+    float z = f * f;
+
+    float p = LOG_P0;
+    p = p * f + LOG_P1;
+    p = p * f + LOG_P2;
+    p = p * f + LOG_P3;
+    p = p * f + LOG_P4;
+    p = p * f + LOG_P5;
+    p = p * f + LOG_P6;
+    p = p * f + LOG_P7;
+    p = p * f + LOG_P8;
+    float y = p * f;
+    y = y * z;
+    y = y + fe * EXP_C2;
+    y = y - 0.5f * z;
+    f = f + y;
+    return f + fe * EXP_C1;
+}
+
+float math_fast_sigmoidf(float x) {
+    return 1.0f / (1.0f + math_fast_expf(-x));
+}
+
+float math_fast_tanhf(float x) {
+    float a = fabsf(x), y;
+    if (a < TANH_SMALL) {
+        float z = a * a;
+        float p = TANH_P0;
+        p = p * z + TANH_P1;
+        p = p * z + TANH_P2;
+        p = p * z + TANH_P3;
+        p = p * z + TANH_P4;
+        y = p * z;
+        y = y * a;
+        y = y + a;
+    } else {
+        float e = math_fast_expf(a + a);
+        y = 1.0f - 2.0f / (e + 1.0f);
+    }
+    return bits_float(float_bits(y) | (float_bits(x) & 0x80000000u));
+}
+
+typedef enum {
+    MATH_OP_EXP,
+    MATH_OP_LOG,
+    MATH_OP_SIGMOID,
+    MATH_OP_TANH
+} math_op_t;
+
+#ifdef FASTMATH_X86
+
+__attribute__((target("avx2")))
+static inline __m256 exp_avx2(__m256 x) {
+    x = _mm256_max_ps(_mm256_set1_ps(EXP_LO), _mm256_min_ps(_mm256_set1_ps(EXP_HI), x));
+    __m256 magic = _mm256_set1_ps(ROUND_MAGIC);
+    __m256 n = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(EXP_LOG2E)), magic), magic);
+    __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(EXP_C1)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(n, _mm256_set1_ps(EXP_C2)));
+    __m256 z = _mm256_mul_ps(r, r);
+
+    __m256 p = _mm256_set1_ps(EXP_P0);
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(EXP_P1));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(EXP_P2));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(EXP_P3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(EXP_P4));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(EXP_P5));
+    __m256 y = _mm256_mul_ps(p, z);
+    y = _mm256_add_ps(y, r);
+    y = _mm256_add_ps(y, _mm256_set1_ps(1.0f));
+
+    __m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(scale));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 log_avx2(__m256 x) {
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256i bits = _mm256_castps_si256(x);
+    __m256i e = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+                                                   _mm256_set1_epi32(0x3f000000)));
+    __m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(LOG_SQRTHF), _CMP_LT_OQ);
+    __m256 fe = _mm256_sub_ps(_mm256_cvtepi32_ps(e), _mm256_and_ps(small, one));
+    __m256 f = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(small, m)), one);
+    __m256 z = _mm256_mul_ps(f, f);
+
+    __m256 p = _mm256_set1_ps(LOG_P0);
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_P1));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_P2));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_P3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_P4));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_P5));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_P6));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_P7));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(LOG_P8));
+    __m256 y = _mm256_mul_ps(p, f);
+    y = _mm256_mul_ps(y, z);
+    y = _mm256_add_ps(y, _mm256_mul_ps(fe, _mm256_set1_ps(EXP_C2)));
+    y = _mm256_sub_ps(y, _mm256_mul_ps(_mm256_set1_ps(0.5f), z));
+    f = _mm256_add_ps(f, y);
+    __m256 result = _mm256_add_ps(f, _mm256_mul_ps(fe, _mm256_set1_ps(EXP_C1)));
+
+    /* Same precedence as the scalar early returns, applied last to first. */
+    __m256 inf = _mm256_set1_ps(INFINITY);
+    result = _mm256_blendv_ps(result, inf, _mm256_cmp_ps(x, inf, _CMP_EQ_OQ));
+    result = _mm256_blendv_ps(result, _mm256_set1_ps(-INFINITY),
+                              _mm256_cmp_ps(x, _mm256_set1_ps(LOG_MIN_NORMAL), _CMP_LT_OQ));
+    result = _mm256_blendv_ps(result, _mm256_set1_ps(NAN), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+    return _mm256_blendv_ps(result, x, _mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 tanh_avx2(__m256 x) {
+    __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 a = _mm256_andnot_ps(sign, x);
+
+    __m256 z = _mm256_mul_ps(a, a);
+    __m256 p = _mm256_set1_ps(TANH_P0);
+    p = _mm256_add_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(TANH_P1));
+    p = _mm256_add_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(TANH_P2));
+    p = _mm256_add_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(TANH_P3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(TANH_P4));
+    __m256 small = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(p, z), a), a);
+
+    __m256 e = exp_avx2(_mm256_add_ps(a, a));
+    __m256 large = _mm256_sub_ps(_mm256_set1_ps(1.0f),
+                                 _mm256_div_ps(_mm256_set1_ps(2.0f), _mm256_add_ps(e, _mm256_set1_ps(1.0f))));
+    __m256 y = _mm256_blendv_ps(large, small, _mm256_cmp_ps(a, _mm256_set1_ps(TANH_SMALL), _CMP_LT_OQ));
+    return _mm256_or_ps(y, _mm256_and_ps(sign, x));
+}
+
+__attribute__((target("avx2")))
+static size_t math_avx2(math_op_t op, float *dst, const float *src, size_t n) {
+    __m256 one = _mm256_set1_ps(1.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(src + i), y;
+        switch (op) {
+            case MATH_OP_EXP: y = exp_avx2(x); break;
+            case MATH_OP_LOG: y = log_avx2(x); break;
+            case MATH_OP_SIGMOID:
+                y = _mm256_div_ps(one, _mm256_add_ps(one, exp_avx2(_mm256_xor_ps(x, _mm256_set1_ps(-0.0f)))));
+                break;
+            default: y = tanh_avx2(x); break;
+        }
+        _mm256_storeu_ps(dst + i, y);
+    }
+    return i;
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 exp_avx512(__m512 x) {
+    x = _mm512_max_ps(_mm512_set1_ps(EXP_LO), _mm512_min_ps(_mm512_set1_ps(EXP_HI), x));
+    __m512 magic = _mm512_set1_ps(ROUND_MAGIC);
+    __m512 n = _mm512_sub_ps(_mm512_add_ps(_mm512_mul_ps(x, _mm512_set1_ps(EXP_LOG2E)), magic), magic);
+    __m512 r = _mm512_sub_ps(x, _mm512_mul_ps(n, _mm512_set1_ps(EXP_C1)));
+    r = _mm512_sub_ps(r, _mm512_mul_ps(n, _mm512_set1_ps(EXP_C2)));
+    __m512 z = _mm512_mul_ps(r, r);
+
+    __m512 p = _mm512_set1_ps(EXP_P0);
+    p = _mm512_add_ps(_mm512_mul_ps(p, r), _mm512_set1_ps(EXP_P1));
+    p = _mm512_add_ps(_mm512_mul_ps(p, r), _mm512_set1_ps(EXP_P2));
+    p = _mm512_add_ps(_mm512_mul_ps(p, r), _mm512_set1_ps(EXP_P3));
+    p = _mm512_add_ps(_mm512_mul_ps(p, r), _mm512_set1_ps(EXP_P4));
+    p = _mm512_add_ps(_mm512_mul_ps(p, r), _mm512_set1_ps(EXP_P5));
+    __m512 y = _mm512_mul_ps(p, z);
+    y = _mm512_add_ps(y, r);
+    y = _mm512_add_ps(y, _mm512_set1_ps(1.0f));
+
+    __m512i scale = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127)), 23);
+    return _mm512_mul_ps(y, _mm512_castsi512_ps(scale));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 log_avx512(__m512 x) {
+    __m512 one = _mm512_set1_ps(1.0f);
+    __m512i bits = _mm512_castps_si512(x);
+    __m512i e = _mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(126));
+    __m512 m = _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi32(0x007fffff)),
+                                                   _mm512_set1_epi32(0x3f000000)));
+    __mmask16 small = _mm512_cmp_ps_mask(m, _mm512_set1_ps(LOG_SQRTHF), _CMP_LT_OQ);
+    __m512 fe = _mm512_cvtepi32_ps(e);
+    fe = _mm512_mask_sub_ps(fe, small, fe, one);
+    __m512 f = _mm512_sub_ps(_mm512_mask_add_ps(m, small, m, m), one);
+    __m512 z = _mm512_mul_ps(f, f);
+
+    __m512 p = _mm512_set1_ps(LOG_P0);
+    p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(LOG_P1));
+    p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(LOG_P2));
+    p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(LOG_P3));
+    p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(LOG_P4));
+    p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(LOG_P5));
+    p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(LOG_P6));
+    p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(LOG_P7));
+    p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(LOG_P8));
+    __m512 y = _mm512_mul_ps(p, f);
+    y = _mm512_mul_ps(y, z);
+    y = _mm512_add_ps(y, _mm512_mul_ps(fe, _mm512_set1_ps(EXP_C2)));
+    y = _mm512_sub_ps(y, _mm512_mul_ps(_mm512_set1_ps(0.5f), z));
+    f = _mm512_add_ps(f, y);
+    __m512 result = _mm512_add_ps(f, _mm512_mul_ps(fe, _mm512_set1_ps(EXP_C1)));
+
+    __m512 inf = _mm512_set1_ps(INFINITY);
+    result = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, inf, _CMP_EQ_OQ), result, inf);
+    result = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, _mm512_set1_ps(LOG_MIN_NORMAL), _CMP_LT_OQ),
+                                  result, _mm512_set1_ps(-INFINITY));
+    result = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_LT_OQ),
+                                  result, _mm512_set1_ps(NAN));
+    return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, x, _CMP_UNORD_Q), result, x);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 tanh_avx512(__m512 x) {
+    __m512i sign = _mm512_set1_epi32((int)0x80000000u);
+    __m512i xi = _mm512_castps_si512(x);
+    __m512 a = _mm512_castsi512_ps(_mm512_andnot_si512(sign, xi));
+
+    __m512 z = _mm512_mul_ps(a, a);
+    __m512 p = _mm512_set1_ps(TANH_P0);
+    p = _mm512_add_ps(_mm512_mul_ps(p, z), _mm512_set1_ps(TANH_P1));
+    p = _mm512_add_ps(_mm512_mul_ps(p, z), _mm512_set1_ps(TANH_P2));
+    p = _mm512_add_ps(_mm512_mul_ps(p, z), _mm512_set1_ps(TANH_P3));
+    p = _mm512_add_ps(_mm512_mul_ps(p, z), _mm512_set1_ps(TANH_P4));
+    __m512 small = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(p, z), a), a);
+
+    __m512 e = exp_avx512(_mm512_add_ps(a, a));
+    __m512 large = _mm512_sub_ps(_mm512_set1_ps(1.0f),
+                                 _mm512_div_ps(_mm512_set1_ps(2.0f), _mm512_add_ps(e, _mm512_set1_ps(1.0f))));
+    __m512 y = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, _mm512_set1_ps(TANH_SMALL), _CMP_LT_OQ), large, small);
+    return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(y), _mm512_and_si512(sign, xi)));
+}
+
+__attribute__((target("avx512f")))
+static size_t math_avx512(math_op_t op, float *dst, const float *src, size_t n) {
+    __m512 one = _mm512_set1_ps(1.0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 x = _mm512_loadu_ps(src + i), y;
+        switch (op) {
+            case MATH_OP_EXP: y = exp_avx512(x); break;
+            case MATH_OP_LOG: y = log_avx512(x); break;
+            case MATH_OP_SIGMOID:
+                y = _mm512_div_ps(one, _mm512_add_ps(one, exp_avx512(_mm512_castsi512_ps(
+                    _mm512_xor_si512(_mm512_castps_si512(x), _mm512_set1_epi32((int)0x80000000u))))));
+                break;
+            default: y = tanh_avx512(x); break;
+        }
+        _mm512_storeu_ps(dst + i, y);
+    }
+    return i;
+}
+
+#endif
+
+static void math_fast(math_op_t op, float *dst, const float *src, size_t n) {
+    size_t i = 0;
+#ifdef FASTMATH_X86
+    gemm_isa_t isa = gemm_get_isa();
+    if (isa == GEMM_ISA_AVX512) i = math_avx512(op, dst, src, n);
+    else if (isa == GEMM_ISA_AVX2) i = math_avx2(op, dst, src, n);
+#endif
+    switch (op) {
+        case MATH_OP_EXP: for (; i < n; i++) dst[i] = math_fast_expf(src[i]); break;
+        case MATH_OP_LOG: for (; i < n; i++) dst[i] = math_fast_logf(src[i]); break;
+        case MATH_OP_SIGMOID: for (; i < n; i++) dst[i] = math_fast_sigmoidf(src[i]); break;
+        case MATH_OP_TANH: for (; i < n; i++) dst[i] = math_fast_tanhf(src[i]); break;
+    }
+}
+
+void math_exp(float *dst, const float *src, size_t n, math_mode_t mode) {
+    if (mode == MATH_FAST) {
+        math_fast(MATH_OP_EXP, dst, src, n);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) dst[i] = expf(src[i]);
+}
+
+void math_log(float *dst, const float *src, size_t n, math_mode_t mode) {
+    if (mode == MATH_FAST) {
+        math_fast(MATH_OP_LOG, dst, src, n);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) dst[i] = logf(src[i]);
+}
+
+void math_sigmoid(float *dst, const float *src, size_t n, math_mode_t mode) {
+    if (mode == MATH_FAST) {
+        math_fast(MATH_OP_SIGMOID, dst, src, n);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) dst[i] = 1.0f / (1.0f + expf(-src[i]));
+}
+
+void math_tanh(float *dst, const float *src, size_t n, math_mode_t mode) {
+    if (mode == MATH_FAST) {
+        math_fast(MATH_OP_TANH, dst, src, n);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) dst[i] = tanhf(src[i]);
+}
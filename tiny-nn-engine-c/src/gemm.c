@@ -0,0 +1,785 @@
+#define _POSIX_C_SOURCE 200112L
+#include "gemm.h"
+#include "threadpool.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GEMM_X86 1
+#include <immintrin.h>
+#endif
+
+#define GEMM_MAX_MR 8
+#define GEMM_MAX_NR 32
+#define GEMM_MAX_KC 256
+#define GEMM_SMALL_FLOPS 4096
+#define GEMM_PARALLEL_FLOPS (1u << 21)
+
+/* Micro-kernels compute C = alpha * A * B + beta * C for one full tile, then
+ * add bias (when non-NULL) and clamp at zero when relu is set, before the
+ * accumulators leave registers. */
+typedef void (*gemm_kernel_fn)(size_t kc, const float *a, const float *b,
+                               float *c, size_t ldc, float alpha, float beta,
+                               const float *bias, int relu);
+
+typedef struct {
+    gemm_isa_t isa;
+    size_t mr;
+    size_t nr;
+    size_t mc;
+    size_t kc;
+    size_t nc;
+    gemm_kernel_fn kernel;
+} gemm_config_t;
+
+static void store_tile(const float *acc, size_t acc_ld, size_t rows, size_t cols,
+                       float *c, size_t ldc, float alpha, float beta,
+                       const float *bias, int relu) {
+    for (size_t i = 0; i < rows; i++) {
+        const float *src = acc + i * acc_ld;
+        float *dst = c + i * ldc;
+        if (beta == 0.0f) {
+            for (size_t j = 0; j < cols; j++) dst[j] = alpha * src[j];
+        } else {
+            for (size_t j = 0; j < cols; j++) dst[j] = alpha * src[j] + beta * dst[j];
+        }
+        if (bias) {
+            for (size_t j = 0; j < cols; j++) dst[j] += bias[j];
+        }
+        if (relu) {
+            for (size_t j = 0; j < cols; j++) dst[j] = fmaxf(0.0f, dst[j]);
+        }
+    }
+}
+
+static void kernel_scalar_4x8(size_t kc, const float *a, const float *b,
+                              float *c, size_t ldc, float alpha, float beta,
+                              const float *bias, int relu) {
+    float acc[4][8];
+    memset(acc, 0, sizeof(acc));
+
+    for (size_t p = 0; p < kc; p++) {
+        for (int r = 0; r < 4; r++) {
+            float ar = a[r];
+            for (int j = 0; j < 8; j++) {
+                acc[r][j] += ar * b[j];
+            }
+        }
+        a += 4;
+        b += 8;
+    }
+
+    store_tile(&acc[0][0], 8, 4, 8, c, ldc, alpha, beta, bias, relu);
+}
+
+#ifdef GEMM_X86
+
+static void kernel_sse_4x8(size_t kc, const float *a, const float *b,
+                           float *c, size_t ldc, float alpha, float beta,
+                           const float *bias, int relu) {
+    __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps();
+    __m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+    __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps();
+    __m128 c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+
+#define SSE_ROW(r) \
+    do { \
+        __m128 ar = _mm_set1_ps(a[r]); \
+        c##r##0 = _mm_add_ps(c##r##0, _mm_mul_ps(ar, b0)); \
+        c##r##1 = _mm_add_ps(c##r##1, _mm_mul_ps(ar, b1)); \
+    } while (0)
+
+    for (size_t p = 0; p < kc; p++) {
+        __m128 b0 = _mm_loadu_ps(b);
+        __m128 b1 = _mm_loadu_ps(b + 4);
+        SSE_ROW(0); SSE_ROW(1); SSE_ROW(2); SSE_ROW(3);
+        a += 4;
+        b += 8;
+    }
+#undef SSE_ROW
+
+    __m128 va = _mm_set1_ps(alpha);
+    __m128 vb = _mm_set1_ps(beta);
+    __m128 zero = _mm_setzero_ps();
+    __m128 bias0 = bias ? _mm_loadu_ps(bias) : zero;
+    __m128 bias1 = bias ? _mm_loadu_ps(bias + 4) : zero;
+
+#define SSE_STORE(r) \
+    do { \
+        float *cr = c + r * ldc; \
+        __m128 x0 = _mm_mul_ps(va, c##r##0); \
+        __m128 x1 = _mm_mul_ps(va, c##r##1); \
+        if (beta != 0.0f) { \
+            x0 = _mm_add_ps(x0, _mm_mul_ps(vb, _mm_loadu_ps(cr))); \
+            x1 = _mm_add_ps(x1, _mm_mul_ps(vb, _mm_loadu_ps(cr + 4))); \
+        } \
+        x0 = _mm_add_ps(x0, bias0); \
+        x1 = _mm_add_ps(x1, bias1); \
+        if (relu) { \
+            x0 = _mm_max_ps(x0, zero); \
+            x1 = _mm_max_ps(x1, zero); \
+        } \
+        _mm_storeu_ps(cr, x0); \
+        _mm_storeu_ps(cr + 4, x1); \
+    } while (0)
+
+    SSE_STORE(0); SSE_STORE(1); SSE_STORE(2); SSE_STORE(3);
+#undef SSE_STORE
+}
+
+__attribute__((target("avx2,fma")))
+static void kernel_avx2_6x16(size_t kc, const float *a, const float *b,
+                             float *c, size_t ldc, float alpha, float beta,
+                             const float *bias, int relu) {
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+#define AVX2_ROW(r) \
+    do { \
+        __m256 ar = _mm256_broadcast_ss(a + r); \
+        c##r##0 = _mm256_fmadd_ps(ar, b0, c##r##0); \
+        c##r##1 = _mm256_fmadd_ps(ar, b1, c##r##1); \
+    } while (0)
+
+    for (size_t p = 0; p < kc; p++) {
+        __m256 b0 = _mm256_loadu_ps(b);
+        __m256 b1 = _mm256_loadu_ps(b + 8);
+        AVX2_ROW(0); AVX2_ROW(1); AVX2_ROW(2);
+        AVX2_ROW(3); AVX2_ROW(4); AVX2_ROW(5);
+        a += 6;
+        b += 16;
+    }
+#undef AVX2_ROW
+
+    __m256 va = _mm256_set1_ps(alpha);
+    __m256 vb = _mm256_set1_ps(beta);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 bias0 = bias ? _mm256_loadu_ps(bias) : zero;
+    __m256 bias1 = bias ? _mm256_loadu_ps(bias + 8) : zero;
+
+#define AVX2_STORE(r) \
+    do { \
+        float *cr = c + r * ldc; \
+        __m256 x0 = _mm256_mul_ps(va, c##r##0); \
+        __m256 x1 = _mm256_mul_ps(va, c##r##1); \
+        if (beta != 0.0f) { \
+            x0 = _mm256_fmadd_ps(vb, _mm256_loadu_ps(cr), x0); \
+            x1 = _mm256_fmadd_ps(vb, _mm256_loadu_ps(cr + 8), x1); \
+        } \
+        x0 = _mm256_add_ps(x0, bias0); \
+        x1 = _mm256_add_ps(x1, bias1); \
+        if (relu) { \
+            x0 = _mm256_max_ps(x0, zero); \
+            x1 = _mm256_max_ps(x1, zero); \
+        } \
+        _mm256_storeu_ps(cr, x0); \
+        _mm256_storeu_ps(cr + 8, x1); \
+    } while (0)
+
+    AVX2_STORE(0); AVX2_STORE(1); AVX2_STORE(2);
+    AVX2_STORE(3); AVX2_STORE(4); AVX2_STORE(5);
+#undef AVX2_STORE
+}
+
+__attribute__((target("avx512f")))
+static void kernel_avx512_8x32(size_t kc, const float *a, const float *b,
+                               float *c, size_t ldc, float alpha, float beta,
+                               const float *bias, int relu) {
+    __m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+    __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+    __m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+    __m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+    __m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+    __m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+    __m512 c60 = _mm512_setzero_ps(), c61 = _mm512_setzero_ps();
+    __m512 c70 = _mm512_setzero_ps(), c71 = _mm512_setzero_ps();
+
+#define AVX512_ROW(r) \
+    do { \
+        __m512 ar = _mm512_set1_ps(a[r]); \
+        c##r##0 = _mm512_fmadd_ps(ar, b0, c##r##0); \
+        c##r##1 = _mm512_fmadd_ps(ar, b1, c##r##1); \
+    } while (0)
+
+    for (size_t p = 0; p < kc; p++) {
+        __m512 b0 = _mm512_loadu_ps(b);
+        __m512 b1 = _mm512_loadu_ps(b + 16);
+        AVX512_ROW(0); AVX512_ROW(1); AVX512_ROW(2); AVX512_ROW(3);
+        AVX512_ROW(4); AVX512_ROW(5); AVX512_ROW(6); AVX512_ROW(7);
+        a += 8;
+        b += 32;
+    }
+#undef AVX512_ROW
+
+    __m512 va = _mm512_set1_ps(alpha);
+    __m512 vb = _mm512_set1_ps(beta);
+    __m512 zero = _mm512_setzero_ps();
+    __m512 bias0 = bias ? _mm512_loadu_ps(bias) : zero;
+    __m512 bias1 = bias ? _mm512_loadu_ps(bias + 16) : zero;
+
+#define AVX512_STORE(r) \
+    do { \
+        float *cr = c + r * ldc; \
+        __m512 x0 = _mm512_mul_ps(va, c##r##0); \
+        __m512 x1 = _mm512_mul_ps(va, c##r##1); \
+        if (beta != 0.0f) { \
+            x0 = _mm512_fmadd_ps(vb, _mm512_loadu_ps(cr), x0); \
+            x1 = _mm512_fmadd_ps(vb, _mm512_loadu_ps(cr + 16), x1); \
+        } \
+        x0 = _mm512_add_ps(x0, bias0); \
+        x1 = _mm512_add_ps(x1, bias1); \
+        if (relu) { \
+            x0 = _mm512_max_ps(x0, zero); \
+            x1 = _mm512_max_ps(x1, zero); \
+        } \
+        _mm512_storeu_ps(cr, x0); \
+        _mm512_storeu_ps(cr + 16, x1); \
+    } while (0)
+
+    AVX512_STORE(0); AVX512_STORE(1); AVX512_STORE(2); AVX512_STORE(3);
+    AVX512_STORE(4); AVX512_STORE(5); AVX512_STORE(6); AVX512_STORE(7);
+#undef AVX512_STORE
+}
+
+#endif
+
+static const gemm_config_t gemm_configs[] = {
+    { GEMM_ISA_SCALAR, 4, 8, 64, 256, 2048, kernel_scalar_4x8 },
+#ifdef GEMM_X86
+    { GEMM_ISA_SSE, 4, 8, 96, 256, 2048, kernel_sse_4x8 },
+    { GEMM_ISA_AVX2, 6, 16, 96, 256, 3072, kernel_avx2_6x16 },
+    { GEMM_ISA_AVX512, 8, 32, 128, 192, 3072, kernel_avx512_8x32 },
+#endif
+};
+
+/* Detected once on first use from any thread. isa_active can change under
+ * running GEMMs through gemm_set_isa, so it is read and written atomically. */
+static pthread_once_t isa_once = PTHREAD_ONCE_INIT;
+static gemm_isa_t isa_supported = GEMM_ISA_SCALAR;
+static gemm_isa_t isa_active = GEMM_ISA_SCALAR;
+
+static gemm_isa_t detect_isa(void) {
+#ifdef GEMM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return GEMM_ISA_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return GEMM_ISA_AVX2;
+    if (__builtin_cpu_supports("sse2")) return GEMM_ISA_SSE;
+#endif
+    return GEMM_ISA_SCALAR;
+}
+
+static void detect_once(void) {
+    isa_supported = detect_isa();
+    gemm_isa_t active = isa_supported;
+
+    const char *forced = getenv("TINY_NN_GEMM_ISA");
+    if (forced) {
+        for (int isa = GEMM_ISA_SCALAR; isa <= GEMM_ISA_AVX512; isa++) {
+            if (strcmp(forced, gemm_isa_name((gemm_isa_t)isa)) == 0) {
+                active = isa < (int)isa_supported ? (gemm_isa_t)isa : isa_supported;
+            }
+        }
+    }
+    __atomic_store_n(&isa_active, active, __ATOMIC_RELAXED);
+}
+
+static void init_isa(void) {
+    pthread_once(&isa_once, detect_once);
+}
+
+gemm_isa_t gemm_get_isa(void) {
+    init_isa();
+    return __atomic_load_n(&isa_active, __ATOMIC_RELAXED);
+}
+
+gemm_isa_t gemm_set_isa(gemm_isa_t isa) {
+    init_isa();
+    gemm_isa_t active = isa < isa_supported ? isa : isa_supported;
+    __atomic_store_n(&isa_active, active, __ATOMIC_RELAXED);
+    return active;
+}
+
+const char* gemm_isa_name(gemm_isa_t isa) {
+    switch (isa) {
+        case GEMM_ISA_SSE: return "sse";
+        case GEMM_ISA_AVX2: return "avx2";
+        case GEMM_ISA_AVX512: return "avx512";
+        case GEMM_ISA_SCALAR:
+        default: return "scalar";
+    }
+}
+
+static const gemm_config_t* active_config(void) {
+    gemm_isa_t isa = gemm_get_isa();
+    for (size_t i = 0; i < sizeof(gemm_configs) / sizeof(gemm_configs[0]); i++) {
+        if (gemm_configs[i].isa == isa) return &gemm_configs[i];
+    }
+    return &gemm_configs[0];
+}
+
+static __thread float *pack_a_buf = NULL;
+static __thread size_t pack_a_cap = 0;
+static __thread float *pack_b_buf = NULL;
+static __thread size_t pack_b_cap = 0;
+static pthread_key_t pack_key;
+static pthread_once_t pack_key_once = PTHREAD_ONCE_INIT;
+
+static void release_pack_buffers(void *unused) {
+    (void)unused;
+    free(pack_a_buf);
+    free(pack_b_buf);
+    pack_a_buf = pack_b_buf = NULL;
+    pack_a_cap = pack_b_cap = 0;
+}
+
+static void create_pack_key(void) {
+    pthread_key_create(&pack_key, release_pack_buffers);
+}
+
+/* Packing buffers are per thread and grow-only; the key frees them when a
+ * pool worker exits. */
+static float* reserve_pack(float **buf, size_t *cap, size_t count) {
+    if (count <= *cap) return *buf;
+
+    pthread_once(&pack_key_once, create_pack_key);
+    pthread_setspecific(pack_key, (void*)1);
+
+    void *mem = NULL;
+    if (posix_memalign(&mem, 64, count * sizeof(float)) != 0) {
+        fprintf(stderr, "Failed to allocate GEMM packing buffer\n");
+        return NULL;
+    }
+    free(*buf);
+    *buf = (float*)mem;
+    *cap = count;
+    return *buf;
+}
+
+/* One GEMM input: element (i, j) of op(X) lives at index i * rs + j * cs of
+ * data, stored in the given precision. */
+typedef struct {
+    const void *data;
+    precision_t type;
+    size_t rs;
+    size_t cs;
+} gemm_operand_t;
+
+static gemm_operand_t operand_offset(const gemm_operand_t *op, size_t i, size_t j) {
+    gemm_operand_t sub = *op;
+    sub.data = (const char*)op->data + (i * op->rs + j * op->cs) * precision_size(op->type);
+    return sub;
+}
+
+static float operand_load(const gemm_operand_t *op, size_t index) {
+    if (op->type == PRECISION_FP32) return ((const float*)op->data)[index];
+    return half_to_float(((const uint16_t*)op->data)[index], op->type);
+}
+
+/* Converts count elements at stride 1 starting at index into dst. */
+static void operand_convert(const gemm_operand_t *op, size_t index, size_t count, float *dst) {
+    half_convert_to_float(dst, (const uint16_t*)op->data + index, count, op->type);
+}
+
+/* Packs an mc x kc block of op(A) into row panels of mr, k-major within a panel.
+ * Reduced-precision rows that are contiguous in memory are converted with the
+ * bulk converters first and then scattered into the panel. */
+static void pack_a(size_t mc, size_t kc, const gemm_operand_t *a, size_t mr, float *dst) {
+    size_t rs = a->rs, cs = a->cs;
+
+    if (a->type == PRECISION_FP32) {
+        const float *data = (const float*)a->data;
+        for (size_t i = 0; i < mc; i += mr) {
+            size_t rows = mc - i < mr ? mc - i : mr;
+            for (size_t p = 0; p < kc; p++) {
+                const float *src = data + i * rs + p * cs;
+                size_t r = 0;
+                for (; r < rows; r++) dst[r] = src[r * rs];
+                for (; r < mr; r++) dst[r] = 0.0f;
+                dst += mr;
+            }
+        }
+        return;
+    }
+
+    float row[GEMM_MAX_KC];
+    for (size_t i = 0; i < mc; i += mr) {
+        size_t rows = mc - i < mr ? mc - i : mr;
+        for (size_t r = 0; r < mr; r++) {
+            if (r >= rows) {
+                for (size_t p = 0; p < kc; p++) dst[p * mr + r] = 0.0f;
+            } else if (cs == 1) {
+                operand_convert(a, (i + r) * rs, kc, row);
+                for (size_t p = 0; p < kc; p++) dst[p * mr + r] = row[p];
+            } else {
+                for (size_t p = 0; p < kc; p++) dst[p * mr + r] = operand_load(a, (i + r) * rs + p * cs);
+            }
+        }
+        dst += mr * kc;
+    }
+}
+
+/* Packs a kc x nc block of op(B) into column panels of nr, k-major within a panel. */
+static void pack_b(size_t kc, size_t nc, const gemm_operand_t *b, size_t nr, float *dst) {
+    size_t rs = b->rs, cs = b->cs;
+
+    if (b->type == PRECISION_FP32) {
+        const float *data = (const float*)b->data;
+        for (size_t j = 0; j < nc; j += nr) {
+            size_t cols = nc - j < nr ? nc - j : nr;
+            for (size_t p = 0; p < kc; p++) {
+                const float *src = data + p * rs + j * cs;
+                size_t c = 0;
+                for (; c < cols; c++) dst[c] = src[c * cs];
+                for (; c < nr; c++) dst[c] = 0.0f;
+                dst += nr;
+            }
+        }
+        return;
+    }
+
+    float column[GEMM_MAX_KC];
+    for (size_t j = 0; j < nc; j += nr) {
+        size_t cols = nc - j < nr ? nc - j : nr;
+        if (cs == 1) {
+            for (size_t p = 0; p < kc; p++) {
+                operand_convert(b, p * rs + j, cols, dst + p * nr);
+                for (size_t c = cols; c < nr; c++) dst[p * nr + c] = 0.0f;
+            }
+        } else {
+            for (size_t c = 0; c < nr; c++) {
+                if (c >= cols) {
+                    for (size_t p = 0; p < kc; p++) dst[p * nr + c] = 0.0f;
+                } else if (rs == 1) {
+                    operand_convert(b, (j + c) * cs, kc, column);
+                    for (size_t p = 0; p < kc; p++) dst[p * nr + c] = column[p];
+                } else {
+                    for (size_t p = 0; p < kc; p++) dst[p * nr + c] = operand_load(b, p * rs + (j + c) * cs);
+                }
+            }
+        }
+        dst += nr * kc;
+    }
+}
+
+static void sigmoid_tile(float *c, size_t ldc, size_t rows, size_t cols) {
+    for (size_t i = 0; i < rows; i++) {
+        float *ci = c + i * ldc;
+        for (size_t j = 0; j < cols; j++) {
+            ci[j] = 1.0f / (1.0f + expf(-ci[j]));
+        }
+    }
+}
+
+/* ep is non-NULL only for the last K block; its bias is indexed from the
+ * first column of this macro block. Consecutive B panels are pb_stride floats
+ * apart: nr * kc when packed per block, nr * k in gemm_packed_t panels. */
+static void macro_kernel(const gemm_config_t *cfg, size_t mc, size_t nc, size_t kc,
+                         float alpha, const float *pa, const float *pb, size_t pb_stride,
+                         float beta, float *c, size_t ldc,
+                         const gemm_epilogue_t *ep) {
+    float tile[GEMM_MAX_MR * GEMM_MAX_NR];
+    int relu = ep && ep->activation == GEMM_ACT_RELU;
+    int sigmoid = ep && ep->activation == GEMM_ACT_SIGMOID;
+
+    for (size_t j = 0; j < nc; j += cfg->nr) {
+        size_t cols = nc - j < cfg->nr ? nc - j : cfg->nr;
+        const float *b_panel = pb + j / cfg->nr * pb_stride;
+        const float *bias = ep && ep->bias ? ep->bias + j : NULL;
+
+        for (size_t i = 0; i < mc; i += cfg->mr) {
+            size_t rows = mc - i < cfg->mr ? mc - i : cfg->mr;
+            const float *a_panel = pa + i * kc;
+            float *c_tile = c + i * ldc + j;
+
+            if (rows == cfg->mr && cols == cfg->nr) {
+                cfg->kernel(kc, a_panel, b_panel, c_tile, ldc, alpha, beta, bias, relu);
+            } else {
+                cfg->kernel(kc, a_panel, b_panel, tile, cfg->nr, 1.0f, 0.0f, NULL, 0);
+                store_tile(tile, cfg->nr, rows, cols, c_tile, ldc, alpha, beta, bias, relu);
+            }
+            if (sigmoid) sigmoid_tile(c_tile, ldc, rows, cols);
+        }
+    }
+}
+
+static void scale_c(size_t m, size_t n, float beta, float *c, size_t ldc) {
+    for (size_t i = 0; i < m; i++) {
+        float *ci = c + i * ldc;
+        if (beta == 0.0f) {
+            memset(ci, 0, n * sizeof(float));
+        } else if (beta != 1.0f) {
+            for (size_t j = 0; j < n; j++) ci[j] *= beta;
+        }
+    }
+}
+
+static void gemm_small(size_t m, size_t n, size_t k, float alpha,
+                       const gemm_operand_t *a, const gemm_operand_t *b,
+                       float beta, float *c, size_t ldc) {
+    scale_c(m, n, beta, c, ldc);
+    for (size_t i = 0; i < m; i++) {
+        float *ci = c + i * ldc;
+        for (size_t p = 0; p < k; p++) {
+            float aip = alpha * operand_load(a, i * a->rs + p * a->cs);
+            if (b->type == PRECISION_FP32) {
+                const float *bp = (const float*)b->data + p * b->rs;
+                for (size_t j = 0; j < n; j++) ci[j] += aip * bp[j * b->cs];
+            } else {
+                for (size_t j = 0; j < n; j++) ci[j] += aip * operand_load(b, p * b->rs + j * b->cs);
+            }
+        }
+    }
+}
+
+static void apply_epilogue(size_t m, size_t n, float *c, size_t ldc, const gemm_epilogue_t *ep) {
+    if (!ep) return;
+    for (size_t i = 0; i < m; i++) {
+        float *ci = c + i * ldc;
+        if (ep->bias) {
+            for (size_t j = 0; j < n; j++) ci[j] += ep->bias[j];
+        }
+        if (ep->activation == GEMM_ACT_RELU) {
+            for (size_t j = 0; j < n; j++) ci[j] = fmaxf(0.0f, ci[j]);
+        }
+    }
+    if (ep->activation == GEMM_ACT_SIGMOID) sigmoid_tile(c, ldc, m, n);
+}
+
+/* With panels (from a gemm_packed_t, offset to the first column of this
+ * call) B is read from them and b is not used. */
+static void gemm_blocked(const gemm_config_t *cfg, size_t m, size_t n, size_t k,
+                         float alpha, const gemm_operand_t *a, const gemm_operand_t *b,
+                         const float *panels,
+                         float beta, float *c, size_t ldc,
+                         const gemm_epilogue_t *ep) {
+    size_t mc_max = m < cfg->mc ? m : cfg->mc;
+    size_t nc_max = n < cfg->nc ? n : cfg->nc;
+    size_t kc_max = k < cfg->kc ? k : cfg->kc;
+
+    size_t a_count = ((mc_max + cfg->mr - 1) / cfg->mr) * cfg->mr * kc_max;
+    size_t b_count = ((nc_max + cfg->nr - 1) / cfg->nr) * cfg->nr * kc_max;
+    float *pa = reserve_pack(&pack_a_buf, &pack_a_cap, a_count);
+    float *pb = panels ? NULL : reserve_pack(&pack_b_buf, &pack_b_cap, b_count);
+    if (!pa || (!panels && !pb)) {
+        /* Panels have no strided form to fall back on; the error is out. */
+        if (panels) return;
+        gemm_small(m, n, k, alpha, a, b, beta, c, ldc);
+        apply_epilogue(m, n, c, ldc, ep);
+        return;
+    }
+
+    for (size_t jc = 0; jc < n; jc += cfg->nc) {
+        size_t nc = n - jc < cfg->nc ? n - jc : cfg->nc;
+        gemm_epilogue_t block_ep = {NULL, GEMM_ACT_NONE};
+        if (ep) {
+            block_ep.activation = ep->activation;
+            block_ep.bias = ep->bias ? ep->bias + jc : NULL;
+        }
+
+        for (size_t pc = 0; pc < k; pc += cfg->kc) {
+            size_t kc = k - pc < cfg->kc ? k - pc : cfg->kc;
+            float beta_block = pc == 0 ? beta : 1.0f;
+            const gemm_epilogue_t *last_ep = ep && pc + kc == k ? &block_ep : NULL;
+
+            const float *b_panels = panels ? panels + jc * k + pc * cfg->nr : pb;
+            size_t b_stride = panels ? cfg->nr * k : cfg->nr * kc;
+            if (!panels) {
+                gemm_operand_t b_block = operand_offset(b, pc, jc);
+                pack_b(kc, nc, &b_block, cfg->nr, pb);
+            }
+
+            for (size_t ic = 0; ic < m; ic += cfg->mc) {
+                size_t mc = m - ic < cfg->mc ? m - ic : cfg->mc;
+
+                gemm_operand_t a_block = operand_offset(a, ic, pc);
+                pack_a(mc, kc, &a_block, cfg->mr, pa);
+                macro_kernel(cfg, mc, nc, kc, alpha, pa, b_panels, b_stride,
+                             beta_block, c + ic * ldc + jc, ldc, last_ep);
+            }
+        }
+    }
+}
+
+typedef struct {
+    const gemm_config_t *cfg;
+    size_t m, n, k;
+    float alpha;
+    gemm_operand_t a;
+    gemm_operand_t b;
+    const float *panels;
+    float beta;
+    float *c;
+    size_t ldc;
+    const gemm_epilogue_t *ep;
+    int split_cols;
+} gemm_job_t;
+
+/* Each task owns whole mr/nr panels of C, so tile boundaries and the K
+ * accumulation order match the serial path and results do not depend on
+ * the thread count. */
+static void gemm_task(void *arg, size_t begin, size_t end) {
+    const gemm_job_t *job = (const gemm_job_t*)arg;
+    const gemm_config_t *cfg = job->cfg;
+
+    if (job->split_cols) {
+        size_t j0 = begin * cfg->nr;
+        size_t j1 = end * cfg->nr < job->n ? end * cfg->nr : job->n;
+        gemm_epilogue_t ep = {NULL, GEMM_ACT_NONE};
+        if (job->ep) {
+            ep.activation = job->ep->activation;
+            ep.bias = job->ep->bias ? job->ep->bias + j0 : NULL;
+        }
+        gemm_operand_t b = job->panels ? job->b : operand_offset(&job->b, 0, j0);
+        const float *panels = job->panels ? job->panels + j0 * job->k : NULL;
+        gemm_blocked(cfg, job->m, j1 - j0, job->k, job->alpha, &job->a, &b, panels,
+                     job->beta, job->c + j0, job->ldc, job->ep ? &ep : NULL);
+    } else {
+        size_t i0 = begin * cfg->mr;
+        size_t i1 = end * cfg->mr < job->m ? end * cfg->mr : job->m;
+        gemm_operand_t a = operand_offset(&job->a, i0, 0);
+        gemm_blocked(cfg, i1 - i0, job->n, job->k, job->alpha, &a, &job->b, job->panels,
+                     job->beta, job->c + i0 * job->ldc, job->ldc, job->ep);
+    }
+}
+
+/* gemm_blocked on the calling thread for small products, otherwise split
+ * over the pool along whichever of m and n has more panels. */
+static void run_blocked(const gemm_config_t *cfg, size_t m, size_t n, size_t k, float alpha,
+                        const gemm_operand_t *a, const gemm_operand_t *b, const float *panels,
+                        float beta, float *c, size_t ldc, const gemm_epilogue_t *epilogue) {
+    if (m * n * k < GEMM_PARALLEL_FLOPS) {
+        gemm_blocked(cfg, m, n, k, alpha, a, b, panels, beta, c, ldc, epilogue);
+        return;
+    }
+
+    gemm_job_t job = {cfg, m, n, k, alpha, *a, *b, panels, beta, c, ldc, epilogue, 0};
+    size_t col_panels = (n + cfg->nr - 1) / cfg->nr;
+    size_t row_panels = (m + cfg->mr - 1) / cfg->mr;
+    job.split_cols = col_panels >= row_panels;
+    threadpool_parallel_for(job.split_cols ? col_panels : row_panels, 1, gemm_task, &job);
+}
+
+void gemm_sgemm(gemm_trans_t trans_a, gemm_trans_t trans_b,
+                size_t m, size_t n, size_t k,
+                float alpha,
+                const float *a, size_t lda,
+                const float *b, size_t ldb,
+                float beta,
+                float *c, size_t ldc) {
+    gemm_sgemm_fused(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, NULL);
+}
+
+void gemm_sgemm_fused(gemm_trans_t trans_a, gemm_trans_t trans_b,
+                      size_t m, size_t n, size_t k,
+                      float alpha,
+                      const float *a, size_t lda,
+                      const float *b, size_t ldb,
+                      float beta,
+                      float *c, size_t ldc,
+                      const gemm_epilogue_t *epilogue) {
+    gemm_mixed_fused(trans_a, trans_b, m, n, k, alpha, a, PRECISION_FP32, lda,
+                     b, PRECISION_FP32, ldb, beta, c, ldc, epilogue);
+}
+
+void gemm_mixed_fused(gemm_trans_t trans_a, gemm_trans_t trans_b,
+                      size_t m, size_t n, size_t k,
+                      float alpha,
+                      const void *a, precision_t a_type, size_t lda,
+                      const void *b, precision_t b_type, size_t ldb,
+                      float beta,
+                      float *c, size_t ldc,
+                      const gemm_epilogue_t *epilogue) {
+    if (m == 0 || n == 0) return;
+    if (epilogue && !epilogue->bias && epilogue->activation == GEMM_ACT_NONE) epilogue = NULL;
+    if (k == 0 || alpha == 0.0f) {
+        scale_c(m, n, beta, c, ldc);
+        apply_epilogue(m, n, c, ldc, epilogue);
+        return;
+    }
+
+    gemm_operand_t op_a = {a, a_type, trans_a == GEMM_TRANS ? 1 : lda, trans_a == GEMM_TRANS ? lda : 1};
+    gemm_operand_t op_b = {b, b_type, trans_b == GEMM_TRANS ? 1 : ldb, trans_b == GEMM_TRANS ? ldb : 1};
+
+    if (m * n * k <= GEMM_SMALL_FLOPS) {
+        gemm_small(m, n, k, alpha, &op_a, &op_b, beta, c, ldc);
+        apply_epilogue(m, n, c, ldc, epilogue);
+        return;
+    }
+
+    run_blocked(active_config(), m, n, k, alpha, &op_a, &op_b, NULL, beta, c, ldc, epilogue);
+}
+
+int gemm_pack_b(gemm_packed_t *packed, gemm_trans_t trans_b, size_t k, size_t n,
+                const void *b, precision_t b_type, size_t ldb) {
+    const gemm_config_t *cfg = active_config();
+    size_t count = (n + cfg->nr - 1) / cfg->nr * cfg->nr * k;
+
+    if (count > packed->capacity) {
+        void *mem = NULL;
+        if (posix_memalign(&mem, 64, count * sizeof(float)) != 0) {
+            fprintf(stderr, "Failed to allocate packed GEMM operand\n");
+            return 0;
+        }
+        free(packed->data);
+        packed->data = (float*)mem;
+        packed->capacity = count;
+    }
+
+    /* One panel and at most GEMM_MAX_KC rows at a time: pack_b then writes
+     * exactly those rows of the panel, contiguously. */
+    gemm_operand_t op = {b, b_type, trans_b == GEMM_TRANS ? 1 : ldb, trans_b == GEMM_TRANS ? ldb : 1};
+    for (size_t j = 0; j < n; j += cfg->nr) {
+        size_t cols = n - j < cfg->nr ? n - j : cfg->nr;
+        for (size_t p = 0; p < k; p += GEMM_MAX_KC) {
+            size_t rows = k - p < GEMM_MAX_KC ? k - p : GEMM_MAX_KC;
+            gemm_operand_t block = operand_offset(&op, p, j);
+            pack_b(rows, cols, &block, cfg->nr, packed->data + j * k + p * cfg->nr);
+        }
+    }
+    packed->k = k;
+    packed->n = n;
+    packed->nr = cfg->nr;
+    return 1;
+}
+
+int gemm_packed_current(const gemm_packed_t *packed) {
+    return packed->nr != 0 && packed->nr == active_config()->nr;
+}
+
+void gemm_packed_release(gemm_packed_t *packed) {
+    free(packed->data);
+    packed->data = NULL;
+    packed->capacity = 0;
+    packed->nr = 0;
+}
+
+void gemm_packed_fused(gemm_trans_t trans_a, size_t m, float alpha,
+                       const void *a, precision_t a_type, size_t lda,
+                       const gemm_packed_t *b,
+                       float beta,
+                       float *c, size_t ldc,
+                       const gemm_epilogue_t *epilogue) {
+    if (!gemm_packed_current(b)) {
+        fprintf(stderr, "Packed GEMM operand does not match the selected kernel\n");
+        return;
+    }
+    size_t n = b->n, k = b->k;
+    if (m == 0 || n == 0) return;
+    if (epilogue && !epilogue->bias && epilogue->activation == GEMM_ACT_NONE) epilogue = NULL;
+    if (k == 0 || alpha == 0.0f) {
+        scale_c(m, n, beta, c, ldc);
+        apply_epilogue(m, n, c, ldc, epilogue);
+        return;
+    }
+
+    gemm_operand_t op_a = {a, a_type, trans_a == GEMM_TRANS ? 1 : lda, trans_a == GEMM_TRANS ? lda : 1};
+    gemm_operand_t op_b = {NULL, PRECISION_FP32, 0, 0};
+    run_blocked(active_config(), m, n, k, alpha, &op_a, &op_b, b->data, beta, c, ldc, epilogue);
+}
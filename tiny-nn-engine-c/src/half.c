@@ -0,0 +1,187 @@
+#define _POSIX_C_SOURCE 200112L
+#include "half.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HALF_X86 1
+#include <immintrin.h>
+#endif
+
+size_t precision_size(precision_t precision) {
+    return precision == PRECISION_FP32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+const char* precision_name(precision_t precision) {
+    switch (precision) {
+        case PRECISION_BF16: return "bf16";
+        case PRECISION_FP16: return "fp16";
+        case PRECISION_FP32:
+        default: return "fp32";
+    }
+}
+
+static uint32_t float_bits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint16_t bf16_from_float(float value) {
+    uint32_t x = float_bits(value);
+    uint32_t exponent = x & 0x7f800000u;
+
+    if (exponent == 0x7f800000u && (x & 0x007fffffu)) return (uint16_t)((x >> 16) | 0x0040u);
+    if (exponent == 0) return (uint16_t)((x >> 16) & 0x8000u);
+    return (uint16_t)((x + 0x7fffu + ((x >> 16) & 1u)) >> 16);
+}
+
+static uint16_t fp16_from_float(float value) {
+    uint32_t x = float_bits(value);
+    uint16_t sign = (uint16_t)((x >> 16) & 0x8000u);
+    int32_t exponent = (int32_t)((x >> 23) & 0xffu);
+    uint32_t mantissa = x & 0x007fffffu;
+
+    if (exponent == 0xff) {
+        return (uint16_t)(sign | 0x7c00u | (mantissa ? 0x0200u | (mantissa >> 13) : 0u));
+    }
+
+    int32_t e = exponent - 127 + 15;
+    if (e >= 31) return (uint16_t)(sign | 0x7c00u);
+
+    if (e <= 0) {
+        /* Denormal result: shift the implicit bit into the mantissa. */
+        if (e < -10) return sign;
+        mantissa |= 0x00800000u;
+        uint32_t shift = (uint32_t)(14 - e);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1u);
+        uint32_t halfway = 1u << (shift - 1u);
+        if (rest > halfway || (rest == halfway && (half & 1u))) half++;
+        return (uint16_t)(sign | half);
+    }
+
+    uint32_t half = ((uint32_t)e << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fffu;
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) half++;
+    return (uint16_t)(sign | half);
+}
+
+static float fp16_to_float(uint16_t value) {
+    uint32_t sign = (uint32_t)(value & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1fu;
+    uint32_t mantissa = value & 0x03ffu;
+
+    if (exponent == 0x1f) {
+        /* NaNs come back quiet, as vcvtph2ps returns them. */
+        return bits_float(sign | 0x7f800000u | (mantissa ? 0x00400000u | (mantissa << 13) : 0u));
+    }
+    if (exponent == 0) {
+        if (mantissa == 0) return bits_float(sign);
+        /* Normalize the denormal. */
+        exponent = 127 - 15 + 1;
+        while (!(mantissa & 0x0400u)) {
+            mantissa <<= 1;
+            exponent--;
+        }
+        mantissa &= 0x03ffu;
+        return bits_float(sign | (exponent << 23) | (mantissa << 13));
+    }
+    return bits_float(sign | ((exponent + 127 - 15) << 23) | (mantissa << 13));
+}
+
+uint16_t half_from_float(float value, precision_t precision) {
+    return precision == PRECISION_FP16 ? fp16_from_float(value) : bf16_from_float(value);
+}
+
+float half_to_float(uint16_t value, precision_t precision) {
+    return precision == PRECISION_FP16 ? fp16_to_float(value) : bits_float((uint32_t)value << 16);
+}
+
+#ifdef HALF_X86
+__attribute__((target("avx512f,avx512bf16")))
+static size_t bf16_from_float_avx512(uint16_t *dst, const float *src, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256bh packed = _mm512_cvtneps_pbh(_mm512_loadu_ps(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), (__m256i)packed);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t bf16_to_float_avx2(float *dst, const uint16_t *src, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16)));
+    }
+    return i;
+}
+
+__attribute__((target("avx,f16c")))
+static size_t fp16_from_float_f16c(uint16_t *dst, const float *src, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i packed = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i*)(dst + i), packed);
+    }
+    return i;
+}
+
+__attribute__((target("avx,f16c")))
+static size_t fp16_to_float_f16c(float *dst, const uint16_t *src, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+    }
+    return i;
+}
+
+typedef struct {
+    int bf16;
+    int avx2;
+    int f16c;
+} half_features_t;
+
+static half_features_t half_features;
+static pthread_once_t half_features_once = PTHREAD_ONCE_INIT;
+
+static void detect_features(void) {
+    __builtin_cpu_init();
+    half_features.bf16 = __builtin_cpu_supports("avx512bf16");
+    half_features.avx2 = __builtin_cpu_supports("avx2");
+    half_features.f16c = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+}
+
+static const half_features_t* features(void) {
+    pthread_once(&half_features_once, detect_features);
+    return &half_features;
+}
+#endif
+
+void half_convert_from_float(uint16_t *dst, const float *src, size_t n, precision_t precision) {
+    size_t i = 0;
+#ifdef HALF_X86
+    const half_features_t *cpu = features();
+    if (precision == PRECISION_BF16 && cpu->bf16) i = bf16_from_float_avx512(dst, src, n);
+    if (precision == PRECISION_FP16 && cpu->f16c) i = fp16_from_float_f16c(dst, src, n);
+#endif
+    for (; i < n; i++) dst[i] = half_from_float(src[i], precision);
+}
+
+void half_convert_to_float(float *dst, const uint16_t *src, size_t n, precision_t precision) {
+    size_t i = 0;
+#ifdef HALF_X86
+    const half_features_t *cpu = features();
+    if (precision == PRECISION_BF16 && cpu->avx2) i = bf16_to_float_avx2(dst, src, n);
+    if (precision == PRECISION_FP16 && cpu->f16c) i = fp16_to_float_f16c(dst, src, n);
+#endif
+    for (; i < n; i++) dst[i] = half_to_float(src[i], precision);
+}
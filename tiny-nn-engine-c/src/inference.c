@@ -0,0 +1,255 @@
+#define _POSIX_C_SOURCE 200112L
+#include "inference.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define INFERENCE_ALIGN 64
+
+static size_t padded(size_t bytes) {
+    return (bytes + INFERENCE_ALIGN - 1) / INFERENCE_ALIGN * INFERENCE_ALIGN;
+}
+
+static void* alloc_aligned(size_t bytes) {
+    void *mem = NULL;
+    if (posix_memalign(&mem, INFERENCE_ALIGN, bytes ? bytes : INFERENCE_ALIGN) != 0) return NULL;
+    return mem;
+}
+
+inference_model_t* inference_model_create(dense_layer_t **layers, size_t num_layers) {
+    return inference_model_create_precision(layers, num_layers, PRECISION_FP32);
+}
+
+inference_model_t* inference_model_create_precision(dense_layer_t **layers, size_t num_layers,
+                                                    precision_t precision) {
+    if (num_layers == 0) return NULL;
+    for (size_t i = 1; i < num_layers; i++) {
+        if (layers[i]->weights->rows != layers[i - 1]->weights->cols) {
+            fprintf(stderr, "Layer %zu input width does not match previous layer\n", i);
+            return NULL;
+        }
+    }
+
+    inference_model_t *model = (inference_model_t*)calloc(1, sizeof(inference_model_t));
+    if (!model) return NULL;
+
+    size_t element = precision_size(precision);
+    size_t bytes = 0;
+    for (size_t i = 0; i < num_layers; i++) {
+        bytes += padded(layers[i]->weights->rows * layers[i]->weights->cols * element);
+        bytes += padded(layers[i]->bias->cols * sizeof(float));
+    }
+
+    model->num_layers = num_layers;
+    model->input_size = layers[0]->weights->rows;
+    model->output_size = layers[num_layers - 1]->weights->cols;
+    model->precision = precision;
+    model->layers = (inference_layer_t*)calloc(num_layers, sizeof(inference_layer_t));
+    model->storage = alloc_aligned(bytes);
+    if (!model->layers || !model->storage) {
+        fprintf(stderr, "Failed to allocate inference model\n");
+        inference_model_destroy(model);
+        return NULL;
+    }
+
+    /* Frozen copies, converted once here rather than on every call. */
+    char *block = (char*)model->storage;
+    for (size_t i = 0; i < num_layers; i++) {
+        const dense_layer_t *src = layers[i];
+        inference_layer_t *dst = &model->layers[i];
+        size_t count = src->weights->rows * src->weights->cols;
+
+        dst->input_size = src->weights->rows;
+        dst->output_size = src->weights->cols;
+        dst->precision = precision;
+        dst->activation = src->activation;
+
+        if (precision == PRECISION_FP32) memcpy(block, src->weights->data, count * sizeof(float));
+        else half_convert_from_float((uint16_t*)block, src->weights->data, count, precision);
+        dst->weights = block;
+        block += padded(count * element);
+
+        memcpy(block, src->bias->data, src->bias->cols * sizeof(float));
+        dst->bias = (const float*)block;
+        block += padded(src->bias->cols * sizeof(float));
+
+        if (i + 1 < num_layers && dst->output_size > model->max_hidden) {
+            model->max_hidden = dst->output_size;
+        }
+    }
+
+    /* Without panels inference_forward packs per call; the model still works. */
+    inference_model_pack(model);
+    return model;
+}
+
+void inference_model_destroy(inference_model_t *model) {
+    if (!model) return;
+
+    for (size_t i = 0; model->layers && i < model->num_layers; i++) {
+        gemm_packed_release(&model->layers[i].packed);
+    }
+    free(model->layers);
+    free(model->storage);
+    if (model->map) munmap(model->map, model->map_size);
+    free(model);
+}
+
+int inference_model_pack(inference_model_t *model) {
+    for (size_t i = 0; i < model->num_layers; i++) {
+        inference_layer_t *layer = &model->layers[i];
+        if (layer->precision != PRECISION_FP32) continue;
+        if (!gemm_pack_b(&layer->packed, GEMM_NO_TRANS, layer->input_size, layer->output_size,
+                         layer->weights, PRECISION_FP32, layer->output_size)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Two hidden activations are live at once: the layer input and its output.
+ * Scratch sizes are counted in floats. */
+static size_t activation_floats(const inference_model_t *model, size_t batch) {
+    size_t bytes = batch * model->max_hidden * precision_size(model->precision);
+    return padded(bytes) / sizeof(float);
+}
+
+static size_t tile_floats(const inference_model_t *model, size_t batch) {
+    if (model->precision == PRECISION_FP32) return 0;
+    size_t rows = batch < INFERENCE_ROW_BLOCK ? batch : INFERENCE_ROW_BLOCK;
+    return padded(rows * model->max_hidden * sizeof(float)) / sizeof(float);
+}
+
+static size_t scratch_floats(const inference_model_t *model, size_t batch) {
+    return 2 * activation_floats(model, batch) + tile_floats(model, batch);
+}
+
+inference_scratch_t* inference_scratch_create(const inference_model_t *model, size_t max_batch) {
+    inference_scratch_t *scratch = (inference_scratch_t*)malloc(sizeof(inference_scratch_t));
+    if (!scratch) return NULL;
+
+    scratch->max_batch = max_batch;
+    scratch->capacity = scratch_floats(model, max_batch);
+    scratch->data = scratch->capacity ? (float*)alloc_aligned(scratch->capacity * sizeof(float)) : NULL;
+    if (scratch->capacity && !scratch->data) {
+        fprintf(stderr, "Failed to allocate inference scratch\n");
+        free(scratch);
+        return NULL;
+    }
+    return scratch;
+}
+
+void inference_scratch_destroy(inference_scratch_t *scratch) {
+    if (!scratch) return;
+
+    free(scratch->data);
+    free(scratch);
+}
+
+static __thread float *thread_scratch = NULL;
+static __thread size_t thread_scratch_cap = 0;
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_key_once = PTHREAD_ONCE_INIT;
+
+static void release_thread_scratch(void *unused) {
+    (void)unused;
+    free(thread_scratch);
+    thread_scratch = NULL;
+    thread_scratch_cap = 0;
+}
+
+static void create_scratch_key(void) {
+    pthread_key_create(&scratch_key, release_thread_scratch);
+}
+
+/* Per-thread, grow-only; freed by the key destructor when the thread exits. */
+static float* reserve_thread_scratch(size_t count) {
+    if (count <= thread_scratch_cap) return thread_scratch;
+
+    pthread_once(&scratch_key_once, create_scratch_key);
+    pthread_setspecific(scratch_key, (void*)1);
+
+    float *mem = (float*)alloc_aligned(count * sizeof(float));
+    if (!mem) {
+        fprintf(stderr, "Failed to allocate inference scratch\n");
+        return NULL;
+    }
+    free(thread_scratch);
+    thread_scratch = mem;
+    thread_scratch_cap = count;
+    return thread_scratch;
+}
+
+int inference_forward(const inference_model_t *model, const tensor_t *input,
+                      tensor_t *output, inference_scratch_t *scratch) {
+    size_t batch = input->rows;
+
+    if (input->cols != model->input_size || output->rows != batch ||
+        output->cols != model->output_size) {
+        fprintf(stderr, "Invalid tensor shapes for inference\n");
+        return 0;
+    }
+
+    size_t needed = scratch_floats(model, batch);
+    float *buffers = NULL;
+    if (scratch) {
+        if (batch > scratch->max_batch) {
+            fprintf(stderr, "Batch of %zu exceeds inference scratch batch %zu\n", batch, scratch->max_batch);
+            return 0;
+        }
+        buffers = scratch->data;
+    } else if (needed) {
+        buffers = reserve_thread_scratch(needed);
+        if (!buffers) return 0;
+    }
+
+    size_t buffer_floats = activation_floats(model, batch);
+    float *tile = buffers ? buffers + 2 * buffer_floats : NULL;
+    const void *x = input->data;
+    precision_t x_type = PRECISION_FP32;
+    size_t x_cols = input->cols;
+    size_t x_ld = input->stride;
+    for (size_t i = 0; i < model->num_layers; i++) {
+        const inference_layer_t *layer = &model->layers[i];
+        size_t out = layer->output_size;
+        gemm_epilogue_t epilogue = {layer->bias, layer_gemm_activation(layer->activation)};
+
+        if (i + 1 == model->num_layers || model->precision == PRECISION_FP32) {
+            int last = i + 1 == model->num_layers;
+            float *y = last ? output->data : buffers + (i % 2) * buffer_floats;
+            size_t y_ld = last ? output->stride : out;
+            if (gemm_packed_current(&layer->packed)) {
+                gemm_packed_fused(GEMM_NO_TRANS, batch, 1.0f, x, x_type, x_ld,
+                                  &layer->packed, 0.0f, y, y_ld, &epilogue);
+            } else {
+                gemm_mixed_fused(GEMM_NO_TRANS, GEMM_NO_TRANS, batch, out, x_cols,
+                                 1.0f, x, x_type, x_ld,
+                                 layer->weights, layer->precision, out,
+                                 0.0f, y, y_ld, &epilogue);
+            }
+            x = y;
+            x_type = PRECISION_FP32;
+        } else {
+            /* 16-bit activations: each block of rows is computed into the
+             * fp32 tile and narrowed while it is still in cache. */
+            uint16_t *y = (uint16_t*)(buffers + (i % 2) * buffer_floats);
+            for (size_t r = 0; r < batch; r += INFERENCE_ROW_BLOCK) {
+                size_t rows = batch - r < INFERENCE_ROW_BLOCK ? batch - r : INFERENCE_ROW_BLOCK;
+                const char *x_rows = (const char*)x + r * x_ld * precision_size(x_type);
+                gemm_mixed_fused(GEMM_NO_TRANS, GEMM_NO_TRANS, rows, out, x_cols,
+                                 1.0f, x_rows, x_type, x_ld,
+                                 layer->weights, layer->precision, out,
+                                 0.0f, tile, out, &epilogue);
+                half_convert_from_float(y + r * out, tile, rows * out, model->precision);
+            }
+            x = y;
+            x_type = model->precision;
+        }
+        x_cols = out;
+        x_ld = out;
+    }
+
+    return 1;
+}
@@ -1,28 +1,93 @@
+#define _POSIX_C_SOURCE 200112L
 #include "layer.h"
+#include "gemm.h"
+#include "threadpool.h"
+#include "profile.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 dense_layer_t* layer_create(size_t input_size, size_t output_size, activation_type_t activation) {
+    PROFILE_BEGIN(mark);
     dense_layer_t *layer = (dense_layer_t*)malloc(sizeof(dense_layer_t));
     if (!layer) return NULL;
+    PROFILE_ALLOC(PROFILE_LAYER_CREATE, sizeof(dense_layer_t));
     
     layer->weights = tensor_create(input_size, output_size);
     layer->bias = tensor_create(1, output_size);
     
     layer->input = NULL;
     layer->output = NULL;
-    layer->pre_activation = NULL;
+    layer->grad_activation = NULL;
+    layer->grad_input = NULL;
     
     layer->grad_weights = tensor_create(input_size, output_size);
     layer->grad_bias = tensor_create(1, output_size);
     
     layer->activation = activation;
-    
+    layer->max_batch = 0;
+    layer->precision = PRECISION_FP32;
+    layer->half_weights = NULL;
+    layer->owns_half_weights = 0;
+    layer->sparse_input = NULL;
+    layer->grad_rows = NULL;
+    layer->num_grad_rows = 0;
+    layer->row_marks = NULL;
+    layer->sparse_grad = 0;
+    layer->version = 0;
+    layer->weights_version = &layer->version;
+    memset(&layer->packed, 0, sizeof(layer->packed));
+    pthread_mutex_init(&layer->packed.lock, NULL);
+    layer->packed_weights = &layer->packed;
+    layer->packing = 1;
     
     layer_xavier_init(layer);
     tensor_zeros(layer->bias);
     
+    PROFILE_END(PROFILE_LAYER_CREATE, mark, 0, 0);
+    return layer;
+}
+
+dense_layer_t* layer_create_shared(const dense_layer_t *source) {
+    PROFILE_BEGIN(mark);
+    dense_layer_t *layer = (dense_layer_t*)malloc(sizeof(dense_layer_t));
+    if (!layer) return NULL;
+    PROFILE_ALLOC(PROFILE_LAYER_CREATE, sizeof(dense_layer_t));
+    
+    size_t in = source->weights->rows;
+    size_t out = source->weights->cols;
+    layer->weights = tensor_wrap(source->weights->data, in, out);
+    layer->bias = tensor_wrap(source->bias->data, 1, out);
+    
+    layer->input = NULL;
+    layer->output = NULL;
+    layer->grad_activation = NULL;
+    layer->grad_input = NULL;
+    
+    layer->grad_weights = tensor_create(in, out);
+    layer->grad_bias = tensor_create(1, out);
+    
+    layer->activation = source->activation;
+    layer->max_batch = 0;
+    layer->precision = source->precision;
+    layer->half_weights = source->half_weights;
+    layer->owns_half_weights = 0;
+    layer->sparse_input = NULL;
+    layer->grad_rows = NULL;
+    layer->num_grad_rows = 0;
+    layer->row_marks = NULL;
+    layer->sparse_grad = 0;
+    layer->version = 0;
+    layer->weights_version = source->weights_version;
+    layer->packed_weights = source->packed_weights;
+    layer->packing = 1;
+    
+    if (!layer->weights || !layer->bias || !layer->grad_weights || !layer->grad_bias) {
+        layer_destroy(layer);
+        return NULL;
+    }
+    PROFILE_END(PROFILE_LAYER_CREATE, mark, 0, 0);
     return layer;
 }
 
@@ -31,113 +96,370 @@ void layer_destroy(dense_layer_t *layer) {
     
     tensor_destroy(layer->weights);
     tensor_destroy(layer->bias);
-    tensor_destroy(layer->input);
     tensor_destroy(layer->output);
-    tensor_destroy(layer->pre_activation);
+    tensor_destroy(layer->grad_activation);
+    tensor_destroy(layer->grad_input);
     tensor_destroy(layer->grad_weights);
     tensor_destroy(layer->grad_bias);
+    if (layer->owns_half_weights) free(layer->half_weights);
+    free(layer->grad_rows);
+    free(layer->row_marks);
+    if (layer->packed_weights == &layer->packed) {
+        gemm_packed_release(&layer->packed.panels);
+        pthread_mutex_destroy(&layer->packed.lock);
+    }
     
     free(layer);
 }
 
+int layer_reserve(dense_layer_t *layer, size_t max_batch) {
+    PROFILE_BEGIN(mark);
+    size_t in = layer->weights->rows;
+    size_t out = layer->weights->cols;
+    tensor_t **slots[] = {&layer->output, &layer->grad_activation, &layer->grad_input};
+    size_t widths[] = {out, out, in};
+    
+    for (size_t i = 0; i < 3; i++) {
+        tensor_destroy(*slots[i]);
+        *slots[i] = tensor_create(max_batch, widths[i]);
+        if (!*slots[i]) {
+            layer->max_batch = 0;
+            return 0;
+        }
+    }
+    
+    layer->max_batch = max_batch;
+    PROFILE_END(PROFILE_LAYER_RESERVE, mark, 0, 0);
+    return 1;
+}
+
+int layer_bind(dense_layer_t *layer, float *output, float *grad_activation, float *grad_input,
+               size_t max_batch) {
+    size_t in = layer->weights->rows;
+    size_t out = layer->weights->cols;
+    tensor_t *views[] = {tensor_wrap(output, max_batch, out),
+                         tensor_wrap(grad_activation, max_batch, out),
+                         tensor_wrap(grad_input, max_batch, in)};
+    tensor_t **slots[] = {&layer->output, &layer->grad_activation, &layer->grad_input};
+    
+    if (!views[0] || !views[1] || !views[2]) {
+        for (size_t i = 0; i < 3; i++) tensor_destroy(views[i]);
+        return 0;
+    }
+    for (size_t i = 0; i < 3; i++) {
+        tensor_destroy(*slots[i]);
+        *slots[i] = views[i];
+    }
+    
+    layer->max_batch = max_batch;
+    return 1;
+}
+
+/* Returns the layer-owned buffer for a batch of the given rows. Reserved
+ * workspaces are only reshaped; otherwise the buffer is reallocated. */
+static tensor_t* layer_buffer(dense_layer_t *layer, tensor_t **slot, size_t rows, size_t cols) {
+    if (layer->max_batch) {
+        if (rows > layer->max_batch) {
+            fprintf(stderr, "Batch of %zu exceeds reserved layer batch %zu\n", rows, layer->max_batch);
+            return NULL;
+        }
+        (*slot)->rows = rows;
+        return *slot;
+    }
+    
+    tensor_destroy(*slot);
+    *slot = tensor_create(rows, cols);
+    return *slot;
+}
+
+int layer_set_precision(dense_layer_t *layer, precision_t precision) {
+    if (layer->owns_half_weights) free(layer->half_weights);
+    layer->half_weights = NULL;
+    layer->owns_half_weights = 0;
+    layer->precision = PRECISION_FP32;
+    layer_weights_changed(layer);
+    if (precision == PRECISION_FP32) return 1;
+    
+    PROFILE_BEGIN(mark);
+    void *mem = NULL;
+    size_t count = layer->weights->rows * layer->weights->cols;
+    if (posix_memalign(&mem, 64, (count ? count : 1) * sizeof(uint16_t)) != 0) {
+        fprintf(stderr, "Failed to allocate %s weights\n", precision_name(precision));
+        return 0;
+    }
+    
+    layer->half_weights = (uint16_t*)mem;
+    layer->owns_half_weights = 1;
+    layer->precision = precision;
+    layer_sync_weights(layer);
+    PROFILE_ALLOC(PROFILE_LAYER_SET_PRECISION, (count ? count : 1) * sizeof(uint16_t));
+    PROFILE_END(PROFILE_LAYER_SET_PRECISION, mark, 0, 0);
+    return 1;
+}
+
+void layer_sync_weights(dense_layer_t *layer) {
+    layer_weights_changed(layer);
+    if (!layer->half_weights) return;
+    PROFILE_BEGIN(mark);
+    half_convert_from_float(layer->half_weights, layer->weights->data,
+                            layer->weights->rows * layer->weights->cols, layer->precision);
+    PROFILE_END(PROFILE_LAYER_SYNC_WEIGHTS, mark, 0,
+                layer->weights->rows * layer->weights->cols * (sizeof(float) + sizeof(uint16_t)));
+}
+
+void layer_weights_changed(dense_layer_t *layer) {
+    __atomic_fetch_add(layer->weights_version, 1, __ATOMIC_RELAXED);
+}
+
+/* The forward panels, repacked if the weights or the selected kernel have
+ * changed since they were built. NULL for 16-bit weights, which are read in
+ * place at half the bytes, or when packing fails.
+ *
+ * Replicas of one layer share the panels, so the check and the repack run
+ * under their lock and only the first forward after a version bump packs.
+ * Weights only change between forwards (the same rule that keeps the weights
+ * themselves race-free), so the panels stay put while any replica reads
+ * them after the lock is released. Hogwild breaks that rule and clears
+ * packing instead. */
+static const gemm_packed_t* packed_weights(dense_layer_t *layer) {
+    if (layer->half_weights || !layer->packing) return NULL;
+    layer_packed_t *packed = layer->packed_weights;
+    const gemm_packed_t *panels = &packed->panels;
+    pthread_mutex_lock(&packed->lock);
+    uint64_t version = __atomic_load_n(layer->weights_version, __ATOMIC_RELAXED);
+    if (version != packed->version || !gemm_packed_current(&packed->panels)) {
+        PROFILE_BEGIN(mark);
+        if (gemm_pack_b(&packed->panels, GEMM_NO_TRANS, layer->weights->rows,
+                        layer->weights->cols, layer->weights->data, PRECISION_FP32,
+                        layer->weights->stride)) {
+            packed->version = version;
+            PROFILE_END(PROFILE_LAYER_PACK_WEIGHTS, mark, 0,
+                        2 * layer->weights->rows * layer->weights->cols * sizeof(float));
+        } else {
+            panels = NULL;
+        }
+    }
+    pthread_mutex_unlock(&packed->lock);
+    return panels;
+}
+
+/* The weights as the GEMMs should read them. */
+static const void* gemm_weights(const dense_layer_t *layer) {
+    return layer->half_weights ? (const void*)layer->half_weights : (const void*)layer->weights->data;
+}
+
+/* Bytes one GEMM moves over the weights as stored. */
+#define WEIGHT_BYTES(layer) ((layer)->weights->rows * (layer)->weights->cols * \
+                             ((layer)->half_weights ? sizeof(uint16_t) : sizeof(float)))
+
 void layer_xavier_init(dense_layer_t *layer) {
+    PROFILE_BEGIN(mark);
     float limit = sqrtf(6.0f / (layer->weights->rows + layer->weights->cols));
     tensor_random(layer->weights, -limit, limit);
+    layer_sync_weights(layer);
+    PROFILE_END(PROFILE_LAYER_INIT, mark, 0, 0);
 }
 
 void layer_he_init(dense_layer_t *layer) {
+    PROFILE_BEGIN(mark);
     float stddev = sqrtf(2.0f / layer->weights->rows);
-    tensor_random(layer->weights, -stddev, stddev);
+    tensor_random_normal(layer->weights, 0.0f, stddev);
+    layer_sync_weights(layer);
+    PROFILE_END(PROFILE_LAYER_INIT, mark, 0, 0);
 }
 
-tensor_t* layer_forward(dense_layer_t *layer, const tensor_t *input) {
+typedef struct {
+    const tensor_t *grad_output;
+    const tensor_t *output;
+    tensor_t *grad_activation;
+    float *grad_bias;
+    activation_type_t activation;
+} activation_backward_job_t;
+
+/* One sweep computes grad * f'(output) and sums it into the bias gradient.
+ * Work is split by column so every bias entry is reduced over rows in a
+ * fixed order. */
+static void activation_backward_task(void *arg, size_t begin, size_t end) {
+    const activation_backward_job_t *job = (const activation_backward_job_t*)arg;
+    float *grad_bias = job->grad_bias;
     
-    if (layer->input) tensor_destroy(layer->input);
-    layer->input = tensor_copy(input);
+    for (size_t j = begin; j < end; j++) grad_bias[j] = 0.0f;
     
+    for (size_t i = 0; i < job->output->rows; i++) {
+        const float *go = job->grad_output->data + i * job->grad_output->stride;
+        const float *out = job->output->data + i * job->output->stride;
+        float *ga = job->grad_activation->data + i * job->grad_activation->stride;
+        
+        switch (job->activation) {
+            case ACTIVATION_RELU:
+                for (size_t j = begin; j < end; j++) {
+                    ga[j] = out[j] > 0.0f ? go[j] : 0.0f;
+                    grad_bias[j] += ga[j];
+                }
+                break;
+            case ACTIVATION_SIGMOID:
+                for (size_t j = begin; j < end; j++) {
+                    ga[j] = go[j] * out[j] * (1.0f - out[j]);
+                    grad_bias[j] += ga[j];
+                }
+                break;
+            case ACTIVATION_NONE:
+            default:
+                for (size_t j = begin; j < end; j++) {
+                    ga[j] = go[j];
+                    grad_bias[j] += ga[j];
+                }
+                break;
+        }
+    }
+}
+
+gemm_activation_t layer_gemm_activation(activation_type_t activation) {
+    switch (activation) {
+        case ACTIVATION_RELU: return GEMM_ACT_RELU;
+        case ACTIVATION_SIGMOID: return GEMM_ACT_SIGMOID;
+        case ACTIVATION_NONE:
+        default: return GEMM_ACT_NONE;
+    }
+}
+
+tensor_t* layer_forward(dense_layer_t *layer, const tensor_t *input) {
+    PROFILE_BEGIN(mark);
+    size_t batch = input->rows;
+    size_t out = layer->weights->cols;
     
-    tensor_t *matmul_result = tensor_matmul(input, layer->weights);
+    if (input->cols != layer->weights->rows) {
+        fprintf(stderr, "Invalid input width for dense layer\n");
+        return NULL;
+    }
     
+    tensor_t *output = layer_buffer(layer, &layer->output, batch, out);
+    if (!output) return NULL;
     
-    if (layer->pre_activation) tensor_destroy(layer->pre_activation);
-    layer->pre_activation = tensor_create(matmul_result->rows, matmul_result->cols);
+    layer->input = input;
+    layer->sparse_input = NULL;
     
-   
-    for (size_t i = 0; i < matmul_result->rows; i++) {
-        for (size_t j = 0; j < matmul_result->cols; j++) {
-            layer->pre_activation->data[i * matmul_result->cols + j] = 
-                matmul_result->data[i * matmul_result->cols + j] + layer->bias->data[j];
-        }
+    gemm_epilogue_t epilogue = {layer->bias->data, layer_gemm_activation(layer->activation)};
+    const gemm_packed_t *packed = packed_weights(layer);
+    if (packed) {
+        gemm_packed_fused(GEMM_NO_TRANS, batch, 1.0f, input->data, PRECISION_FP32, input->stride,
+                          packed, 0.0f, output->data, output->stride, &epilogue);
+    } else {
+        gemm_mixed_fused(GEMM_NO_TRANS, GEMM_NO_TRANS, batch, out, input->cols,
+                         1.0f, input->data, PRECISION_FP32, input->stride,
+                         gemm_weights(layer), layer->precision, layer->weights->cols,
+                         0.0f, output->data, output->stride, &epilogue);
     }
     
-    tensor_destroy(matmul_result);
+    /* The GEMM plus the bias and activation epilogue. */
+    PROFILE_END(PROFILE_LAYER_FORWARD, mark, (2.0 * input->cols + 2.0) * batch * out,
+                (batch * (input->cols + out) + out) * sizeof(float) + WEIGHT_BYTES(layer));
+    return output;
+}
+
+tensor_t* layer_forward_sparse(dense_layer_t *layer, const sparse_tensor_t *input) {
+    PROFILE_BEGIN(mark);
+    size_t batch = input->rows;
+    size_t out = layer->weights->cols;
+    
+    if (input->cols != layer->weights->rows) {
+        fprintf(stderr, "Invalid input width for dense layer\n");
+        return NULL;
+    }
     
+    tensor_t *output = layer_buffer(layer, &layer->output, batch, out);
+    if (!output) return NULL;
     
-    if (layer->output) tensor_destroy(layer->output);
-    layer->output = tensor_create(layer->pre_activation->rows, layer->pre_activation->cols);
+    layer->input = NULL;
+    layer->sparse_input = input;
     
-    switch (layer->activation) {
-        case ACTIVATION_RELU:
-            tensor_relu(layer->pre_activation, layer->output);
-            break;
-        case ACTIVATION_SIGMOID:
-            tensor_sigmoid(layer->pre_activation, layer->output);
-            break;
-        case ACTIVATION_NONE:
-        default:
-            tensor_copy_data(layer->output, layer->pre_activation);
-            break;
-    }
+    /* The fp32 master weights are read directly; only gathered rows are
+     * touched, so there is nothing to gain from the 16-bit copy. */
+    gemm_epilogue_t epilogue = {layer->bias->data, layer_gemm_activation(layer->activation)};
+    sparse_matmul_fused(input, layer->weights, output, &epilogue);
     
-    return layer->output;
+    PROFILE_END(PROFILE_LAYER_FORWARD, mark, (2.0 * sparse_nnz(input) + 2.0 * batch) * out,
+                (sparse_nnz(input) * (out + 2) + 2 * batch * out + out) * sizeof(float));
+    return output;
 }
 
-tensor_t* layer_backward(dense_layer_t *layer, const tensor_t *grad_output) {
-   
-    tensor_t *grad_activation = tensor_create(grad_output->rows, grad_output->cols);
-    
-    switch (layer->activation) {
-        case ACTIVATION_RELU: {
-            tensor_t *relu_deriv = tensor_create(layer->pre_activation->rows, layer->pre_activation->cols);
-            tensor_relu_derivative(layer->pre_activation, relu_deriv);
-            tensor_multiply(grad_output, relu_deriv, grad_activation);
-            tensor_destroy(relu_deriv);
-            break;
+/* Weight gradient of a sparse batch: clears the rows the last sparse batch
+ * wrote (or everything after a dense backward), then fills the rows of the
+ * features this batch uses. */
+static int sparse_weight_gradient(dense_layer_t *layer, const tensor_t *grad_activation) {
+    const sparse_tensor_t *input = layer->sparse_input;
+    size_t in = layer->weights->rows;
+    size_t out = layer->weights->cols;
+    
+    if (!layer->grad_rows) {
+        layer->grad_rows = (uint32_t*)malloc((in ? in : 1) * sizeof(uint32_t));
+        layer->row_marks = (unsigned char*)calloc(in ? in : 1, 1);
+        if (!layer->grad_rows || !layer->row_marks) {
+            fprintf(stderr, "Failed to allocate sparse gradient rows\n");
+            free(layer->grad_rows);
+            free(layer->row_marks);
+            layer->grad_rows = NULL;
+            layer->row_marks = NULL;
+            return 0;
         }
-        case ACTIVATION_SIGMOID: {
-            tensor_t *sigmoid_deriv = tensor_create(layer->output->rows, layer->output->cols);
-            tensor_sigmoid_derivative(layer->output, sigmoid_deriv);
-            tensor_multiply(grad_output, sigmoid_deriv, grad_activation);
-            tensor_destroy(sigmoid_deriv);
-            break;
+    }
+    
+    float *grad = layer->grad_weights->data;
+    if (!layer->sparse_grad) {
+        memset(grad, 0, in * out * sizeof(float));
+    } else {
+        for (size_t r = 0; r < layer->num_grad_rows; r++) {
+            memset(grad + (size_t)layer->grad_rows[r] * out, 0, out * sizeof(float));
         }
-        case ACTIVATION_NONE:
-        default:
-            tensor_copy_data(grad_activation, grad_output);
-            break;
     }
     
-   
-    tensor_t *input_T = tensor_transpose(layer->input);
-    tensor_t *grad_w = tensor_matmul(input_T, grad_activation);
-    tensor_copy_data(layer->grad_weights, grad_w);
-    tensor_destroy(input_T);
-    tensor_destroy(grad_w);
+    layer->num_grad_rows = sparse_columns(input, layer->grad_rows, layer->row_marks);
+    layer->sparse_grad = 1;
+    sparse_matmul_tn_rows(input, grad_activation, layer->grad_weights,
+                          layer->grad_rows, layer->num_grad_rows);
+    return 1;
+}
+
+tensor_t* layer_backward(dense_layer_t *layer, const tensor_t *grad_output) {
+    PROFILE_BEGIN(mark);
+    size_t batch = grad_output->rows;
     
-   
-    tensor_zeros(layer->grad_bias);
-    for (size_t i = 0; i < grad_activation->rows; i++) {
-        for (size_t j = 0; j < grad_activation->cols; j++) {
-            layer->grad_bias->data[j] += grad_activation->data[i * grad_activation->cols + j];
-        }
+    tensor_t *grad_activation = layer_buffer(layer, &layer->grad_activation, batch, grad_output->cols);
+    if (!grad_activation) return NULL;
+    
+    activation_backward_job_t job = {grad_output, layer->output, grad_activation,
+                                     layer->grad_bias->data, layer->activation};
+    size_t grain = batch >= THREADPOOL_GRAIN ? 1 : THREADPOOL_GRAIN / (batch ? batch : 1);
+    threadpool_parallel_for(grad_output->cols, grain, activation_backward_task, &job);
+    
+    if (layer->sparse_input) {
+        if (!sparse_weight_gradient(layer, grad_activation)) return NULL;
+        PROFILE_END(PROFILE_LAYER_BACKWARD, mark,
+                    (3.0 * batch + 2.0 * sparse_nnz(layer->sparse_input)) * grad_output->cols,
+                    (batch * 3 * grad_output->cols
+                     + sparse_nnz(layer->sparse_input) * (2 * grad_output->cols + 2)) * sizeof(float));
+        return NULL;
     }
+   
+    tensor_matmul_tn_into(layer->input, grad_activation, layer->grad_weights);
+    layer->sparse_grad = 0;
+    
     
+    tensor_t *grad_input = layer->max_batch
+        ? layer_buffer(layer, &layer->grad_input, batch, layer->weights->rows)
+        : tensor_create(batch, layer->weights->rows);
+    if (!grad_input) return NULL;
     
-    tensor_t *weights_T = tensor_transpose(layer->weights);
-    tensor_t *grad_input = tensor_matmul(grad_activation, weights_T);
-    tensor_destroy(weights_T);
-    tensor_destroy(grad_activation);
+    gemm_mixed_fused(GEMM_NO_TRANS, GEMM_TRANS, batch, layer->weights->rows, layer->weights->cols,
+                     1.0f, grad_activation->data, PRECISION_FP32, grad_activation->stride,
+                     gemm_weights(layer), layer->precision, layer->weights->cols,
+                     0.0f, grad_input->data, grad_input->stride, NULL);
     
+    /* The activation sweep and the input-gradient GEMM; the weight gradient
+     * is charged to tensor_matmul_tn. */
+    PROFILE_END(PROFILE_LAYER_BACKWARD, mark, (2.0 * layer->weights->rows + 3.0) * batch * grad_output->cols,
+                (batch * (4 * grad_output->cols + layer->weights->rows) + grad_output->cols) * sizeof(float)
+                + WEIGHT_BYTES(layer));
     return grad_input;
 }
 
@@ -1,7 +1,21 @@
 #include "loss.h"
+#include "gemm.h"
+#include "threadpool.h"
+#include "profile.h"
 #include <math.h>
 #include <stdio.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define LOSS_X86 1
+#include <immintrin.h>
+#endif
+
+/* Elements per pass of the vectorized transcendentals and per reduction
+ * chunk; the scratch lives on the stack of each worker. */
+#define LOSS_CHUNK 256
+#define LOSS_LANES 16
+#define LOSS_MAX_LEVELS 64
+
 static int check_dimensions(const tensor_t *a, const tensor_t *b) {
     if (!a || !b) {
         fprintf(stderr, "Null tensor pointer\n");
@@ -18,6 +32,346 @@ static int check_dimensions(const tensor_t *a, const tensor_t *b) {
     return 1;
 }
 
+/* Rows of cols floats at each operand's stride; cols covers the whole tensor
+ * when every operand is contiguous. grad is NULL when only the loss is
+ * wanted. */
+typedef struct {
+    const float *predictions;
+    const float *targets;
+    float *grad;
+    size_t ldp, ldt, ldg;
+    size_t cols;
+    float scale;
+    math_mode_t mode;
+    gemm_isa_t isa;
+} loss_job_t;
+
+static loss_job_t loss_job(const tensor_t *predictions, const tensor_t *targets,
+                           tensor_t *grad, float scale) {
+    int contiguous = tensor_is_contiguous(predictions) && tensor_is_contiguous(targets) &&
+                     (!grad || tensor_is_contiguous(grad));
+    loss_job_t job = {predictions->data, targets->data, grad ? grad->data : NULL,
+                      predictions->stride, targets->stride, grad ? grad->stride : 0,
+                      contiguous ? predictions->rows * predictions->cols : predictions->cols, scale,
+                      MATH_PRECISE, gemm_get_isa()};
+    return job;
+}
+
+/* Blocked pairwise summation. Each chunk of loss terms is summed in
+ * LOSS_LANES independent lanes, which are then added as a tree; chunk sums
+ * enter a binary counter that only adds partials of equal weight. Error
+ * grows with log(n) instead of n, and the vector path adds exactly what the
+ * scalar lanes add, so both give the same bits. */
+typedef struct {
+    float partial[LOSS_MAX_LEVELS];
+    size_t top;
+    size_t count;
+} pairwise_sum_t;
+
+static void pairwise_add(pairwise_sum_t *sum, float value) {
+    sum->partial[sum->top++] = value;
+    for (size_t n = ++sum->count; !(n & 1); n >>= 1) {
+        sum->top--;
+        sum->partial[sum->top - 1] += sum->partial[sum->top];
+    }
+}
+
+static float pairwise_total(const pairwise_sum_t *sum) {
+    float total = 0.0f;
+    for (size_t i = sum->top; i-- > 0;) total += sum->partial[i];
+    return total;
+}
+
+static float lanes_total(float *lanes) {
+    for (size_t width = LOSS_LANES / 2; width > 0; width /= 2) {
+        for (size_t l = 0; l < width; l++) lanes[l] += lanes[l + width];
+    }
+    return lanes[0];
+}
+
+static float chunk_sum_scalar(const float *x, size_t n) {
+    float lanes[LOSS_LANES] = {0.0f};
+    size_t i = 0;
+    for (; i + LOSS_LANES <= n; i += LOSS_LANES) {
+        for (size_t l = 0; l < LOSS_LANES; l++) lanes[l] += x[i + l];
+    }
+    for (size_t l = 0; i + l < n; l++) lanes[l] += x[i + l];
+    return lanes_total(lanes);
+}
+
+#ifdef LOSS_X86
+__attribute__((target("avx2")))
+static float chunk_sum_avx2(const float *x, size_t n) {
+    __m256 lo = _mm256_setzero_ps(), hi = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + LOSS_LANES <= n; i += LOSS_LANES) {
+        lo = _mm256_add_ps(lo, _mm256_loadu_ps(x + i));
+        hi = _mm256_add_ps(hi, _mm256_loadu_ps(x + i + 8));
+    }
+    float lanes[LOSS_LANES];
+    _mm256_storeu_ps(lanes, lo);
+    _mm256_storeu_ps(lanes + 8, hi);
+    for (size_t l = 0; i + l < n; l++) lanes[l] += x[i + l];
+    return lanes_total(lanes);
+}
+#endif
+
+static float chunk_sum(const loss_job_t *job, const float *x, size_t n) {
+#ifdef LOSS_X86
+    if (job->isa >= GEMM_ISA_AVX2) return chunk_sum_avx2(x, n);
+#endif
+    (void)job;
+    return chunk_sum_scalar(x, n);
+}
+
+/* Splits [begin, end) into runs that stay within one row. */
+static size_t loss_span(const loss_job_t *job, size_t begin, size_t end,
+                        const float **p, const float **t, float **g) {
+    size_t row = begin / job->cols, col = begin % job->cols;
+    *p = job->predictions + row * job->ldp + col;
+    *t = job->targets + row * job->ldt + col;
+    if (g) *g = job->grad + row * job->ldg + col;
+    return job->cols - col < end - begin ? job->cols - col : end - begin;
+}
+
+/* MSE is cheap enough per element that the chunk scratch would cost more
+ * than the arithmetic, so the terms go straight into the lanes, in the same
+ * lane order as chunk_sum. */
+static float mse_chunk_scalar(const float *p, const float *t, float *g, float scale, size_t n) {
+    float lanes[LOSS_LANES] = {0.0f};
+    size_t i = 0;
+    for (; i + LOSS_LANES <= n; i += LOSS_LANES) {
+        for (size_t l = 0; l < LOSS_LANES; l++) {
+            float diff = p[i + l] - t[i + l];
+            lanes[l] += diff * diff;
+            if (g) g[i + l] = scale * diff;
+        }
+    }
+    for (size_t l = 0; i + l < n; l++) {
+        float diff = p[i + l] - t[i + l];
+        lanes[l] += diff * diff;
+        if (g) g[i + l] = scale * diff;
+    }
+    return lanes_total(lanes);
+}
+
+#ifdef LOSS_X86
+__attribute__((target("avx2")))
+static float mse_chunk_avx2(const float *p, const float *t, float *g, float scale, size_t n) {
+    __m256 lo = _mm256_setzero_ps(), hi = _mm256_setzero_ps();
+    __m256 s = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + LOSS_LANES <= n; i += LOSS_LANES) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(p + i), _mm256_loadu_ps(t + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(p + i + 8), _mm256_loadu_ps(t + i + 8));
+        lo = _mm256_add_ps(lo, _mm256_mul_ps(d0, d0));
+        hi = _mm256_add_ps(hi, _mm256_mul_ps(d1, d1));
+        if (g) {
+            _mm256_storeu_ps(g + i, _mm256_mul_ps(s, d0));
+            _mm256_storeu_ps(g + i + 8, _mm256_mul_ps(s, d1));
+        }
+    }
+    float lanes[LOSS_LANES];
+    _mm256_storeu_ps(lanes, lo);
+    _mm256_storeu_ps(lanes + 8, hi);
+    for (size_t l = 0; i + l < n; l++) {
+        float diff = p[i + l] - t[i + l];
+        lanes[l] += diff * diff;
+        if (g) g[i + l] = scale * diff;
+    }
+    return lanes_total(lanes);
+}
+#endif
+
+/* The fused kernels below write the gradient, when there is one, in the
+ * same sweep that produces the loss terms. */
+static float mse_kernel(void *arg, size_t begin, size_t end) {
+    const loss_job_t *job = (const loss_job_t*)arg;
+    pairwise_sum_t sum = {{0.0f}, 0, 0};
+
+    while (begin < end) {
+        const float *p, *t;
+        float *g = NULL;
+        size_t n = loss_span(job, begin, end, &p, &t, job->grad ? &g : NULL);
+        if (n > LOSS_CHUNK) n = LOSS_CHUNK;
+
+#ifdef LOSS_X86
+        if (job->isa >= GEMM_ISA_AVX2) {
+            pairwise_add(&sum, mse_chunk_avx2(p, t, g, job->scale, n));
+            begin += n;
+            continue;
+        }
+#endif
+        pairwise_add(&sum, mse_chunk_scalar(p, t, g, job->scale, n));
+        begin += n;
+    }
+
+    return pairwise_total(&sum);
+}
+
+static float bce_kernel(void *arg, size_t begin, size_t end) {
+    const loss_job_t *job = (const loss_job_t*)arg;
+    const float epsilon = 1e-7f;
+    float term[LOSS_CHUNK];
+    pairwise_sum_t sum = {{0.0f}, 0, 0};
+
+    while (begin < end) {
+        const float *pred, *target;
+        float *g = NULL;
+        size_t n = loss_span(job, begin, end, &pred, &target, job->grad ? &g : NULL);
+        if (n > LOSS_CHUNK) n = LOSS_CHUNK;
+
+        for (size_t i = 0; i < n; i++) {
+            float p = pred[i];
+
+            if (p < epsilon) p = epsilon;
+            if (p > 1.0f - epsilon) p = 1.0f - epsilon;
+
+            float t = target[i];
+
+            term[i] = -(t * logf(p) + (1.0f - t) * logf(1.0f - p));
+            if (g) g[i] = (p - t) / ((p * (1.0f - p)) * job->scale);
+        }
+        pairwise_add(&sum, chunk_sum(job, term, n));
+        begin += n;
+    }
+
+    return pairwise_total(&sum);
+}
+
+/* max(z, 0) - z * t + log(1 + exp(-|z|)) is -(t log s + (1 - t) log(1 - s))
+ * for s = sigmoid(z), without ever forming s or taking the log of 0. The
+ * same e = exp(-|z|) gives s = 1 / (1 + e) for z >= 0 and e / (1 + e)
+ * otherwise, so the gradient costs one division more. */
+static float bce_logits_kernel(void *arg, size_t begin, size_t end) {
+    const loss_job_t *job = (const loss_job_t*)arg;
+    float e[LOSS_CHUNK], softplus[LOSS_CHUNK];
+    pairwise_sum_t sum = {{0.0f}, 0, 0};
+
+    while (begin < end) {
+        const float *z, *t;
+        float *g = NULL;
+        size_t n = loss_span(job, begin, end, &z, &t, job->grad ? &g : NULL);
+        if (n > LOSS_CHUNK) n = LOSS_CHUNK;
+
+        for (size_t i = 0; i < n; i++) e[i] = -fabsf(z[i]);
+        math_exp(e, e, n, job->mode);
+        for (size_t i = 0; i < n; i++) softplus[i] = 1.0f + e[i];
+        if (g) {
+            for (size_t i = 0; i < n; i++) {
+                float s = (z[i] >= 0.0f ? 1.0f : e[i]) / softplus[i];
+                g[i] = (s - t[i]) / job->scale;
+            }
+        }
+        math_log(softplus, softplus, n, job->mode);
+        for (size_t i = 0; i < n; i++) {
+            softplus[i] += (z[i] > 0.0f ? z[i] : 0.0f) - z[i] * t[i];
+        }
+        pairwise_add(&sum, chunk_sum(job, softplus, n));
+        begin += n;
+    }
+
+    return pairwise_total(&sum);
+}
+
+/* Softmax cross-entropy, one row per sample. The reduction runs over
+ * elements so blocks and threads split like the other losses; a block takes
+ * the rows that start inside it. With m the row max and S the sum of
+ * exp(z - m), the row loss -sum t log softmax(z) is
+ *   (sum t) (m + log S) - sum t z
+ * and the gradient (softmax(z) - t) / rows. exp(z - m) is written straight
+ * into the gradient row and normalized once S is known. */
+static float softmax_ce_kernel(void *arg, size_t begin, size_t end) {
+    const loss_job_t *job = (const loss_job_t*)arg;
+    size_t cols = job->cols;
+    float shifted[LOSS_CHUNK], weighted[LOSS_CHUNK];
+    pairwise_sum_t sum = {{0.0f}, 0, 0};
+
+    for (size_t row = (begin + cols - 1) / cols; row < (end + cols - 1) / cols; row++) {
+        const float *z = job->predictions + row * job->ldp;
+        const float *t = job->targets + row * job->ldt;
+        float *g = job->grad ? job->grad + row * job->ldg : NULL;
+
+        float max = z[0];
+        for (size_t j = 1; j < cols; j++) max = z[j] > max ? z[j] : max;
+
+        pairwise_sum_t exp_sum = {{0.0f}, 0, 0}, t_sum = {{0.0f}, 0, 0}, tz_sum = {{0.0f}, 0, 0};
+        for (size_t j = 0; j < cols; j += LOSS_CHUNK) {
+            size_t n = cols - j < LOSS_CHUNK ? cols - j : LOSS_CHUNK;
+            for (size_t i = 0; i < n; i++) {
+                shifted[i] = z[j + i] - max;
+                weighted[i] = t[j + i] * shifted[i];
+            }
+            pairwise_add(&t_sum, chunk_sum(job, t + j, n));
+            pairwise_add(&tz_sum, chunk_sum(job, weighted, n));
+            float *e = g ? g + j : shifted;
+            math_exp(e, shifted, n, job->mode);
+            pairwise_add(&exp_sum, chunk_sum(job, e, n));
+        }
+
+        float total = pairwise_total(&exp_sum);
+        float log_total = logf(total);
+        pairwise_add(&sum, pairwise_total(&t_sum) * log_total - pairwise_total(&tz_sum));
+        if (g) {
+            float inverse = 1.0f / total;
+            for (size_t j = 0; j < cols; j++) g[j] = (g[j] * inverse - t[j]) * job->scale;
+        }
+    }
+
+    return pairwise_total(&sum);
+}
+
+static void mse_grad_task(void *arg, size_t begin, size_t end) {
+    const loss_job_t *job = (const loss_job_t*)arg;
+
+    while (begin < end) {
+        const float *p, *t;
+        float *g;
+        size_t n = loss_span(job, begin, end, &p, &t, &g);
+        for (size_t i = 0; i < n; i++) {
+            g[i] = job->scale * (p[i] - t[i]);
+        }
+        begin += n;
+    }
+}
+
+static void bce_grad_task(void *arg, size_t begin, size_t end) {
+    const loss_job_t *job = (const loss_job_t*)arg;
+    const float epsilon = 1e-7f;
+
+    while (begin < end) {
+        const float *pred, *target;
+        float *g;
+        size_t n = loss_span(job, begin, end, &pred, &target, &g);
+        for (size_t i = 0; i < n; i++) {
+            float p = pred[i];
+
+            if (p < epsilon) p = epsilon;
+            if (p > 1.0f - epsilon) p = 1.0f - epsilon;
+
+            float t = target[i];
+
+            g[i] = (p - t) / ((p * (1.0f - p)) * job->scale);
+        }
+        begin += n;
+    }
+}
+
+static void bce_logits_grad_task(void *arg, size_t begin, size_t end) {
+    const loss_job_t *job = (const loss_job_t*)arg;
+
+    while (begin < end) {
+        const float *z, *t;
+        float *g;
+        size_t n = loss_span(job, begin, end, &z, &t, &g);
+        math_sigmoid(g, z, n, job->mode);
+        for (size_t i = 0; i < n; i++) {
+            g[i] = (g[i] - t[i]) / job->scale;
+        }
+        begin += n;
+    }
+}
+
 float loss_mse(const tensor_t *predictions, const tensor_t *targets) {
     if (!check_dimensions(predictions, targets))
         return 0.0f;
@@ -26,12 +380,10 @@ float loss_mse(const tensor_t *predictions, const tensor_t *targets) {
     if (n == 0)
         return 0.0f;
 
-    float sum = 0.0f;
-
-    for (size_t i = 0; i < n; i++) {
-        float diff = predictions->data[i] - targets->data[i];
-        sum += diff * diff;
-    }
+    PROFILE_BEGIN(mark);
+    loss_job_t job = loss_job(predictions, targets, NULL, 0.0f);
+    float sum = threadpool_reduce_sum(n, mse_kernel, &job);
+    PROFILE_END(PROFILE_LOSS_MSE, mark, 3 * n, 2 * n * sizeof(float));
 
     return sum / (float)n;
 }
@@ -44,19 +396,10 @@ float loss_binary_crossentropy(const tensor_t *predictions, const tensor_t *targ
     if (n == 0)
         return 0.0f;
 
-    const float epsilon = 1e-7f;
-    float sum = 0.0f;
-
-    for (size_t i = 0; i < n; i++) {
-        float p = predictions->data[i];
-
-        if (p < epsilon) p = epsilon;
-        if (p > 1.0f - epsilon) p = 1.0f - epsilon;
-
-        float t = targets->data[i];
-
-        sum += -(t * logf(p) + (1.0f - t) * logf(1.0f - p));
-    }
+    PROFILE_BEGIN(mark);
+    loss_job_t job = loss_job(predictions, targets, NULL, 0.0f);
+    float sum = threadpool_reduce_sum(n, bce_kernel, &job);
+    PROFILE_END(PROFILE_LOSS_BCE, mark, 7 * n, 2 * n * sizeof(float));
 
     return sum / (float)n;
 }
@@ -73,9 +416,10 @@ void loss_mse_derivative(const tensor_t *predictions,
     if (n == 0)
         return;
 
-    for (size_t i = 0; i < n; i++) {
-        grad->data[i] = 2.0f * (predictions->data[i] - targets->data[i]) / (float)n;
-    }
+    PROFILE_BEGIN(mark);
+    loss_job_t job = loss_job(predictions, targets, grad, 2.0f / (float)n);
+    threadpool_parallel_for(n, THREADPOOL_GRAIN, mse_grad_task, &job);
+    PROFILE_END(PROFILE_LOSS_MSE_DERIVATIVE, mark, 3 * n, 3 * n * sizeof(float));
 }
 
 void loss_bce_derivative(const tensor_t *predictions,
@@ -90,18 +434,132 @@ void loss_bce_derivative(const tensor_t *predictions,
     if (n == 0)
         return;
 
-    const float epsilon = 1e-7f;
+    PROFILE_BEGIN(mark);
+    loss_job_t job = loss_job(predictions, targets, grad, (float)n);
+    threadpool_parallel_for(n, THREADPOOL_GRAIN, bce_grad_task, &job);
+    PROFILE_END(PROFILE_LOSS_BCE_DERIVATIVE, mark, 6 * n, 3 * n * sizeof(float));
+}
 
-    for (size_t i = 0; i < n; i++) {
-        float p = predictions->data[i];
+float loss_bce_with_logits(const tensor_t *logits, const tensor_t *targets, math_mode_t mode) {
+    if (!check_dimensions(logits, targets))
+        return 0.0f;
 
-        
-        if (p < epsilon) p = epsilon;
-        if (p > 1.0f - epsilon) p = 1.0f - epsilon;
+    size_t n = logits->rows * logits->cols;
+    if (n == 0)
+        return 0.0f;
 
-        float t = targets->data[i];
+    PROFILE_BEGIN(mark);
+    loss_job_t job = loss_job(logits, targets, NULL, 0.0f);
+    job.mode = mode;
+    float sum = threadpool_reduce_sum(n, bce_logits_kernel, &job);
+    PROFILE_END(PROFILE_LOSS_BCE_LOGITS, mark, 6 * n, 2 * n * sizeof(float));
 
-        grad->data[i] =
-            (p - t) / ((p * (1.0f - p)) * (float)n);
-    }
+    return sum / (float)n;
+}
+
+void loss_bce_with_logits_derivative(const tensor_t *logits,
+                                     const tensor_t *targets,
+                                     tensor_t *grad,
+                                     math_mode_t mode) {
+
+    if (!check_dimensions(logits, targets) ||
+        !check_dimensions(logits, grad))
+        return;
+
+    size_t n = logits->rows * logits->cols;
+    if (n == 0)
+        return;
+
+    PROFILE_BEGIN(mark);
+    loss_job_t job = loss_job(logits, targets, grad, (float)n);
+    job.mode = mode;
+    threadpool_parallel_for(n, THREADPOOL_GRAIN, bce_logits_grad_task, &job);
+    PROFILE_END(PROFILE_LOSS_BCE_LOGITS_DERIVATIVE, mark, 3 * n, 3 * n * sizeof(float));
+}
+
+float loss_mse_with_grad(const tensor_t *predictions, const tensor_t *targets, tensor_t *grad) {
+    if (!check_dimensions(predictions, targets) ||
+        !check_dimensions(predictions, grad))
+        return 0.0f;
+
+    size_t n = predictions->rows * predictions->cols;
+    if (n == 0)
+        return 0.0f;
+
+    PROFILE_BEGIN(mark);
+    loss_job_t job = loss_job(predictions, targets, grad, 2.0f / (float)n);
+    float sum = threadpool_reduce_sum(n, mse_kernel, &job);
+    PROFILE_END(PROFILE_LOSS_MSE_WITH_GRAD, mark, 5 * n, 3 * n * sizeof(float));
+
+    return sum / (float)n;
 }
+
+float loss_bce_with_grad(const tensor_t *predictions, const tensor_t *targets, tensor_t *grad) {
+    if (!check_dimensions(predictions, targets) ||
+        !check_dimensions(predictions, grad))
+        return 0.0f;
+
+    size_t n = predictions->rows * predictions->cols;
+    if (n == 0)
+        return 0.0f;
+
+    PROFILE_BEGIN(mark);
+    loss_job_t job = loss_job(predictions, targets, grad, (float)n);
+    float sum = threadpool_reduce_sum(n, bce_kernel, &job);
+    PROFILE_END(PROFILE_LOSS_BCE_WITH_GRAD, mark, 12 * n, 3 * n * sizeof(float));
+
+    return sum / (float)n;
+}
+
+float loss_bce_logits_with_grad(const tensor_t *logits, const tensor_t *targets,
+                                tensor_t *grad, math_mode_t mode) {
+    if (!check_dimensions(logits, targets) ||
+        !check_dimensions(logits, grad))
+        return 0.0f;
+
+    size_t n = logits->rows * logits->cols;
+    if (n == 0)
+        return 0.0f;
+
+    PROFILE_BEGIN(mark);
+    loss_job_t job = loss_job(logits, targets, grad, (float)n);
+    job.mode = mode;
+    float sum = threadpool_reduce_sum(n, bce_logits_kernel, &job);
+    PROFILE_END(PROFILE_LOSS_BCE_LOGITS_WITH_GRAD, mark, 9 * n, 3 * n * sizeof(float));
+
+    return sum / (float)n;
+}
+
+/* Rows are never merged: the kernel needs the class count per row. */
+static float softmax_crossentropy(const tensor_t *logits, const tensor_t *targets,
+                                  tensor_t *grad, math_mode_t mode) {
+    if (!check_dimensions(logits, targets) ||
+        (grad && !check_dimensions(logits, grad)))
+        return 0.0f;
+
+    size_t n = logits->rows * logits->cols;
+    if (n == 0)
+        return 0.0f;
+
+    PROFILE_BEGIN(mark);
+    loss_job_t job = {logits->data, targets->data, grad ? grad->data : NULL,
+                      logits->stride, targets->stride, grad ? grad->stride : 0,
+                      logits->cols, 1.0f / (float)logits->rows, mode, gemm_get_isa()};
+    float sum = threadpool_reduce_sum(n, softmax_ce_kernel, &job);
+    PROFILE_END(PROFILE_LOSS_SOFTMAX_CE, mark, (grad ? 10 : 7) * n, (grad ? 3 : 2) * n * sizeof(float));
+
+    return sum / (float)logits->rows;
+}
+
+float loss_softmax_crossentropy(const tensor_t *logits, const tensor_t *targets, math_mode_t mode) {
+    return softmax_crossentropy(logits, targets, NULL, mode);
+}
+
+float loss_softmax_crossentropy_with_grad(const tensor_t *logits, const tensor_t *targets,
+                                          tensor_t *grad, math_mode_t mode) {
+    if (!grad) {
+        fprintf(stderr, "Null tensor pointer\n");
+        return 0.0f;
+    }
+    return softmax_crossentropy(logits, targets, grad, mode);
+}
\ No newline at end of file
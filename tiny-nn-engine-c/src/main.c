@@ -4,9 +4,96 @@
 #include "layer.h"
 #include "loss.h"
 #include "optimizer.h"
+#include "threadpool.h"
+#include "dataset.h"
+#include "inference.h"
+#include "model.h"
+#include "quant.h"
+#include "network.h"
+#include "rng.h"
 
-int main() {
+/* A 2-4-1 ReLU net misses XOR from some starting points (hidden units that
+ * die early), the default seed among them. This one reaches 4/4 with every
+ * GEMM ISA at 1 and 4 threads. */
+#define XOR_SEED 5
+
+static int train_dataset(const char *path, const char *model_path) {
+    dataset_t *dataset = dataset_open(path);
+    if (!dataset) return 1;
+    
+    size_t batch_size = 64;
+    dataset_loader_t *loader = dataset_loader_create(dataset, batch_size, 1, 42);
+    if (!loader) {
+        dataset_close(dataset);
+        return 1;
+    }
+    printf("Dataset: %zu samples, %zu features, %zu targets\n",
+           dataset->num_samples, dataset->num_features, dataset->num_targets);
+    
+    network_t *network = network_create();
+    network_add_dense(network, dataset->num_features, 64, ACTIVATION_RELU);
+    network_add_dense(network, 64, dataset->num_targets, ACTIVATION_SIGMOID);
+    if (!network_build(network, batch_size)) {
+        network_destroy(network);
+        dataset_loader_destroy(loader);
+        dataset_close(dataset);
+        return 1;
+    }
+    adam_optimizer_t *optimizer = adam_create(0.001f, network->num_layers);
+    printf("Activation arena: %zu KiB (%zu KiB without sharing)\n",
+           network->arena_bytes / 1024, network->unplanned_bytes / 1024);
+    
+    for (int epoch = 0; epoch < 10; epoch++) {
+        float total = 0.0f;
+        size_t batches = 0;
+        const tensor_t *x, *y;
+        while (dataset_loader_next(loader, &x, &y)) {
+            total += network_train_step(network, x, y, NETWORK_LOSS_BCE, optimizer);
+            batches++;
+        }
+        printf("Epoch %5d | Loss: %.6f\n", epoch + 1, total / (float)batches);
+    }
+    
+    /* Accuracy cost of serving the trained model with int8 weights. The
+     * calibration rows are read-only views of the mapping. */
+    size_t calibration_rows = dataset->num_samples < 1024 ? dataset->num_samples : 1024;
+    const tensor_t calibration_x = tensor_view((float*)dataset->features, calibration_rows,
+                                               dataset->num_features, dataset->num_features);
+    const tensor_t calibration_y = tensor_view((float*)dataset->targets, calibration_rows,
+                                               dataset->num_targets, dataset->num_targets);
+    quant_model_t *quantized = quant_model_create(network->layers, network->num_layers);
+    quant_report_t report;
+    if (quantized && quant_calibrate(quantized, network->layers, network->num_layers, &calibration_x, &calibration_y, &report)) {
+        printf("int8 (%s): accuracy %.4f vs fp32 %.4f (delta %+.4f), max |error| %.5f\n",
+               quant_kernel_name(quant_get_kernel()), report.int8_accuracy, report.fp32_accuracy,
+               report.accuracy_delta, report.max_abs_error);
+    }
+    quant_model_destroy(quantized);
+    
+    int status = 0;
+    if (model_path) {
+        status = model_save(model_path, network->layers, network->num_layers) ? 0 : 1;
+        if (status == 0) printf("Saved model to %s\n", model_path);
+    }
+    
+    network_destroy(network);
+    adam_destroy(optimizer);
+    dataset_loader_destroy(loader);
+    dataset_close(dataset);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        threadpool_init(0);
+        int status = train_dataset(argv[1], argc > 2 ? argv[2] : NULL);
+        threadpool_shutdown();
+        return status;
+    }
+    
     printf("🧠 Tiny Neural Network Engine - XOR Problem\n");
+    threadpool_init(0);
+    rng_set_seed(XOR_SEED);
     float xor_inputs_data[4][2] = {
         {0.0f, 0.0f},
         {0.0f, 1.0f},
@@ -30,23 +117,14 @@ int main() {
         y->data[i] = xor_targets_data[i][0];
     }
     
-    dense_layer_t *layer1 = layer_create(2, 4, ACTIVATION_RELU);
-    dense_layer_t *layer2 = layer_create(4, 1, ACTIVATION_SIGMOID);
-    dense_layer_t *layers[] = {layer1, layer2};
-    adam_optimizer_t *optimizer = adam_create(0.1f, 2);
+    network_t *network = network_create();
+    network_add_dense(network, 2, 4, ACTIVATION_RELU);
+    network_add_dense(network, 4, 1, ACTIVATION_SIGMOID);
+    network_build(network, 4);
+    adam_optimizer_t *optimizer = adam_create(0.1f, network->num_layers);
     int epochs = 5000;
     for (int epoch = 0; epoch < epochs; epoch++) {
-        tensor_t *hidden = layer_forward(layer1, X);
-        tensor_t *output = layer_forward(layer2, hidden);
-        float loss = loss_binary_crossentropy(output, y);
-        tensor_t *grad = tensor_create(output->rows, output->cols);
-        loss_bce_derivative(output, y, grad);   
-        tensor_t *grad_hidden = layer_backward(layer2, grad);
-        tensor_t *grad_input = layer_backward(layer1, grad_hidden);
-        adam_step(optimizer, layers, 2);
-        tensor_destroy(grad);
-        tensor_destroy(grad_hidden);
-        tensor_destroy(grad_input);
+        float loss = network_train_step(network, X, y, NETWORK_LOSS_BCE, optimizer);
         if ((epoch + 1) % 1000 == 0) {
             printf("Epoch %5d | Loss: %.6f\n", epoch + 1, loss);
         }
@@ -55,8 +133,9 @@ int main() {
     printf("\n✅ Training Complete!\n\n");
     printf("XOR Predictions:\n");
     printf("----------------\n");
-    tensor_t *final_hidden = layer_forward(layer1, X);
-    tensor_t *predictions = layer_forward(layer2, final_hidden);
+    inference_model_t *model = inference_model_create(network->layers, network->num_layers);
+    tensor_t *predictions = tensor_create(4, 1);
+    inference_forward(model, X, predictions, NULL);
     
     int correct = 0;
     for (int i = 0; i < 4; i++) {
@@ -76,9 +155,11 @@ int main() {
     printf("\nAccuracy: %d/4 (%.1f%%)\n", correct, (correct / 4.0f) * 100.0f);
     tensor_destroy(X);
     tensor_destroy(y);
-    layer_destroy(layer1);
-    layer_destroy(layer2);
+    tensor_destroy(predictions);
+    inference_model_destroy(model);
+    network_destroy(network);
     adam_destroy(optimizer);
+    threadpool_shutdown();
     
     printf("\n🚀 Program complete!\n");
     
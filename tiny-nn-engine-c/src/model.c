@@ -0,0 +1,190 @@
+#define _POSIX_C_SOURCE 200112L
+#include "model.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MODEL_ALIGN 64
+
+static uint64_t align_up(uint64_t value) {
+    return (value + MODEL_ALIGN - 1) / MODEL_ALIGN * MODEL_ALIGN;
+}
+
+static int write_block(FILE *file, uint64_t offset, const void *data, size_t bytes) {
+    if (fseek(file, (long)offset, SEEK_SET) != 0) return 0;
+    return fwrite(data, 1, bytes, file) == bytes;
+}
+
+/* Writes count weights at offset, narrowed to precision through a bounded
+ * staging buffer. */
+static int write_weights(FILE *file, uint64_t offset, const float *data, size_t count,
+                         precision_t precision) {
+    if (precision == PRECISION_FP32) return write_block(file, offset, data, count * sizeof(float));
+    if (fseek(file, (long)offset, SEEK_SET) != 0) return 0;
+
+    uint16_t staging[4096];
+    for (size_t i = 0; i < count; i += 4096) {
+        size_t n = count - i < 4096 ? count - i : 4096;
+        half_convert_from_float(staging, data + i, n, precision);
+        if (fwrite(staging, sizeof(uint16_t), n, file) != n) return 0;
+    }
+    return 1;
+}
+
+int model_save(const char *path, dense_layer_t **layers, size_t num_layers) {
+    return model_save_precision(path, layers, num_layers, PRECISION_FP32);
+}
+
+int model_save_precision(const char *path, dense_layer_t **layers, size_t num_layers,
+                         precision_t precision) {
+    model_layer_record_t *records = (model_layer_record_t*)calloc(num_layers, sizeof(model_layer_record_t));
+    if (!records) return 0;
+
+    uint64_t offset = align_up(sizeof(model_header_t) + num_layers * sizeof(model_layer_record_t));
+    for (size_t i = 0; i < num_layers; i++) {
+        const dense_layer_t *layer = layers[i];
+        records[i].input_size = layer->weights->rows;
+        records[i].output_size = layer->weights->cols;
+        records[i].activation = (uint32_t)layer->activation;
+        records[i].precision = (uint32_t)precision;
+        records[i].weights_offset = offset;
+        offset = align_up(offset + layer->weights->rows * layer->weights->cols * precision_size(precision));
+        records[i].bias_offset = offset;
+        offset = align_up(offset + layer->bias->cols * sizeof(float));
+    }
+
+    model_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MODEL_MAGIC, 8);
+    header.version = MODEL_VERSION;
+    header.header_size = sizeof(header);
+    header.num_layers = (uint32_t)num_layers;
+    header.record_size = sizeof(model_layer_record_t);
+    header.file_size = offset;
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open model %s for writing\n", path);
+        free(records);
+        return 0;
+    }
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(records, sizeof(model_layer_record_t), num_layers, file) == num_layers;
+    for (size_t i = 0; i < num_layers && ok; i++) {
+        const dense_layer_t *layer = layers[i];
+        ok = write_weights(file, records[i].weights_offset, layer->weights->data,
+                           layer->weights->rows * layer->weights->cols, precision) &&
+             write_block(file, records[i].bias_offset, layer->bias->data,
+                         layer->bias->cols * sizeof(float));
+    }
+    /* Pad to file_size so the last blob's alignment tail is mapped too. */
+    if (ok && ftell(file) < (long)offset) {
+        char zero = 0;
+        ok = write_block(file, offset - 1, &zero, 1);
+    }
+    if (fclose(file) != 0) ok = 0;
+    free(records);
+
+    if (!ok) fprintf(stderr, "Failed to write model %s\n", path);
+    return ok;
+}
+
+/* Checks that a blob of count elements lies inside the file on an aligned offset. */
+static int blob_valid(uint64_t offset, uint64_t count, size_t element, uint64_t file_size) {
+    return offset % MODEL_ALIGN == 0 && offset <= file_size &&
+           count <= (file_size - offset) / element;
+}
+
+static int header_valid(const model_header_t *header, size_t size) {
+    if (memcmp(header->magic, MODEL_MAGIC, 8) != 0 || header->version < 1 || header->version > MODEL_VERSION ||
+        header->header_size != sizeof(model_header_t) ||
+        header->record_size != sizeof(model_layer_record_t) ||
+        header->file_size != size || header->num_layers == 0) {
+        return 0;
+    }
+    if ((uint64_t)header->num_layers * sizeof(model_layer_record_t) > size - sizeof(model_header_t)) {
+        return 0;
+    }
+
+    const model_layer_record_t *records = (const model_layer_record_t*)(header + 1);
+    for (uint32_t i = 0; i < header->num_layers; i++) {
+        const model_layer_record_t *r = &records[i];
+        if (r->input_size == 0 || r->output_size == 0 || r->activation > ACTIVATION_SIGMOID ||
+            r->precision > PRECISION_FP16 || r->output_size > UINT64_MAX / r->input_size ||
+            !blob_valid(r->weights_offset, r->input_size * r->output_size,
+                        precision_size((precision_t)r->precision), size) ||
+            !blob_valid(r->bias_offset, r->output_size, sizeof(float), size) ||
+            (i > 0 && r->input_size != records[i - 1].output_size)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+inference_model_t* model_load(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open model %s\n", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(model_header_t)) {
+        fprintf(stderr, "Model %s is too small\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map model %s\n", path);
+        return NULL;
+    }
+
+    const model_header_t *header = (const model_header_t*)map;
+    if (!header_valid(header, size)) {
+        fprintf(stderr, "Model %s has an invalid header\n", path);
+        munmap(map, size);
+        return NULL;
+    }
+
+    inference_model_t *model = (inference_model_t*)calloc(1, sizeof(inference_model_t));
+    if (!model) {
+        munmap(map, size);
+        return NULL;
+    }
+    model->map = map;
+    model->map_size = size;
+    model->num_layers = header->num_layers;
+    model->layers = (inference_layer_t*)calloc(model->num_layers, sizeof(inference_layer_t));
+    if (!model->layers) {
+        inference_model_destroy(model);
+        return NULL;
+    }
+
+    const model_layer_record_t *records = (const model_layer_record_t*)(header + 1);
+    for (size_t i = 0; i < model->num_layers; i++) {
+        const model_layer_record_t *r = &records[i];
+        inference_layer_t *layer = &model->layers[i];
+        layer->input_size = r->input_size;
+        layer->output_size = r->output_size;
+        layer->weights = (const char*)map + r->weights_offset;
+        layer->bias = (const float*)((const char*)map + r->bias_offset);
+        layer->precision = (precision_t)r->precision;
+        layer->activation = (activation_type_t)r->activation;
+        if (i + 1 < model->num_layers && r->output_size > model->max_hidden) {
+            model->max_hidden = r->output_size;
+        }
+    }
+    model->input_size = records[0].input_size;
+    model->output_size = records[model->num_layers - 1].output_size;
+    model->precision = (precision_t)records[0].precision;
+    return model;
+}
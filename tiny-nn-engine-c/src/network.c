@@ -0,0 +1,374 @@
+#define _POSIX_C_SOURCE 200112L
+#include "network.h"
+#include "loss.h"
+#include "allocator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define NETWORK_ALIGN 64
+
+network_t* network_create(void) {
+    network_t *network = (network_t*)calloc(1, sizeof(network_t));
+    if (!network) {
+        fprintf(stderr, "Failed to allocate network\n");
+        return NULL;
+    }
+    network->checkpoint_interval = 1;
+    return network;
+}
+
+void network_destroy(network_t *network) {
+    if (!network) return;
+
+    for (size_t i = 0; i < network->num_layers; i++) layer_destroy(network->layers[i]);
+    free(network->layers);
+    param_arena_destroy(network->params);
+    tensor_destroy(network->loss_grad);
+    allocator_free(network->arena);
+    free(network);
+}
+
+int network_add(network_t *network, dense_layer_t *layer) {
+    if (!layer) return 0;
+    if (network->max_batch) {
+        fprintf(stderr, "Cannot add layers to a built network\n");
+        return 0;
+    }
+
+    if (network->num_layers == network->capacity) {
+        size_t capacity = network->capacity ? 2 * network->capacity : 4;
+        dense_layer_t **layers = (dense_layer_t**)realloc(network->layers, capacity * sizeof(dense_layer_t*));
+        if (!layers) {
+            fprintf(stderr, "Failed to grow network\n");
+            return 0;
+        }
+        network->layers = layers;
+        network->capacity = capacity;
+    }
+
+    network->layers[network->num_layers++] = layer;
+    return 1;
+}
+
+dense_layer_t* network_add_dense(network_t *network, size_t input_size, size_t output_size,
+                                 activation_type_t activation) {
+    dense_layer_t *layer = layer_create(input_size, output_size, activation);
+    if (!layer) return NULL;
+    if (!network_add(network, layer)) {
+        layer_destroy(layer);
+        return NULL;
+    }
+    return layer;
+}
+
+size_t network_input_size(const network_t *network) {
+    return network->num_layers ? network->layers[0]->weights->rows : 0;
+}
+
+size_t network_output_size(const network_t *network) {
+    return network->num_layers ? network->layers[network->num_layers - 1]->weights->cols : 0;
+}
+
+/* One planned buffer: bytes, the first and last step that touch it, and its
+ * place in the arena once assigned. A recomputed output is live twice, in
+ * forward and again from its recompute to its backward; again_last is 0 for
+ * every other buffer. */
+typedef struct {
+    size_t bytes;
+    size_t first;
+    size_t last;
+    size_t again_first;
+    size_t again_last;
+    size_t offset;
+} plan_buffer_t;
+
+static size_t aligned_bytes(size_t floats) {
+    size_t bytes = floats * sizeof(float);
+    return (bytes + NETWORK_ALIGN - 1) / NETWORK_ALIGN * NETWORK_ALIGN;
+}
+
+static int ranges_overlap(size_t a_first, size_t a_last, size_t b_first, size_t b_last) {
+    return a_first <= b_last && b_first <= a_last;
+}
+
+static int lifetimes_overlap(const plan_buffer_t *a, const plan_buffer_t *b) {
+    if (ranges_overlap(a->first, a->last, b->first, b->last)) return 1;
+    if (a->again_last && ranges_overlap(a->again_first, a->again_last, b->first, b->last)) return 1;
+    if (b->again_last && ranges_overlap(a->first, a->last, b->again_first, b->again_last)) return 1;
+    return a->again_last && b->again_last &&
+           ranges_overlap(a->again_first, a->again_last, b->again_first, b->again_last);
+}
+
+/* Greedy placement, largest buffer first: each buffer takes the lowest offset
+ * that does not collide with any already placed buffer that is live at the
+ * same time. Returns the arena size. */
+static size_t plan_offsets(plan_buffer_t *buffers, size_t count) {
+    size_t *order = (size_t*)malloc(count * sizeof(size_t));
+    size_t *placed = (size_t*)malloc(count * sizeof(size_t));
+    if (!order || !placed) {
+        free(order);
+        free(placed);
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; i++) order[i] = i;
+    for (size_t i = 1; i < count; i++) {
+        size_t key = order[i], j = i;
+        while (j > 0 && buffers[order[j - 1]].bytes < buffers[key].bytes) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = key;
+    }
+
+    size_t total = 0, num_placed = 0;
+    for (size_t n = 0; n < count; n++) {
+        plan_buffer_t *buffer = &buffers[order[n]];
+        size_t offset = 0;
+        /* Raise the candidate offset past every conflict until none is left. */
+        for (int moved = 1; moved;) {
+            moved = 0;
+            for (size_t p = 0; p < num_placed; p++) {
+                const plan_buffer_t *other = &buffers[placed[p]];
+                if (!lifetimes_overlap(buffer, other)) continue;
+                if (offset < other->offset + other->bytes && other->offset < offset + buffer->bytes) {
+                    offset = other->offset + other->bytes;
+                    moved = 1;
+                }
+            }
+        }
+        buffer->offset = offset;
+        placed[num_placed++] = order[n];
+        if (offset + buffer->bytes > total) total = offset + buffer->bytes;
+    }
+
+    free(order);
+    free(placed);
+    return total;
+}
+
+/* First layer of the checkpoint segment that ends at or after layer i. The
+ * outputs of the last layer of every segment are kept from forward to
+ * backward; the others are recomputed from the segment's input. */
+static size_t network_segment_begin(const network_t *network, size_t i) {
+    return i / network->checkpoint_interval * network->checkpoint_interval;
+}
+
+/* Lays out and binds the activation arena for batches of up to max_batch. */
+static int plan_activations(network_t *network, size_t max_batch) {
+    size_t n = network->num_layers;
+
+    /* Steps: forward i is i and the loss is n. Backward then walks the
+     * checkpoint segments from the last: it recomputes the outputs inside the
+     * segment (recompute), then runs each layer's backward as two steps,
+     * activation (act) then input gradient (act + 1), in reverse order. */
+    size_t count = 3 * n + 1;
+    plan_buffer_t *buffers = (plan_buffer_t*)calloc(count, sizeof(plan_buffer_t));
+    size_t *act = (size_t*)malloc(n * sizeof(size_t));
+    size_t *recompute = (size_t*)calloc(n, sizeof(size_t));
+    if (!buffers || !act || !recompute) {
+        free(buffers);
+        free(act);
+        free(recompute);
+        return 0;
+    }
+
+    size_t step = n + 1;
+    network->recompute_flops = 0.0;
+    for (size_t end = n; end > 0;) {
+        size_t begin = network_segment_begin(network, end - 1);
+        for (size_t i = begin; i + 1 < end; i++) {
+            const dense_layer_t *layer = network->layers[i];
+            recompute[i] = step++;
+            network->recompute_flops += (2.0 * layer->weights->rows + 2.0) * layer->weights->cols;
+        }
+        for (size_t i = end; i-- > begin;) {
+            act[i] = step;
+            step += 2;
+        }
+        end = begin;
+    }
+
+    plan_buffer_t *outputs = buffers, *grad_activations = buffers + n, *grad_inputs = buffers + 2 * n;
+    plan_buffer_t *loss_grad = buffers + 3 * n;
+    for (size_t i = 0; i < n; i++) {
+        const dense_layer_t *layer = network->layers[i];
+
+        /* A recomputed output only has to survive until the next layer has
+         * read it in forward; it is rebuilt before its backward. */
+        outputs[i] = recompute[i]
+            ? (plan_buffer_t){aligned_bytes(max_batch * layer->weights->cols), i, i + 1, recompute[i], act[i], 0}
+            : (plan_buffer_t){aligned_bytes(max_batch * layer->weights->cols), i, act[i], 0, 0, 0};
+        grad_activations[i] = (plan_buffer_t){outputs[i].bytes, act[i], act[i] + 1, 0, 0, 0};
+        grad_inputs[i] = (plan_buffer_t){aligned_bytes(max_batch * layer->weights->rows), act[i] + 1,
+                                         i > 0 ? act[i - 1] : act[i] + 1, 0, 0, 0};
+    }
+    *loss_grad = (plan_buffer_t){outputs[n - 1].bytes, n, act[n - 1], 0, 0, 0};
+    free(act);
+    free(recompute);
+
+    network->unplanned_bytes = 0;
+    for (size_t i = 0; i < count; i++) network->unplanned_bytes += buffers[i].bytes;
+    network->arena_bytes = plan_offsets(buffers, count);
+
+    if (network->arena_bytes) network->arena = (float*)allocator_alloc(allocator_tensor(), network->arena_bytes);
+    if (!network->arena) {
+        fprintf(stderr, "Failed to allocate network arena\n");
+        free(buffers);
+        return 0;
+    }
+
+    char *base = (char*)network->arena;
+    int ok = 1;
+    for (size_t i = 0; i < n && ok; i++) {
+        ok = layer_bind(network->layers[i], (float*)(base + outputs[i].offset),
+                        (float*)(base + grad_activations[i].offset),
+                        (float*)(base + grad_inputs[i].offset), max_batch);
+    }
+    network->loss_grad = ok ? tensor_wrap((float*)(base + loss_grad->offset), max_batch,
+                                          network_output_size(network)) : NULL;
+    free(buffers);
+    return network->loss_grad != NULL;
+}
+
+int network_build(network_t *network, size_t max_batch) {
+    size_t n = network->num_layers;
+    if (n == 0 || max_batch == 0) {
+        fprintf(stderr, "Network needs layers and a batch size\n");
+        return 0;
+    }
+    if (network->max_batch) {
+        fprintf(stderr, "Network is already built\n");
+        return 0;
+    }
+    for (size_t i = 1; i < n; i++) {
+        if (network->layers[i]->weights->rows != network->layers[i - 1]->weights->cols) {
+            fprintf(stderr, "Layer %zu input width does not match previous layer\n", i);
+            return 0;
+        }
+    }
+
+    if (network->checkpoint_interval == NETWORK_CHECKPOINT_SQRT) {
+        network->checkpoint_interval = (size_t)lround(sqrt((double)n));
+    }
+    if (network->checkpoint_interval > n) network->checkpoint_interval = n;
+
+    if (plan_activations(network, max_batch)) {
+        network->params = param_arena_create(network->layers, n);
+    }
+    if (!network->params) {
+        fprintf(stderr, "Failed to build network\n");
+        return 0;
+    }
+    network->max_batch = max_batch;
+    return 1;
+}
+
+network_t* network_replicate(const network_t *network, size_t max_batch) {
+    if (!network->max_batch || max_batch == 0) {
+        fprintf(stderr, "Only a built network can be replicated\n");
+        return NULL;
+    }
+
+    network_t *replica = network_create();
+    if (!replica) return NULL;
+    replica->math = network->math;
+    replica->checkpoint_interval = network->checkpoint_interval;
+    for (size_t i = 0; i < network->num_layers; i++) {
+        if (!network_add(replica, layer_create_shared(network->layers[i]))) {
+            network_destroy(replica);
+            return NULL;
+        }
+    }
+
+    if (plan_activations(replica, max_batch)) {
+        replica->params = param_arena_share(network->params, replica->layers, replica->num_layers);
+    }
+    if (!replica->params) {
+        fprintf(stderr, "Failed to replicate network\n");
+        network_destroy(replica);
+        return NULL;
+    }
+    replica->max_batch = max_batch;
+    return replica;
+}
+
+const tensor_t* network_forward(network_t *network, const tensor_t *input) {
+    if (!network->max_batch) {
+        fprintf(stderr, "Network must be built before use\n");
+        return NULL;
+    }
+
+    const tensor_t *x = input;
+    for (size_t i = 0; i < network->num_layers && x; i++) x = layer_forward(network->layers[i], x);
+    return x;
+}
+
+const tensor_t* network_forward_sparse(network_t *network, const sparse_tensor_t *input) {
+    if (!network->max_batch) {
+        fprintf(stderr, "Network must be built before use\n");
+        return NULL;
+    }
+
+    const tensor_t *x = layer_forward_sparse(network->layers[0], input);
+    for (size_t i = 1; i < network->num_layers && x; i++) x = layer_forward(network->layers[i], x);
+    return x;
+}
+
+float network_loss(network_t *network, const tensor_t *targets, network_loss_t loss) {
+    const tensor_t *output = network->layers[network->num_layers - 1]->output;
+    tensor_t *grad = network->loss_grad;
+    grad->rows = output->rows;
+
+    if (loss == NETWORK_LOSS_BCE_LOGITS || loss == NETWORK_LOSS_SOFTMAX_CE) {
+        if (network->layers[network->num_layers - 1]->activation != ACTIVATION_NONE) {
+            fprintf(stderr, "Losses on logits need a linear output layer\n");
+            return 0.0f;
+        }
+        if (loss == NETWORK_LOSS_SOFTMAX_CE) {
+            return loss_softmax_crossentropy_with_grad(output, targets, grad, network->math);
+        }
+        return loss_bce_logits_with_grad(output, targets, grad, network->math);
+    }
+    if (loss == NETWORK_LOSS_BCE) return loss_bce_with_grad(output, targets, grad);
+    return loss_mse_with_grad(output, targets, grad);
+}
+
+int network_checkpoint(network_t *network, size_t interval) {
+    if (network->max_batch) {
+        fprintf(stderr, "Checkpointing must be chosen before network_build\n");
+        return 0;
+    }
+    network->checkpoint_interval = interval;
+    return 1;
+}
+
+const tensor_t* network_backward(network_t *network, const tensor_t *grad_output) {
+    const tensor_t *grad = grad_output ? grad_output : network->loss_grad;
+    for (size_t i = network->num_layers; i-- > 0 && grad;) {
+        /* Entering a segment from its end: rebuild the outputs inside it from
+         * the kept input, which each layer still points at. */
+        size_t begin = network_segment_begin(network, i);
+        if (i + 1 == network->num_layers || network_segment_begin(network, i + 1) != begin) {
+            for (size_t j = begin; j < i; j++) {
+                dense_layer_t *layer = network->layers[j];
+                if (layer->sparse_input) layer_forward_sparse(layer, layer->sparse_input);
+                else layer_forward(layer, layer->input);
+            }
+        }
+        grad = layer_backward(network->layers[i], grad);
+    }
+    return grad;
+}
+
+float network_train_step(network_t *network, const tensor_t *input, const tensor_t *targets,
+                         network_loss_t loss, adam_optimizer_t *optimizer) {
+    if (!network_forward(network, input)) return 0.0f;
+
+    float value = network_loss(network, targets, loss);
+    network_backward(network, NULL);
+    adam_step_params(optimizer, network->params);
+    return value;
+}
@@ -1,96 +1,390 @@
+#define _POSIX_C_SOURCE 200112L
 #include "optimizer.h"
+#include "gemm.h"
+#include "threadpool.h"
+#include "profile.h"
+#include "allocator.h"
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define OPTIMIZER_X86 1
+#include <immintrin.h>
+#endif
+
+/* SGD reuses v as the velocity and beta1 as the momentum. */
+typedef struct {
+    float *param;
+    const float *grad;
+    float *m;
+    float *v;
+    float lr;
+    float beta1;
+    float beta2;
+    float epsilon;
+    float decay;
+    gemm_isa_t isa;
+    uint16_t *half;         /* refreshed from param after the update when non-NULL */
+    precision_t precision;
+} update_job_t;
+
+/* The vector paths use separate multiplies and adds in the same order as the
+ * scalar loop, so every element gets bit-identical results wherever chunk
+ * boundaries fall. */
+static void adam_scalar(const update_job_t *job, size_t begin, size_t end) {
+    float c1 = 1.0f - job->beta1;
+    float c2 = 1.0f - job->beta2;
+    for (size_t i = begin; i < end; i++) {
+        float g = job->grad[i];
+
+        job->m[i] = job->beta1 * job->m[i] + c1 * g;
+        job->v[i] = job->beta2 * job->v[i] + c2 * g * g;
+
+        float p = job->param[i] - job->decay * job->param[i];
+        job->param[i] = p - job->lr * job->m[i] / (sqrtf(job->v[i]) + job->epsilon);
+    }
+}
+
+static void sgd_scalar(const update_job_t *job, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        float g = job->grad[i] + job->decay * job->param[i];
+        if (job->v) {
+            job->v[i] = job->beta1 * job->v[i] + g;
+            g = job->v[i];
+        }
+        job->param[i] -= job->lr * g;
+    }
+}
+
+#ifdef OPTIMIZER_X86
+
+__attribute__((target("avx2")))
+static size_t adam_avx2(const update_job_t *job, size_t begin, size_t end) {
+    __m256 b1 = _mm256_set1_ps(job->beta1), c1 = _mm256_set1_ps(1.0f - job->beta1);
+    __m256 b2 = _mm256_set1_ps(job->beta2), c2 = _mm256_set1_ps(1.0f - job->beta2);
+    __m256 lr = _mm256_set1_ps(job->lr), eps = _mm256_set1_ps(job->epsilon);
+    __m256 decay = _mm256_set1_ps(job->decay);
+    size_t i = begin;
+
+    for (; i + 8 <= end; i += 8) {
+        __m256 g = _mm256_loadu_ps(job->grad + i);
+        __m256 m = _mm256_add_ps(_mm256_mul_ps(b1, _mm256_loadu_ps(job->m + i)), _mm256_mul_ps(c1, g));
+        __m256 v = _mm256_add_ps(_mm256_mul_ps(b2, _mm256_loadu_ps(job->v + i)),
+                                 _mm256_mul_ps(_mm256_mul_ps(c2, g), g));
+        __m256 p = _mm256_loadu_ps(job->param + i);
+        p = _mm256_sub_ps(p, _mm256_mul_ps(decay, p));
+        __m256 step = _mm256_div_ps(_mm256_mul_ps(lr, m), _mm256_add_ps(_mm256_sqrt_ps(v), eps));
+        _mm256_storeu_ps(job->m + i, m);
+        _mm256_storeu_ps(job->v + i, v);
+        _mm256_storeu_ps(job->param + i, _mm256_sub_ps(p, step));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f")))
+static size_t adam_avx512(const update_job_t *job, size_t begin, size_t end) {
+    __m512 b1 = _mm512_set1_ps(job->beta1), c1 = _mm512_set1_ps(1.0f - job->beta1);
+    __m512 b2 = _mm512_set1_ps(job->beta2), c2 = _mm512_set1_ps(1.0f - job->beta2);
+    __m512 lr = _mm512_set1_ps(job->lr), eps = _mm512_set1_ps(job->epsilon);
+    __m512 decay = _mm512_set1_ps(job->decay);
+    size_t i = begin;
+
+    for (; i + 16 <= end; i += 16) {
+        __m512 g = _mm512_loadu_ps(job->grad + i);
+        __m512 m = _mm512_add_ps(_mm512_mul_ps(b1, _mm512_loadu_ps(job->m + i)), _mm512_mul_ps(c1, g));
+        __m512 v = _mm512_add_ps(_mm512_mul_ps(b2, _mm512_loadu_ps(job->v + i)),
+                                 _mm512_mul_ps(_mm512_mul_ps(c2, g), g));
+        __m512 p = _mm512_loadu_ps(job->param + i);
+        p = _mm512_sub_ps(p, _mm512_mul_ps(decay, p));
+        __m512 step = _mm512_div_ps(_mm512_mul_ps(lr, m), _mm512_add_ps(_mm512_sqrt_ps(v), eps));
+        _mm512_storeu_ps(job->m + i, m);
+        _mm512_storeu_ps(job->v + i, v);
+        _mm512_storeu_ps(job->param + i, _mm512_sub_ps(p, step));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t sgd_avx2(const update_job_t *job, size_t begin, size_t end) {
+    __m256 lr = _mm256_set1_ps(job->lr), mu = _mm256_set1_ps(job->beta1);
+    __m256 decay = _mm256_set1_ps(job->decay);
+    size_t i = begin;
+
+    for (; i + 8 <= end; i += 8) {
+        __m256 p = _mm256_loadu_ps(job->param + i);
+        __m256 g = _mm256_add_ps(_mm256_loadu_ps(job->grad + i), _mm256_mul_ps(decay, p));
+        if (job->v) {
+            g = _mm256_add_ps(_mm256_mul_ps(mu, _mm256_loadu_ps(job->v + i)), g);
+            _mm256_storeu_ps(job->v + i, g);
+        }
+        _mm256_storeu_ps(job->param + i, _mm256_sub_ps(p, _mm256_mul_ps(lr, g)));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f")))
+static size_t sgd_avx512(const update_job_t *job, size_t begin, size_t end) {
+    __m512 lr = _mm512_set1_ps(job->lr), mu = _mm512_set1_ps(job->beta1);
+    __m512 decay = _mm512_set1_ps(job->decay);
+    size_t i = begin;
+
+    for (; i + 16 <= end; i += 16) {
+        __m512 p = _mm512_loadu_ps(job->param + i);
+        __m512 g = _mm512_add_ps(_mm512_loadu_ps(job->grad + i), _mm512_mul_ps(decay, p));
+        if (job->v) {
+            g = _mm512_add_ps(_mm512_mul_ps(mu, _mm512_loadu_ps(job->v + i)), g);
+            _mm512_storeu_ps(job->v + i, g);
+        }
+        _mm512_storeu_ps(job->param + i, _mm512_sub_ps(p, _mm512_mul_ps(lr, g)));
+    }
+    return i;
+}
+
+#endif
+
+static void adam_task(void *arg, size_t begin, size_t end) {
+    const update_job_t *job = (const update_job_t*)arg;
+    size_t first = begin;
+#ifdef OPTIMIZER_X86
+    if (job->isa == GEMM_ISA_AVX512) begin = adam_avx512(job, begin, end);
+    else if (job->isa == GEMM_ISA_AVX2) begin = adam_avx2(job, begin, end);
+#endif
+    adam_scalar(job, begin, end);
+    if (job->half) half_convert_from_float(job->half + first, job->param + first, end - first, job->precision);
+}
+
+static void sgd_task(void *arg, size_t begin, size_t end) {
+    const update_job_t *job = (const update_job_t*)arg;
+    size_t first = begin;
+#ifdef OPTIMIZER_X86
+    if (job->isa == GEMM_ISA_AVX512) begin = sgd_avx512(job, begin, end);
+    else if (job->isa == GEMM_ISA_AVX2) begin = sgd_avx2(job, begin, end);
+#endif
+    sgd_scalar(job, begin, end);
+    if (job->half) half_convert_from_float(job->half + first, job->param + first, end - first, job->precision);
+}
+
+/* State is allocated on the first step but charged to optimizer_create. */
+static float* alloc_state(size_t count) {
+    float *state = (float*)allocator_alloc(allocator_tensor(), count * sizeof(float));
+    if (!state) {
+        fprintf(stderr, "Failed to allocate optimizer state\n");
+        return NULL;
+    }
+    PROFILE_ALLOC(PROFILE_OPTIMIZER_CREATE, count * sizeof(float));
+    return state;
+}
+
 
 sgd_optimizer_t* sgd_create(float learning_rate) {
+    return sgd_create_momentum(learning_rate, 0.0f, 0.0f);
+}
+
+sgd_optimizer_t* sgd_create_momentum(float learning_rate, float momentum, float weight_decay) {
+    PROFILE_BEGIN(mark);
     sgd_optimizer_t *opt = (sgd_optimizer_t*)malloc(sizeof(sgd_optimizer_t));
+    if (!opt) return NULL;
+
     opt->learning_rate = learning_rate;
+    opt->momentum = momentum;
+    opt->weight_decay = weight_decay;
+    opt->velocity = NULL;
+    opt->size = 0;
+    PROFILE_ALLOC(PROFILE_OPTIMIZER_CREATE, sizeof(sgd_optimizer_t));
+    PROFILE_END(PROFILE_OPTIMIZER_CREATE, mark, 0, 0);
     return opt;
 }
 
+/* After a sparse-input backward the weight rows outside grad_rows have a
+ * zero gradient and, without decay, would not move. */
+static inline int sgd_sparse_rows(const sgd_optimizer_t *opt, const dense_layer_t *layer) {
+    return layer->sparse_grad && opt->weight_decay == 0.0f;
+}
+
+static inline size_t sgd_updated_count(const sgd_optimizer_t *opt, const dense_layer_t *layer) {
+    size_t rows = sgd_sparse_rows(opt, layer) ? layer->num_grad_rows : layer->weights->rows;
+    return rows * layer->weights->cols + layer->bias->cols;
+}
+
 void sgd_step(sgd_optimizer_t *opt, dense_layer_t *layer) {
-    for (size_t i = 0; i < layer->weights->rows * layer->weights->cols; i++) {
-        layer->weights->data[i] -= opt->learning_rate * layer->grad_weights->data[i];
+    if (opt->momentum != 0.0f) {
+        fprintf(stderr, "Momentum SGD needs sgd_step_params\n");
+        return;
     }
-    
-    
-    for (size_t i = 0; i < layer->bias->cols; i++) {
-        layer->bias->data[i] -= opt->learning_rate * layer->grad_bias->data[i];
+    PROFILE_BEGIN(mark);
+
+    update_job_t weights = {layer->weights->data, layer->grad_weights->data, NULL, NULL,
+                            opt->learning_rate, 0.0f, 0.0f, 0.0f, opt->weight_decay, gemm_get_isa(),
+                            layer->half_weights, layer->precision};
+    if (sgd_sparse_rows(opt, layer)) {
+        size_t out = layer->weights->cols;
+        for (size_t r = 0; r < layer->num_grad_rows; r++) {
+            size_t begin = (size_t)layer->grad_rows[r] * out;
+            sgd_task(&weights, begin, begin + out);
+        }
+    } else {
+        threadpool_parallel_for(layer->weights->rows * layer->weights->cols, THREADPOOL_GRAIN, sgd_task, &weights);
     }
+    layer_weights_changed(layer);
+
+
+    update_job_t bias = {layer->bias->data, layer->grad_bias->data, NULL, NULL,
+                         opt->learning_rate, 0.0f, 0.0f, 0.0f, opt->weight_decay, gemm_get_isa(),
+                         NULL, PRECISION_FP32};
+    threadpool_parallel_for(layer->bias->cols, THREADPOOL_GRAIN, sgd_task, &bias);
+    PROFILE_END(PROFILE_SGD_STEP, mark, 4.0 * sgd_updated_count(opt, layer),
+                3 * sgd_updated_count(opt, layer) * sizeof(float));
+}
+
+void sgd_step_params(sgd_optimizer_t *opt, param_arena_t *params) {
+    if (opt->momentum != 0.0f && !opt->velocity) {
+        opt->velocity = alloc_state(params->count);
+        if (!opt->velocity) return;
+        opt->size = params->count;
+    }
+    if (opt->velocity && opt->size != params->count) {
+        fprintf(stderr, "SGD state does not match parameter arena\n");
+        return;
+    }
+    PROFILE_BEGIN(mark);
+
+    update_job_t job = {params->values, params->grads, NULL, opt->velocity,
+                        opt->learning_rate, opt->momentum, 0.0f, 0.0f, opt->weight_decay, gemm_get_isa(),
+                        params->half_values, params->precision};
+    threadpool_parallel_for(params->count, THREADPOOL_GRAIN, sgd_task, &job);
+    __atomic_fetch_add(params->values_version, 1, __ATOMIC_RELAXED);
+    PROFILE_END(PROFILE_SGD_STEP, mark, (opt->velocity ? 6.0 : 4.0) * params->count,
+                (opt->velocity ? 5 : 3) * params->count * sizeof(float));
 }
 
 void sgd_destroy(sgd_optimizer_t *opt) {
+    if (!opt) return;
+    allocator_free(opt->velocity);
     free(opt);
 }
 
 adam_optimizer_t* adam_create(float learning_rate, size_t num_layers) {
+    return adamw_create(learning_rate, 0.0f, num_layers);
+}
+
+adam_optimizer_t* adamw_create(float learning_rate, float weight_decay, size_t num_layers) {
+    PROFILE_BEGIN(mark);
     adam_optimizer_t *opt = (adam_optimizer_t*)malloc(sizeof(adam_optimizer_t));
-    
+    if (!opt) return NULL;
+
     opt->learning_rate = learning_rate;
     opt->beta1 = 0.9f;
     opt->beta2 = 0.999f;
     opt->epsilon = 1e-8f;
+    opt->weight_decay = weight_decay;
     opt->timestep = 0;
     opt->num_layers = num_layers;
-    
+
     opt->m_weights = (tensor_t**)calloc(num_layers, sizeof(tensor_t*));
     opt->v_weights = (tensor_t**)calloc(num_layers, sizeof(tensor_t*));
     opt->m_bias = (tensor_t**)calloc(num_layers, sizeof(tensor_t*));
     opt->v_bias = (tensor_t**)calloc(num_layers, sizeof(tensor_t*));
-    
+
+    opt->m = NULL;
+    opt->v = NULL;
+    opt->size = 0;
+
+    PROFILE_ALLOC(PROFILE_OPTIMIZER_CREATE, sizeof(adam_optimizer_t) + 4 * num_layers * sizeof(tensor_t*));
+    PROFILE_END(PROFILE_OPTIMIZER_CREATE, mark, 0, 0);
     return opt;
 }
 
-void adam_step(adam_optimizer_t *opt, dense_layer_t **layers, size_t num_layers) {
+static update_job_t adam_job(adam_optimizer_t *opt) {
     opt->timestep++;
-    
-    float lr_t = opt->learning_rate * sqrtf(1.0f - powf(opt->beta2, opt->timestep)) 
+
+    float lr_t = opt->learning_rate * sqrtf(1.0f - powf(opt->beta2, opt->timestep))
                   / (1.0f - powf(opt->beta1, opt->timestep));
-    
+
+    update_job_t job = {NULL, NULL, NULL, NULL, lr_t, opt->beta1, opt->beta2, opt->epsilon,
+                        opt->learning_rate * opt->weight_decay, gemm_get_isa(), NULL, PRECISION_FP32};
+    return job;
+}
+
+static inline size_t layers_param_count(dense_layer_t **layers, size_t num_layers) {
+    size_t count = 0;
+    for (size_t i = 0; i < num_layers; i++) count += layer_param_count(layers[i]);
+    return count;
+}
+
+void adam_step(adam_optimizer_t *opt, dense_layer_t **layers, size_t num_layers) {
+    PROFILE_BEGIN(mark);
+    update_job_t job = adam_job(opt);
+
     for (size_t layer_idx = 0; layer_idx < num_layers; layer_idx++) {
         dense_layer_t *layer = layers[layer_idx];
-        
-        
+
+
         if (opt->m_weights[layer_idx] == NULL) {
             opt->m_weights[layer_idx] = tensor_create(layer->weights->rows, layer->weights->cols);
             opt->v_weights[layer_idx] = tensor_create(layer->weights->rows, layer->weights->cols);
             opt->m_bias[layer_idx] = tensor_create(1, layer->bias->cols);
             opt->v_bias[layer_idx] = tensor_create(1, layer->bias->cols);
-            
+
             tensor_zeros(opt->m_weights[layer_idx]);
             tensor_zeros(opt->v_weights[layer_idx]);
             tensor_zeros(opt->m_bias[layer_idx]);
             tensor_zeros(opt->v_bias[layer_idx]);
         }
-        
-        
-        for (size_t i = 0; i < layer->weights->rows * layer->weights->cols; i++) {
-            float g = layer->grad_weights->data[i];
-            
-            
-            opt->m_weights[layer_idx]->data[i] = opt->beta1 * opt->m_weights[layer_idx]->data[i] 
-                                                  + (1.0f - opt->beta1) * g;
-            
-            opt->v_weights[layer_idx]->data[i] = opt->beta2 * opt->v_weights[layer_idx]->data[i] 
-                                                  + (1.0f - opt->beta2) * g * g;
-            
-            layer->weights->data[i] -= lr_t * opt->m_weights[layer_idx]->data[i] 
-                                        / (sqrtf(opt->v_weights[layer_idx]->data[i]) + opt->epsilon);
-        }
-        for (size_t i = 0; i < layer->bias->cols; i++) {
-            float g = layer->grad_bias->data[i];
-            
-            opt->m_bias[layer_idx]->data[i] = opt->beta1 * opt->m_bias[layer_idx]->data[i] 
-                                               + (1.0f - opt->beta1) * g;
-            
-            opt->v_bias[layer_idx]->data[i] = opt->beta2 * opt->v_bias[layer_idx]->data[i] 
-                                               + (1.0f - opt->beta2) * g * g;
-            
-            layer->bias->data[i] -= lr_t * opt->m_bias[layer_idx]->data[i] 
-                                     / (sqrtf(opt->v_bias[layer_idx]->data[i]) + opt->epsilon);
+
+
+        job.param = layer->weights->data;
+        job.grad = layer->grad_weights->data;
+        job.m = opt->m_weights[layer_idx]->data;
+        job.v = opt->v_weights[layer_idx]->data;
+        job.half = layer->half_weights;
+        job.precision = layer->precision;
+        threadpool_parallel_for(layer->weights->rows * layer->weights->cols, THREADPOOL_GRAIN,
+                                adam_task, &job);
+        layer_weights_changed(layer);
+
+        job.param = layer->bias->data;
+        job.grad = layer->grad_bias->data;
+        job.m = opt->m_bias[layer_idx]->data;
+        job.v = opt->v_bias[layer_idx]->data;
+        job.half = NULL;
+        threadpool_parallel_for(layer->bias->cols, THREADPOOL_GRAIN, adam_task, &job);
+    }
+    PROFILE_END(PROFILE_ADAM_STEP, mark, 12.0 * layers_param_count(layers, num_layers),
+                7 * layers_param_count(layers, num_layers) * sizeof(float));
+}
+
+void adam_step_params(adam_optimizer_t *opt, param_arena_t *params) {
+    if (!opt->m) {
+        opt->m = alloc_state(params->count);
+        opt->v = alloc_state(params->count);
+        if (!opt->m || !opt->v) {
+            /* Leave no half-made state behind, so the next step retries. */
+            allocator_free(opt->m);
+            allocator_free(opt->v);
+            opt->m = NULL;
+            opt->v = NULL;
+            return;
         }
+        opt->size = params->count;
+    }
+    if (opt->size != params->count) {
+        fprintf(stderr, "Adam state does not match parameter arena\n");
+        return;
     }
+    PROFILE_BEGIN(mark);
+
+    update_job_t job = adam_job(opt);
+    job.param = params->values;
+    job.grad = params->grads;
+    job.m = opt->m;
+    job.v = opt->v;
+    job.half = params->half_values;
+    job.precision = params->precision;
+    threadpool_parallel_for(params->count, THREADPOOL_GRAIN, adam_task, &job);
+    __atomic_fetch_add(params->values_version, 1, __ATOMIC_RELAXED);
+    PROFILE_END(PROFILE_ADAM_STEP, mark, 12.0 * params->count, 7 * params->count * sizeof(float));
 }
 
 void adam_destroy(adam_optimizer_t *opt) {
@@ -100,10 +394,12 @@ void adam_destroy(adam_optimizer_t *opt) {
         if (opt->m_bias[i]) tensor_destroy(opt->m_bias[i]);
         if (opt->v_bias[i]) tensor_destroy(opt->v_bias[i]);
     }
-    
+
     free(opt->m_weights);
     free(opt->v_weights);
     free(opt->m_bias);
     free(opt->v_bias);
+    allocator_free(opt->m);
+    allocator_free(opt->v);
     free(opt);
-}
\ No newline at end of file
+}
@@ -0,0 +1,159 @@
+#define _POSIX_C_SOURCE 200112L
+#include "params.h"
+#include "allocator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PARAM_ALIGN_FLOATS 16
+
+static size_t padded(size_t count) {
+    return (count + PARAM_ALIGN_FLOATS - 1) / PARAM_ALIGN_FLOATS * PARAM_ALIGN_FLOATS;
+}
+
+static float* alloc_block(size_t count) {
+    float *block = (float*)allocator_alloc(allocator_tensor(), count * sizeof(float));
+    if (!block) fprintf(stderr, "Failed to allocate parameter arena\n");
+    return block;
+}
+
+/* Replaces *slot with a view at offset, copying the old contents across
+ * unless the block already holds them. */
+static int move_into(tensor_t **slot, float *block, size_t offset, int copy) {
+    tensor_t *old = *slot;
+    tensor_t *view = tensor_wrap(block + offset, old->rows, old->cols);
+    if (!view) return 0;
+
+    if (copy) memcpy(view->data, old->data, old->rows * old->cols * sizeof(float));
+    tensor_destroy(old);
+    *slot = view;
+    return 1;
+}
+
+static size_t layers_count(dense_layer_t **layers, size_t num_layers) {
+    size_t count = 0;
+    for (size_t i = 0; i < num_layers; i++) {
+        count += padded(layers[i]->weights->rows * layers[i]->weights->cols);
+        count += padded(layers[i]->bias->cols);
+    }
+    return count;
+}
+
+/* Points every layer's parameters and gradients at the arena blocks. */
+static int place_layers(param_arena_t *arena, dense_layer_t **layers, size_t num_layers,
+                        int copy_values) {
+    size_t offset = 0;
+    for (size_t i = 0; i < num_layers; i++) {
+        dense_layer_t *layer = layers[i];
+        size_t weight_count = padded(layer->weights->rows * layer->weights->cols);
+
+        if (!move_into(&layer->weights, arena->values, offset, copy_values) ||
+            !move_into(&layer->grad_weights, arena->grads, offset, 1)) {
+            return 0;
+        }
+        if (arena->half_values) {
+            if (layer->owns_half_weights) free(layer->half_weights);
+            layer->half_weights = arena->half_values + offset;
+            layer->owns_half_weights = 0;
+            layer->precision = arena->precision;
+        }
+        layer->weights_version = arena->values_version;
+        layer_weights_changed(layer);
+        offset += weight_count;
+
+        if (!move_into(&layer->bias, arena->values, offset, copy_values) ||
+            !move_into(&layer->grad_bias, arena->grads, offset, 1)) {
+            return 0;
+        }
+        offset += padded(layer->bias->cols);
+    }
+    return 1;
+}
+
+param_arena_t* param_arena_create(dense_layer_t **layers, size_t num_layers) {
+    param_arena_t *arena = (param_arena_t*)malloc(sizeof(param_arena_t));
+    if (!arena) return NULL;
+
+    arena->count = layers_count(layers, num_layers);
+    arena->num_layers = num_layers;
+    arena->half_values = NULL;
+    arena->precision = PRECISION_FP32;
+    arena->owns_values = 1;
+    arena->version = 0;
+    arena->values_version = &arena->version;
+    arena->values = alloc_block(arena->count);
+    arena->grads = alloc_block(arena->count);
+    if (!arena->values || !arena->grads || !place_layers(arena, layers, num_layers, 1)) {
+        param_arena_destroy(arena);
+        return NULL;
+    }
+
+    return arena;
+}
+
+param_arena_t* param_arena_share(const param_arena_t *source, dense_layer_t **layers,
+                                 size_t num_layers) {
+    if (num_layers != source->num_layers || layers_count(layers, num_layers) != source->count) {
+        fprintf(stderr, "Layers do not match parameter arena\n");
+        return NULL;
+    }
+
+    param_arena_t *arena = (param_arena_t*)malloc(sizeof(param_arena_t));
+    if (!arena) return NULL;
+
+    *arena = *source;
+    arena->owns_values = 0;
+    arena->grads = alloc_block(arena->count);
+    if (!arena->grads || !place_layers(arena, layers, num_layers, 0)) {
+        param_arena_destroy(arena);
+        return NULL;
+    }
+
+    return arena;
+}
+
+void param_arena_destroy(param_arena_t *arena) {
+    if (!arena) return;
+
+    if (arena->owns_values) {
+        allocator_free(arena->values);
+        free(arena->half_values);
+    }
+    allocator_free(arena->grads);
+    free(arena);
+}
+
+int param_arena_set_precision(param_arena_t *arena, dense_layer_t **layers, size_t num_layers,
+                              precision_t precision) {
+    if (num_layers != arena->num_layers) {
+        fprintf(stderr, "Layers do not match parameter arena\n");
+        return 0;
+    }
+    if (!arena->owns_values) {
+        fprintf(stderr, "Cannot change the precision of a shared parameter arena\n");
+        return 0;
+    }
+
+    for (size_t i = 0; i < num_layers; i++) layer_set_precision(layers[i], PRECISION_FP32);
+    free(arena->half_values);
+    arena->half_values = NULL;
+    arena->precision = PRECISION_FP32;
+    if (precision == PRECISION_FP32) return 1;
+
+    void *mem = NULL;
+    if (posix_memalign(&mem, 64, arena->count * sizeof(uint16_t)) != 0) {
+        fprintf(stderr, "Failed to allocate parameter arena\n");
+        return 0;
+    }
+    arena->half_values = (uint16_t*)mem;
+    arena->precision = precision;
+    half_convert_from_float(arena->half_values, arena->values, arena->count, precision);
+
+    for (size_t i = 0; i < num_layers; i++) {
+        dense_layer_t *layer = layers[i];
+        layer->half_weights = arena->half_values + (layer->weights->data - arena->values);
+        layer->owns_half_weights = 0;
+        layer->precision = precision;
+    }
+    return 1;
+}
@@ -0,0 +1,222 @@
+#define _POSIX_C_SOURCE 200112L
+#include "profile.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Nesting deeper than this is timed but not subtracted from its parents. */
+#define PROFILE_MAX_DEPTH 32
+
+static const char *op_names[PROFILE_NUM_OPS] = {
+    "tensor_create", "tensor_fill", "tensor_random", "tensor_random_normal", "tensor_copy_data",
+    "tensor_add", "tensor_subtract", "tensor_multiply", "tensor_scale",
+    "tensor_matmul", "tensor_matmul_tn", "tensor_matmul_nt", "tensor_transpose",
+    "tensor_relu", "tensor_relu_derivative", "tensor_sigmoid", "tensor_sigmoid_derivative",
+    "tensor_tanh", "tensor_exp", "tensor_log",
+    "layer_create", "layer_reserve", "layer_set_precision", "layer_sync_weights",
+    "layer_pack_weights", "layer_init", "layer_forward", "layer_backward",
+    "loss_mse", "loss_bce", "loss_bce_with_logits",
+    "loss_mse_derivative", "loss_bce_derivative", "loss_bce_with_logits_derivative",
+    "loss_mse_with_grad", "loss_bce_with_grad", "loss_bce_logits_with_grad", "loss_softmax_crossentropy",
+    "optimizer_create", "sgd_step", "adam_step"
+};
+
+typedef struct {
+    uint64_t calls;
+    uint64_t ns;
+    uint64_t self_ns;
+    double flops;
+    double bytes;
+    double allocated;
+} profile_counter_t;
+
+typedef struct {
+    uint64_t start;             /* ns since the trace clock started */
+    uint64_t duration;
+    float flops;
+    float bytes;
+    uint32_t op;
+} profile_event_t;
+
+typedef struct profile_thread {
+    profile_counter_t counters[PROFILE_NUM_OPS];
+    uint64_t children[PROFILE_MAX_DEPTH + 1];   /* ns of nested calls per open depth */
+    int depth;
+    profile_event_t *events;
+    size_t num_events;
+    uint64_t dropped;
+    size_t id;
+    struct profile_thread *next;
+} profile_thread_t;
+
+static __thread profile_thread_t *current;
+static profile_thread_t *threads;
+static size_t num_threads;
+static uint64_t epoch;
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Buffers outlive their threads so a resized pool keeps its history. */
+static profile_thread_t* thread_buffer(void) {
+    if (current) return current;
+
+    profile_thread_t *buffer = (profile_thread_t*)calloc(1, sizeof(profile_thread_t));
+    if (!buffer) return NULL;
+    buffer->events = (profile_event_t*)malloc(PROFILE_MAX_EVENTS * sizeof(profile_event_t));
+
+    pthread_mutex_lock(&threads_lock);
+    if (!epoch) epoch = now_ns();
+    buffer->id = num_threads++;
+    buffer->next = threads;
+    threads = buffer;
+    pthread_mutex_unlock(&threads_lock);
+
+    current = buffer;
+    return buffer;
+}
+
+int profile_enabled(void) {
+#ifdef TINY_NN_PROFILE
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+const char* profile_op_name(profile_op_t op) {
+    return (unsigned)op < PROFILE_NUM_OPS ? op_names[op] : "unknown";
+}
+
+profile_mark_t profile_begin(void) {
+    profile_mark_t mark = {0, 0};
+    profile_thread_t *t = thread_buffer();
+    if (!t) return mark;
+
+    /* A call left open by an early return is closed by its caller's end. */
+    mark.depth = t->depth + 1;
+    t->depth = mark.depth;
+    if (mark.depth <= PROFILE_MAX_DEPTH) t->children[mark.depth] = 0;
+    mark.start = now_ns();
+    return mark;
+}
+
+void profile_end(profile_op_t op, profile_mark_t mark, double flops, double bytes) {
+    uint64_t end = now_ns();
+    profile_thread_t *t = current;
+    if (!t || mark.depth == 0) return;
+
+    uint64_t duration = end - mark.start;
+    uint64_t nested = mark.depth <= PROFILE_MAX_DEPTH ? t->children[mark.depth] : 0;
+    t->depth = mark.depth - 1;
+    if (t->depth > 0 && t->depth <= PROFILE_MAX_DEPTH) t->children[t->depth] += duration;
+
+    profile_counter_t *c = &t->counters[op];
+    c->calls++;
+    c->ns += duration;
+    c->self_ns += nested < duration ? duration - nested : 0;
+    c->flops += flops;
+    c->bytes += bytes;
+
+    if (t->events && t->num_events < PROFILE_MAX_EVENTS) {
+        profile_event_t *e = &t->events[t->num_events++];
+        e->start = mark.start > epoch ? mark.start - epoch : 0;
+        e->duration = duration;
+        e->flops = (float)flops;
+        e->bytes = (float)bytes;
+        e->op = (uint32_t)op;
+    } else {
+        t->dropped++;
+    }
+}
+
+void profile_alloc(profile_op_t op, double bytes) {
+    profile_thread_t *t = thread_buffer();
+    if (t) t->counters[op].allocated += bytes;
+}
+
+void profile_reset(void) {
+    pthread_mutex_lock(&threads_lock);
+    for (profile_thread_t *t = threads; t; t = t->next) {
+        memset(t->counters, 0, sizeof(t->counters));
+        t->num_events = 0;
+        t->dropped = 0;
+    }
+    epoch = now_ns();
+    pthread_mutex_unlock(&threads_lock);
+}
+
+profile_stats_t profile_query(profile_op_t op) {
+    profile_stats_t stats = {0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    if ((unsigned)op >= PROFILE_NUM_OPS) return stats;
+
+    pthread_mutex_lock(&threads_lock);
+    for (profile_thread_t *t = threads; t; t = t->next) {
+        const profile_counter_t *c = &t->counters[op];
+        stats.calls += c->calls;
+        stats.seconds += (double)c->ns * 1e-9;
+        stats.self_seconds += (double)c->self_ns * 1e-9;
+        stats.flops += c->flops;
+        stats.bytes += c->bytes;
+        stats.allocated += c->allocated;
+    }
+    pthread_mutex_unlock(&threads_lock);
+    return stats;
+}
+
+uint64_t profile_dropped_events(void) {
+    uint64_t dropped = 0;
+    pthread_mutex_lock(&threads_lock);
+    for (profile_thread_t *t = threads; t; t = t->next) dropped += t->dropped;
+    pthread_mutex_unlock(&threads_lock);
+    return dropped;
+}
+
+void profile_report(FILE *out) {
+    fprintf(out, "%-32s %10s %12s %12s %10s %12s %12s\n",
+            "op", "calls", "total ms", "self ms", "GFLOP/s", "MB moved", "MB alloc");
+    for (int op = 0; op < PROFILE_NUM_OPS; op++) {
+        profile_stats_t s = profile_query((profile_op_t)op);
+        if (!s.calls && !s.allocated) continue;
+        double rate = s.self_seconds > 0.0 ? s.flops / s.self_seconds * 1e-9 : 0.0;
+        fprintf(out, "%-32s %10llu %12.3f %12.3f %10.2f %12.3f %12.3f\n",
+                op_names[op], (unsigned long long)s.calls, s.seconds * 1e3, s.self_seconds * 1e3,
+                rate, s.bytes * 1e-6, s.allocated * 1e-6);
+    }
+}
+
+int profile_write_trace(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return 0;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+    int first = 1;
+    pthread_mutex_lock(&threads_lock);
+    for (profile_thread_t *t = threads; t; t = t->next) {
+        fprintf(file, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %zu, "
+                "\"args\": {\"name\": \"thread %zu\"}}", first ? "" : ",", t->id, t->id);
+        first = 0;
+        for (size_t i = 0; i < t->num_events; i++) {
+            const profile_event_t *e = &t->events[i];
+            fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %zu, "
+                    "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"flops\": %.0f, \"bytes\": %.0f}}",
+                    op_names[e->op], t->id, (double)e->start * 1e-3, (double)e->duration * 1e-3,
+                    (double)e->flops, (double)e->bytes);
+        }
+    }
+    pthread_mutex_unlock(&threads_lock);
+    fprintf(file, "\n]}\n");
+
+    int ok = !ferror(file);
+    if (fclose(file) != 0) ok = 0;
+    if (!ok) fprintf(stderr, "Failed to write trace %s\n", path);
+    return ok;
+}
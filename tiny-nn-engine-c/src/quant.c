@@ -0,0 +1,638 @@
+#define _POSIX_C_SOURCE 200112L
+#include "quant.h"
+#include "gemm.h"
+#include "threadpool.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define QUANT_X86 1
+#include <immintrin.h>
+#endif
+
+#define QUANT_MAX_MR 8
+#define QUANT_PARALLEL_OPS (1u << 20)
+
+/* Dequantization applied to each tile before it leaves the kernel: with the
+ * exact int32 dot product acc, c = acc * scale[j] + bias[j], then ReLU. The
+ * scale already folds the activation scale into the per-column one. */
+typedef struct {
+    const int32_t *column_sums;
+    const float *scale;
+    const float *bias;
+    int relu;
+} quant_epilogue_t;
+
+/* Computes an mr x QUANT_PANEL tile of A * W for one weight panel into c.
+ * A rows are k_padded bytes at stride lda, quantized with the kernel's
+ * activation encoding. */
+typedef void (*quant_kernel_fn)(size_t groups, const int8_t *a, size_t lda, const int8_t *w,
+                                const quant_epilogue_t *ep, float *c, size_t ldc);
+
+/* Quantizes an m x k float block into rows of lda bytes and returns the scale.
+ * q = round_half_even(clamp(x / scale, -127, 127)); with offset the bytes are
+ * stored as q + 128. Every variant produces identical bytes. */
+typedef float (*quantize_fn)(const float *x, size_t m, size_t k, int8_t *dst, size_t lda, int offset);
+
+static float dequantize(int32_t acc, const quant_epilogue_t *ep, size_t j) {
+    float v = (float)acc * ep->scale[j] + ep->bias[j];
+    return ep->relu && v < 0.0f ? 0.0f : v;
+}
+
+static void kernel_scalar(size_t groups, const int8_t *a, size_t lda, const int8_t *w,
+                          const quant_epilogue_t *ep, float *c, size_t ldc) {
+    for (size_t r = 0; r < 4; r++) {
+        int32_t sums[QUANT_PANEL] = {0};
+        const int8_t *row = a + r * lda;
+        for (size_t g = 0; g < groups; g++) {
+            const int8_t *panel = w + g * QUANT_PANEL * 4;
+            for (size_t j = 0; j < QUANT_PANEL; j++) {
+                for (size_t b = 0; b < 4; b++) {
+                    sums[j] += (int32_t)row[g * 4 + b] * panel[j * 4 + b];
+                }
+            }
+        }
+        for (size_t j = 0; j < QUANT_PANEL; j++) c[r * ldc + j] = dequantize(sums[j], ep, j);
+    }
+}
+
+/* Symmetric range clamp, then round to nearest even by the 1.5 * 2^23 trick,
+ * which matches cvtps2dq under the default rounding mode. */
+static int8_t quantize_value(float value, float inv) {
+    float v = value * inv;
+    if (v > 127.0f) v = 127.0f;
+    if (v < -127.0f) v = -127.0f;
+    float shifted = v + 12582912.0f;
+    return (int8_t)(int)(shifted - 12582912.0f);
+}
+
+static float activation_scale(float max_abs) {
+    return max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+}
+
+static float quantize_scalar(const float *x, size_t m, size_t k, int8_t *dst, size_t lda, int offset) {
+    float max_abs = 0.0f;
+    for (size_t i = 0; i < m * k; i++) {
+        float v = fabsf(x[i]);
+        if (v > max_abs) max_abs = v;
+    }
+    float scale = activation_scale(max_abs);
+    float inv = 1.0f / scale;
+    int8_t bias = offset ? (int8_t)-128 : 0;
+
+    for (size_t i = 0; i < m; i++) {
+        int8_t *row = dst + i * lda;
+        for (size_t j = 0; j < k; j++) row[j] = (int8_t)(quantize_value(x[i * k + j], inv) ^ bias);
+        memset(row + k, (unsigned char)bias, lda - k);
+    }
+    return scale;
+}
+
+#ifdef QUANT_X86
+static int32_t load_group(const int8_t *p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/* maddubs multiplies unsigned by signed bytes and saturates pairs to int16.
+ * Feeding it |a| and sign(w, a) keeps each pair within 2 * 127 * 127, so the
+ * dot product is exact without an activation offset. */
+__attribute__((target("avx2")))
+static void kernel_avx2(size_t groups, const int8_t *a, size_t lda, const int8_t *w,
+                        const quant_epilogue_t *ep, float *c, size_t ldc) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256();
+    __m256i c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+    __m256i c20 = _mm256_setzero_si256(), c21 = _mm256_setzero_si256();
+    __m256i c30 = _mm256_setzero_si256(), c31 = _mm256_setzero_si256();
+
+#define AVX2_ROW(r) \
+    do { \
+        __m256i ar = _mm256_set1_epi32(load_group(a + r * lda)); \
+        __m256i ur = _mm256_abs_epi8(ar); \
+        __m256i p0 = _mm256_maddubs_epi16(ur, _mm256_sign_epi8(w0, ar)); \
+        __m256i p1 = _mm256_maddubs_epi16(ur, _mm256_sign_epi8(w1, ar)); \
+        c##r##0 = _mm256_add_epi32(c##r##0, _mm256_madd_epi16(p0, ones)); \
+        c##r##1 = _mm256_add_epi32(c##r##1, _mm256_madd_epi16(p1, ones)); \
+    } while (0)
+
+    for (size_t g = 0; g < groups; g++) {
+        __m256i w0 = _mm256_loadu_si256((const __m256i*)w);
+        __m256i w1 = _mm256_loadu_si256((const __m256i*)(w + 32));
+        AVX2_ROW(0); AVX2_ROW(1); AVX2_ROW(2); AVX2_ROW(3);
+        a += 4;
+        w += 64;
+    }
+#undef AVX2_ROW
+
+    __m256 zero = _mm256_setzero_ps();
+    __m256 scale0 = _mm256_loadu_ps(ep->scale), scale1 = _mm256_loadu_ps(ep->scale + 8);
+    __m256 bias0 = _mm256_loadu_ps(ep->bias), bias1 = _mm256_loadu_ps(ep->bias + 8);
+
+#define AVX2_STORE(r) \
+    do { \
+        __m256 x0 = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(c##r##0), scale0), bias0); \
+        __m256 x1 = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(c##r##1), scale1), bias1); \
+        if (ep->relu) { \
+            x0 = _mm256_max_ps(x0, zero); \
+            x1 = _mm256_max_ps(x1, zero); \
+        } \
+        _mm256_storeu_ps(c + r * ldc, x0); \
+        _mm256_storeu_ps(c + r * ldc + 8, x1); \
+    } while (0)
+
+    AVX2_STORE(0); AVX2_STORE(1); AVX2_STORE(2); AVX2_STORE(3);
+#undef AVX2_STORE
+}
+
+__attribute__((target("avx2")))
+static float quantize_avx2(const float *x, size_t m, size_t k, int8_t *dst, size_t lda, int offset) {
+    size_t n = m * k, i = 0;
+    __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 vmax = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8) vmax = _mm256_max_ps(vmax, _mm256_and_ps(_mm256_loadu_ps(x + i), abs_mask));
+    float lanes[8];
+    _mm256_storeu_ps(lanes, vmax);
+    float max_abs = 0.0f;
+    for (size_t l = 0; l < 8; l++) if (lanes[l] > max_abs) max_abs = lanes[l];
+    for (; i < n; i++) if (fabsf(x[i]) > max_abs) max_abs = fabsf(x[i]);
+
+    float scale = activation_scale(max_abs);
+    float inv = 1.0f / scale;
+    int8_t bias = offset ? (int8_t)-128 : 0;
+    __m256 vinv = _mm256_set1_ps(inv);
+    __m256 hi = _mm256_set1_ps(127.0f), lo = _mm256_set1_ps(-127.0f);
+    __m128i flip = _mm_set1_epi8(bias);
+
+    for (size_t r = 0; r < m; r++) {
+        const float *src = x + r * k;
+        int8_t *row = dst + r * lda;
+        size_t j = 0;
+        for (; j + 8 <= k; j += 8) {
+            __m256 v = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + j), vinv), hi), lo);
+            __m256i q = _mm256_cvtps_epi32(v);
+            __m128i q16 = _mm_packs_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+            __m128i q8 = _mm_xor_si128(_mm_packs_epi16(q16, q16), flip);
+            _mm_storel_epi64((__m128i*)(row + j), q8);
+        }
+        for (; j < k; j++) row[j] = (int8_t)(quantize_value(src[j], inv) ^ bias);
+        memset(row + k, (unsigned char)bias, lda - k);
+    }
+    return scale;
+}
+
+/* vpdpbusd takes unsigned activations, so they are stored offset by 128 and
+ * 128 * column sum is subtracted once at the end. Eight rows keep enough
+ * independent accumulators in flight to cover the instruction latency. */
+__attribute__((target("avx512f,avx512vnni")))
+static void kernel_avx512_vnni(size_t groups, const int8_t *a, size_t lda, const int8_t *w,
+                               const quant_epilogue_t *ep, float *c, size_t ldc) {
+    __m512i c0 = _mm512_setzero_si512(), c1 = _mm512_setzero_si512();
+    __m512i c2 = _mm512_setzero_si512(), c3 = _mm512_setzero_si512();
+    __m512i c4 = _mm512_setzero_si512(), c5 = _mm512_setzero_si512();
+    __m512i c6 = _mm512_setzero_si512(), c7 = _mm512_setzero_si512();
+
+#define VNNI_ROW(r) \
+    c##r = _mm512_dpbusd_epi32(c##r, _mm512_set1_epi32(load_group(a + r * lda)), wv)
+
+    for (size_t g = 0; g < groups; g++) {
+        __m512i wv = _mm512_loadu_si512((const void*)w);
+        VNNI_ROW(0); VNNI_ROW(1); VNNI_ROW(2); VNNI_ROW(3);
+        VNNI_ROW(4); VNNI_ROW(5); VNNI_ROW(6); VNNI_ROW(7);
+        a += 4;
+        w += 64;
+    }
+#undef VNNI_ROW
+
+    __m512i sums = _mm512_loadu_si512((const void*)ep->column_sums);
+    __m512 scale = _mm512_loadu_ps(ep->scale);
+    __m512 bias = _mm512_loadu_ps(ep->bias);
+    __m512 zero = _mm512_setzero_ps();
+
+#define VNNI_STORE(r) \
+    do { \
+        __m512 x = _mm512_cvtepi32_ps(_mm512_sub_epi32(c##r, sums)); \
+        x = _mm512_add_ps(_mm512_mul_ps(x, scale), bias); \
+        if (ep->relu) x = _mm512_max_ps(x, zero); \
+        _mm512_storeu_ps(c + r * ldc, x); \
+    } while (0)
+
+    VNNI_STORE(0); VNNI_STORE(1); VNNI_STORE(2); VNNI_STORE(3);
+    VNNI_STORE(4); VNNI_STORE(5); VNNI_STORE(6); VNNI_STORE(7);
+#undef VNNI_STORE
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+static float quantize_avx512(const float *x, size_t m, size_t k, int8_t *dst, size_t lda, int offset) {
+    size_t n = m * k, i = 0;
+    __m512 vmax = _mm512_setzero_ps();
+    for (; i + 16 <= n; i += 16) vmax = _mm512_max_ps(vmax, _mm512_abs_ps(_mm512_loadu_ps(x + i)));
+    if (i < n) {
+        __mmask16 tail = (__mmask16)((1u << (n - i)) - 1);
+        vmax = _mm512_max_ps(vmax, _mm512_abs_ps(_mm512_maskz_loadu_ps(tail, x + i)));
+    }
+    float scale = activation_scale(_mm512_reduce_max_ps(vmax));
+    float inv = 1.0f / scale;
+    int8_t bias = offset ? (int8_t)-128 : 0;
+    __m512 vinv = _mm512_set1_ps(inv);
+    __m512 hi = _mm512_set1_ps(127.0f), lo = _mm512_set1_ps(-127.0f);
+    __m128i flip = _mm_set1_epi8(bias);
+
+    for (size_t r = 0; r < m; r++) {
+        const float *src = x + r * k;
+        int8_t *row = dst + r * lda;
+        for (size_t j = 0; j < lda; j += 16) {
+            size_t left = k > j ? k - j : 0;
+            __mmask16 mask = left >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << left) - 1);
+            __m512 v = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, src + j), vinv);
+            v = _mm512_max_ps(_mm512_min_ps(v, hi), lo);
+            __m128i q8 = _mm_xor_si128(_mm512_cvtsepi32_epi8(_mm512_cvtps_epi32(v)), flip);
+            size_t width = lda - j < 16 ? lda - j : 16;
+            _mm_mask_storeu_epi8(row + j, (__mmask16)((1u << width) - 1), q8);
+        }
+    }
+    return scale;
+}
+#endif
+
+typedef struct {
+    quant_kernel_t kernel;
+    size_t mr;
+    int offset;                 /* activations stored as q + 128 */
+    quant_kernel_fn fn;
+    quantize_fn quantize;
+} quant_config_t;
+
+static const quant_config_t quant_configs[] = {
+    {QUANT_KERNEL_SCALAR, 4, 0, kernel_scalar, quantize_scalar},
+#ifdef QUANT_X86
+    {QUANT_KERNEL_AVX2, 4, 0, kernel_avx2, quantize_avx2},
+    {QUANT_KERNEL_AVX512_VNNI, 8, 1, kernel_avx512_vnni, quantize_avx512},
+#endif
+};
+
+quant_kernel_t quant_get_kernel(void) {
+#ifdef QUANT_X86
+    gemm_isa_t isa = gemm_get_isa();
+    __builtin_cpu_init();
+    if (isa >= GEMM_ISA_AVX512 && __builtin_cpu_supports("avx512vnni") &&
+        __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl")) {
+        return QUANT_KERNEL_AVX512_VNNI;
+    }
+    if (isa >= GEMM_ISA_AVX2 && __builtin_cpu_supports("avx2")) return QUANT_KERNEL_AVX2;
+#endif
+    return QUANT_KERNEL_SCALAR;
+}
+
+const char* quant_kernel_name(quant_kernel_t kernel) {
+    switch (kernel) {
+        case QUANT_KERNEL_AVX2: return "avx2";
+        case QUANT_KERNEL_AVX512_VNNI: return "avx512-vnni";
+        case QUANT_KERNEL_SCALAR:
+        default: return "scalar";
+    }
+}
+
+static const quant_config_t* quant_config(quant_kernel_t kernel) {
+    for (size_t i = 0; i < sizeof(quant_configs) / sizeof(quant_configs[0]); i++) {
+        if (quant_configs[i].kernel == kernel) return &quant_configs[i];
+    }
+    return &quant_configs[0];
+}
+
+static size_t round_up(size_t value, size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+static void* alloc_aligned(size_t bytes) {
+    void *mem = NULL;
+    if (posix_memalign(&mem, 64, bytes ? bytes : 64) != 0) return NULL;
+    memset(mem, 0, bytes);
+    return mem;
+}
+
+static void quant_layer_release(quant_layer_t *layer) {
+    free(layer->weights);
+    free(layer->scales);
+    free(layer->column_sums);
+    free(layer->bias);
+}
+
+static int quant_layer_init(quant_layer_t *layer, const float *weights, const float *bias,
+                            size_t in, size_t out, activation_type_t activation) {
+    size_t n_padded = round_up(out, QUANT_PANEL);
+    size_t groups = round_up(in, 4) / 4;
+
+    layer->input_size = in;
+    layer->output_size = out;
+    layer->k_padded = groups * 4;
+    layer->activation = activation;
+    layer->weights = (int8_t*)alloc_aligned(n_padded * layer->k_padded);
+    layer->scales = (float*)alloc_aligned(n_padded * sizeof(float));
+    layer->column_sums = (int32_t*)alloc_aligned(n_padded * sizeof(int32_t));
+    layer->bias = (float*)alloc_aligned(n_padded * sizeof(float));
+    if (!layer->weights || !layer->scales || !layer->column_sums || !layer->bias) {
+        fprintf(stderr, "Failed to allocate quantized layer\n");
+        return 0;
+    }
+
+    memcpy(layer->bias, bias, out * sizeof(float));
+    for (size_t n = 0; n < out; n++) {
+        float max_abs = 0.0f;
+        for (size_t k = 0; k < in; k++) {
+            float v = fabsf(weights[k * out + n]);
+            if (v > max_abs) max_abs = v;
+        }
+        float scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+        layer->scales[n] = scale;
+
+        size_t panel = n / QUANT_PANEL, j = n % QUANT_PANEL;
+        int8_t *dst = layer->weights + panel * groups * QUANT_PANEL * 4;
+        int32_t sum = 0;
+        for (size_t k = 0; k < in; k++) {
+            int8_t q = quantize_value(weights[k * out + n], 1.0f / scale);
+            dst[((k / 4) * QUANT_PANEL + j) * 4 + k % 4] = q;
+            sum += q;
+        }
+        layer->column_sums[n] = 128 * sum;
+    }
+    return 1;
+}
+
+static quant_model_t* quant_model_alloc(size_t num_layers) {
+    quant_model_t *model = (quant_model_t*)calloc(1, sizeof(quant_model_t));
+    if (!model) return NULL;
+
+    model->layers = (quant_layer_t*)calloc(num_layers, sizeof(quant_layer_t));
+    if (!model->layers) {
+        free(model);
+        return NULL;
+    }
+    model->num_layers = num_layers;
+    return model;
+}
+
+static void quant_model_finish(quant_model_t *model) {
+    model->input_size = model->layers[0].input_size;
+    model->output_size = model->layers[model->num_layers - 1].output_size;
+    for (size_t i = 0; i < model->num_layers; i++) {
+        if (model->layers[i].input_size > model->max_width) model->max_width = model->layers[i].input_size;
+        if (model->layers[i].output_size > model->max_width) model->max_width = model->layers[i].output_size;
+    }
+}
+
+quant_model_t* quant_model_create(dense_layer_t **layers, size_t num_layers) {
+    if (num_layers == 0) return NULL;
+    for (size_t i = 1; i < num_layers; i++) {
+        if (layers[i]->weights->rows != layers[i - 1]->weights->cols) {
+            fprintf(stderr, "Layer %zu input width does not match previous layer\n", i);
+            return NULL;
+        }
+    }
+
+    quant_model_t *model = quant_model_alloc(num_layers);
+    if (!model) return NULL;
+
+    for (size_t i = 0; i < num_layers; i++) {
+        const dense_layer_t *layer = layers[i];
+        if (!quant_layer_init(&model->layers[i], layer->weights->data, layer->bias->data,
+                              layer->weights->rows, layer->weights->cols, layer->activation)) {
+            quant_model_destroy(model);
+            return NULL;
+        }
+    }
+    quant_model_finish(model);
+    return model;
+}
+
+quant_model_t* quant_model_from_inference(const inference_model_t *source) {
+    quant_model_t *model = quant_model_alloc(source->num_layers);
+    if (!model) return NULL;
+
+    for (size_t i = 0; i < source->num_layers; i++) {
+        const inference_layer_t *layer = &source->layers[i];
+        const float *weights = (const float*)layer->weights;
+        float *widened = NULL;
+        if (layer->precision != PRECISION_FP32) {
+            size_t count = layer->input_size * layer->output_size;
+            widened = (float*)malloc(count * sizeof(float));
+            if (!widened) {
+                quant_model_destroy(model);
+                return NULL;
+            }
+            half_convert_to_float(widened, (const uint16_t*)layer->weights, count, layer->precision);
+            weights = widened;
+        }
+
+        int ok = quant_layer_init(&model->layers[i], weights, layer->bias, layer->input_size,
+                                  layer->output_size, layer->activation);
+        free(widened);
+        if (!ok) {
+            quant_model_destroy(model);
+            return NULL;
+        }
+    }
+    quant_model_finish(model);
+    return model;
+}
+
+void quant_model_destroy(quant_model_t *model) {
+    if (!model) return;
+
+    for (size_t i = 0; i < model->num_layers; i++) quant_layer_release(&model->layers[i]);
+    free(model->layers);
+    free(model);
+}
+
+typedef struct {
+    const quant_config_t *config;
+    const quant_layer_t *layer;
+    const int8_t *a;
+    size_t m;
+    float input_scale;
+    float *output;
+    size_t ldc;
+} quant_job_t;
+
+static void quant_gemm_task(void *arg, size_t begin, size_t end) {
+    const quant_job_t *job = (const quant_job_t*)arg;
+    const quant_layer_t *layer = job->layer;
+    size_t groups = layer->k_padded / 4, mr = job->config->mr, ldc = job->ldc;
+    float scale[QUANT_PANEL] __attribute__((aligned(64)));
+    float tile[QUANT_MAX_MR * QUANT_PANEL] __attribute__((aligned(64)));
+
+    for (size_t p = begin; p < end; p++) {
+        size_t col = p * QUANT_PANEL;
+        size_t n = layer->output_size;
+        size_t cols = n - col < QUANT_PANEL ? n - col : QUANT_PANEL;
+        for (size_t j = 0; j < QUANT_PANEL; j++) scale[j] = job->input_scale * layer->scales[col + j];
+        quant_epilogue_t ep = {layer->column_sums + col, scale, layer->bias + col,
+                               layer->activation == ACTIVATION_RELU};
+        const int8_t *panel = layer->weights + p * groups * QUANT_PANEL * 4;
+
+        for (size_t row = 0; row < job->m; row += mr) {
+            size_t rows = job->m - row < mr ? job->m - row : mr;
+            float *y = job->output + row * ldc + col;
+            /* Edge tiles land in a local buffer and only their valid part is copied. */
+            int full = rows == mr && cols == QUANT_PANEL;
+            job->config->fn(groups, job->a + row * layer->k_padded, layer->k_padded, panel, &ep,
+                            full ? y : tile, full ? ldc : QUANT_PANEL);
+            for (size_t r = 0; r < rows; r++) {
+                float *yr = y + r * ldc;
+                if (!full) memcpy(yr, tile + r * QUANT_PANEL, cols * sizeof(float));
+                if (layer->activation == ACTIVATION_SIGMOID) {
+                    for (size_t j = 0; j < cols; j++) yr[j] = 1.0f / (1.0f + expf(-yr[j]));
+                }
+            }
+        }
+    }
+}
+
+static __thread unsigned char *thread_scratch = NULL;
+static __thread size_t thread_scratch_cap = 0;
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_key_once = PTHREAD_ONCE_INIT;
+
+static void release_thread_scratch(void *unused) {
+    (void)unused;
+    free(thread_scratch);
+    thread_scratch = NULL;
+    thread_scratch_cap = 0;
+}
+
+static void create_scratch_key(void) {
+    pthread_key_create(&scratch_key, release_thread_scratch);
+}
+
+static unsigned char* reserve_thread_scratch(size_t bytes) {
+    if (bytes <= thread_scratch_cap) return thread_scratch;
+
+    pthread_once(&scratch_key_once, create_scratch_key);
+    pthread_setspecific(scratch_key, (void*)1);
+
+    unsigned char *mem = (unsigned char*)alloc_aligned(bytes);
+    if (!mem) {
+        fprintf(stderr, "Failed to allocate quantized inference scratch\n");
+        return NULL;
+    }
+    free(thread_scratch);
+    thread_scratch = mem;
+    thread_scratch_cap = bytes;
+    return thread_scratch;
+}
+
+int quant_forward(const quant_model_t *model, const tensor_t *input, tensor_t *output) {
+    size_t batch = input->rows;
+    if (input->cols != model->input_size || output->rows != batch ||
+        output->cols != model->output_size) {
+        fprintf(stderr, "Invalid tensor shapes for quantized inference\n");
+        return 0;
+    }
+
+    /* Quantized rows are padded to whole QUANT_MAX_MR tiles so kernels never branch
+     * on the row count; the hidden buffers ping-pong as in inference_forward. */
+    size_t m_padded = round_up(batch, QUANT_MAX_MR);
+    size_t q_bytes = round_up(m_padded * round_up(model->max_width, 4), 64);
+    size_t hidden = round_up(batch * model->max_width, 16);
+    unsigned char *scratch = reserve_thread_scratch(q_bytes + 2 * hidden * sizeof(float));
+    if (!scratch) return 0;
+
+    int8_t *a = (int8_t*)scratch;
+    float *buffers = (float*)(scratch + q_bytes);
+    const quant_config_t *config = quant_config(quant_get_kernel());
+
+    /* The quantizers scan their input as one block, so a strided view is
+     * gathered first into the buffer the first layer does not write. */
+    const float *x = input->data;
+    if (!tensor_is_contiguous(input)) {
+        tensor_t packed = tensor_view(buffers + hidden, batch, input->cols, input->cols);
+        tensor_copy_data(&packed, input);
+        x = packed.data;
+    }
+    for (size_t i = 0; i < model->num_layers; i++) {
+        const quant_layer_t *layer = &model->layers[i];
+        int last = i + 1 == model->num_layers;
+        float *y = last ? output->data : buffers + (i % 2) * hidden;
+
+        float scale = config->quantize(x, batch, layer->input_size, a, layer->k_padded, config->offset);
+        memset(a + batch * layer->k_padded, config->offset ? 0x80 : 0, (m_padded - batch) * layer->k_padded);
+
+        quant_job_t job = {config, layer, a, batch, scale, y, last ? output->stride : layer->output_size};
+        size_t panels = round_up(layer->output_size, QUANT_PANEL) / QUANT_PANEL;
+        size_t ops = m_padded * layer->k_padded * QUANT_PANEL;
+        size_t grain = ops >= QUANT_PARALLEL_OPS ? 1 : QUANT_PARALLEL_OPS / ops;
+        threadpool_parallel_for(panels, grain, quant_gemm_task, &job);
+        x = y;
+    }
+
+    return 1;
+}
+
+/* A single output is a probability after a sigmoid, or a logit from a
+ * linear layer (BCE on logits), whose decision boundary is 0. */
+static size_t predicted_class(const float *row, size_t cols, float threshold) {
+    if (cols == 1) return row[0] > threshold;
+
+    size_t best = 0;
+    for (size_t j = 1; j < cols; j++) {
+        if (row[j] > row[best]) best = j;
+    }
+    return best;
+}
+
+int quant_calibrate(const quant_model_t *model, dense_layer_t **layers, size_t num_layers,
+                    const tensor_t *inputs, const tensor_t *targets, quant_report_t *report) {
+    size_t batch = inputs->rows, cols = model->output_size;
+    float threshold = model->layers[model->num_layers - 1].activation == ACTIVATION_NONE ? 0.0f : 0.5f;
+
+    inference_model_t *reference = inference_model_create(layers, num_layers);
+    tensor_t *expected = tensor_create(batch, cols);
+    tensor_t *actual = tensor_create(batch, cols);
+    int ok = reference && expected && actual && reference->output_size == cols &&
+             inference_forward(reference, inputs, expected, NULL) &&
+             quant_forward(model, inputs, actual);
+
+    if (ok) {
+        double total_error = 0.0;
+        size_t fp32_correct = 0, int8_correct = 0, agree = 0;
+        memset(report, 0, sizeof(*report));
+        report->samples = batch;
+
+        for (size_t i = 0; i < batch; i++) {
+            const float *e = expected->data + i * expected->stride;
+            const float *q = actual->data + i * actual->stride;
+            for (size_t j = 0; j < cols; j++) {
+                float err = fabsf(q[j] - e[j]);
+                total_error += err;
+                if (err > report->max_abs_error) report->max_abs_error = err;
+            }
+
+            size_t fp32_class = predicted_class(e, cols, threshold);
+            size_t int8_class = predicted_class(q, cols, threshold);
+            agree += fp32_class == int8_class;
+            if (targets) {
+                size_t target_class = predicted_class(targets->data + i * targets->stride,
+                                                      targets->cols, 0.5f);
+                fp32_correct += fp32_class == target_class;
+                int8_correct += int8_class == target_class;
+            }
+        }
+
+        report->mean_abs_error = batch ? (float)(total_error / (double)(batch * cols)) : 0.0f;
+        report->agreement = batch ? (float)agree / (float)batch : 1.0f;
+        if (targets && batch) {
+            report->fp32_accuracy = (float)fp32_correct / (float)batch;
+            report->int8_accuracy = (float)int8_correct / (float)batch;
+            report->accuracy_delta = report->int8_accuracy - report->fp32_accuracy;
+        }
+    }
+
+    inference_model_destroy(reference);
+    tensor_destroy(expected);
+    tensor_destroy(actual);
+    return ok;
+}
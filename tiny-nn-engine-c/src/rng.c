@@ -0,0 +1,369 @@
+#include "rng.h"
+#include "gemm.h"
+#include "threadpool.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RNG_X86 1
+#include <immintrin.h>
+#endif
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+/* Fills work in groups of eight blocks: element 32 * g + 8 * j + l is word j
+ * of block 8 * g + l, so the vector path stores each output word of its
+ * eight lanes as one run. Groups are generated RNG_CHUNK_GROUPS at a time
+ * into scratch on the worker's stack. */
+#define RNG_GROUP 32
+#define RNG_CHUNK_GROUPS 8
+#define RNG_CHUNK (RNG_GROUP * RNG_CHUNK_GROUPS)
+
+/* Box-Muller: z = sqrt(-2 log u1) * (cos, sin)(2 pi u2). The top two bits of
+ * u2's word pick the quadrant and the next 22 the angle within it, which is
+ * centred on pi / 4 so the Taylor polynomials only see |x| <= pi / 4, where
+ * they are good to a few ulps. */
+#define RNG_HALF_PI 1.57079632679489662f
+#define RNG_SQRT_HALF 0.707106781186547524f
+#define SIN_P1 -1.66666666667e-1f
+#define SIN_P2 8.33333333333e-3f
+#define SIN_P3 -1.98412698413e-4f
+#define SIN_P4 2.75573192240e-6f
+#define COS_P1 -5.0e-1f
+#define COS_P2 4.16666666667e-2f
+#define COS_P3 -1.38888888889e-3f
+#define COS_P4 2.48015873016e-5f
+#define COS_P5 -2.75573192240e-7f
+
+void rng_philox4x32(uint32_t counter[4], const uint32_t key[2]) {
+    uint32_t k0 = key[0], k1 = key[1];
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+
+    for (int round = 0; round < PHILOX_ROUNDS; round++) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+        c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t)p1;
+        c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t)p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    counter[0] = c0;
+    counter[1] = c1;
+    counter[2] = c2;
+    counter[3] = c3;
+}
+
+static void seed_key(uint32_t key[2], uint64_t seed) {
+    key[0] = (uint32_t)seed;
+    key[1] = (uint32_t)(seed >> 32);
+}
+
+void rng_init(rng_t *rng, uint64_t seed, uint64_t stream) {
+    seed_key(rng->key, seed);
+    rng->stream = stream;
+    rng->block = 0;
+    rng->used = 4;
+}
+
+uint32_t rng_u32(rng_t *rng) {
+    if (rng->used == 4) {
+        rng->words[0] = (uint32_t)rng->block;
+        rng->words[1] = (uint32_t)(rng->block >> 32);
+        rng->words[2] = (uint32_t)rng->stream;
+        rng->words[3] = (uint32_t)(rng->stream >> 32);
+        rng_philox4x32(rng->words, rng->key);
+        rng->block++;
+        rng->used = 0;
+    }
+    return rng->words[rng->used++];
+}
+
+float rng_uniform(rng_t *rng) {
+    return (float)(rng_u32(rng) >> 8) * 0x1p-24f;
+}
+
+uint64_t rng_below(rng_t *rng, uint64_t n) {
+    uint64_t high = rng_u32(rng);
+    return ((high << 32) | rng_u32(rng)) % n;
+}
+
+static void groups_scalar(const uint32_t key[2], uint64_t stream, uint64_t group, size_t count,
+                          uint32_t *out) {
+    for (size_t g = 0; g < count; g++) {
+        uint64_t first = (group + g) * 8;
+        for (uint32_t l = 0; l < 8; l++) {
+            uint64_t block = first + l;
+            uint32_t words[4] = {(uint32_t)block, (uint32_t)(block >> 32),
+                                 (uint32_t)stream, (uint32_t)(stream >> 32)};
+            rng_philox4x32(words, key);
+            for (size_t j = 0; j < 4; j++) out[g * RNG_GROUP + j * 8 + l] = words[j];
+        }
+    }
+}
+
+static void sincos_scalar(uint32_t word, float *cos_out, float *sin_out) {
+    float x = ((float)((word >> 8) & 0x3FFFFFu) * 0x1p-22f - 0.5f) * RNG_HALF_PI;
+    float x2 = x * x;
+    float s = x + x * x2 * (SIN_P1 + x2 * (SIN_P2 + x2 * (SIN_P3 + x2 * SIN_P4)));
+    float c = 1.0f + x2 * (COS_P1 + x2 * (COS_P2 + x2 * (COS_P3 + x2 * (COS_P4 + x2 * COS_P5))));
+    float sin_t = (s + c) * RNG_SQRT_HALF;
+    float cos_t = (c - s) * RNG_SQRT_HALF;
+
+    /* Rotate by the quadrant: q * pi / 2 + t. */
+    uint32_t q = word >> 30;
+    if (q & 1) {
+        float tmp = cos_t;
+        cos_t = sin_t;
+        sin_t = tmp;
+    }
+    if ((q ^ (q >> 1)) & 1) cos_t = -cos_t;
+    if (q & 2) sin_t = -sin_t;
+    *cos_out = cos_t;
+    *sin_out = sin_t;
+}
+
+/* u1 in (0, 1] for each Box-Muller pair: words 0 and 2 of every group. */
+static void normal_radius_input(const uint32_t *words, float *u1, size_t groups) {
+    for (size_t g = 0; g < groups; g++) {
+        for (size_t h = 0; h < 2; h++) {
+            for (size_t l = 0; l < 8; l++) {
+                uint32_t w = words[g * RNG_GROUP + h * 16 + l];
+                u1[g * 16 + h * 8 + l] = (float)((w >> 8) + 1) * 0x1p-24f;
+            }
+        }
+    }
+}
+
+static void normal_scalar(const uint32_t *words, const float *log_u1, float *out, size_t groups,
+                          float mean, float stddev) {
+    for (size_t g = 0; g < groups; g++) {
+        for (size_t h = 0; h < 2; h++) {
+            for (size_t l = 0; l < 8; l++) {
+                float r = sqrtf(-2.0f * log_u1[g * 16 + h * 8 + l]);
+                float c, s;
+                sincos_scalar(words[g * RNG_GROUP + h * 16 + 8 + l], &c, &s);
+                out[g * RNG_GROUP + h * 16 + l] = mean + stddev * (r * c);
+                out[g * RNG_GROUP + h * 16 + 8 + l] = mean + stddev * (r * s);
+            }
+        }
+    }
+}
+
+#ifdef RNG_X86
+/* Lane i of x times lane i of m as 64 bits, split into high and low words. */
+__attribute__((target("avx2")))
+static inline void mulhilo_avx2(__m256i x, __m256i m, __m256i *hi, __m256i *lo) {
+    __m256i even = _mm256_mul_epu32(x, m);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), m);
+    *lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+    *hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+__attribute__((target("avx2")))
+static void groups_avx2(const uint32_t key[2], uint64_t stream, uint64_t group, size_t count,
+                        uint32_t *out) {
+    __m256i m0 = _mm256_set1_epi32((int)PHILOX_M0), m1 = _mm256_set1_epi32((int)PHILOX_M1);
+    __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (size_t g = 0; g < count; g++) {
+        uint64_t first = (group + g) * 8;
+        __m256i c0 = _mm256_or_si256(_mm256_set1_epi32((int)(uint32_t)first), lanes);
+        __m256i c1 = _mm256_set1_epi32((int)(uint32_t)(first >> 32));
+        __m256i c2 = _mm256_set1_epi32((int)(uint32_t)stream);
+        __m256i c3 = _mm256_set1_epi32((int)(uint32_t)(stream >> 32));
+        uint32_t k0 = key[0], k1 = key[1];
+
+        for (int round = 0; round < PHILOX_ROUNDS; round++) {
+            __m256i hi0, lo0, hi1, lo1;
+            mulhilo_avx2(c0, m0, &hi0, &lo0);
+            mulhilo_avx2(c2, m1, &hi1, &lo1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32((int)k0));
+            c1 = lo1;
+            c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32((int)k1));
+            c3 = lo0;
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+
+        uint32_t *dst = out + g * RNG_GROUP;
+        _mm256_storeu_si256((__m256i*)dst, c0);
+        _mm256_storeu_si256((__m256i*)(dst + 8), c1);
+        _mm256_storeu_si256((__m256i*)(dst + 16), c2);
+        _mm256_storeu_si256((__m256i*)(dst + 24), c3);
+    }
+}
+
+__attribute__((target("avx2")))
+static void uniform_avx2(const uint32_t *words, float *out, size_t n, float min, float range) {
+    __m256 lo = _mm256_set1_ps(min), scale = _mm256_set1_ps(range), step = _mm256_set1_ps(0x1p-24f);
+    for (size_t i = 0; i < n; i += 8) {
+        __m256i w = _mm256_srli_epi32(_mm256_loadu_si256((const __m256i*)(words + i)), 8);
+        __m256 u = _mm256_mul_ps(_mm256_cvtepi32_ps(w), step);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(lo, _mm256_mul_ps(u, scale)));
+    }
+}
+
+/* sincos_scalar on eight words, operation for operation. */
+__attribute__((target("avx2")))
+static inline void sincos_avx2(__m256i word, __m256 *cos_out, __m256 *sin_out) {
+    __m256i angle = _mm256_and_si256(_mm256_srli_epi32(word, 8), _mm256_set1_epi32(0x3FFFFF));
+    __m256 x = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(angle), _mm256_set1_ps(0x1p-22f)),
+                             _mm256_set1_ps(0.5f));
+    x = _mm256_mul_ps(x, _mm256_set1_ps(RNG_HALF_PI));
+    __m256 x2 = _mm256_mul_ps(x, x);
+
+    __m256 p = _mm256_add_ps(_mm256_set1_ps(SIN_P3), _mm256_mul_ps(x2, _mm256_set1_ps(SIN_P4)));
+    p = _mm256_add_ps(_mm256_set1_ps(SIN_P2), _mm256_mul_ps(x2, p));
+    p = _mm256_add_ps(_mm256_set1_ps(SIN_P1), _mm256_mul_ps(x2, p));
+    __m256 s = _mm256_add_ps(x, _mm256_mul_ps(_mm256_mul_ps(x, x2), p));
+
+    __m256 q = _mm256_add_ps(_mm256_set1_ps(COS_P4), _mm256_mul_ps(x2, _mm256_set1_ps(COS_P5)));
+    q = _mm256_add_ps(_mm256_set1_ps(COS_P3), _mm256_mul_ps(x2, q));
+    q = _mm256_add_ps(_mm256_set1_ps(COS_P2), _mm256_mul_ps(x2, q));
+    q = _mm256_add_ps(_mm256_set1_ps(COS_P1), _mm256_mul_ps(x2, q));
+    __m256 c = _mm256_add_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(x2, q));
+
+    __m256 half = _mm256_set1_ps(RNG_SQRT_HALF);
+    __m256 sin_t = _mm256_mul_ps(_mm256_add_ps(s, c), half);
+    __m256 cos_t = _mm256_mul_ps(_mm256_sub_ps(c, s), half);
+
+    __m256i quadrant = _mm256_srli_epi32(word, 30);
+    __m256i one = _mm256_set1_epi32(1);
+    __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+    __m256i flip = _mm256_xor_si256(quadrant, _mm256_srli_epi32(quadrant, 1));
+    __m256 negate_cos = _mm256_castsi256_ps(_mm256_slli_epi32(flip, 31));
+    __m256 negate_sin = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_srli_epi32(quadrant, 1), 31));
+
+    __m256 swapped_cos = _mm256_blendv_ps(cos_t, sin_t, swap);
+    __m256 swapped_sin = _mm256_blendv_ps(sin_t, cos_t, swap);
+    *cos_out = _mm256_xor_ps(swapped_cos, negate_cos);
+    *sin_out = _mm256_xor_ps(swapped_sin, negate_sin);
+}
+
+__attribute__((target("avx2")))
+static void normal_avx2(const uint32_t *words, const float *log_u1, float *out, size_t groups,
+                        float mean, float stddev) {
+    __m256 mu = _mm256_set1_ps(mean), sigma = _mm256_set1_ps(stddev), minus_two = _mm256_set1_ps(-2.0f);
+    for (size_t g = 0; g < groups; g++) {
+        for (size_t h = 0; h < 2; h++) {
+            __m256 r = _mm256_sqrt_ps(_mm256_mul_ps(minus_two, _mm256_loadu_ps(log_u1 + g * 16 + h * 8)));
+            __m256 c, s;
+            sincos_avx2(_mm256_loadu_si256((const __m256i*)(words + g * RNG_GROUP + h * 16 + 8)), &c, &s);
+            float *dst = out + g * RNG_GROUP + h * 16;
+            _mm256_storeu_ps(dst, _mm256_add_ps(mu, _mm256_mul_ps(sigma, _mm256_mul_ps(r, c))));
+            _mm256_storeu_ps(dst + 8, _mm256_add_ps(mu, _mm256_mul_ps(sigma, _mm256_mul_ps(r, s))));
+        }
+    }
+}
+#endif
+
+typedef struct {
+    float *data;
+    size_t cols, stride;
+    uint32_t key[2];
+    uint64_t stream;
+    int normal;
+    float a, b;                 /* min and range, or mean and stddev */
+    gemm_isa_t isa;
+} fill_job_t;
+
+static void generate(const fill_job_t *job, uint64_t group, size_t groups, uint32_t *words) {
+#ifdef RNG_X86
+    if (job->isa >= GEMM_ISA_AVX2) {
+        groups_avx2(job->key, job->stream, group, groups, words);
+        return;
+    }
+#endif
+    groups_scalar(job->key, job->stream, group, groups, words);
+}
+
+static void to_values(const fill_job_t *job, const uint32_t *words, float *values, size_t groups) {
+    size_t n = groups * RNG_GROUP;
+    if (job->normal) {
+        float log_u1[RNG_CHUNK / 2];
+        normal_radius_input(words, log_u1, groups);
+        math_log(log_u1, log_u1, groups * 16, MATH_FAST);
+#ifdef RNG_X86
+        if (job->isa >= GEMM_ISA_AVX2) {
+            normal_avx2(words, log_u1, values, groups, job->a, job->b);
+            return;
+        }
+#endif
+        normal_scalar(words, log_u1, values, groups, job->a, job->b);
+        return;
+    }
+#ifdef RNG_X86
+    if (job->isa >= GEMM_ISA_AVX2) {
+        uniform_avx2(words, values, n, job->a, job->b);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) values[i] = job->a + (float)(words[i] >> 8) * 0x1p-24f * job->b;
+}
+
+/* Generates whole groups around [begin, end) and copies out the part that
+ * falls inside, one row run at a time. */
+static void fill_task(void *ctx, size_t begin, size_t end) {
+    const fill_job_t *job = (const fill_job_t*)ctx;
+    uint32_t words[RNG_CHUNK];
+    float values[RNG_CHUNK];
+
+    while (begin < end) {
+        uint64_t group = begin / RNG_GROUP;
+        size_t first = (size_t)group * RNG_GROUP;
+        size_t groups = (end - first + RNG_GROUP - 1) / RNG_GROUP;
+        if (groups > RNG_CHUNK_GROUPS) groups = RNG_CHUNK_GROUPS;
+
+        generate(job, group, groups, words);
+        to_values(job, words, values, groups);
+
+        size_t stop = first + groups * RNG_GROUP < end ? first + groups * RNG_GROUP : end;
+        while (begin < stop) {
+            size_t row = begin / job->cols, col = begin % job->cols;
+            size_t run = job->cols - col < stop - begin ? job->cols - col : stop - begin;
+            memcpy(job->data + row * job->stride + col, values + (begin - first), run * sizeof(float));
+            begin += run;
+        }
+    }
+}
+
+static void fill(tensor_t *tensor, int normal, float a, float b, uint64_t seed, uint64_t stream) {
+    size_t count = tensor->rows * tensor->cols;
+    if (count == 0) return;
+
+    fill_job_t job = {tensor->data, tensor->cols, tensor->stride, {0, 0}, stream, normal, a, b,
+                      gemm_get_isa()};
+    seed_key(job.key, seed);
+    threadpool_parallel_for(count, THREADPOOL_GRAIN, fill_task, &job);
+}
+
+void rng_fill_uniform(tensor_t *tensor, float min, float max, uint64_t seed, uint64_t stream) {
+    fill(tensor, 0, min, max - min, seed, stream);
+}
+
+void rng_fill_normal(tensor_t *tensor, float mean, float stddev, uint64_t seed, uint64_t stream) {
+    fill(tensor, 1, mean, stddev, seed, stream);
+}
+
+static uint64_t global_seed = RNG_DEFAULT_SEED;
+static uint64_t global_stream = 0;
+
+void rng_set_seed(uint64_t seed) {
+    __atomic_store_n(&global_seed, seed, __ATOMIC_RELAXED);
+    __atomic_store_n(&global_stream, 0, __ATOMIC_RELAXED);
+}
+
+uint64_t rng_seed(void) {
+    return __atomic_load_n(&global_seed, __ATOMIC_RELAXED);
+}
+
+uint64_t rng_next_stream(void) {
+    return __atomic_fetch_add(&global_stream, 1, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,560 @@
+#define _POSIX_C_SOURCE 200112L
+#include "server.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SERVER_BACKLOG 64
+
+typedef struct connection {
+    server_t *server;
+    int fd;
+    pthread_t thread;
+    float *input;               /* one request, up to max_batch rows */
+    float *output;              /* its reply, filled by the batcher */
+    uint32_t id;                /* the request in flight, guarded by the lock */
+    size_t rows;
+    uint64_t arrival;
+    int done;
+    int ok;                     /* the forward pass for the request succeeded */
+    int finished;               /* the reader thread has returned */
+    struct connection *next_queued;
+    struct connection *next;
+} connection_t;
+
+struct server {
+    const inference_model_t *model;
+    server_config_t config;
+    char path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+    int listen_fd;
+    int stopping;               /* set from signal handlers; __atomic access only */
+
+    pthread_mutex_t lock;
+    pthread_cond_t queued;      /* batcher waits, on CLOCK_MONOTONIC */
+    pthread_cond_t served;      /* readers wait for their reply */
+    int running;
+    connection_t *head, *tail;
+    size_t queued_rows;
+    size_t queued_requests;
+    size_t open_connections;    /* readers still running */
+    connection_t *connections;
+    pthread_t batcher;
+
+    tensor_t *batch_input;
+    tensor_t *batch_output;
+    inference_scratch_t *scratch;
+    server_stats_t stats;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int read_full(int fd, void *buffer, size_t bytes) {
+    char *p = (char*)buffer;
+    while (bytes) {
+        ssize_t n = recv(fd, p, bytes, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        p += n;
+        bytes -= (size_t)n;
+    }
+    return 1;
+}
+
+/* A frame and its payload in one gather write, resumed after short writes. */
+static int send_frame(int fd, const server_frame_t *frame, const void *payload, size_t bytes) {
+    struct iovec iov[2] = {{(void*)frame, sizeof(*frame)}, {(void*)payload, bytes}};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = bytes ? 2 : 1;
+
+    while (msg.msg_iovlen) {
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        size_t sent = (size_t)n;
+        while (msg.msg_iovlen && sent >= msg.msg_iov->iov_len) {
+            sent -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen) {
+            msg.msg_iov->iov_base = (char*)msg.msg_iov->iov_base + sent;
+            msg.msg_iov->iov_len -= sent;
+        }
+    }
+    return 1;
+}
+
+static int send_error(int fd, uint32_t id) {
+    server_frame_t frame = {SERVER_ERROR, id, 0, 0};
+    return send_frame(fd, &frame, NULL, 0);
+}
+
+static int log2_bucket(uint64_t value, int buckets) {
+    int b = 0;
+    while (value >= 2 && b < buckets - 1) {
+        value >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static void* batcher_main(void *arg) {
+    server_t *server = (server_t*)arg;
+    size_t in = server->model->input_size, out = server->model->output_size;
+    size_t max_batch = server->config.max_batch;
+
+    pthread_mutex_lock(&server->lock);
+    for (;;) {
+        while (server->running && !server->head) pthread_cond_wait(&server->queued, &server->lock);
+        if (!server->running) break;
+
+        uint64_t deadline_ns = server->head->arrival + (uint64_t)server->config.max_wait_us * 1000;
+        struct timespec deadline = {(time_t)(deadline_ns / 1000000000ull), (long)(deadline_ns % 1000000000ull)};
+        /* Each connection has one request in flight, so once every open
+         * connection is queued nothing else can join the batch. */
+        while (server->running && server->queued_rows < max_batch &&
+               server->queued_requests < server->open_connections) {
+            if (pthread_cond_timedwait(&server->queued, &server->lock, &deadline) == ETIMEDOUT) break;
+        }
+        if (!server->running) break;
+
+        /* Whole requests in arrival order, as many as fit. */
+        connection_t *batch = NULL, **link = &batch;
+        size_t rows = 0;
+        while (server->head && rows + server->head->rows <= max_batch) {
+            connection_t *c = server->head;
+            server->head = c->next_queued;
+            c->next_queued = NULL;
+            *link = c;
+            link = &c->next_queued;
+            rows += c->rows;
+            server->queued_requests--;
+        }
+        if (!server->head) server->tail = NULL;
+        server->queued_rows -= rows;
+        pthread_mutex_unlock(&server->lock);
+
+        size_t offset = 0;
+        for (connection_t *c = batch; c; c = c->next_queued) {
+            memcpy(server->batch_input->data + offset * in, c->input, c->rows * in * sizeof(float));
+            offset += c->rows;
+        }
+        tensor_t x = tensor_rows(server->batch_input, 0, rows);
+        tensor_t y = tensor_rows(server->batch_output, 0, rows);
+        uint64_t start = now_ns();
+        int ok = inference_forward(server->model, &x, &y, server->scratch);
+        uint64_t forward = now_ns() - start;
+
+        /* Each reader sends its own reply, so a client that is slow to
+         * read only holds up its own connection. */
+        offset = 0;
+        for (connection_t *c = batch; c; c = c->next_queued) {
+            if (ok) memcpy(c->output, y.data + offset * out, c->rows * out * sizeof(float));
+            c->ok = ok;
+            offset += c->rows;
+        }
+
+        /* Counted before any reply goes out, so a client that has its
+         * answer also sees it in the statistics. */
+        uint64_t ready = now_ns();
+        size_t requests = 0;
+        pthread_mutex_lock(&server->lock);
+        server_stats_t *stats = &server->stats;
+        for (connection_t *c = batch; c; c = c->next_queued) {
+            stats->latency[log2_bucket((ready - c->arrival) / 1000, SERVER_LATENCY_BUCKETS)]++;
+            requests++;
+        }
+        stats->requests += requests;
+        stats->rows += rows;
+        stats->batches++;
+        if (!ok) stats->errors += requests;
+        if (rows > stats->max_batch_rows) stats->max_batch_rows = rows;
+        stats->forward_seconds += (double)forward * 1e-9;
+        stats->batch_rows[log2_bucket(rows, SERVER_BATCH_BUCKETS)]++;
+        for (connection_t *c = batch; c; c = c->next_queued) c->done = 1;
+        pthread_cond_broadcast(&server->served);
+    }
+    pthread_mutex_unlock(&server->lock);
+    return NULL;
+}
+
+static void reply_stats(connection_t *c, uint32_t id) {
+    server_stats_t stats;
+    server_get_stats(c->server, &stats);
+    size_t length = server_format_stats(&stats, NULL, 0);
+    char *json = (char*)malloc(length + 1);
+    if (!json) {
+        send_error(c->fd, id);
+        return;
+    }
+    server_format_stats(&stats, json, length + 1);
+    server_frame_t frame = {SERVER_STATS, id, (uint32_t)length, 0};
+    send_frame(c->fd, &frame, json, length);
+    free(json);
+}
+
+/* Reads requests until the client hangs up or sends something malformed,
+ * which gets an error reply and closes the connection. */
+static void* connection_main(void *arg) {
+    connection_t *c = (connection_t*)arg;
+    server_t *server = c->server;
+    size_t in = server->model->input_size, out = server->model->output_size;
+
+    for (;;) {
+        server_frame_t frame;
+        if (!read_full(c->fd, &frame, sizeof(frame))) break;
+        if (frame.magic == SERVER_STATS) {
+            reply_stats(c, frame.id);
+            continue;
+        }
+        if (frame.magic != SERVER_REQUEST || frame.cols != in || frame.rows == 0 ||
+            frame.rows > server->config.max_batch) {
+            pthread_mutex_lock(&server->lock);
+            server->stats.errors++;
+            pthread_mutex_unlock(&server->lock);
+            send_error(c->fd, frame.id);
+            break;
+        }
+        if (!read_full(c->fd, c->input, (size_t)frame.rows * in * sizeof(float))) break;
+
+        pthread_mutex_lock(&server->lock);
+        if (!server->running) {
+            pthread_mutex_unlock(&server->lock);
+            break;
+        }
+        c->id = frame.id;
+        c->rows = frame.rows;
+        c->arrival = now_ns();
+        c->done = 0;
+        c->next_queued = NULL;
+        if (server->tail) server->tail->next_queued = c;
+        else server->head = c;
+        server->tail = c;
+        server->queued_rows += c->rows;
+        server->queued_requests++;
+        pthread_cond_signal(&server->queued);
+
+        while (!c->done && server->running) pthread_cond_wait(&server->served, &server->lock);
+        int served = c->done;
+        pthread_mutex_unlock(&server->lock);
+        if (!served) break;
+
+        frame.magic = SERVER_RESPONSE;
+        frame.cols = (uint32_t)out;
+        if (c->ok ? !send_frame(c->fd, &frame, c->output, c->rows * out * sizeof(float))
+                  : !send_error(c->fd, c->id)) {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&server->lock);
+    c->finished = 1;
+    server->open_connections--;
+    pthread_cond_signal(&server->queued);
+    pthread_mutex_unlock(&server->lock);
+    return NULL;
+}
+
+static void connection_destroy(connection_t *c) {
+    pthread_join(c->thread, NULL);
+    close(c->fd);
+    free(c->input);
+    free(c->output);
+    free(c);
+}
+
+/* Joins readers whose clients have gone. */
+static void reap_connections(server_t *server) {
+    pthread_mutex_lock(&server->lock);
+    connection_t **link = &server->connections, *gone = NULL;
+    while (*link) {
+        connection_t *c = *link;
+        if (c->finished) {
+            *link = c->next;
+            c->next = gone;
+            gone = c;
+        } else {
+            link = &c->next;
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    while (gone) {
+        connection_t *next = gone->next;
+        connection_destroy(gone);
+        gone = next;
+    }
+}
+
+static int add_connection(server_t *server, int fd) {
+    connection_t *c = (connection_t*)calloc(1, sizeof(connection_t));
+    void *input = NULL, *output = NULL;
+    size_t in_bytes = server->config.max_batch * server->model->input_size * sizeof(float);
+    size_t out_bytes = server->config.max_batch * server->model->output_size * sizeof(float);
+    if (!c || posix_memalign(&input, 64, in_bytes ? in_bytes : 64) != 0 ||
+        posix_memalign(&output, 64, out_bytes ? out_bytes : 64) != 0) {
+        free(input);
+        free(c);
+        return 0;
+    }
+    c->server = server;
+    c->fd = fd;
+    c->input = (float*)input;
+    c->output = (float*)output;
+
+    pthread_mutex_lock(&server->lock);
+    server->open_connections++;
+    if (pthread_create(&c->thread, NULL, connection_main, c) != 0) {
+        server->open_connections--;
+        pthread_mutex_unlock(&server->lock);
+        free(c->input);
+        free(c->output);
+        free(c);
+        return 0;
+    }
+    c->next = server->connections;
+    server->connections = c;
+    pthread_mutex_unlock(&server->lock);
+    return 1;
+}
+
+server_t* server_create(const inference_model_t *model, const server_config_t *config) {
+    if (!config->socket_path || config->max_batch == 0) {
+        fprintf(stderr, "Server needs a socket path and a max batch of at least 1\n");
+        return NULL;
+    }
+    server_t *server = (server_t*)calloc(1, sizeof(server_t));
+    if (!server) return NULL;
+    if (strlen(config->socket_path) >= sizeof(server->path)) {
+        fprintf(stderr, "Socket path %s is too long\n", config->socket_path);
+        free(server);
+        return NULL;
+    }
+
+    server->model = model;
+    server->config = *config;
+    strcpy(server->path, config->socket_path);
+    server->config.socket_path = server->path;
+    server->listen_fd = -1;
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&server->queued, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&server->served, NULL);
+
+    server->batch_input = tensor_create(config->max_batch, model->input_size);
+    server->batch_output = tensor_create(config->max_batch, model->output_size);
+    server->scratch = inference_scratch_create(model, config->max_batch);
+    if (!server->batch_input || !server->batch_output || !server->scratch) {
+        server_destroy(server);
+        return NULL;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, server->path);
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(server->path);
+    if (server->listen_fd < 0 || bind(server->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(server->listen_fd, SERVER_BACKLOG) != 0) {
+        fprintf(stderr, "Failed to listen on %s: %s\n", server->path, strerror(errno));
+        server_destroy(server);
+        return NULL;
+    }
+    return server;
+}
+
+int server_run(server_t *server) {
+    int status = 1;
+    server->running = 1;
+    if (pthread_create(&server->batcher, NULL, batcher_main, server) != 0) {
+        fprintf(stderr, "Failed to start the batcher\n");
+        return 0;
+    }
+
+    while (!__atomic_load_n(&server->stopping, __ATOMIC_ACQUIRE)) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (__atomic_load_n(&server->stopping, __ATOMIC_ACQUIRE)) break;
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            fprintf(stderr, "accept failed: %s\n", strerror(errno));
+            status = 0;
+            break;
+        }
+        reap_connections(server);
+        if (!add_connection(server, fd)) {
+            fprintf(stderr, "Failed to start a connection\n");
+            close(fd);
+        }
+    }
+
+    /* The batcher finishes the batch in hand; queued requests are dropped. */
+    pthread_mutex_lock(&server->lock);
+    server->running = 0;
+    pthread_cond_broadcast(&server->queued);
+    pthread_cond_broadcast(&server->served);
+    pthread_mutex_unlock(&server->lock);
+    pthread_join(server->batcher, NULL);
+
+    for (connection_t *c = server->connections; c; c = c->next) shutdown(c->fd, SHUT_RDWR);
+    while (server->connections) {
+        connection_t *c = server->connections;
+        server->connections = c->next;
+        connection_destroy(c);
+    }
+    server->head = server->tail = NULL;
+    server->queued_rows = 0;
+    server->queued_requests = 0;
+    return status;
+}
+
+void server_stop(server_t *server) {
+    __atomic_store_n(&server->stopping, 1, __ATOMIC_RELEASE);
+    shutdown(server->listen_fd, SHUT_RDWR);
+}
+
+void server_destroy(server_t *server) {
+    if (!server) return;
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+        unlink(server->path);
+    }
+    tensor_destroy(server->batch_input);
+    tensor_destroy(server->batch_output);
+    inference_scratch_destroy(server->scratch);
+    pthread_cond_destroy(&server->queued);
+    pthread_cond_destroy(&server->served);
+    pthread_mutex_destroy(&server->lock);
+    free(server);
+}
+
+void server_get_stats(server_t *server, server_stats_t *stats) {
+    pthread_mutex_lock(&server->lock);
+    *stats = server->stats;
+    pthread_mutex_unlock(&server->lock);
+}
+
+double server_latency_percentile(const server_stats_t *stats, double p) {
+    uint64_t total = 0;
+    for (int b = 0; b < SERVER_LATENCY_BUCKETS; b++) total += stats->latency[b];
+    if (total == 0) return 0.0;
+
+    double target = p / 100.0 * (double)total;
+    uint64_t seen = 0;
+    for (int b = 0; b < SERVER_LATENCY_BUCKETS; b++) {
+        seen += stats->latency[b];
+        if ((double)seen >= target && stats->latency[b]) return (double)(2ull << b);
+    }
+    return (double)(2ull << (SERVER_LATENCY_BUCKETS - 1));
+}
+
+typedef struct {
+    char *buffer;
+    size_t size;
+    size_t length;
+} json_out_t;
+
+/* snprintf that keeps counting once the buffer is full. */
+static void json_printf(json_out_t *out, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t room = out->length < out->size ? out->size - out->length : 0;
+    int n = vsnprintf(room ? out->buffer + out->length : NULL, room, format, args);
+    va_end(args);
+    if (n > 0) out->length += (size_t)n;
+}
+
+static void json_histogram(json_out_t *out, const char *name, const uint64_t *counts, int buckets) {
+    json_printf(out, ", \"%s\": [", name);
+    int first = 1;
+    for (int b = 0; b < buckets; b++) {
+        if (!counts[b]) continue;
+        json_printf(out, "%s[%llu, %llu]", first ? "" : ", ",
+                    b ? 1ull << b : 0ull, (unsigned long long)counts[b]);
+        first = 0;
+    }
+    json_printf(out, "]");
+}
+
+size_t server_format_stats(const server_stats_t *stats, char *buffer, size_t size) {
+    json_out_t out = {buffer, size, 0};
+    if (buffer && size) buffer[0] = '\0';
+    double mean = stats->batches ? (double)stats->rows / (double)stats->batches : 0.0;
+    json_printf(&out, "{\"requests\": %llu, \"rows\": %llu, \"batches\": %llu, \"errors\": %llu, "
+                "\"mean_batch_rows\": %.3f, \"max_batch_rows\": %llu, \"forward_seconds\": %.6f, "
+                "\"latency_us\": {\"p50\": %.0f, \"p90\": %.0f, \"p99\": %.0f}",
+                (unsigned long long)stats->requests, (unsigned long long)stats->rows,
+                (unsigned long long)stats->batches, (unsigned long long)stats->errors, mean,
+                (unsigned long long)stats->max_batch_rows, stats->forward_seconds,
+                server_latency_percentile(stats, 50.0), server_latency_percentile(stats, 90.0),
+                server_latency_percentile(stats, 99.0));
+    /* Each histogram entry is [lower edge, count]. */
+    json_histogram(&out, "latency_histogram_us", stats->latency, SERVER_LATENCY_BUCKETS);
+    json_histogram(&out, "batch_rows_histogram", stats->batch_rows, SERVER_BATCH_BUCKETS);
+    json_printf(&out, "}");
+    return out.length;
+}
+
+int server_connect(const char *socket_path) {
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int server_infer(int fd, uint32_t id, const float *input, size_t rows, size_t cols,
+                 float *output, size_t out_cols) {
+    server_frame_t frame = {SERVER_REQUEST, id, (uint32_t)rows, (uint32_t)cols};
+    if (!send_frame(fd, &frame, input, rows * cols * sizeof(float))) return 0;
+    if (!read_full(fd, &frame, sizeof(frame))) return 0;
+    if (frame.magic != SERVER_RESPONSE || frame.id != id || frame.rows != rows || frame.cols != out_cols) {
+        return 0;
+    }
+    return read_full(fd, output, rows * out_cols * sizeof(float));
+}
+
+int server_query_stats(int fd, char *buffer, size_t size) {
+    server_frame_t frame = {SERVER_STATS, 0, 0, 0};
+    if (!send_frame(fd, &frame, NULL, 0)) return 0;
+    if (!read_full(fd, &frame, sizeof(frame)) || frame.magic != SERVER_STATS) return 0;
+
+    /* Too long: drain it so the connection stays usable. */
+    if (frame.rows >= size) {
+        char discard[256];
+        for (size_t left = frame.rows; left; ) {
+            size_t n = left < sizeof(discard) ? left : sizeof(discard);
+            if (!read_full(fd, discard, n)) break;
+            left -= n;
+        }
+        return 0;
+    }
+    if (!read_full(fd, buffer, frame.rows)) return 0;
+    buffer[frame.rows] = '\0';
+    return 1;
+}
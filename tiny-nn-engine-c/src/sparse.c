@@ -0,0 +1,330 @@
+#define _POSIX_C_SOURCE 200112L
+#include "sparse.h"
+#include "threadpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+sparse_tensor_t* sparse_create(size_t rows, size_t cols, size_t capacity) {
+    if (cols > UINT32_MAX) {
+        fprintf(stderr, "Sparse tensor of %zu columns does not fit 32-bit indices\n", cols);
+        return NULL;
+    }
+    sparse_tensor_t *sparse = (sparse_tensor_t*)malloc(sizeof(sparse_tensor_t));
+    if (!sparse) {
+        fprintf(stderr, "Failed to allocate sparse tensor structure\n");
+        return NULL;
+    }
+
+    sparse->row_ptr = (size_t*)calloc(rows + 1, sizeof(size_t));
+    sparse->col_idx = (uint32_t*)malloc((capacity ? capacity : 1) * sizeof(uint32_t));
+    sparse->values = (float*)malloc((capacity ? capacity : 1) * sizeof(float));
+    sparse->rows = rows;
+    sparse->cols = cols;
+    sparse->capacity = capacity;
+    sparse->owns_data = 1;
+    if (!sparse->row_ptr || !sparse->col_idx || !sparse->values) {
+        fprintf(stderr, "Failed to allocate sparse tensor data\n");
+        sparse_destroy(sparse);
+        return NULL;
+    }
+    return sparse;
+}
+
+void sparse_destroy(sparse_tensor_t *sparse) {
+    if (!sparse) return;
+    if (sparse->owns_data) {
+        free(sparse->row_ptr);
+        free(sparse->col_idx);
+        free(sparse->values);
+    }
+    free(sparse);
+}
+
+sparse_tensor_t* sparse_from_dense(const tensor_t *dense) {
+    size_t nnz = 0;
+    for (size_t i = 0; i < dense->rows; i++) {
+        const float *row = dense->data + i * dense->stride;
+        for (size_t j = 0; j < dense->cols; j++) nnz += row[j] != 0.0f;
+    }
+
+    sparse_tensor_t *sparse = sparse_create(dense->rows, dense->cols, nnz);
+    if (!sparse) return NULL;
+    size_t k = 0;
+    for (size_t i = 0; i < dense->rows; i++) {
+        const float *row = dense->data + i * dense->stride;
+        for (size_t j = 0; j < dense->cols; j++) {
+            if (row[j] == 0.0f) continue;
+            sparse->col_idx[k] = (uint32_t)j;
+            sparse->values[k++] = row[j];
+        }
+        sparse->row_ptr[i + 1] = k;
+    }
+    return sparse;
+}
+
+void sparse_to_dense(const sparse_tensor_t *sparse, tensor_t *dense) {
+    if (dense->rows != sparse->rows || dense->cols != sparse->cols) {
+        fprintf(stderr, "Invalid dimensions for sparse to dense copy\n");
+        return;
+    }
+    for (size_t i = 0; i < sparse->rows; i++) {
+        float *row = dense->data + i * dense->stride;
+        memset(row, 0, dense->cols * sizeof(float));
+        for (size_t k = sparse->row_ptr[i]; k < sparse->row_ptr[i + 1]; k++) {
+            row[sparse->col_idx[k]] = sparse->values[k];
+        }
+    }
+}
+
+sparse_tensor_t sparse_rows(const sparse_tensor_t *sparse, size_t row, size_t rows) {
+    sparse_tensor_t view = {NULL, sparse->col_idx, sparse->values, 0, sparse->cols, sparse->capacity, 0};
+    if (row + rows > sparse->rows) {
+        fprintf(stderr, "Sparse row range out of range\n");
+        return view;
+    }
+    view.row_ptr = sparse->row_ptr + row;
+    view.rows = rows;
+    return view;
+}
+
+size_t sparse_nnz(const sparse_tensor_t *sparse) {
+    return sparse->row_ptr ? sparse->row_ptr[sparse->rows] - sparse->row_ptr[0] : 0;
+}
+
+/* Appends one nonzero, doubling the arrays when they are full. */
+static int sparse_push(sparse_tensor_t *sparse, size_t k, uint32_t col, float value) {
+    if (k == sparse->capacity) {
+        size_t capacity = sparse->capacity ? 2 * sparse->capacity : 1024;
+        uint32_t *col_idx = (uint32_t*)realloc(sparse->col_idx, capacity * sizeof(uint32_t));
+        if (col_idx) sparse->col_idx = col_idx;
+        float *values = (float*)realloc(sparse->values, capacity * sizeof(float));
+        if (values) sparse->values = values;
+        if (!col_idx || !values) return 0;
+        sparse->capacity = capacity;
+    }
+    sparse->col_idx[k] = col;
+    sparse->values[k] = value;
+    return 1;
+}
+
+sparse_tensor_t* sparse_load_libsvm(const char *path, size_t num_features, tensor_t **targets) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return NULL;
+    }
+
+    /* One pass sizes the rows and targets, a second fills them. */
+    size_t rows = 0;
+    int c, blank = 1;
+    while ((c = fgetc(file)) != EOF) {
+        if (c == '\n') {
+            rows += !blank;
+            blank = 1;
+        } else if (c != ' ' && c != '\t' && c != '\r') {
+            blank = 0;
+        }
+    }
+    rows += !blank;
+    rewind(file);
+
+    sparse_tensor_t *sparse = sparse_create(rows, 0, 0);
+    tensor_t *labels = tensor_create(rows, 1);
+    char *line = NULL;
+    size_t line_cap = 0, row = 0, k = 0, max_col = 0;
+    int ok = sparse && labels;
+
+    while (ok && row < rows) {
+        /* getline is POSIX 2008; read the line in growing chunks instead. */
+        size_t length = 0;
+        while ((c = fgetc(file)) != EOF && c != '\n') {
+            if (length + 1 >= line_cap) {
+                size_t cap = line_cap ? 2 * line_cap : 256;
+                char *grown = (char*)realloc(line, cap);
+                if (!grown) {
+                    ok = 0;
+                    break;
+                }
+                line = grown;
+                line_cap = cap;
+            }
+            line[length++] = (char)c;
+        }
+        if (!ok) break;
+        if (length == 0 && c == EOF) break;
+        if (!line) continue;
+        line[length] = '\0';
+
+        char *p = line, *end;
+        while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+        if (*p == '\0') continue;
+
+        labels->data[row] = strtof(p, &end);
+        if (end == p) {
+            fprintf(stderr, "%s: sample %zu has no target\n", path, row + 1);
+            ok = 0;
+            break;
+        }
+        p = end;
+
+        size_t previous = 0;
+        for (;;) {
+            while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+            if (*p == '\0' || *p == '#') break;
+            unsigned long index = strtoul(p, &end, 10);
+            if (end == p || *end != ':' || index == 0 || index <= previous ||
+                (num_features && index > num_features) || index > UINT32_MAX) {
+                fprintf(stderr, "%s: bad feature index in sample %zu\n", path, row + 1);
+                ok = 0;
+                break;
+            }
+            p = end + 1;
+            float value = strtof(p, &end);
+            if (end == p) {
+                fprintf(stderr, "%s: bad feature value in sample %zu\n", path, row + 1);
+                ok = 0;
+                break;
+            }
+            p = end;
+            previous = index;
+            if (value == 0.0f) continue;
+            if (!sparse_push(sparse, k, (uint32_t)(index - 1), value)) {
+                fprintf(stderr, "Failed to grow sparse tensor\n");
+                ok = 0;
+                break;
+            }
+            k++;
+            if (index > max_col) max_col = index;
+        }
+        sparse->row_ptr[++row] = k;
+    }
+
+    free(line);
+    fclose(file);
+    if (!ok) {
+        sparse_destroy(sparse);
+        tensor_destroy(labels);
+        return NULL;
+    }
+    sparse->cols = num_features ? num_features : max_col;
+    *targets = labels;
+    return sparse;
+}
+
+/* Rows gathered by column index are scattered over the dense operand, so
+ * the row a few nonzeros ahead is fetched while the current one is used. */
+#define SPARSE_PREFETCH 4
+
+static inline void prefetch_row(const float *row, size_t n) {
+    for (size_t j = 0; j < n; j += 64 / sizeof(float)) __builtin_prefetch(row + j);
+}
+
+typedef struct {
+    const sparse_tensor_t *a;
+    const tensor_t *b;
+    tensor_t *result;
+    const gemm_epilogue_t *epilogue;
+} sparse_matmul_job_t;
+
+static void sparse_matmul_task(void *arg, size_t begin, size_t end) {
+    const sparse_matmul_job_t *job = (const sparse_matmul_job_t*)arg;
+    const sparse_tensor_t *a = job->a;
+    const gemm_epilogue_t *ep = job->epilogue;
+    size_t n = job->b->cols;
+
+    for (size_t i = begin; i < end; i++) {
+        float *out = job->result->data + i * job->result->stride;
+        if (ep && ep->bias) memcpy(out, ep->bias, n * sizeof(float));
+        else memset(out, 0, n * sizeof(float));
+
+        for (size_t k = a->row_ptr[i]; k < a->row_ptr[i + 1]; k++) {
+            const float *b_row = job->b->data + (size_t)a->col_idx[k] * job->b->stride;
+            float value = a->values[k];
+            if (k + SPARSE_PREFETCH < a->row_ptr[a->rows]) {
+                prefetch_row(job->b->data + (size_t)a->col_idx[k + SPARSE_PREFETCH] * job->b->stride, n);
+            }
+            for (size_t j = 0; j < n; j++) out[j] += value * b_row[j];
+        }
+
+        if (!ep) continue;
+        if (ep->activation == GEMM_ACT_RELU) {
+            for (size_t j = 0; j < n; j++) out[j] = fmaxf(0.0f, out[j]);
+        } else if (ep->activation == GEMM_ACT_SIGMOID) {
+            for (size_t j = 0; j < n; j++) out[j] = 1.0f / (1.0f + expf(-out[j]));
+        }
+    }
+}
+
+void sparse_matmul_fused(const sparse_tensor_t *a, const tensor_t *b, tensor_t *result,
+                         const gemm_epilogue_t *epilogue) {
+    if (a->cols != b->rows || result->rows != a->rows || result->cols != b->cols) {
+        fprintf(stderr, "Invalid dimensions for sparse matrix multiplication\n");
+        return;
+    }
+    sparse_matmul_job_t job = {a, b, result, epilogue};
+    size_t per_row = (sparse_nnz(a) / (a->rows ? a->rows : 1) + 1) * (b->cols ? b->cols : 1);
+    threadpool_parallel_for(a->rows, per_row >= THREADPOOL_GRAIN ? 1 : THREADPOOL_GRAIN / per_row,
+                            sparse_matmul_task, &job);
+}
+
+void sparse_matmul_into(const sparse_tensor_t *a, const tensor_t *b, tensor_t *result) {
+    sparse_matmul_fused(a, b, result, NULL);
+}
+
+size_t sparse_columns(const sparse_tensor_t *a, uint32_t *columns, unsigned char *marks) {
+    size_t count = 0;
+    for (size_t k = a->row_ptr[0]; k < a->row_ptr[a->rows]; k++) {
+        uint32_t col = a->col_idx[k];
+        if (marks[col]) continue;
+        marks[col] = 1;
+        columns[count++] = col;
+    }
+    for (size_t i = 0; i < count; i++) marks[columns[i]] = 0;
+    return count;
+}
+
+typedef struct {
+    const sparse_tensor_t *a;
+    const tensor_t *b;
+    tensor_t *result;
+    const uint32_t *columns;
+    size_t count;
+} sparse_tn_job_t;
+
+/* Split by output column, so every entry sums its nonzeros in the same
+ * order whatever the thread count. */
+static void sparse_matmul_tn_task(void *arg, size_t begin, size_t end) {
+    const sparse_tn_job_t *job = (const sparse_tn_job_t*)arg;
+    const sparse_tensor_t *a = job->a;
+
+    for (size_t c = 0; c < job->count; c++) {
+        float *out = job->result->data + (size_t)job->columns[c] * job->result->stride;
+        for (size_t j = begin; j < end; j++) out[j] = 0.0f;
+    }
+    for (size_t i = 0; i < a->rows; i++) {
+        const float *b_row = job->b->data + i * job->b->stride;
+        for (size_t k = a->row_ptr[i]; k < a->row_ptr[i + 1]; k++) {
+            float *out = job->result->data + (size_t)a->col_idx[k] * job->result->stride;
+            float value = a->values[k];
+            if (k + SPARSE_PREFETCH < a->row_ptr[a->rows]) {
+                prefetch_row(job->result->data + (size_t)a->col_idx[k + SPARSE_PREFETCH] * job->result->stride
+                             + begin, end - begin);
+            }
+            for (size_t j = begin; j < end; j++) out[j] += value * b_row[j];
+        }
+    }
+}
+
+void sparse_matmul_tn_rows(const sparse_tensor_t *a, const tensor_t *b, tensor_t *result,
+                           const uint32_t *columns, size_t count) {
+    if (a->rows != b->rows || result->rows != a->cols || result->cols != b->cols) {
+        fprintf(stderr, "Invalid dimensions for sparse transposed multiplication\n");
+        return;
+    }
+    sparse_tn_job_t job = {a, b, result, columns, count};
+    size_t per_col = sparse_nnz(a) + count + 1;
+    threadpool_parallel_for(b->cols, per_col >= THREADPOOL_GRAIN ? 1 : THREADPOOL_GRAIN / per_col,
+                            sparse_matmul_tn_task, &job);
+}
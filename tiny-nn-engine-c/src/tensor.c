@@ -1,58 +1,218 @@
+#define _POSIX_C_SOURCE 200112L
 #include "tensor.h"
+#include "gemm.h"
+#include "threadpool.h"
+#include "profile.h"
+#include "rng.h"
+#include "allocator.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
-#include <time.h>
 
 tensor_t* tensor_create(size_t rows, size_t cols) {
+    PROFILE_BEGIN(mark);
     tensor_t *tensor = (tensor_t*)malloc(sizeof(tensor_t));
     if (!tensor) {
         fprintf(stderr, "Failed to allocate tensor structure\n");
         return NULL;
     }
     
+    size_t bytes = rows * cols * sizeof(float);
+    void *mem = allocator_alloc(allocator_tensor(), bytes);
+    if (!mem) {
+        fprintf(stderr, "Failed to allocate tensor data\n");
+        free(tensor);
+        return NULL;
+    }
+    
+    tensor->data = (float*)mem;
     tensor->rows = rows;
     tensor->cols = cols;
-    tensor->data = (float*)calloc(rows * cols, sizeof(float));
+    tensor->stride = cols;
+    tensor->owns_data = 1;
+    PROFILE_ALLOC(PROFILE_TENSOR_CREATE, sizeof(tensor_t) + bytes);
+    PROFILE_END(PROFILE_TENSOR_CREATE, mark, 0, bytes);
+    return tensor;
+}
+
+tensor_t* tensor_wrap(float *data, size_t rows, size_t cols) {
+    return tensor_wrap_strided(data, rows, cols, cols);
+}
+
+tensor_t* tensor_wrap_strided(float *data, size_t rows, size_t cols, size_t stride) {
+    if (stride < cols) {
+        fprintf(stderr, "Tensor stride %zu is narrower than %zu columns\n", stride, cols);
+        return NULL;
+    }
     
-    if (!tensor->data) {
-        fprintf(stderr, "Failed to allocate tensor data\n");
-        free(tensor);
+    tensor_t *tensor = (tensor_t*)malloc(sizeof(tensor_t));
+    if (!tensor) {
+        fprintf(stderr, "Failed to allocate tensor structure\n");
         return NULL;
     }
     
+    *tensor = tensor_view(data, rows, cols, stride);
     return tensor;
 }
 
+tensor_t tensor_view(float *data, size_t rows, size_t cols, size_t stride) {
+    tensor_t view = {data, rows, cols, stride, 0};
+    return view;
+}
+
+tensor_t tensor_block(const tensor_t *tensor, size_t row, size_t rows, size_t col, size_t cols) {
+    if (row + rows > tensor->rows || col + cols > tensor->cols) {
+        fprintf(stderr, "Tensor block out of range\n");
+        return tensor_view(NULL, 0, 0, 0);
+    }
+    return tensor_view(tensor->data + row * tensor->stride + col, rows, cols, tensor->stride);
+}
+
+tensor_t tensor_rows(const tensor_t *tensor, size_t row, size_t rows) {
+    return tensor_block(tensor, row, rows, 0, tensor->cols);
+}
+
+int tensor_is_contiguous(const tensor_t *tensor) {
+    return tensor->stride == tensor->cols || tensor->rows <= 1;
+}
+
 void tensor_destroy(tensor_t *tensor) {
     if (tensor) {
-        if (tensor->data) {
-            free(tensor->data);
+        if (tensor->data && tensor->owns_data) {
+            allocator_free(tensor->data);
         }
         free(tensor);
     }
 }
 
-void tensor_fill(tensor_t *tensor, float value) {
-    for (size_t i = 0; i < tensor->rows * tensor->cols; i++) {
-        tensor->data[i] = value;
+typedef enum {
+    ELEMENTWISE_FILL,
+    ELEMENTWISE_ADD,
+    ELEMENTWISE_SUBTRACT,
+    ELEMENTWISE_MULTIPLY,
+    ELEMENTWISE_SCALE,
+    ELEMENTWISE_RELU,
+    ELEMENTWISE_RELU_DERIVATIVE,
+    ELEMENTWISE_SIGMOID,
+    ELEMENTWISE_SIGMOID_DERIVATIVE,
+    ELEMENTWISE_EXP,
+    ELEMENTWISE_LOG,
+    ELEMENTWISE_TANH
+} elementwise_op_t;
+
+/* Operands are walked as rows of cols floats at their own strides. When every
+ * operand is contiguous the whole tensor is a single row. */
+typedef struct {
+    elementwise_op_t op;
+    const float *a;
+    const float *b;
+    float *out;
+    size_t lda, ldb, ldo;
+    size_t cols;
+    float scalar;
+    math_mode_t mode;       /* for the transcendentals */
+} elementwise_job_t;
+
+static void elementwise_span(elementwise_op_t op, const float *a, const float *b,
+                             float *out, float scalar, math_mode_t mode, size_t n) {
+    switch (op) {
+        case ELEMENTWISE_FILL:
+            for (size_t i = 0; i < n; i++) out[i] = scalar;
+            break;
+        case ELEMENTWISE_ADD:
+            for (size_t i = 0; i < n; i++) out[i] = a[i] + b[i];
+            break;
+        case ELEMENTWISE_SUBTRACT:
+            for (size_t i = 0; i < n; i++) out[i] = a[i] - b[i];
+            break;
+        case ELEMENTWISE_MULTIPLY:
+            for (size_t i = 0; i < n; i++) out[i] = a[i] * b[i];
+            break;
+        case ELEMENTWISE_SCALE:
+            for (size_t i = 0; i < n; i++) out[i] = a[i] * scalar;
+            break;
+        case ELEMENTWISE_RELU:
+            for (size_t i = 0; i < n; i++) out[i] = fmaxf(0.0f, a[i]);
+            break;
+        case ELEMENTWISE_RELU_DERIVATIVE:
+            for (size_t i = 0; i < n; i++) out[i] = a[i] > 0.0f ? 1.0f : 0.0f;
+            break;
+        case ELEMENTWISE_SIGMOID:
+            math_sigmoid(out, a, n, mode);
+            break;
+        case ELEMENTWISE_SIGMOID_DERIVATIVE:
+            for (size_t i = 0; i < n; i++) out[i] = a[i] * (1.0f - a[i]);
+            break;
+        case ELEMENTWISE_EXP:
+            math_exp(out, a, n, mode);
+            break;
+        case ELEMENTWISE_LOG:
+            math_log(out, a, n, mode);
+            break;
+        case ELEMENTWISE_TANH:
+            math_tanh(out, a, n, mode);
+            break;
     }
 }
 
-void tensor_random(tensor_t *tensor, float min, float max) {
-    static int seeded = 0;
-    if (!seeded) {
-        srand(time(NULL));
-        seeded = 1;
-    }
+static void elementwise_task(void *arg, size_t begin, size_t end) {
+    const elementwise_job_t *job = (const elementwise_job_t*)arg;
     
-    for (size_t i = 0; i < tensor->rows * tensor->cols; i++) {
-        float random = (float)rand() / RAND_MAX;
-        tensor->data[i] = min + random * (max - min);
+    while (begin < end) {
+        size_t row = begin / job->cols, col = begin % job->cols;
+        size_t n = job->cols - col < end - begin ? job->cols - col : end - begin;
+        elementwise_span(job->op,
+                         job->a ? job->a + row * job->lda + col : NULL,
+                         job->b ? job->b + row * job->ldb + col : NULL,
+                         job->out + row * job->ldo + col, job->scalar, job->mode, n);
+        begin += n;
     }
 }
 
+#ifdef TINY_NN_PROFILE
+static const profile_op_t elementwise_profile[] = {
+    PROFILE_TENSOR_FILL, PROFILE_TENSOR_ADD, PROFILE_TENSOR_SUBTRACT, PROFILE_TENSOR_MULTIPLY,
+    PROFILE_TENSOR_SCALE, PROFILE_TENSOR_RELU, PROFILE_TENSOR_RELU_DERIVATIVE, PROFILE_TENSOR_SIGMOID,
+    PROFILE_TENSOR_SIGMOID_DERIVATIVE, PROFILE_TENSOR_EXP, PROFILE_TENSOR_LOG, PROFILE_TENSOR_TANH
+};
+#endif
+
+/* a and b may be NULL for operations that do not read them; the shape is out's. */
+static void elementwise(elementwise_op_t op, const tensor_t *a, const tensor_t *b,
+                        tensor_t *out, float scalar, math_mode_t mode) {
+    PROFILE_BEGIN(mark);
+    int contiguous = tensor_is_contiguous(out) && (!a || tensor_is_contiguous(a)) &&
+                     (!b || tensor_is_contiguous(b));
+    size_t n = out->rows * out->cols;
+    if (n == 0) return;
+    
+    elementwise_job_t job = {op, a ? a->data : NULL, b ? b->data : NULL, out->data,
+                             a ? a->stride : 0, b ? b->stride : 0, out->stride,
+                             contiguous ? n : out->cols, scalar, mode};
+    threadpool_parallel_for(n, THREADPOOL_GRAIN, elementwise_task, &job);
+    PROFILE_END(elementwise_profile[op], mark, op == ELEMENTWISE_FILL ? 0 : n,
+                n * sizeof(float) * (1 + (a != NULL) + (b != NULL)));
+}
+
+void tensor_fill(tensor_t *tensor, float value) {
+    elementwise(ELEMENTWISE_FILL, NULL, NULL, tensor, value, MATH_PRECISE);
+}
+
+void tensor_random(tensor_t *tensor, float min, float max) {
+    PROFILE_BEGIN(mark);
+    rng_fill_uniform(tensor, min, max, rng_seed(), rng_next_stream());
+    PROFILE_END(PROFILE_TENSOR_RANDOM, mark, 2 * tensor->rows * tensor->cols,
+                tensor->rows * tensor->cols * sizeof(float));
+}
+
+void tensor_random_normal(tensor_t *tensor, float mean, float stddev) {
+    PROFILE_BEGIN(mark);
+    rng_fill_normal(tensor, mean, stddev, rng_seed(), rng_next_stream());
+    PROFILE_END(PROFILE_TENSOR_RANDOM_NORMAL, mark, 16 * tensor->rows * tensor->cols,
+                tensor->rows * tensor->cols * sizeof(float));
+}
+
 void tensor_zeros(tensor_t *tensor) {
     tensor_fill(tensor, 0.0f);
 }
@@ -65,17 +225,18 @@ void tensor_print(const tensor_t *tensor, const char *name) {
     printf("%s (%zu x %zu):\n", name, tensor->rows, tensor->cols);
     for (size_t i = 0; i < tensor->rows; i++) {
         for (size_t j = 0; j < tensor->cols; j++) {
-            printf("%8.4f ", tensor->data[i * tensor->cols + j]);
+            printf("%8.4f ", tensor->data[i * tensor->stride + j]);
         }
         printf("\n");
     }
     printf("\n");
 }
 
+/* A copy of a view is a new contiguous tensor. */
 tensor_t* tensor_copy(const tensor_t *src) {
     tensor_t *dst = tensor_create(src->rows, src->cols);
     if (dst) {
-        memcpy(dst->data, src->data, src->rows * src->cols * sizeof(float));
+        tensor_copy_data(dst, src);
     }
     return dst;
 }
@@ -85,46 +246,94 @@ void tensor_copy_data(tensor_t *dst, const tensor_t *src) {
         fprintf(stderr, "Tensor dimensions don't match for copy\n");
         return;
     }
-    memcpy(dst->data, src->data, src->rows * src->cols * sizeof(float));
+    PROFILE_BEGIN(mark);
+    if (tensor_is_contiguous(dst) && tensor_is_contiguous(src)) {
+        memcpy(dst->data, src->data, src->rows * src->cols * sizeof(float));
+    } else {
+        for (size_t i = 0; i < src->rows; i++) {
+            memcpy(dst->data + i * dst->stride, src->data + i * src->stride, src->cols * sizeof(float));
+        }
+    }
+    PROFILE_END(PROFILE_TENSOR_COPY_DATA, mark, 0, 2 * src->rows * src->cols * sizeof(float));
 }
 
 void tensor_add(const tensor_t *a, const tensor_t *b, tensor_t *result) {
-    if (a->rows != b->rows || a->cols != b->cols) {
+    if (a->rows != b->rows || a->cols != b->cols ||
+        result->rows != a->rows || result->cols != a->cols) {
         fprintf(stderr, "Tensor dimensions don't match for addition\n");
         return;
     }
     
-    for (size_t i = 0; i < a->rows * a->cols; i++) {
-        result->data[i] = a->data[i] + b->data[i];
-    }
+    elementwise(ELEMENTWISE_ADD, a, b, result, 0.0f, MATH_PRECISE);
 }
 
 void tensor_subtract(const tensor_t *a, const tensor_t *b, tensor_t *result) {
-    if (a->rows != b->rows || a->cols != b->cols) {
+    if (a->rows != b->rows || a->cols != b->cols ||
+        result->rows != a->rows || result->cols != a->cols) {
         fprintf(stderr, "Tensor dimensions don't match for subtraction\n");
         return;
     }
     
-    for (size_t i = 0; i < a->rows * a->cols; i++) {
-        result->data[i] = a->data[i] - b->data[i];
-    }
+    elementwise(ELEMENTWISE_SUBTRACT, a, b, result, 0.0f, MATH_PRECISE);
 }
 
 void tensor_multiply(const tensor_t *a, const tensor_t *b, tensor_t *result) {
-    if (a->rows != b->rows || a->cols != b->cols) {
+    if (a->rows != b->rows || a->cols != b->cols ||
+        result->rows != a->rows || result->cols != a->cols) {
         fprintf(stderr, "Tensor dimensions don't match for multiplication\n");
         return;
     }
     
-    for (size_t i = 0; i < a->rows * a->cols; i++) {
-        result->data[i] = a->data[i] * b->data[i];
-    }
+    elementwise(ELEMENTWISE_MULTIPLY, a, b, result, 0.0f, MATH_PRECISE);
 }
 
 void tensor_scale(tensor_t *tensor, float scalar) {
-    for (size_t i = 0; i < tensor->rows * tensor->cols; i++) {
-        tensor->data[i] *= scalar;
+    elementwise(ELEMENTWISE_SCALE, tensor, NULL, tensor, scalar, MATH_PRECISE);
+}
+
+void tensor_matmul_into(const tensor_t *a, const tensor_t *b, tensor_t *result) {
+    if (a->cols != b->rows || result->rows != a->rows || result->cols != b->cols) {
+        fprintf(stderr, "Invalid dimensions for matrix multiplication\n");
+        return;
+    }
+    
+    PROFILE_BEGIN(mark);
+    gemm_sgemm(GEMM_NO_TRANS, GEMM_NO_TRANS, a->rows, b->cols, a->cols,
+               1.0f, a->data, a->stride,
+               b->data, b->stride,
+               0.0f, result->data, result->stride);
+    PROFILE_END(PROFILE_TENSOR_MATMUL, mark, 2.0 * a->rows * a->cols * (double)result->cols,
+                (a->rows * a->cols + b->rows * b->cols + result->rows * result->cols) * sizeof(float));
+}
+
+void tensor_matmul_tn_into(const tensor_t *a, const tensor_t *b, tensor_t *result) {
+    if (a->rows != b->rows || result->rows != a->cols || result->cols != b->cols) {
+        fprintf(stderr, "Invalid dimensions for transposed matrix multiplication\n");
+        return;
+    }
+    
+    PROFILE_BEGIN(mark);
+    gemm_sgemm(GEMM_TRANS, GEMM_NO_TRANS, a->cols, b->cols, a->rows,
+               1.0f, a->data, a->stride,
+               b->data, b->stride,
+               0.0f, result->data, result->stride);
+    PROFILE_END(PROFILE_TENSOR_MATMUL_TN, mark, 2.0 * a->rows * a->cols * (double)result->cols,
+                (a->rows * a->cols + b->rows * b->cols + result->rows * result->cols) * sizeof(float));
+}
+
+void tensor_matmul_nt_into(const tensor_t *a, const tensor_t *b, tensor_t *result) {
+    if (a->cols != b->cols || result->rows != a->rows || result->cols != b->rows) {
+        fprintf(stderr, "Invalid dimensions for transposed matrix multiplication\n");
+        return;
     }
+    
+    PROFILE_BEGIN(mark);
+    gemm_sgemm(GEMM_NO_TRANS, GEMM_TRANS, a->rows, b->rows, a->cols,
+               1.0f, a->data, a->stride,
+               b->data, b->stride,
+               0.0f, result->data, result->stride);
+    PROFILE_END(PROFILE_TENSOR_MATMUL_NT, mark, 2.0 * a->rows * a->cols * (double)result->cols,
+                (a->rows * a->cols + b->rows * b->cols + result->rows * result->cols) * sizeof(float));
 }
 
 tensor_t* tensor_matmul(const tensor_t *a, const tensor_t *b) {
@@ -136,53 +345,94 @@ tensor_t* tensor_matmul(const tensor_t *a, const tensor_t *b) {
     tensor_t *result = tensor_create(a->rows, b->cols);
     if (!result) return NULL;
     
-    for (size_t i = 0; i < a->rows; i++) {
-        for (size_t j = 0; j < b->cols; j++) {
-            float sum = 0.0f;
-            for (size_t k = 0; k < a->cols; k++) {
-                sum += a->data[i * a->cols + k] * b->data[k * b->cols + j];
-            }
-            result->data[i * result->cols + j] = sum;
-        }
+    tensor_matmul_into(a, b, result);
+    return result;
+}
+
+tensor_t* tensor_matmul_tn(const tensor_t *a, const tensor_t *b) {
+    if (a->rows != b->rows) {
+        fprintf(stderr, "Invalid dimensions for transposed matrix multiplication\n");
+        return NULL;
     }
     
+    tensor_t *result = tensor_create(a->cols, b->cols);
+    if (!result) return NULL;
+    
+    tensor_matmul_tn_into(a, b, result);
+    return result;
+}
+
+tensor_t* tensor_matmul_nt(const tensor_t *a, const tensor_t *b) {
+    if (a->cols != b->cols) {
+        fprintf(stderr, "Invalid dimensions for transposed matrix multiplication\n");
+        return NULL;
+    }
+    
+    tensor_t *result = tensor_create(a->rows, b->rows);
+    if (!result) return NULL;
+    
+    tensor_matmul_nt_into(a, b, result);
     return result;
 }
 
 tensor_t* tensor_transpose(const tensor_t *tensor) {
+    PROFILE_BEGIN(mark);
     tensor_t *result = tensor_create(tensor->cols, tensor->rows);
     if (!result) return NULL;
     
     for (size_t i = 0; i < tensor->rows; i++) {
         for (size_t j = 0; j < tensor->cols; j++) {
-            result->data[j * result->cols + i] = tensor->data[i * tensor->cols + j];
+            result->data[j * result->stride + i] = tensor->data[i * tensor->stride + j];
         }
     }
     
+    PROFILE_END(PROFILE_TENSOR_TRANSPOSE, mark, 0, 2 * tensor->rows * tensor->cols * sizeof(float));
     return result;
 }
 
-void tensor_relu(const tensor_t *input, tensor_t *output) {
-    for (size_t i = 0; i < input->rows * input->cols; i++) {
-        output->data[i] = fmaxf(0.0f, input->data[i]);
+static int same_shape(const tensor_t *input, const tensor_t *output) {
+    if (input->rows != output->rows || input->cols != output->cols) {
+        fprintf(stderr, "Tensor dimensions don't match for activation\n");
+        return 0;
     }
+    return 1;
+}
+
+void tensor_relu(const tensor_t *input, tensor_t *output) {
+    if (!same_shape(input, output)) return;
+    elementwise(ELEMENTWISE_RELU, input, NULL, output, 0.0f, MATH_PRECISE);
 }
 
 void tensor_relu_derivative(const tensor_t *input, tensor_t *output) {
-    for (size_t i = 0; i < input->rows * input->cols; i++) {
-        output->data[i] = input->data[i] > 0.0f ? 1.0f : 0.0f;
-    }
+    if (!same_shape(input, output)) return;
+    elementwise(ELEMENTWISE_RELU_DERIVATIVE, input, NULL, output, 0.0f, MATH_PRECISE);
 }
 
 void tensor_sigmoid(const tensor_t *input, tensor_t *output) {
-    for (size_t i = 0; i < input->rows * input->cols; i++) {
-        output->data[i] = 1.0f / (1.0f + expf(-input->data[i]));
-    }
+    tensor_sigmoid_mode(input, output, MATH_PRECISE);
+}
+
+void tensor_sigmoid_mode(const tensor_t *input, tensor_t *output, math_mode_t mode) {
+    if (!same_shape(input, output)) return;
+    elementwise(ELEMENTWISE_SIGMOID, input, NULL, output, 0.0f, mode);
 }
 
 void tensor_sigmoid_derivative(const tensor_t *input, tensor_t *output) {
-    for (size_t i = 0; i < input->rows * input->cols; i++) {
-        float s = input->data[i];
-        output->data[i] = s * (1.0f - s);
-    }
+    if (!same_shape(input, output)) return;
+    elementwise(ELEMENTWISE_SIGMOID_DERIVATIVE, input, NULL, output, 0.0f, MATH_PRECISE);
+}
+
+void tensor_tanh(const tensor_t *input, tensor_t *output, math_mode_t mode) {
+    if (!same_shape(input, output)) return;
+    elementwise(ELEMENTWISE_TANH, input, NULL, output, 0.0f, mode);
+}
+
+void tensor_exp(const tensor_t *input, tensor_t *output, math_mode_t mode) {
+    if (!same_shape(input, output)) return;
+    elementwise(ELEMENTWISE_EXP, input, NULL, output, 0.0f, mode);
+}
+
+void tensor_log(const tensor_t *input, tensor_t *output, math_mode_t mode) {
+    if (!same_shape(input, output)) return;
+    elementwise(ELEMENTWISE_LOG, input, NULL, output, 0.0f, mode);
 }
\ No newline at end of file
@@ -0,0 +1,219 @@
+#define _POSIX_C_SOURCE 200809L
+#include "threadpool.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define REDUCE_MAX_BLOCKS 256
+
+typedef struct {
+    pthread_t *threads;
+    size_t num_threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    pthread_mutex_t dispatch;
+
+    threadpool_task_fn fn;
+    void *ctx;
+    size_t count;
+    size_t chunk;
+    size_t num_chunks;
+    unsigned char *claimed;     /* one flag per chunk, at most num_threads */
+    size_t active_workers;
+    unsigned long generation;
+    int stop;
+} threadpool_t;
+
+static threadpool_t pool = {
+    NULL, 1,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER,
+    NULL, NULL, 0, 0, 0, NULL, 0, 0, 0
+};
+static int pool_started = 0;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static __thread int in_pool_task = 0;
+
+static void run_chunk(size_t c) {
+    if (__atomic_exchange_n(&pool.claimed[c], 1, __ATOMIC_RELAXED)) return;
+    size_t begin = c * pool.chunk;
+    size_t end = begin + pool.chunk < pool.count ? begin + pool.chunk : pool.count;
+    pool.fn(pool.ctx, begin, end);
+}
+
+/* Participant self (0 is the dispatching thread, workers count from 1)
+ * takes chunk self first, so a given range of a sweep runs on the same
+ * thread whenever that thread is free; allocator first touch relies on
+ * this. Then it helps with whatever is left. */
+static void run_chunks(size_t self) {
+    in_pool_task = 1;
+    if (self < pool.num_chunks) run_chunk(self);
+    for (size_t c = 0; c < pool.num_chunks; c++) run_chunk(c);
+    in_pool_task = 0;
+}
+
+static void* worker_main(void *arg) {
+    size_t self = (size_t)arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (!pool.stop && pool.generation == seen) {
+            pthread_cond_wait(&pool.work_ready, &pool.lock);
+        }
+        if (pool.stop) break;
+        seen = pool.generation;
+        pthread_mutex_unlock(&pool.lock);
+
+        run_chunks(self);
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.active_workers == 0) {
+            pthread_cond_signal(&pool.work_done);
+        }
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+static size_t default_thread_count(void) {
+    const char *env = getenv("TINY_NN_THREADS");
+    if (env && atoi(env) > 0) return (size_t)atoi(env);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (size_t)cpus : 1;
+}
+
+int threadpool_init(size_t num_threads) {
+    if (num_threads == 0) num_threads = default_thread_count();
+    threadpool_shutdown();
+
+    pool.num_threads = 1;
+    pool.stop = 0;
+    pool.generation = 0;
+    pool_started = 1;
+    if (num_threads == 1) return 1;
+
+    pool.threads = (pthread_t*)malloc((num_threads - 1) * sizeof(pthread_t));
+    pool.claimed = (unsigned char*)malloc(num_threads);
+    if (!pool.threads || !pool.claimed) {
+        fprintf(stderr, "Failed to allocate thread pool\n");
+        return 0;
+    }
+
+    for (size_t i = 0; i < num_threads - 1; i++) {
+        if (pthread_create(&pool.threads[i], NULL, worker_main, (void*)(i + 1)) != 0) {
+            fprintf(stderr, "Failed to start thread pool worker\n");
+            break;
+        }
+        pool.num_threads++;
+    }
+
+    return pool.num_threads == num_threads;
+}
+
+void threadpool_shutdown(void) {
+    if (!pool_started) return;
+
+    pthread_mutex_lock(&pool.lock);
+    pool.stop = 1;
+    pthread_cond_broadcast(&pool.work_ready);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (size_t i = 0; i + 1 < pool.num_threads; i++) {
+        pthread_join(pool.threads[i], NULL);
+    }
+    free(pool.threads);
+    free(pool.claimed);
+    pool.threads = NULL;
+    pool.claimed = NULL;
+    pool.num_threads = 1;
+    pool_started = 0;
+}
+
+static void default_init(void) {
+    if (!pool_started) threadpool_init(0);
+}
+
+size_t threadpool_num_threads(void) {
+    pthread_once(&pool_once, default_init);
+    return pool.num_threads;
+}
+
+void threadpool_parallel_for(size_t count, size_t grain, threadpool_task_fn fn, void *ctx) {
+    if (count == 0) return;
+    if (grain == 0) grain = 1;
+
+    size_t threads = threadpool_num_threads();
+    if (threads == 1 || count <= grain || in_pool_task ||
+        pthread_mutex_trylock(&pool.dispatch) != 0) {
+        fn(ctx, 0, count);
+        return;
+    }
+
+    size_t num_chunks = (count + grain - 1) / grain;
+    if (num_chunks > threads) num_chunks = threads;
+    size_t chunk = (count + num_chunks - 1) / num_chunks;
+
+    pthread_mutex_lock(&pool.lock);
+    pool.fn = fn;
+    pool.ctx = ctx;
+    pool.count = count;
+    pool.chunk = chunk;
+    pool.num_chunks = (count + chunk - 1) / chunk;
+    memset(pool.claimed, 0, pool.num_chunks);
+    pool.active_workers = threads - 1;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.work_ready);
+    pthread_mutex_unlock(&pool.lock);
+
+    run_chunks(0);
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.active_workers > 0) {
+        pthread_cond_wait(&pool.work_done, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    pthread_mutex_unlock(&pool.dispatch);
+}
+
+typedef struct {
+    threadpool_reduce_fn fn;
+    void *ctx;
+    size_t count;
+    size_t block;
+    float *partials;
+} reduce_job_t;
+
+static void reduce_blocks(void *arg, size_t begin, size_t end) {
+    reduce_job_t *job = (reduce_job_t*)arg;
+    for (size_t b = begin; b < end; b++) {
+        size_t lo = b * job->block;
+        size_t hi = lo + job->block < job->count ? lo + job->block : job->count;
+        job->partials[b] = job->fn(job->ctx, lo, hi);
+    }
+}
+
+float threadpool_reduce_sum(size_t count, threadpool_reduce_fn fn, void *ctx) {
+    if (count <= THREADPOOL_GRAIN) return fn(ctx, 0, count);
+
+    float partials[REDUCE_MAX_BLOCKS];
+    size_t block = THREADPOOL_GRAIN;
+    if ((count + block - 1) / block > REDUCE_MAX_BLOCKS) {
+        block = (count + REDUCE_MAX_BLOCKS - 1) / REDUCE_MAX_BLOCKS;
+    }
+    size_t num_blocks = (count + block - 1) / block;
+
+    reduce_job_t job = {fn, ctx, count, block, partials};
+    threadpool_parallel_for(num_blocks, 1, reduce_blocks, &job);
+
+    /* Pairwise, so rounding grows with log(blocks). */
+    for (size_t width = 1; width < num_blocks; width *= 2) {
+        for (size_t b = 0; b + width < num_blocks; b += 2 * width) partials[b] += partials[b + width];
+    }
+    return partials[0];
+}
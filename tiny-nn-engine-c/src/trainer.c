@@ -0,0 +1,276 @@
+#define _POSIX_C_SOURCE 200112L
+#include "trainer.h"
+#include "threadpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Floats per cache line, and per tile the reduction tree runs over at once. */
+#define TRAINER_LINE 16
+#define TRAINER_TILE 2048
+
+trainer_t* trainer_create(network_t *network, size_t num_workers) {
+    if (!network->max_batch) {
+        fprintf(stderr, "Network must be built before training\n");
+        return NULL;
+    }
+    if (num_workers == 0) num_workers = threadpool_num_threads();
+
+    trainer_t *trainer = (trainer_t*)calloc(1, sizeof(trainer_t));
+    if (!trainer) return NULL;
+    trainer->network = network;
+    trainer->workers = (network_t**)calloc(num_workers, sizeof(network_t*));
+    trainer->losses = (float*)calloc(num_workers, sizeof(float));
+    trainer->batches = (size_t*)calloc(num_workers, sizeof(size_t));
+    trainer->sgd = (sgd_optimizer_t**)calloc(num_workers, sizeof(sgd_optimizer_t*));
+    if (!trainer->workers || !trainer->losses || !trainer->batches || !trainer->sgd) {
+        trainer_destroy(trainer);
+        return NULL;
+    }
+
+    size_t shard = (network->max_batch + num_workers - 1) / num_workers;
+    trainer->workers[0] = network;
+    trainer->num_workers = 1;
+    for (size_t w = 1; w < num_workers; w++) {
+        trainer->workers[w] = network_replicate(network, shard);
+        if (!trainer->workers[w]) {
+            trainer_destroy(trainer);
+            return NULL;
+        }
+        trainer->num_workers++;
+    }
+    return trainer;
+}
+
+void trainer_destroy(trainer_t *trainer) {
+    if (!trainer) return;
+
+    for (size_t w = 1; w < trainer->num_workers; w++) network_destroy(trainer->workers[w]);
+    for (size_t w = 0; w < trainer->num_workers && trainer->sgd; w++) sgd_destroy(trainer->sgd[w]);
+    free(trainer->workers);
+    free(trainer->losses);
+    free(trainer->batches);
+    free(trainer->sgd);
+    free(trainer);
+}
+
+/* Rows [*row, *row + *rows) of a batch go to worker w; the first
+ * batch % workers shards take one extra row. */
+static void shard_bounds(size_t batch, size_t workers, size_t w, size_t *row, size_t *rows) {
+    size_t base = batch / workers, extra = batch % workers;
+    *row = w * base + (w < extra ? w : extra);
+    *rows = base + (w < extra ? 1 : 0);
+}
+
+typedef struct {
+    trainer_t *trainer;
+    const tensor_t *input;
+    const tensor_t *targets;
+    network_loss_t loss;
+    size_t active;
+} step_job_t;
+
+static void worker_task(void *arg, size_t begin, size_t end) {
+    const step_job_t *job = (const step_job_t*)arg;
+    size_t batch = job->input->rows;
+
+    for (size_t w = begin; w < end; w++) {
+        network_t *network = job->trainer->workers[w];
+        size_t row, rows;
+        shard_bounds(batch, job->active, w, &row, &rows);
+        tensor_t x = tensor_rows(job->input, row, rows);
+        tensor_t y = tensor_rows(job->targets, row, rows);
+
+        job->trainer->losses[w] = 0.0f;
+        if (!network_forward(network, &x)) continue;
+        job->trainer->losses[w] = network_loss(network, &y, job->loss);
+        network_backward(network, NULL);
+
+        /* The loss gradient was averaged over this shard only. */
+        if (rows != batch) {
+            float weight = (float)rows / (float)batch;
+            float *grads = network->params->grads;
+            for (size_t i = 0; i < network->params->count; i++) grads[i] *= weight;
+        }
+    }
+}
+
+typedef struct {
+    network_t **workers;
+    size_t active;
+} reduce_job_t;
+
+static void reduce_task(void *arg, size_t begin, size_t end) {
+    const reduce_job_t *job = (const reduce_job_t*)arg;
+    size_t last = end * TRAINER_LINE;
+
+    for (size_t lo = begin * TRAINER_LINE; lo < last; lo += TRAINER_TILE) {
+        size_t n = last - lo < TRAINER_TILE ? last - lo : TRAINER_TILE;
+        for (size_t stride = 1; stride < job->active; stride *= 2) {
+            for (size_t w = 0; w + stride < job->active; w += 2 * stride) {
+                float *dst = job->workers[w]->params->grads + lo;
+                const float *src = job->workers[w + stride]->params->grads + lo;
+                for (size_t i = 0; i < n; i++) dst[i] += src[i];
+            }
+        }
+    }
+}
+
+/* Forward and backward over the shards, then the reduction: the network's
+ * gradient block ends up holding the gradient of the whole batch. Returns 0
+ * when the batch is unusable. */
+static int trainer_gradients(trainer_t *trainer, const tensor_t *input, const tensor_t *targets,
+                             network_loss_t loss, float *value) {
+    size_t batch = input->rows;
+    if (batch == 0 || targets->rows != batch) {
+        fprintf(stderr, "Training batch needs matching, non-empty inputs and targets\n");
+        return 0;
+    }
+    if (batch > trainer->network->max_batch) {
+        fprintf(stderr, "Batch of %zu exceeds network batch %zu\n", batch, trainer->network->max_batch);
+        return 0;
+    }
+
+    /* Small batches leave the last workers idle rather than empty. */
+    size_t active = batch < trainer->num_workers ? batch : trainer->num_workers;
+    step_job_t job = {trainer, input, targets, loss, active};
+    threadpool_parallel_for(active, 1, worker_task, &job);
+
+    /* Arena blocks are padded to whole cache lines. */
+    reduce_job_t reduce = {trainer->workers, active};
+    threadpool_parallel_for(trainer->network->params->count / TRAINER_LINE,
+                            THREADPOOL_GRAIN / TRAINER_LINE, reduce_task, &reduce);
+
+    *value = 0.0f;
+    for (size_t w = 0; w < active; w++) {
+        size_t row, rows;
+        shard_bounds(batch, active, w, &row, &rows);
+        *value += (float)rows / (float)batch * trainer->losses[w];
+    }
+    return 1;
+}
+
+float trainer_step(trainer_t *trainer, const tensor_t *input, const tensor_t *targets,
+                   network_loss_t loss, adam_optimizer_t *optimizer) {
+    float value = 0.0f;
+    if (trainer_gradients(trainer, input, targets, loss, &value)) {
+        adam_step_params(optimizer, trainer->network->params);
+    }
+    return value;
+}
+
+float trainer_step_sgd(trainer_t *trainer, const tensor_t *input, const tensor_t *targets,
+                       network_loss_t loss, sgd_optimizer_t *optimizer) {
+    float value = 0.0f;
+    if (trainer_gradients(trainer, input, targets, loss, &value)) {
+        sgd_step_params(optimizer, trainer->network->params);
+    }
+    return value;
+}
+
+typedef struct {
+    trainer_t *trainer;
+    const tensor_t *inputs;
+    const tensor_t *targets;
+    network_loss_t loss;
+    size_t batch_size;
+    size_t num_batches;
+    size_t next;                /* claimed with a relaxed fetch-add */
+} hogwild_job_t;
+
+static void hogwild_task(void *arg, size_t begin, size_t end) {
+    hogwild_job_t *job = (hogwild_job_t*)arg;
+    size_t samples = job->inputs->rows;
+
+    for (size_t w = begin; w < end; w++) {
+        network_t *network = job->trainer->workers[w];
+        float total = 0.0f;
+        size_t batches = 0;
+
+        for (;;) {
+            size_t b = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+            if (b >= job->num_batches) break;
+            size_t row = b * job->batch_size;
+            size_t rows = samples - row < job->batch_size ? samples - row : job->batch_size;
+            tensor_t x = tensor_rows(job->inputs, row, rows);
+            tensor_t y = tensor_rows(job->targets, row, rows);
+
+            if (!network_forward(network, &x)) break;
+            total += network_loss(network, &y, job->loss);
+            network_backward(network, NULL);
+            sgd_step_params(job->trainer->sgd[w], network->params);
+            batches++;
+        }
+        job->trainer->losses[w] = total;
+        job->trainer->batches[w] = batches;
+    }
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Hogwild workers step the weights under each other's forward passes, so
+ * they read the plain weights: the shared panels would need a lock and a
+ * repack after every mini-batch, and a repack would rewrite them under other
+ * workers' GEMMs. */
+static void set_packing(trainer_t *trainer, int packing) {
+    for (size_t w = 0; w < trainer->num_workers; w++) {
+        network_t *network = trainer->workers[w];
+        for (size_t i = 0; i < network->num_layers; i++) network->layers[i]->packing = packing;
+    }
+}
+
+int trainer_hogwild_epoch(trainer_t *trainer, const tensor_t *inputs, const tensor_t *targets,
+                          size_t batch_size, network_loss_t loss, const sgd_optimizer_t *settings,
+                          trainer_stats_t *stats) {
+    size_t shard = trainer->network->max_batch;
+    for (size_t w = 1; w < trainer->num_workers; w++) {
+        if (trainer->workers[w]->max_batch < shard) shard = trainer->workers[w]->max_batch;
+    }
+    if (batch_size == 0 || batch_size > shard) {
+        fprintf(stderr, "Hogwild batches must have 1 to %zu rows\n", shard);
+        return 0;
+    }
+    if (inputs->rows == 0 || targets->rows != inputs->rows) {
+        fprintf(stderr, "Training data needs matching, non-empty inputs and targets\n");
+        return 0;
+    }
+
+    /* Settings are re-read every pass so schedules can change them; momentum
+     * stays with its worker. */
+    for (size_t w = 0; w < trainer->num_workers; w++) {
+        if (!trainer->sgd[w]) {
+            trainer->sgd[w] = sgd_create_momentum(settings->learning_rate, settings->momentum,
+                                                  settings->weight_decay);
+            if (!trainer->sgd[w]) return 0;
+        }
+        trainer->sgd[w]->learning_rate = settings->learning_rate;
+        trainer->sgd[w]->momentum = settings->momentum;
+        trainer->sgd[w]->weight_decay = settings->weight_decay;
+    }
+
+    hogwild_job_t job = {trainer, inputs, targets, loss, batch_size,
+                         (inputs->rows + batch_size - 1) / batch_size, 0};
+    set_packing(trainer, 0);
+    double start = now_seconds();
+    threadpool_parallel_for(trainer->num_workers, 1, hogwild_task, &job);
+    double seconds = now_seconds() - start;
+    set_packing(trainer, 1);
+
+    size_t batches = 0;
+    float total = 0.0f;
+    for (size_t w = 0; w < trainer->num_workers; w++) {
+        batches += trainer->batches[w];
+        total += trainer->losses[w];
+    }
+    if (stats) {
+        stats->batches = batches;
+        stats->samples = inputs->rows;
+        stats->seconds = seconds;
+        stats->loss = batches ? total / (float)batches : 0.0f;
+    }
+    return batches == job.num_batches;
+}
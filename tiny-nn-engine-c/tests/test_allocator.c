@@ -0,0 +1,212 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/allocator.h"
+#include "../include/network.h"
+#include "../include/threadpool.h"
+
+static int all_zero(const unsigned char *data, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        if (data[i]) return 0;
+    }
+    return 1;
+}
+
+/* Blocks come back zeroed and aligned even when the memory is reused, and
+ * the counters follow every alloc and free. */
+static void check_blocks(allocator_t *allocator, size_t bytes) {
+    allocator_stats_t before = allocator_stats(allocator);
+    for (int round = 0; round < 2; round++) {
+        unsigned char *a = (unsigned char*)allocator_alloc(allocator, bytes);
+        unsigned char *b = (unsigned char*)allocator_alloc(allocator, 100);
+        assert(a && b);
+        assert((uintptr_t)a % ALLOCATOR_ALIGN == 0 && (uintptr_t)b % ALLOCATOR_ALIGN == 0);
+        assert(all_zero(a, bytes) && all_zero(b, 100));
+
+        allocator_stats_t stats = allocator_stats(allocator);
+        assert(stats.bytes_in_use == before.bytes_in_use + bytes + 100);
+        assert(stats.peak_bytes >= stats.bytes_in_use);
+        assert(stats.allocations == before.allocations + 2 * round + 2);
+
+        memset(a, 0xff, bytes);
+        memset(b, 0xff, 100);
+        allocator_free(a);
+        allocator_free(b);
+        assert(allocator_stats(allocator).bytes_in_use == before.bytes_in_use);
+    }
+}
+
+void test_system_allocator() {
+    printf("Testing the system allocator and its statistics... ");
+    allocator_t *system = allocator_system();
+    assert(allocator_tensor() == system);
+    check_blocks(system, 1000);
+    check_blocks(system, 0);
+
+    size_t in_use = allocator_stats(system).bytes_in_use;
+    void *big = allocator_alloc(system, 1 << 20);
+    allocator_free(big);
+    assert(allocator_stats(system).peak_bytes >= in_use + (1 << 20));
+    allocator_reset_peak(system);
+    assert(allocator_stats(system).peak_bytes == in_use);
+    allocator_free(NULL);
+    printf("✓\n");
+}
+
+void test_huge_pages() {
+    printf("Testing huge-page blocks and first touch... ");
+    static const unsigned flags[] = {
+        ALLOCATOR_HUGE_PAGES, ALLOCATOR_HUGE_PAGES | ALLOCATOR_FIRST_TOUCH,
+        ALLOCATOR_HUGETLB, ALLOCATOR_FIRST_TOUCH
+    };
+    threadpool_init(3);
+    for (size_t f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+        allocator_t *allocator = allocator_create_linux(flags[f], 1 << 20);
+        check_blocks(allocator, (3 << 20) + 12);
+        check_blocks(allocator, 5000);
+
+        void *block = allocator_alloc(allocator, 3 << 20);
+        allocator_stats_t stats = allocator_stats(allocator);
+#ifdef __linux__
+        if (flags[f] & (ALLOCATOR_HUGE_PAGES | ALLOCATOR_HUGETLB)) {
+            /* Whole huge pages, each block starting at its own offset. */
+            assert(stats.huge_bytes == 2 * ALLOCATOR_HUGE_PAGE_SIZE);
+            void *next = allocator_alloc(allocator, 3 << 20);
+            assert((uintptr_t)next % ALLOCATOR_HUGE_PAGE_SIZE != (uintptr_t)block % ALLOCATOR_HUGE_PAGE_SIZE);
+            allocator_free(next);
+        } else {
+            assert(stats.huge_bytes == 0);
+        }
+#endif
+        allocator_free(block);
+        stats = allocator_stats(allocator);
+        assert(stats.bytes_in_use == 0 && stats.huge_bytes == 0);
+        assert(stats.peak_bytes >= (3 << 20) + 12 + 100);
+        allocator_destroy(allocator);
+    }
+    threadpool_init(0);
+    printf("✓\n");
+}
+
+typedef struct {
+    size_t allocs;
+    size_t releases;
+} counting_t;
+
+static void* counting_alloc(allocator_t *self, size_t bytes) {
+    ((counting_t*)self->ctx)->allocs++;
+    void *mem = NULL;
+    if (posix_memalign(&mem, ALLOCATOR_ALIGN, bytes) != 0) return NULL;
+    memset(mem, 0, bytes);
+    return mem;
+}
+
+static void counting_release(allocator_t *self, void *block, size_t bytes) {
+    (void)bytes;
+    ((counting_t*)self->ctx)->releases++;
+    free(block);
+}
+
+/* A custom backend behind tensors, param arenas, optimizer state and the
+ * network arena; tensors made before the switch still free through the
+ * allocator they came from. */
+void test_tensor_allocator() {
+    printf("Testing a custom tensor allocator... ");
+    counting_t counts = {0, 0};
+    allocator_t *allocator = allocator_create(counting_alloc, counting_release, &counts);
+    size_t system_in_use = allocator_stats(allocator_system()).bytes_in_use;
+
+    tensor_t *before = tensor_create(7, 9);
+    allocator_set_tensor(allocator);
+    assert(allocator_tensor() == allocator);
+    tensor_t *after = tensor_create(7, 9);
+    assert(counts.allocs == 1 && allocator_stats(allocator).bytes_in_use == 7 * 9 * sizeof(float));
+    tensor_destroy(before);
+    assert(counts.releases == 0 && allocator_stats(allocator_system()).bytes_in_use == system_in_use);
+
+    network_t *network = network_create();
+    network_add_dense(network, 16, 32, ACTIVATION_RELU);
+    network_add_dense(network, 32, 4, ACTIVATION_NONE);
+    assert(network_build(network, 8));
+    tensor_t *x = tensor_create(8, 16);
+    tensor_t *y = tensor_create(8, 4);
+    adam_optimizer_t *adam = adam_create(0.01f, 2);
+    network_train_step(network, x, y, NETWORK_LOSS_MSE, adam);
+    allocator_stats_t stats = allocator_stats(allocator);
+    assert(stats.bytes_in_use >= 4 * network->params->count * sizeof(float) + network->arena_bytes);
+
+    allocator_set_tensor(NULL);
+    assert(allocator_tensor() == allocator_system());
+    adam_destroy(adam);
+    network_destroy(network);
+    tensor_destroy(x);
+    tensor_destroy(y);
+    tensor_destroy(after);
+    assert(allocator_stats(allocator).bytes_in_use == 0 && counts.allocs == counts.releases);
+    assert(allocator_stats(allocator).peak_bytes == stats.peak_bytes);
+    allocator_destroy(allocator);
+    printf("✓\n");
+}
+
+/* A backend that hands out a fixed number of blocks, then fails. */
+static void* budget_alloc(allocator_t *self, size_t bytes) {
+    size_t *left = (size_t*)self->ctx;
+    if (*left == 0) return NULL;
+    (*left)--;
+    void *mem = NULL;
+    if (posix_memalign(&mem, ALLOCATOR_ALIGN, bytes) != 0) return NULL;
+    memset(mem, 0, bytes);
+    return mem;
+}
+
+static void budget_release(allocator_t *self, void *block, size_t bytes) {
+    (void)self;
+    (void)bytes;
+    free(block);
+}
+
+/* Adam state that fails half-way is released, and the next step retries
+ * instead of reporting a mismatched arena forever. */
+void test_optimizer_state_failure() {
+    printf("Testing optimizer state allocation failure... ");
+    dense_layer_t *layers[2] = {layer_create(6, 9, ACTIVATION_RELU), layer_create(9, 2, ACTIVATION_NONE)};
+    param_arena_t *params = param_arena_create(layers, 2);
+    adam_optimizer_t *adam = adam_create(0.01f, 2);
+
+    size_t left = 1;
+    allocator_t *allocator = allocator_create(budget_alloc, budget_release, &left);
+    allocator_set_tensor(allocator);
+    adam_step_params(adam, params);
+    assert(adam->m == NULL && adam->v == NULL && adam->size == 0);
+    assert(allocator_stats(allocator).bytes_in_use == 0);
+
+    left = 2;
+    adam_step_params(adam, params);
+    assert(adam->m && adam->v && adam->size == params->count);
+
+    adam_destroy(adam);
+    allocator_set_tensor(NULL);
+    assert(allocator_stats(allocator).bytes_in_use == 0);
+    allocator_destroy(allocator);
+    param_arena_destroy(params);
+    layer_destroy(layers[0]);
+    layer_destroy(layers[1]);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running Allocator Tests\n");
+    threadpool_init(0);
+
+    test_system_allocator();
+    test_huge_pages();
+    test_tensor_allocator();
+    test_optimizer_state_failure();
+
+    threadpool_shutdown();
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "../include/dataset.h"
+
+#define DATASET_PATH "test_dataset.tnd"
+
+static void write_fixture(size_t samples) {
+    tensor_t *x = tensor_create(samples, 3);
+    tensor_t *y = tensor_create(samples, 1);
+    for (size_t i = 0; i < samples; i++) {
+        for (size_t j = 0; j < 3; j++) x->data[i * 3 + j] = (float)(i * 10 + j);
+        y->data[i] = (float)i;
+    }
+    assert(dataset_write(DATASET_PATH, x, y));
+    tensor_destroy(x);
+    tensor_destroy(y);
+}
+
+void test_dataset_roundtrip() {
+    printf("Testing dataset write and map... ");
+    write_fixture(10);
+
+    dataset_t *ds = dataset_open(DATASET_PATH);
+    assert(ds != NULL);
+    assert(ds->num_samples == 10 && ds->num_features == 3 && ds->num_targets == 1);
+    assert(((size_t)ds->features % 64) == 0);
+    assert(ds->features[7 * 3 + 2] == 72.0f);
+    assert(ds->targets[9] == 9.0f);
+
+    dataset_close(ds);
+    printf("✓\n");
+}
+
+/* Column blocks of a wider table are saved as the columns they show. */
+void test_dataset_write_strided_views() {
+    printf("Testing dataset write from strided views... ");
+    tensor_t *table = tensor_create(6, 5);
+    for (size_t i = 0; i < 6; i++) {
+        for (size_t j = 0; j < 5; j++) table->data[i * 5 + j] = (float)(i * 10 + j);
+    }
+    tensor_t x = tensor_block(table, 1, 5, 0, 3);
+    tensor_t y = tensor_block(table, 1, 5, 4, 1);
+    assert(x.stride == 5);
+    assert(dataset_write(DATASET_PATH, &x, &y));
+
+    dataset_t *ds = dataset_open(DATASET_PATH);
+    assert(ds != NULL && ds->num_samples == 5 && ds->num_features == 3 && ds->num_targets == 1);
+    for (size_t i = 0; i < 5; i++) {
+        for (size_t j = 0; j < 3; j++) assert(ds->features[i * 3 + j] == (float)((i + 1) * 10 + j));
+        assert(ds->targets[i] == (float)((i + 1) * 10 + 4));
+    }
+
+    dataset_close(ds);
+    tensor_destroy(table);
+    printf("✓\n");
+}
+
+void test_dataset_sequential_views() {
+    printf("Testing sequential mini-batch views... ");
+    write_fixture(10);
+    dataset_t *ds = dataset_open(DATASET_PATH);
+    dataset_loader_t *loader = dataset_loader_create(ds, 4, 0, 0);
+    assert(dataset_loader_batches_per_epoch(loader) == 3);
+
+    for (int epoch = 0; epoch < 2; epoch++) {
+        size_t seen = 0;
+        const tensor_t *x, *y;
+        while (dataset_loader_next(loader, &x, &y)) {
+            assert(x->data == ds->features + seen * 3);
+            assert(!x->owns_data);
+            assert(y->data[0] == (float)seen);
+            seen += x->rows;
+        }
+        assert(seen == 10);
+    }
+
+    dataset_loader_destroy(loader);
+    dataset_close(ds);
+    printf("✓\n");
+}
+
+void test_dataset_shuffled_epochs() {
+    printf("Testing shuffled mini-batches... ");
+    write_fixture(37);
+    dataset_t *ds = dataset_open(DATASET_PATH);
+    dataset_loader_t *loader = dataset_loader_create(ds, 8, 1, 1234);
+    float first_epoch[37];
+
+    for (int epoch = 0; epoch < 3; epoch++) {
+        int seen[37];
+        size_t count = 0;
+        int same_order = 1;
+        memset(seen, 0, sizeof(seen));
+        const tensor_t *x, *y;
+        while (dataset_loader_next(loader, &x, &y)) {
+            for (size_t r = 0; r < x->rows; r++) {
+                size_t sample = (size_t)y->data[r];
+                assert(x->data[r * 3 + 1] == (float)(sample * 10 + 1));
+                seen[sample]++;
+                if (epoch == 0) first_epoch[count] = y->data[r];
+                else if (first_epoch[count] != y->data[r]) same_order = 0;
+                count++;
+            }
+        }
+        assert(count == 37);
+        for (size_t i = 0; i < 37; i++) assert(seen[i] == 1);
+        if (epoch > 0) assert(!same_order);
+    }
+
+    dataset_loader_destroy(loader);
+    dataset_close(ds);
+    remove(DATASET_PATH);
+    printf("✓\n");
+}
+
+/* Rewrites the fixture's header with one field changed. */
+static void write_header(const dataset_header_t *header) {
+    FILE *file = fopen(DATASET_PATH, "r+b");
+    assert(file && fwrite(header, sizeof(*header), 1, file) == 1);
+    fclose(file);
+}
+
+void test_dataset_rejects_bad_headers() {
+    printf("Testing dataset header validation... ");
+    write_fixture(10);
+    FILE *file = fopen(DATASET_PATH, "rb");
+    dataset_header_t good;
+    assert(file && fread(&good, sizeof(good), 1, file) == 1);
+    fclose(file);
+
+    /* 4 * 2^62 wraps to 0 floats, which would pass an unchecked product. */
+    dataset_header_t header = good;
+    header.num_features = 1ull << 62;
+    header.num_samples = 4;
+    write_header(&header);
+    assert(dataset_open(DATASET_PATH) == NULL);
+
+    /* An offset past the end, whose sum with the block size wraps. */
+    header = good;
+    header.targets_offset = UINT64_MAX / 64 * 64;
+    write_header(&header);
+    assert(dataset_open(DATASET_PATH) == NULL);
+
+    header = good;
+    header.features_offset += 64 * 4;
+    write_header(&header);
+    assert(dataset_open(DATASET_PATH) == NULL);
+
+    write_header(&good);
+    dataset_t *ds = dataset_open(DATASET_PATH);
+    assert(ds != NULL);
+    dataset_close(ds);
+    remove(DATASET_PATH);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running Dataset Tests\n");
+
+    test_dataset_roundtrip();
+    test_dataset_write_strided_views();
+    test_dataset_sequential_views();
+    test_dataset_shuffled_epochs();
+    test_dataset_rejects_bad_headers();
+
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}
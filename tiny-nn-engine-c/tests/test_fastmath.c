@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/fastmath.h"
+#include "../include/gemm.h"
+#include "../include/loss.h"
+#include "../include/network.h"
+
+#define SAMPLES 4096
+
+static float from_bits(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/* Every 4099th bit pattern, about a million floats of each sign and exponent,
+ * held to the bounds documented in fastmath.h. */
+void test_fast_math_error_bounds() {
+    printf("Testing fast exp/log/sigmoid/tanh error bounds... ");
+    float *x = (float*)malloc(SAMPLES * sizeof(float));
+    float *y = (float*)malloc(SAMPLES * sizeof(float));
+    double exp_rel = 0.0, log_rel = 0.0, sigmoid_rel = 0.0, sigmoid_abs = 0.0;
+    double tanh_abs = 0.0, tanh_rel = 0.0;
+
+    uint64_t bits = 0;
+    while (bits < 0x100000000ull) {
+        size_t n = 0;
+        for (; n < SAMPLES && bits < 0x100000000ull; n++, bits += 4099) x[n] = from_bits((uint32_t)bits);
+
+        math_exp(y, x, n, MATH_FAST);
+        for (size_t i = 0; i < n; i++) {
+            if (!(x[i] >= -87.3f && x[i] <= 88.0f)) continue;
+            double ref = exp((double)x[i]);
+            exp_rel = fmax(exp_rel, fabs(y[i] - ref) / ref);
+        }
+
+        math_log(y, x, n, MATH_FAST);
+        for (size_t i = 0; i < n; i++) {
+            if (!(x[i] >= 1.17549435e-38f && x[i] < INFINITY) || x[i] == 1.0f) continue;
+            double ref = log((double)x[i]);
+            log_rel = fmax(log_rel, fabs(y[i] - ref) / fabs(ref));
+        }
+
+        math_sigmoid(y, x, n, MATH_FAST);
+        for (size_t i = 0; i < n; i++) {
+            if (isnan(x[i])) continue;
+            double ref = 1.0 / (1.0 + exp(-(double)x[i]));
+            sigmoid_abs = fmax(sigmoid_abs, fabs(y[i] - ref));
+            if (ref > 1e-37) sigmoid_rel = fmax(sigmoid_rel, fabs(y[i] - ref) / ref);
+        }
+
+        math_tanh(y, x, n, MATH_FAST);
+        for (size_t i = 0; i < n; i++) {
+            if (isnan(x[i])) continue;
+            double ref = tanh((double)x[i]);
+            tanh_abs = fmax(tanh_abs, fabs(y[i] - ref));
+            if (fabsf(x[i]) >= 1e-3f) tanh_rel = fmax(tanh_rel, fabs(y[i] - ref) / fabs(ref));
+        }
+    }
+    assert(exp_rel <= 8.2e-8 && log_rel <= 8.2e-8);
+    assert(sigmoid_rel <= 1.5e-7 && sigmoid_abs <= 9e-8);
+    assert(tanh_abs <= 8e-8 && tanh_rel <= 1.5e-7);
+
+    free(x);
+    free(y);
+    printf("✓\n");
+}
+
+void test_fast_math_special_values() {
+    printf("Testing fast math special values... ");
+    assert(math_fast_expf(0.0f) == 1.0f);
+    assert(math_fast_expf(1000.0f) > 1e38f && isfinite(math_fast_expf(1000.0f)));
+    assert(math_fast_expf(-1000.0f) < 1.2e-38f);
+    assert(isnan(math_fast_expf(NAN)));
+
+    assert(math_fast_logf(1.0f) == 0.0f);
+    assert(math_fast_logf(0.0f) == -INFINITY && math_fast_logf(-0.0f) == -INFINITY);
+    assert(math_fast_logf(1e-40f) == -INFINITY);
+    assert(isnan(math_fast_logf(-1.0f)) && isnan(math_fast_logf(NAN)));
+    assert(math_fast_logf(INFINITY) == INFINITY);
+
+    assert(math_fast_sigmoidf(0.0f) == 0.5f);
+    assert(math_fast_sigmoidf(100.0f) == 1.0f && math_fast_sigmoidf(-100.0f) < 1e-38f);
+    assert(math_fast_tanhf(20.0f) == 1.0f && math_fast_tanhf(-20.0f) == -1.0f);
+    assert(math_fast_tanhf(-0.0f) == 0.0f && signbit(math_fast_tanhf(-0.0f)));
+    printf("✓\n");
+}
+
+/* The vector kernels must reproduce the scalar ones bit for bit on every ISA
+ * the CPU has, including the special-value lanes and the tails. */
+void test_fast_math_matches_scalar() {
+    printf("Testing vectorized fast math against scalar... ");
+    size_t n = 1003;
+    float *x = (float*)malloc(n * sizeof(float));
+    float *y = (float*)malloc(n * sizeof(float));
+    static const float specials[] = {0.0f, -0.0f, 1.0f, INFINITY, -INFINITY, NAN, 1e-40f, -1e-40f,
+                                     88.5f, -88.5f, 0.625f, -0.625f, 1e-30f};
+    srand(11);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t bits = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        x[i] = i % 2 ? ((float)rand() / RAND_MAX - 0.5f) * 40.0f : from_bits(bits);
+    }
+    memcpy(x + 100, specials, sizeof(specials));
+
+    gemm_isa_t original = gemm_get_isa();
+    gemm_isa_t isas[] = {GEMM_ISA_SCALAR, GEMM_ISA_AVX2, GEMM_ISA_AVX512};
+    for (int k = 0; k < 3; k++) {
+        if (gemm_set_isa(isas[k]) != isas[k]) continue;
+        for (int op = 0; op < 4; op++) {
+            if (op == 0) math_exp(y, x, n, MATH_FAST);
+            if (op == 1) math_log(y, x, n, MATH_FAST);
+            if (op == 2) math_sigmoid(y, x, n, MATH_FAST);
+            if (op == 3) math_tanh(y, x, n, MATH_FAST);
+            for (size_t i = 0; i < n; i++) {
+                float expected = op == 0 ? math_fast_expf(x[i]) : op == 1 ? math_fast_logf(x[i]) :
+                                 op == 2 ? math_fast_sigmoidf(x[i]) : math_fast_tanhf(x[i]);
+                assert(isnan(expected) ? isnan(y[i]) : memcmp(&y[i], &expected, sizeof(float)) == 0);
+            }
+        }
+    }
+    gemm_set_isa(original);
+
+    free(x);
+    free(y);
+    printf("✓\n");
+}
+
+/* The fused loss must agree with sigmoid, BCE and the chain rule through
+ * the sigmoid derivative, and stay finite where the chained form saturates. */
+void test_bce_with_logits() {
+    printf("Testing BCE with logits against the chained form... ");
+    tensor_t *z = tensor_create(37, 5);
+    tensor_t *t = tensor_create(37, 5);
+    tensor_t *s = tensor_create(37, 5);
+    tensor_t *ds = tensor_create(37, 5);
+    tensor_t *chained = tensor_create(37, 5);
+    tensor_t *fused = tensor_create(37, 5);
+    tensor_random(z, -6.0f, 6.0f);
+    tensor_random(t, 0.0f, 1.0f);
+
+    tensor_sigmoid(z, s);
+    loss_bce_derivative(s, t, chained);
+    tensor_sigmoid_derivative(s, ds);
+    tensor_multiply(chained, ds, chained);
+    float expected = loss_binary_crossentropy(s, t);
+
+    math_mode_t modes[] = {MATH_PRECISE, MATH_FAST};
+    for (int m = 0; m < 2; m++) {
+        assert(fabsf(loss_bce_with_logits(z, t, modes[m]) - expected) < 1e-5f);
+        loss_bce_with_logits_derivative(z, t, fused, modes[m]);
+        for (size_t i = 0; i < 37 * 5; i++) {
+            assert(fabsf(fused->data[i] - chained->data[i]) < 1e-6f);
+        }
+    }
+
+    /* Confidently wrong: the loss is the logit itself, the gradient +-1/n. */
+    z->rows = t->rows = fused->rows = 1;
+    z->cols = t->cols = fused->cols = 2;
+    z->stride = t->stride = fused->stride = 2;
+    z->data[0] = 200.0f;
+    z->data[1] = -200.0f;
+    t->data[0] = 0.0f;
+    t->data[1] = 1.0f;
+    for (int m = 0; m < 2; m++) {
+        assert(loss_bce_with_logits(z, t, modes[m]) == 200.0f);
+        loss_bce_with_logits_derivative(z, t, fused, modes[m]);
+        assert(fused->data[0] == 0.5f && fused->data[1] == -0.5f);
+    }
+
+    tensor_destroy(z);
+    tensor_destroy(t);
+    tensor_destroy(s);
+    tensor_destroy(ds);
+    tensor_destroy(chained);
+    tensor_destroy(fused);
+    printf("✓\n");
+}
+
+/* y = sum(x) > 0 on a network whose linear head is trained through the
+ * fused loss with fast math. */
+void test_network_bce_logits() {
+    printf("Testing network training with BCE on logits... ");
+    network_t *network = network_create();
+    network_add_dense(network, 8, 32, ACTIVATION_RELU);
+    network_add_dense(network, 32, 1, ACTIVATION_NONE);
+    assert(network_build(network, 64));
+    network->math = MATH_FAST;
+    adam_optimizer_t *opt = adam_create(0.01f, 2);
+
+    tensor_t *x = tensor_create(64, 8);
+    tensor_t *y = tensor_create(64, 1);
+    float first = 0.0f, last = 0.0f;
+    for (int step = 0; step < 300; step++) {
+        tensor_random(x, -1.0f, 1.0f);
+        for (size_t i = 0; i < 64; i++) {
+            float sum = 0.0f;
+            for (size_t j = 0; j < 8; j++) sum += x->data[i * 8 + j];
+            y->data[i] = sum > 0.0f ? 1.0f : 0.0f;
+        }
+        float loss = network_train_step(network, x, y, NETWORK_LOSS_BCE_LOGITS, opt);
+        if (step == 0) first = loss;
+        last = loss;
+    }
+    assert(last < 0.5f * first);
+
+    network_t *sigmoid_head = network_create();
+    network_add_dense(sigmoid_head, 8, 1, ACTIVATION_SIGMOID);
+    assert(network_build(sigmoid_head, 64));
+    assert(network_forward(sigmoid_head, x));
+    assert(network_loss(sigmoid_head, y, NETWORK_LOSS_BCE_LOGITS) == 0.0f);
+
+    tensor_destroy(x);
+    tensor_destroy(y);
+    adam_destroy(opt);
+    network_destroy(network);
+    network_destroy(sigmoid_head);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running Fast Math Tests\n");
+
+    test_fast_math_error_bounds();
+    test_fast_math_special_values();
+    test_fast_math_matches_scalar();
+    test_bce_with_logits();
+    test_network_bce_logits();
+
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include "../include/half.h"
+#include "../include/inference.h"
+#include "../include/optimizer.h"
+#include "../include/loss.h"
+
+static float from_bits(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void test_half_conversions() {
+    printf("Testing bf16/fp16 scalar conversions... ");
+    assert(half_from_float(1.0f, PRECISION_BF16) == 0x3f80);
+    assert(half_from_float(-2.5f, PRECISION_BF16) == 0xc020);
+    /* Ties round to even; fp32 denormals flush to zero. */
+    assert(half_from_float(from_bits(0x3f808000u), PRECISION_BF16) == 0x3f80);
+    assert(half_from_float(from_bits(0x3f818000u), PRECISION_BF16) == 0x3f82);
+    assert(half_from_float(from_bits(0x80000001u), PRECISION_BF16) == 0x8000);
+    assert(isnan(half_to_float(half_from_float(NAN, PRECISION_BF16), PRECISION_BF16)));
+
+    assert(half_from_float(1.0f, PRECISION_FP16) == 0x3c00);
+    assert(half_from_float(65504.0f, PRECISION_FP16) == 0x7bff);
+    assert(half_from_float(65520.0f, PRECISION_FP16) == 0x7c00);
+    assert(half_from_float(ldexpf(1.0f, -24), PRECISION_FP16) == 0x0001);
+    assert(half_from_float(ldexpf(1.0f, -26), PRECISION_FP16) == 0x0000);
+    assert(half_to_float(0x0001, PRECISION_FP16) == ldexpf(1.0f, -24));
+    assert(half_to_float(0xfc00, PRECISION_FP16) == -INFINITY);
+    assert(isnan(half_to_float(half_from_float(NAN, PRECISION_FP16), PRECISION_FP16)));
+
+    /* Every fp16 value survives a round trip through fp32. */
+    for (uint32_t h = 0; h < 0x10000u; h++) {
+        if ((h & 0x7c00u) == 0x7c00u && (h & 0x03ffu)) continue;
+        assert(half_from_float(half_to_float((uint16_t)h, PRECISION_FP16), PRECISION_FP16) == h);
+    }
+    printf("✓\n");
+}
+
+void test_half_bulk_matches_scalar() {
+    printf("Testing vectorized conversions against scalar... ");
+    size_t n = 1003;
+    float *src = (float*)malloc(n * sizeof(float));
+    float *back = (float*)malloc(n * sizeof(float));
+    uint16_t *dst = (uint16_t*)malloc(n * sizeof(uint16_t));
+    srand(7);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t bits = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        src[i] = i % 3 ? ((float)rand() / RAND_MAX - 0.5f) * 1e3f : from_bits(bits);
+    }
+
+    precision_t types[] = {PRECISION_BF16, PRECISION_FP16};
+    for (int t = 0; t < 2; t++) {
+        half_convert_from_float(dst, src, n, types[t]);
+        half_convert_to_float(back, dst, n, types[t]);
+        for (size_t i = 0; i < n; i++) {
+            assert(dst[i] == half_from_float(src[i], types[t]));
+            float expected = half_to_float(dst[i], types[t]);
+            assert(memcmp(&back[i], &expected, sizeof(float)) == 0);
+        }
+    }
+
+    free(src);
+    free(back);
+    free(dst);
+    printf("✓\n");
+}
+
+/* Widening is exact, so a mixed GEMM must equal the fp32 GEMM run on the
+ * widened operands bit for bit, on every path (small, blocked, threaded). */
+void test_mixed_gemm_matches_widened() {
+    printf("Testing mixed-precision GEMM... ");
+    size_t sizes[][3] = {{3, 5, 7}, {37, 45, 29}, {130, 150, 300}};
+    precision_t types[] = {PRECISION_BF16, PRECISION_FP16};
+
+    for (int s = 0; s < 3; s++) {
+        size_t m = sizes[s][0], n = sizes[s][1], k = sizes[s][2];
+        float *a = (float*)malloc(m * k * sizeof(float));
+        float *b = (float*)malloc(k * n * sizeof(float));
+        float *c = (float*)malloc(m * n * sizeof(float));
+        float *ref = (float*)malloc(m * n * sizeof(float));
+        uint16_t *ha = (uint16_t*)malloc(m * k * sizeof(uint16_t));
+        uint16_t *hb = (uint16_t*)malloc(k * n * sizeof(uint16_t));
+        for (size_t i = 0; i < m * k; i++) a[i] = (float)rand() / RAND_MAX - 0.5f;
+        for (size_t i = 0; i < k * n; i++) b[i] = (float)rand() / RAND_MAX - 0.5f;
+
+        for (int t = 0; t < 2; t++) {
+            half_convert_from_float(ha, a, m * k, types[t]);
+            half_convert_from_float(hb, b, k * n, types[t]);
+            float *wa = (float*)malloc(m * k * sizeof(float));
+            float *wb = (float*)malloc(k * n * sizeof(float));
+            half_convert_to_float(wa, ha, m * k, types[t]);
+            half_convert_to_float(wb, hb, k * n, types[t]);
+
+            for (int trans = 0; trans < 4; trans++) {
+                gemm_trans_t ta = trans & 1 ? GEMM_TRANS : GEMM_NO_TRANS;
+                gemm_trans_t tb = trans & 2 ? GEMM_TRANS : GEMM_NO_TRANS;
+                /* The same buffers read as transposed are k x m and n x k. */
+                size_t lda = ta == GEMM_TRANS ? m : k, ldb = tb == GEMM_TRANS ? k : n;
+
+                gemm_sgemm(ta, tb, m, n, k, 1.0f, wa, lda, b, ldb, 0.0f, ref, n);
+                gemm_mixed_fused(ta, tb, m, n, k, 1.0f, ha, types[t], lda, b, PRECISION_FP32, ldb,
+                                 0.0f, c, n, NULL);
+                assert(memcmp(c, ref, m * n * sizeof(float)) == 0);
+
+                gemm_sgemm(ta, tb, m, n, k, 1.0f, a, lda, wb, ldb, 0.0f, ref, n);
+                gemm_mixed_fused(ta, tb, m, n, k, 1.0f, a, PRECISION_FP32, lda, hb, types[t], ldb,
+                                 0.0f, c, n, NULL);
+                assert(memcmp(c, ref, m * n * sizeof(float)) == 0);
+            }
+            free(wa);
+            free(wb);
+        }
+
+        free(a);
+        free(b);
+        free(c);
+        free(ref);
+        free(ha);
+        free(hb);
+    }
+    printf("✓\n");
+}
+
+/* Odd widths throughout: every weight block and activation row leaves a
+ * remainder after the 16- and 8-wide conversion loops, so the scalar tails
+ * round part of every layer. */
+static void build_odd_layers(dense_layer_t **layers) {
+    layers[0] = layer_create(23, 97, ACTIVATION_RELU);
+    layers[1] = layer_create(97, 45, ACTIVATION_RELU);
+    layers[2] = layer_create(45, 5, ACTIVATION_SIGMOID);
+    for (int i = 0; i < 3; i++) tensor_random(layers[i]->bias, -0.2f, 0.2f);
+}
+
+/* Largest output difference against the fp32 model. bf16 keeps 8 mantissa
+ * bits, fp16 11, so the bounds are a few units of each format's epsilon. */
+void test_half_inference_accuracy() {
+    printf("Testing bf16/fp16 inference against fp32... ");
+    dense_layer_t *layers[3];
+    build_odd_layers(layers);
+    size_t batch = 300;     /* more than one INFERENCE_ROW_BLOCK */
+    tensor_t *x = tensor_create(batch, 23);
+    tensor_t *expected = tensor_create(batch, 5);
+    tensor_t *out = tensor_create(batch, 5);
+    tensor_t *again = tensor_create(batch, 5);
+    tensor_random(x, -1.0f, 1.0f);
+
+    inference_model_t *fp32 = inference_model_create(layers, 3);
+    assert(inference_forward(fp32, x, expected, NULL));
+
+    precision_t types[] = {PRECISION_BF16, PRECISION_FP16};
+    float bounds[] = {2e-2f, 3e-3f};
+    for (int t = 0; t < 2; t++) {
+        inference_model_t *model = inference_model_create_precision(layers, 3, types[t]);
+        assert(model != NULL && model->precision == types[t]);
+        assert(inference_forward(model, x, out, NULL));
+
+        float max_error = 0.0f;
+        for (size_t i = 0; i < batch * 5; i++) {
+            float error = fabsf(out->data[i] - expected->data[i]);
+            if (error > max_error) max_error = error;
+        }
+        assert(max_error > 0.0f && max_error < bounds[t]);
+
+        /* Caller scratch sized for the 16-bit layout gives the same answer. */
+        inference_scratch_t *scratch = inference_scratch_create(model, batch);
+        assert(inference_forward(model, x, again, scratch));
+        assert(memcmp(again->data, out->data, batch * 5 * sizeof(float)) == 0);
+        inference_scratch_destroy(scratch);
+        inference_model_destroy(model);
+    }
+
+    tensor_destroy(x);
+    tensor_destroy(expected);
+    tensor_destroy(out);
+    tensor_destroy(again);
+    inference_model_destroy(fp32);
+    for (int i = 0; i < 3; i++) layer_destroy(layers[i]);
+    printf("✓\n");
+}
+
+/* Trains y = sum(x) > 0 with bf16 weight copies and fp32 masters. The
+ * optimizer must keep the copy equal to the rounded masters. */
+void test_half_training_converges() {
+    printf("Testing training with bf16 weights... ");
+    dense_layer_t *layers[2];
+    layers[0] = layer_create(8, 32, ACTIVATION_RELU);
+    layers[1] = layer_create(32, 1, ACTIVATION_SIGMOID);
+    param_arena_t *params = param_arena_create(layers, 2);
+    assert(param_arena_set_precision(params, layers, 2, PRECISION_BF16));
+    assert(layers[0]->precision == PRECISION_BF16 && !layers[0]->owns_half_weights);
+    for (int i = 0; i < 2; i++) layer_reserve(layers[i], 64);
+    adam_optimizer_t *opt = adam_create(0.01f, 2);
+
+    tensor_t *x = tensor_create(64, 8);
+    tensor_t *y = tensor_create(64, 1);
+    tensor_t *grad = tensor_create(64, 1);
+    float first = 0.0f, last = 0.0f;
+    for (int step = 0; step < 300; step++) {
+        tensor_random(x, -1.0f, 1.0f);
+        for (size_t i = 0; i < 64; i++) {
+            float sum = 0.0f;
+            for (size_t j = 0; j < 8; j++) sum += x->data[i * 8 + j];
+            y->data[i] = sum > 0.0f ? 1.0f : 0.0f;
+        }
+
+        tensor_t *out = layer_forward(layers[1], layer_forward(layers[0], x));
+        float loss = loss_binary_crossentropy(out, y);
+        if (step == 0) first = loss;
+        last = loss;
+        loss_bce_derivative(out, y, grad);
+        layer_backward(layers[0], layer_backward(layers[1], grad));
+        adam_step_params(opt, params);
+    }
+    assert(last < 0.5f * first);
+
+    for (int l = 0; l < 2; l++) {
+        for (size_t i = 0; i < layers[l]->weights->rows * layers[l]->weights->cols; i++) {
+            assert(layers[l]->half_weights[i] ==
+                   half_from_float(layers[l]->weights->data[i], PRECISION_BF16));
+        }
+    }
+
+    tensor_destroy(x);
+    tensor_destroy(y);
+    tensor_destroy(grad);
+    adam_destroy(opt);
+    for (int i = 0; i < 2; i++) layer_destroy(layers[i]);
+    param_arena_destroy(params);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running Reduced Precision Tests\n");
+
+    test_half_conversions();
+    test_half_bulk_matches_scalar();
+    test_mixed_gemm_matches_widened();
+    test_half_inference_accuracy();
+    test_half_training_converges();
+
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include "../include/inference.h"
+#include "../include/threadpool.h"
+
+#define NUM_READERS 4
+#define NUM_LAYERS 4
+
+/* Four layers, so the forward pass ping-pongs through both scratch buffers
+ * twice, with the widest hidden layer in the middle of the stack so the
+ * buffers must be sized by max_hidden rather than by the first layer. */
+static void build_deep_layers(dense_layer_t **layers) {
+    layers[0] = layer_create(12, 20, ACTIVATION_RELU);
+    layers[1] = layer_create(20, 48, ACTIVATION_RELU);
+    layers[2] = layer_create(48, 24, ACTIVATION_RELU);
+    layers[3] = layer_create(24, 3, ACTIVATION_SIGMOID);
+    for (int i = 0; i < NUM_LAYERS; i++) tensor_random(layers[i]->bias, -0.5f, 0.5f);
+}
+
+void test_inference_matches_training_forward() {
+    printf("Testing frozen model against layer_forward... ");
+    dense_layer_t *layers[NUM_LAYERS];
+    build_deep_layers(layers);
+    tensor_t *x = tensor_create(9, 12);
+    tensor_random(x, -1.0f, 1.0f);
+
+    const tensor_t *expected = x;
+    for (int i = 0; i < NUM_LAYERS; i++) expected = layer_forward(layers[i], expected);
+
+    inference_model_t *model = inference_model_create(layers, NUM_LAYERS);
+    assert(model != NULL);
+    assert(model->input_size == 12 && model->output_size == 3 && model->max_hidden == 48);
+
+    inference_scratch_t *scratch = inference_scratch_create(model, 16);
+    tensor_t *out = tensor_create(9, 3);
+    assert(inference_forward(model, x, out, scratch));
+    assert(memcmp(out->data, expected->data, 9 * 3 * sizeof(float)) == 0);
+
+    /* Thread-local scratch gives the same answer, and the model is a copy. */
+    tensor_t *again = tensor_create(9, 3);
+    tensor_fill(layers[NUM_LAYERS - 1]->weights, 0.0f);
+    assert(inference_forward(model, x, again, NULL));
+    assert(memcmp(again->data, out->data, 9 * 3 * sizeof(float)) == 0);
+
+    tensor_t *wide = tensor_create(17, 12);
+    tensor_t *wide_out = tensor_create(17, 3);
+    assert(!inference_forward(model, wide, wide_out, scratch));
+
+    tensor_destroy(wide);
+    tensor_destroy(wide_out);
+    tensor_destroy(again);
+    tensor_destroy(out);
+    tensor_destroy(x);
+    inference_scratch_destroy(scratch);
+    inference_model_destroy(model);
+    for (int i = 0; i < NUM_LAYERS; i++) layer_destroy(layers[i]);
+    printf("✓\n");
+}
+
+typedef struct {
+    const inference_model_t *model;
+    const tensor_t *input;
+    const tensor_t *expected;
+    int mismatches;
+} reader_t;
+
+static void* reader_main(void *arg) {
+    reader_t *reader = (reader_t*)arg;
+    tensor_t *out = tensor_create(reader->input->rows, reader->model->output_size);
+
+    for (int iter = 0; iter < 200; iter++) {
+        if (!inference_forward(reader->model, reader->input, out, NULL) ||
+            memcmp(out->data, reader->expected->data, out->rows * out->cols * sizeof(float)) != 0) {
+            reader->mismatches++;
+        }
+    }
+
+    tensor_destroy(out);
+    return NULL;
+}
+
+void test_inference_concurrent_readers() {
+    printf("Testing concurrent inference on one model... ");
+    dense_layer_t *layers[NUM_LAYERS];
+    build_deep_layers(layers);
+    inference_model_t *model = inference_model_create(layers, NUM_LAYERS);
+
+    tensor_t *inputs[NUM_READERS], *expected[NUM_READERS];
+    reader_t readers[NUM_READERS];
+    pthread_t threads[NUM_READERS];
+    for (int t = 0; t < NUM_READERS; t++) {
+        inputs[t] = tensor_create((size_t)(5 + 40 * t), 12);
+        expected[t] = tensor_create(inputs[t]->rows, 3);
+        tensor_random(inputs[t], -1.0f, 1.0f);
+        assert(inference_forward(model, inputs[t], expected[t], NULL));
+        readers[t] = (reader_t){model, inputs[t], expected[t], 0};
+    }
+
+    for (int t = 0; t < NUM_READERS; t++) pthread_create(&threads[t], NULL, reader_main, &readers[t]);
+    for (int t = 0; t < NUM_READERS; t++) {
+        pthread_join(threads[t], NULL);
+        assert(readers[t].mismatches == 0);
+        tensor_destroy(inputs[t]);
+        tensor_destroy(expected[t]);
+    }
+
+    inference_model_destroy(model);
+    for (int i = 0; i < NUM_LAYERS; i++) layer_destroy(layers[i]);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running Inference Tests\n");
+    threadpool_init(4);
+
+    test_inference_matches_training_forward();
+    test_inference_concurrent_readers();
+
+    threadpool_shutdown();
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}
@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "../include/layer.h"
+#include "../include/loss.h"
+#include "../include/optimizer.h"
+
+#define EPSILON 1e-5f
+
+/* The checks below write weights directly, so the packed copy is refreshed. */
+static float mse_of_layer(dense_layer_t *layer, const tensor_t *x, const tensor_t *y) {
+    layer_sync_weights(layer);
+    tensor_t *out = layer_forward(layer, x);
+    return loss_mse(out, y);
+}
+
+void test_layer_gradients() {
+    printf("Testing dense layer gradients... ");
+    activation_type_t activations[] = {ACTIVATION_NONE, ACTIVATION_RELU, ACTIVATION_SIGMOID};
+
+    for (int a = 0; a < 3; a++) {
+        dense_layer_t *layer = layer_create(5, 3, activations[a]);
+        tensor_t *x = tensor_create(4, 5);
+        tensor_t *y = tensor_create(4, 3);
+        tensor_t *grad = tensor_create(4, 3);
+        tensor_random(x, -1.0f, 1.0f);
+        tensor_random(y, -1.0f, 1.0f);
+        tensor_random(layer->bias, -0.5f, 0.5f);
+
+        tensor_t *out = layer_forward(layer, x);
+        loss_mse_derivative(out, y, grad);
+        tensor_t *grad_input = layer_backward(layer, grad);
+
+        const float h = 1e-3f;
+        for (size_t i = 0; i < layer->weights->rows * layer->weights->cols; i++) {
+            float w = layer->weights->data[i];
+            layer->weights->data[i] = w + h;
+            float plus = mse_of_layer(layer, x, y);
+            layer->weights->data[i] = w - h;
+            float minus = mse_of_layer(layer, x, y);
+            layer->weights->data[i] = w;
+            assert(fabsf((plus - minus) / (2.0f * h) - layer->grad_weights->data[i]) < 1e-2f);
+        }
+        for (size_t i = 0; i < x->rows * x->cols; i++) {
+            float v = x->data[i];
+            x->data[i] = v + h;
+            float plus = mse_of_layer(layer, x, y);
+            x->data[i] = v - h;
+            float minus = mse_of_layer(layer, x, y);
+            x->data[i] = v;
+            assert(fabsf((plus - minus) / (2.0f * h) - grad_input->data[i]) < 1e-2f);
+        }
+
+        tensor_destroy(grad_input);
+        tensor_destroy(x);
+        tensor_destroy(y);
+        tensor_destroy(grad);
+        layer_destroy(layer);
+    }
+    printf("✓\n");
+}
+
+void test_layer_reserved_workspace() {
+    printf("Testing reserved layer workspaces... ");
+    dense_layer_t *plain = layer_create(6, 4, ACTIVATION_RELU);
+    dense_layer_t *reserved = layer_create(6, 4, ACTIVATION_RELU);
+    tensor_copy_data(reserved->weights, plain->weights);
+    assert(layer_reserve(reserved, 8));
+
+    size_t batches[] = {8, 3};
+    for (int b = 0; b < 2; b++) {
+        tensor_t *x = tensor_create(batches[b], 6);
+        tensor_t *grad = tensor_create(batches[b], 4);
+        tensor_random(x, -1.0f, 1.0f);
+        tensor_random(grad, -1.0f, 1.0f);
+
+        tensor_t *out_plain = layer_forward(plain, x);
+        tensor_t *out_reserved = layer_forward(reserved, x);
+        assert(out_reserved == reserved->output);
+        assert(out_reserved->rows == batches[b]);
+        for (size_t i = 0; i < out_plain->rows * out_plain->cols; i++) {
+            assert(fabsf(out_plain->data[i] - out_reserved->data[i]) < EPSILON);
+        }
+
+        tensor_t *gi_plain = layer_backward(plain, grad);
+        tensor_t *gi_reserved = layer_backward(reserved, grad);
+        assert(gi_reserved == reserved->grad_input);
+        for (size_t i = 0; i < gi_plain->rows * gi_plain->cols; i++) {
+            assert(fabsf(gi_plain->data[i] - gi_reserved->data[i]) < EPSILON);
+        }
+        for (size_t i = 0; i < 24; i++) {
+            assert(fabsf(plain->grad_weights->data[i] - reserved->grad_weights->data[i]) < EPSILON);
+        }
+
+        tensor_destroy(gi_plain);
+        tensor_destroy(x);
+        tensor_destroy(grad);
+    }
+
+    layer_destroy(plain);
+    layer_destroy(reserved);
+    printf("✓\n");
+}
+
+void test_param_arena_optimizers() {
+    printf("Testing parameter arena optimizers... ");
+    dense_layer_t *a[2] = {layer_create(7, 5, ACTIVATION_RELU), layer_create(5, 3, ACTIVATION_NONE)};
+    dense_layer_t *b[2] = {layer_create(7, 5, ACTIVATION_RELU), layer_create(5, 3, ACTIVATION_NONE)};
+    for (int l = 0; l < 2; l++) {
+        tensor_copy_data(b[l]->weights, a[l]->weights);
+    }
+
+    param_arena_t *params = param_arena_create(b, 2);
+    assert(params != NULL);
+    assert(((size_t)b[0]->weights->data % 64) == 0);
+    assert(((size_t)b[1]->bias->data % 64) == 0);
+    assert(!b[1]->grad_weights->owns_data);
+
+    adam_optimizer_t *per_layer = adamw_create(0.01f, 0.1f, 2);
+    adam_optimizer_t *fused = adamw_create(0.01f, 0.1f, 2);
+    tensor_t *x = tensor_create(4, 7);
+    tensor_t *grad = tensor_create(4, 3);
+    for (int step = 0; step < 3; step++) {
+        tensor_random(x, -1.0f, 1.0f);
+        tensor_random(grad, -1.0f, 1.0f);
+        layer_forward(a[1], layer_forward(a[0], x));
+        layer_forward(b[1], layer_forward(b[0], x));
+        tensor_t *ga = layer_backward(a[1], grad);
+        tensor_t *gb = layer_backward(b[1], grad);
+        tensor_destroy(layer_backward(a[0], ga));
+        tensor_destroy(layer_backward(b[0], gb));
+        tensor_destroy(ga);
+        tensor_destroy(gb);
+
+        adam_step(per_layer, a, 2);
+        adam_step_params(fused, params);
+    }
+    for (int l = 0; l < 2; l++) {
+        for (size_t i = 0; i < a[l]->weights->rows * a[l]->weights->cols; i++) {
+            assert(a[l]->weights->data[i] == b[l]->weights->data[i]);
+        }
+        for (size_t i = 0; i < a[l]->bias->cols; i++) {
+            assert(a[l]->bias->data[i] == b[l]->bias->data[i]);
+        }
+    }
+
+    sgd_optimizer_t *sgd = sgd_create_momentum(0.1f, 0.9f, 0.0f);
+    float before = b[0]->weights->data[0];
+    float g = b[0]->grad_weights->data[0];
+    sgd_step_params(sgd, params);
+    sgd_step_params(sgd, params);
+    assert(fabsf(b[0]->weights->data[0] - (before - 0.1f * g - 0.1f * 1.9f * g)) < EPSILON);
+
+    sgd_destroy(sgd);
+    adam_destroy(per_layer);
+    adam_destroy(fused);
+    tensor_destroy(x);
+    tensor_destroy(grad);
+    for (int l = 0; l < 2; l++) {
+        layer_destroy(a[l]);
+        layer_destroy(b[l]);
+    }
+    param_arena_destroy(params);
+    printf("✓\n");
+}
+
+/* A mini-batch sliced out of a wider buffer trains exactly like a packed copy. */
+void test_layer_strided_input() {
+    printf("Testing layers on strided views... ");
+    dense_layer_t *layer = layer_create(4, 3, ACTIVATION_RELU);
+    tensor_t *buffer = tensor_create(10, 9);
+    tensor_random(buffer, -1.0f, 1.0f);
+    tensor_t x = tensor_block(buffer, 3, 5, 2, 4);
+    tensor_t grad = tensor_block(buffer, 3, 5, 6, 3);
+    tensor_t *x_packed = tensor_copy(&x);
+    tensor_t *grad_packed = tensor_copy(&grad);
+
+    tensor_t *expected = tensor_copy(layer_forward(layer, x_packed));
+    tensor_t *expected_input = layer_backward(layer, grad_packed);
+    tensor_t *expected_weights = tensor_copy(layer->grad_weights);
+
+    tensor_t *out = layer_forward(layer, &x);
+    assert(memcmp(out->data, expected->data, 15 * sizeof(float)) == 0);
+    tensor_t *grad_input = layer_backward(layer, &grad);
+    assert(memcmp(grad_input->data, expected_input->data, 20 * sizeof(float)) == 0);
+    assert(memcmp(layer->grad_weights->data, expected_weights->data, 12 * sizeof(float)) == 0);
+
+    tensor_destroy(grad_input);
+    tensor_destroy(expected_input);
+    tensor_destroy(expected_weights);
+    tensor_destroy(expected);
+    tensor_destroy(x_packed);
+    tensor_destroy(grad_packed);
+    tensor_destroy(buffer);
+    layer_destroy(layer);
+    printf("✓\n");
+}
+
+/* layer_forward through the weight panels against a GEMM over the plain
+ * weights. Above the small-product cutoff both run the same kernel on the
+ * same packed values, so the results are bit-identical. */
+static void assert_forward_current(dense_layer_t *layer, const tensor_t *x) {
+    tensor_t *expected = tensor_create(x->rows, layer->weights->cols);
+    gemm_epilogue_t epilogue = {layer->bias->data, layer_gemm_activation(layer->activation)};
+    gemm_sgemm_fused(GEMM_NO_TRANS, GEMM_NO_TRANS, x->rows, layer->weights->cols, x->cols,
+                     1.0f, x->data, x->stride, layer->weights->data, layer->weights->cols,
+                     0.0f, expected->data, expected->stride, &epilogue);
+    tensor_t *out = layer_forward(layer, x);
+    assert(memcmp(out->data, expected->data, x->rows * layer->weights->cols * sizeof(float)) == 0);
+    assert(gemm_packed_current(&layer->packed_weights->panels));
+    assert(layer->packed_weights->version == *layer->weights_version);
+    tensor_destroy(expected);
+}
+
+void test_layer_packed_weights() {
+    printf("Testing cached weight panels... ");
+    dense_layer_t *layer = layer_create(70, 37, ACTIVATION_RELU);
+    tensor_t *x = tensor_create(5, 70);
+    tensor_t *grad = tensor_create(5, 37);
+    tensor_random(x, -1.0f, 1.0f);
+    tensor_random(grad, -1.0f, 1.0f);
+    tensor_random(layer->bias, -0.5f, 0.5f);
+
+    assert(layer->packed_weights->panels.nr == 0);
+    assert_forward_current(layer, x);
+    const float *panels = layer->packed_weights->panels.data;
+    uint64_t version = layer->packed_weights->version;
+    assert_forward_current(layer, x);
+    assert(layer->packed_weights->version == version);
+
+    /* Each way of changing the weights moves the version, and the next
+     * forward repacks into the same allocation. */
+    tensor_destroy(layer_backward(layer, grad));
+    sgd_optimizer_t *sgd = sgd_create(0.1f);
+    sgd_step(sgd, layer);
+    assert(*layer->weights_version != version);
+    assert_forward_current(layer, x);
+    assert(layer->packed_weights->panels.data == panels);
+
+    layer->weights->data[3] += 1.0f;
+    layer_sync_weights(layer);
+    assert_forward_current(layer, x);
+
+    /* A kernel of another width makes the panels stale. */
+    gemm_isa_t isa = gemm_get_isa();
+    gemm_set_isa(GEMM_ISA_SCALAR);
+    assert_forward_current(layer, x);
+    gemm_set_isa(isa);
+    assert_forward_current(layer, x);
+
+    /* A shared layer and a param arena follow the weights' owner. A shared
+     * layer reads the owner's panels, so after a step whichever forward runs
+     * first repacks them for both. */
+    dense_layer_t *shared = layer_create_shared(layer);
+    assert(shared->packed_weights == layer->packed_weights);
+    assert_forward_current(shared, x);
+    sgd_step(sgd, layer);
+    assert_forward_current(shared, x);
+    version = layer->packed_weights->version;
+    assert_forward_current(layer, x);
+    assert(layer->packed_weights->version == version && layer->packed_weights->panels.data == panels);
+
+    dense_layer_t *layers[1] = {layer};
+    param_arena_t *params = param_arena_create(layers, 1);
+    assert(layer->weights_version == params->values_version);
+    assert_forward_current(layer, x);
+    tensor_destroy(layer_backward(layer, grad));
+    adam_optimizer_t *adam = adam_create(0.01f, 1);
+    adam_step_params(adam, params);
+    assert_forward_current(layer, x);
+
+    /* 16-bit weights are read in place. */
+    assert(param_arena_set_precision(params, layers, 1, PRECISION_BF16));
+    gemm_packed_release(&layer->packed_weights->panels);
+    assert(layer_forward(layer, x) && layer->packed_weights->panels.nr == 0);
+
+    adam_destroy(adam);
+    sgd_destroy(sgd);
+    tensor_destroy(x);
+    tensor_destroy(grad);
+    layer_destroy(shared);
+    layer_destroy(layer);
+    param_arena_destroy(params);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running Layer Tests\n");
+
+    test_layer_gradients();
+    test_layer_reserved_workspace();
+    test_param_arena_optimizers();
+    test_layer_strided_input();
+    test_layer_packed_weights();
+
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/loss.h"
+#include "../include/network.h"
+#include "../include/gemm.h"
+#include "../include/threadpool.h"
+
+static int same_bits(const tensor_t *a, const tensor_t *b) {
+    for (size_t i = 0; i < a->rows; i++) {
+        if (memcmp(a->data + i * a->stride, b->data + i * b->stride, a->cols * sizeof(float)) != 0) return 0;
+    }
+    return 1;
+}
+
+/* Each fused call returns what the loss alone returns and writes what the
+ * derivative alone writes. */
+void test_fused_matches_separate() {
+    printf("Testing fused loss and gradient against separate calls... ");
+    tensor_t *p = tensor_create(37, 53);
+    tensor_t *t = tensor_create(37, 53);
+    tensor_t *fused = tensor_create(37, 53);
+    tensor_t *separate = tensor_create(37, 53);
+    tensor_random(p, 0.0f, 1.0f);
+    tensor_random(t, 0.0f, 1.0f);
+    p->data[0] = 0.0f;
+    p->data[1] = 1.0f;
+
+    assert(loss_mse_with_grad(p, t, fused) == loss_mse(p, t));
+    loss_mse_derivative(p, t, separate);
+    assert(same_bits(fused, separate));
+
+    assert(loss_bce_with_grad(p, t, fused) == loss_binary_crossentropy(p, t));
+    loss_bce_derivative(p, t, separate);
+    assert(same_bits(fused, separate));
+
+    tensor_random(p, -30.0f, 30.0f);
+    for (int m = 0; m < 2; m++) {
+        math_mode_t mode = m ? MATH_FAST : MATH_PRECISE;
+        assert(loss_bce_logits_with_grad(p, t, fused, mode) == loss_bce_with_logits(p, t, mode));
+        loss_bce_with_logits_derivative(p, t, separate, mode);
+        for (size_t i = 0; i < 37 * 53; i++) assert(fabsf(fused->data[i] - separate->data[i]) < 1e-10f);
+    }
+
+    /* Strided views take the row-by-row path. */
+    tensor_t wide = tensor_view(p->data, 37, 40, 53);
+    tensor_t targets = tensor_view(t->data, 37, 40, 53);
+    tensor_t grad = tensor_view(fused->data, 37, 40, 53);
+    tensor_t *packed_p = tensor_create(37, 40), *packed_t = tensor_create(37, 40), *packed_g = tensor_create(37, 40);
+    tensor_copy_data(packed_p, &wide);
+    tensor_copy_data(packed_t, &targets);
+    float strided = loss_mse_with_grad(&wide, &targets, &grad);
+    assert(fabsf(strided - loss_mse_with_grad(packed_p, packed_t, packed_g)) < 1e-6f * strided);
+    tensor_t packed_view = tensor_view(packed_g->data, 37, 40, 40);
+    assert(same_bits(&grad, &packed_view));
+
+    assert(loss_mse_with_grad(p, t, packed_g) == 0.0f);
+
+    tensor_destroy(p);
+    tensor_destroy(t);
+    tensor_destroy(fused);
+    tensor_destroy(separate);
+    tensor_destroy(packed_p);
+    tensor_destroy(packed_t);
+    tensor_destroy(packed_g);
+    printf("✓\n");
+}
+
+/* Four million equal terms: a single float accumulator stalls once the sum
+ * dwarfs each term, the pairwise sum stays within a few ulps. The value is
+ * also the same for every thread count and for the scalar and vector lanes. */
+void test_reduction_accuracy() {
+    printf("Testing pairwise reduction accuracy and determinism... ");
+    size_t rows = 2048, cols = 2048;
+    tensor_t *p = tensor_create(rows, cols);
+    tensor_t *t = tensor_create(rows, cols);
+    tensor_t *g = tensor_create(rows, cols);
+    tensor_fill(p, 0.1f);
+    double term = (double)0.1f * (double)0.1f;
+
+    float loss = loss_mse_with_grad(p, t, g);
+    assert(fabs(loss - term) / term < 1e-6);
+
+    threadpool_init(3);
+    assert(loss_mse_with_grad(p, t, g) == loss);
+    threadpool_init(1);
+    assert(loss_mse_with_grad(p, t, g) == loss);
+    gemm_isa_t isa = gemm_get_isa();
+    gemm_set_isa(GEMM_ISA_SCALAR);
+    assert(loss_mse_with_grad(p, t, g) == loss);
+    gemm_set_isa(isa);
+    threadpool_init(0);
+
+    tensor_destroy(p);
+    tensor_destroy(t);
+    tensor_destroy(g);
+    printf("✓\n");
+}
+
+static double softmax_reference(const tensor_t *z, const tensor_t *t, tensor_t *grad) {
+    double total = 0.0;
+    for (size_t i = 0; i < z->rows; i++) {
+        const float *zi = z->data + i * z->stride, *ti = t->data + i * t->stride;
+        double max = zi[0], s = 0.0;
+        for (size_t j = 1; j < z->cols; j++) if (zi[j] > max) max = zi[j];
+        for (size_t j = 0; j < z->cols; j++) s += exp(zi[j] - max);
+        for (size_t j = 0; j < z->cols; j++) {
+            double log_softmax = zi[j] - max - log(s);
+            total -= ti[j] * log_softmax;
+            grad->data[i * grad->stride + j] = (float)((exp(log_softmax) - ti[j]) / z->rows);
+        }
+    }
+    return total / z->rows;
+}
+
+void test_softmax_crossentropy() {
+    printf("Testing softmax cross-entropy... ");
+    /* 300 classes spans more than one chunk per row. */
+    static const size_t classes[] = {3, 10, 300};
+    for (size_t c = 0; c < 3; c++) {
+        size_t rows = 33, cols = classes[c];
+        tensor_t *z = tensor_create(rows, cols);
+        tensor_t *t = tensor_create(rows, cols);
+        tensor_t *g = tensor_create(rows, cols);
+        tensor_t *expected = tensor_create(rows, cols);
+        tensor_random(z, -20.0f, 20.0f);
+        z->data[0] = 150.0f;    /* exp(150) alone would overflow */
+        for (size_t i = 0; i < rows; i++) t->data[i * cols + (i * 7) % cols] = 1.0f;
+
+        double reference = softmax_reference(z, t, expected);
+        for (int m = 0; m < 2; m++) {
+            math_mode_t mode = m ? MATH_FAST : MATH_PRECISE;
+            float loss = loss_softmax_crossentropy_with_grad(z, t, g, mode);
+            assert(isfinite(loss) && fabs(loss - reference) < 1e-5 * (1.0 + reference));
+            assert(loss == loss_softmax_crossentropy(z, t, mode));
+            for (size_t i = 0; i < rows; i++) {
+                double row_sum = 0.0;
+                for (size_t j = 0; j < cols; j++) {
+                    assert(fabsf(g->data[i * cols + j] - expected->data[i * cols + j]) < 1e-6f);
+                    row_sum += g->data[i * cols + j];
+                }
+                assert(fabs(row_sum) < 1e-6);
+            }
+        }
+
+        tensor_destroy(z);
+        tensor_destroy(t);
+        tensor_destroy(g);
+        tensor_destroy(expected);
+    }
+    printf("✓\n");
+}
+
+/* Three clusters learned through a linear head with the softmax loss. */
+void test_softmax_network() {
+    printf("Testing multi-class training with softmax cross-entropy... ");
+    size_t batch = 30;
+    tensor_t *x = tensor_create(batch, 2);
+    tensor_t *y = tensor_create(batch, 3);
+    static const float centers[3][2] = {{1.0f, 0.0f}, {-1.0f, 1.0f}, {0.0f, -1.0f}};
+    for (size_t i = 0; i < batch; i++) {
+        size_t label = i % 3;
+        x->data[2 * i] = centers[label][0] + 0.1f * (float)((int)(i * 37 % 7) - 3) / 3.0f;
+        x->data[2 * i + 1] = centers[label][1] + 0.1f * (float)((int)(i * 11 % 5) - 2) / 2.0f;
+        y->data[3 * i + label] = 1.0f;
+    }
+
+    network_t *network = network_create();
+    network_add_dense(network, 2, 16, ACTIVATION_RELU);
+    network_add_dense(network, 16, 3, ACTIVATION_NONE);
+    assert(network_build(network, batch));
+    adam_optimizer_t *opt = adam_create(0.05f, 2);
+    float first = network_train_step(network, x, y, NETWORK_LOSS_SOFTMAX_CE, opt), loss = first;
+    for (int step = 0; step < 200; step++) loss = network_train_step(network, x, y, NETWORK_LOSS_SOFTMAX_CE, opt);
+    assert(loss < 0.1f * first);
+
+    const tensor_t *out = network_forward(network, x);
+    for (size_t i = 0; i < batch; i++) {
+        const float *row = out->data + 3 * i;
+        size_t best = row[1] > row[0] ? 1 : 0;
+        if (row[2] > row[best]) best = 2;
+        assert(best == i % 3);
+    }
+
+    /* The head must be linear. */
+    network_t *sigmoid_head = network_create();
+    network_add_dense(sigmoid_head, 2, 3, ACTIVATION_SIGMOID);
+    assert(network_build(sigmoid_head, batch));
+    assert(network_forward(sigmoid_head, x));
+    assert(network_loss(sigmoid_head, y, NETWORK_LOSS_SOFTMAX_CE) == 0.0f);
+
+    network_destroy(sigmoid_head);
+    network_destroy(network);
+    adam_destroy(opt);
+    tensor_destroy(x);
+    tensor_destroy(y);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running Loss Tests\n");
+    threadpool_init(0);
+
+    test_fused_matches_separate();
+    test_reduction_accuracy();
+    test_softmax_crossentropy();
+    test_softmax_network();
+
+    threadpool_shutdown();
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}
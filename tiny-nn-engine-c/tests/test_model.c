@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "../include/model.h"
+#include "../include/network.h"
+
+#define MODEL_PATH "test_model.tnm"
+
+/* A network a few Adam steps into training, so the saved layers have moved
+ * biases and live in a param arena rather than in tensors of their own. */
+static network_t* build_trained_network(void) {
+    network_t *network = network_create();
+    network_add_dense(network, 7, 33, ACTIVATION_RELU);
+    network_add_dense(network, 33, 5, ACTIVATION_NONE);
+    network_add_dense(network, 5, 2, ACTIVATION_SIGMOID);
+    assert(network_build(network, 6));
+
+    tensor_t *x = tensor_create(6, 7);
+    tensor_t *y = tensor_create(6, 2);
+    tensor_random(x, -1.0f, 1.0f);
+    tensor_random(y, 0.0f, 1.0f);
+    adam_optimizer_t *adam = adam_create(0.05f, 3);
+    for (int step = 0; step < 5; step++) network_train_step(network, x, y, NETWORK_LOSS_BCE, adam);
+    adam_destroy(adam);
+    tensor_destroy(x);
+    tensor_destroy(y);
+    return network;
+}
+
+static int inside_map(const inference_model_t *model, const void *p) {
+    const char *base = (const char*)model->map;
+    return (const char*)p >= base && (const char*)p < base + model->map_size;
+}
+
+void test_model_save_load() {
+    printf("Testing model save and mapped load... ");
+    network_t *network = build_trained_network();
+    dense_layer_t **layers = network->layers;
+    assert(model_save(MODEL_PATH, layers, 3));
+
+    inference_model_t *loaded = model_load(MODEL_PATH);
+    assert(loaded != NULL);
+    assert(loaded->num_layers == 3 && loaded->input_size == 7 && loaded->output_size == 2);
+    assert(loaded->max_hidden == 33 && loaded->storage == NULL);
+
+    for (int i = 0; i < 3; i++) {
+        const inference_layer_t *layer = &loaded->layers[i];
+        assert(layer->activation == layers[i]->activation && layer->precision == PRECISION_FP32);
+        assert(inside_map(loaded, layer->weights) && inside_map(loaded, layer->bias));
+        assert((uintptr_t)layer->weights % 64 == 0 && (uintptr_t)layer->bias % 64 == 0);
+        assert(memcmp(layer->weights, layers[i]->weights->data,
+                      layer->input_size * layer->output_size * sizeof(float)) == 0);
+        assert(memcmp(layer->bias, layers[i]->bias->data, layer->output_size * sizeof(float)) == 0);
+        /* Packing is opt-in, so nothing is copied out of the mapping. */
+        assert(layer->packed.data == NULL && !gemm_packed_current(&layer->packed));
+    }
+
+    inference_model_t *copy = inference_model_create(layers, 3);
+    tensor_t *x = tensor_create(6, 7);
+    tensor_t *expected = tensor_create(6, 2);
+    tensor_t *out = tensor_create(6, 2);
+    tensor_random(x, -1.0f, 1.0f);
+    assert(inference_forward(copy, x, expected, NULL));
+    assert(inference_forward(loaded, x, out, NULL));
+    for (size_t i = 0; i < 6 * 2; i++) assert(fabsf(out->data[i] - expected->data[i]) < 1e-6f);
+    assert(inference_model_pack(loaded) && gemm_packed_current(&loaded->layers[0].packed));
+    assert(inference_forward(loaded, x, out, NULL));
+    assert(memcmp(out->data, expected->data, 6 * 2 * sizeof(float)) == 0);
+
+    /* Panels for another kernel width fall back to the plain weights until
+     * the model is repacked. */
+    gemm_isa_t isa = gemm_get_isa();
+    gemm_set_isa(GEMM_ISA_SCALAR);
+    assert(inference_forward(loaded, x, out, NULL));
+    for (size_t i = 0; i < 6 * 2; i++) assert(fabsf(out->data[i] - expected->data[i]) < 1e-6f);
+    assert(inference_model_pack(loaded) && gemm_packed_current(&loaded->layers[0].packed));
+    assert(inference_forward(loaded, x, out, NULL));
+    for (size_t i = 0; i < 6 * 2; i++) assert(fabsf(out->data[i] - expected->data[i]) < 1e-6f);
+    gemm_set_isa(isa);
+
+    tensor_destroy(x);
+    tensor_destroy(expected);
+    tensor_destroy(out);
+    inference_model_destroy(copy);
+    inference_model_destroy(loaded);
+    network_destroy(network);
+    printf("✓\n");
+}
+
+void test_model_half_precision() {
+    printf("Testing bf16 model save and load... ");
+    network_t *network = build_trained_network();
+    dense_layer_t **layers = network->layers;
+    assert(model_save_precision(MODEL_PATH, layers, 3, PRECISION_BF16));
+
+    inference_model_t *loaded = model_load(MODEL_PATH);
+    assert(loaded != NULL && loaded->precision == PRECISION_BF16);
+    for (int i = 0; i < 3; i++) {
+        const inference_layer_t *layer = &loaded->layers[i];
+        const uint16_t *weights = (const uint16_t*)layer->weights;
+        assert(layer->precision == PRECISION_BF16 && inside_map(loaded, weights));
+        assert(layer->packed.nr == 0);
+        for (size_t j = 0; j < layer->input_size * layer->output_size; j++) {
+            assert(weights[j] == half_from_float(layers[i]->weights->data[j], PRECISION_BF16));
+        }
+    }
+
+    /* Bit-identical to a bf16 model built in memory from the same layers. */
+    inference_model_t *copy = inference_model_create_precision(layers, 3, PRECISION_BF16);
+    tensor_t *x = tensor_create(6, 7);
+    tensor_t *expected = tensor_create(6, 2);
+    tensor_t *out = tensor_create(6, 2);
+    tensor_random(x, -1.0f, 1.0f);
+    assert(inference_forward(copy, x, expected, NULL));
+    assert(inference_forward(loaded, x, out, NULL));
+    assert(memcmp(out->data, expected->data, 6 * 2 * sizeof(float)) == 0);
+
+    tensor_destroy(x);
+    tensor_destroy(expected);
+    tensor_destroy(out);
+    inference_model_destroy(copy);
+    inference_model_destroy(loaded);
+    remove(MODEL_PATH);
+    network_destroy(network);
+    printf("✓\n");
+}
+
+static void rewrite_byte(long offset, char value) {
+    FILE *file = fopen(MODEL_PATH, "r+b");
+    fseek(file, offset, SEEK_SET);
+    fputc(value, file);
+    fclose(file);
+}
+
+void test_model_rejects_corrupt_files() {
+    printf("Testing model validation... ");
+    network_t *network = build_trained_network();
+    dense_layer_t **layers = network->layers;
+
+    assert(model_save(MODEL_PATH, layers, 3));
+    rewrite_byte(0, 'X');
+    assert(model_load(MODEL_PATH) == NULL);
+
+    assert(model_save(MODEL_PATH, layers, 3));
+    rewrite_byte((long)offsetof(model_header_t, version), 9);
+    assert(model_load(MODEL_PATH) == NULL);
+
+    /* Second layer's input width no longer matches the first layer's output. */
+    assert(model_save(MODEL_PATH, layers, 3));
+    rewrite_byte((long)(sizeof(model_header_t) + sizeof(model_layer_record_t) +
+                        offsetof(model_layer_record_t, input_size)), 34);
+    assert(model_load(MODEL_PATH) == NULL);
+
+    assert(model_save(MODEL_PATH, layers, 3));
+    FILE *file = fopen(MODEL_PATH, "ab");
+    fputc(0, file);
+    fclose(file);
+    assert(model_load(MODEL_PATH) == NULL);
+
+    remove(MODEL_PATH);
+    network_destroy(network);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running Model File Tests\n");
+
+    test_model_save_load();
+    test_model_half_precision();
+    test_model_rejects_corrupt_files();
+
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include "../include/network.h"
+#include "../include/loss.h"
+
+#define DEPTH 6
+
+static const size_t widths[DEPTH + 1] = {10, 48, 64, 64, 32, 16, 3};
+
+static network_t* build_checkpointed(size_t max_batch, size_t interval) {
+    network_t *network = network_create();
+    for (size_t i = 0; i < DEPTH; i++) {
+        activation_type_t act = i + 1 == DEPTH ? ACTIVATION_SIGMOID : ACTIVATION_RELU;
+        assert(network_add_dense(network, widths[i], widths[i + 1], act) != NULL);
+    }
+    assert(network_checkpoint(network, interval));
+    assert(network_build(network, max_batch));
+    return network;
+}
+
+static network_t* build_network(size_t max_batch) {
+    return build_checkpointed(max_batch, 1);
+}
+
+/* The planned network must compute exactly what independently reserved
+ * layers compute; any wrongly shared buffer would corrupt a later step. */
+void test_network_matches_layers() {
+    printf("Testing network against separately reserved layers... ");
+    network_t *network = build_network(16);
+    dense_layer_t *layers[DEPTH];
+    for (size_t i = 0; i < DEPTH; i++) {
+        dense_layer_t *src = network->layers[i];
+        layers[i] = layer_create(widths[i], widths[i + 1], src->activation);
+        tensor_copy_data(layers[i]->weights, src->weights);
+        tensor_random(src->bias, -0.3f, 0.3f);
+        tensor_copy_data(layers[i]->bias, src->bias);
+        assert(layer_reserve(layers[i], 16));
+    }
+    param_arena_t *params = param_arena_create(layers, DEPTH);
+    adam_optimizer_t *network_opt = adam_create(0.01f, DEPTH);
+    adam_optimizer_t *layer_opt = adam_create(0.01f, DEPTH);
+
+    tensor_t *x = tensor_create(16, widths[0]);
+    tensor_t *y = tensor_create(16, widths[DEPTH]);
+    tensor_t *grad = tensor_create(16, widths[DEPTH]);
+    for (int step = 0; step < 5; step++) {
+        /* Short last batches reuse the same plan. */
+        size_t batch = step % 2 ? 11 : 16;
+        x->rows = y->rows = grad->rows = batch;
+        tensor_random(x, -1.0f, 1.0f);
+        tensor_random(y, 0.0f, 1.0f);
+
+        float loss = network_train_step(network, x, y, NETWORK_LOSS_MSE, network_opt);
+
+        const tensor_t *out = x;
+        for (size_t i = 0; i < DEPTH; i++) out = layer_forward(layers[i], out);
+        float expected = loss_mse(out, y);
+        loss_mse_derivative(out, y, grad);
+        const tensor_t *g = grad;
+        for (size_t i = DEPTH; i-- > 0;) g = layer_backward(layers[i], g);
+        adam_step_params(layer_opt, params);
+
+        assert(loss == expected);
+        assert(memcmp(network->params->values, params->values, params->count * sizeof(float)) == 0);
+    }
+
+    tensor_destroy(x);
+    tensor_destroy(y);
+    tensor_destroy(grad);
+    adam_destroy(network_opt);
+    adam_destroy(layer_opt);
+    for (size_t i = 0; i < DEPTH; i++) layer_destroy(layers[i]);
+    param_arena_destroy(params);
+    network_destroy(network);
+    printf("✓\n");
+}
+
+void test_network_memory_plan() {
+    printf("Testing activation memory plan... ");
+    network_t *network = build_network(64);
+
+    /* Every output stays live until backward; the gradients only need room
+     * for about two layers at a time instead of all of them. */
+    size_t outputs = 0, widest = 0;
+    for (size_t i = 1; i <= DEPTH; i++) {
+        outputs += 64 * widths[i] * sizeof(float);
+        if (widths[i] > widest) widest = widths[i];
+    }
+    assert(network->arena_bytes >= outputs);
+    assert(network->arena_bytes <= outputs + 3 * 64 * widest * sizeof(float));
+    assert(network->unplanned_bytes > 2 * outputs);
+    assert((size_t)network->arena % 64 == 0);
+
+    assert(!network_add_dense(network, 3, 3, ACTIVATION_NONE));
+    network_destroy(network);
+
+    network_t *bad = network_create();
+    network_add_dense(bad, 4, 8, ACTIVATION_RELU);
+    network_add_dense(bad, 7, 2, ACTIVATION_NONE);
+    assert(!network_build(bad, 8));
+    network_destroy(bad);
+    printf("✓\n");
+}
+
+/* Recomputing segments in backward reproduces the stored activations bit
+ * for bit, so training is unchanged for every interval. */
+void test_network_checkpointing() {
+    printf("Testing activation checkpointing... ");
+    network_t *reference = build_network(16);
+    assert(reference->checkpoint_interval == 1 && reference->recompute_flops == 0.0);
+    static const size_t intervals[] = {NETWORK_CHECKPOINT_SQRT, 3, DEPTH, 2 * DEPTH};
+    static const size_t resolved[] = {2, 3, DEPTH, DEPTH};
+    network_t *networks[4];
+    adam_optimizer_t *opts[5];
+    for (size_t n = 0; n < 4; n++) {
+        networks[n] = build_checkpointed(16, intervals[n]);
+        assert(networks[n]->checkpoint_interval == resolved[n]);
+        assert(networks[n]->params->count == reference->params->count);
+        memcpy(networks[n]->params->values, reference->params->values,
+               reference->params->count * sizeof(float));
+        opts[n] = adam_create(0.01f, DEPTH);
+    }
+    opts[4] = adam_create(0.01f, DEPTH);
+
+    /* Interval 3 recomputes layers 0, 1, 3 and 4. */
+    double flops = 0.0;
+    for (size_t i = 0; i < DEPTH; i++) {
+        if (i % 3 != 2) flops += (2.0 * widths[i] + 2.0) * widths[i + 1];
+    }
+    assert(networks[1]->recompute_flops == flops);
+    assert(!network_checkpoint(networks[1], 2));
+
+    tensor_t *x = tensor_create(16, widths[0]);
+    tensor_t *y = tensor_create(16, widths[DEPTH]);
+    for (int step = 0; step < 5; step++) {
+        size_t batch = step % 2 ? 11 : 16;
+        x->rows = y->rows = batch;
+        tensor_random(x, -1.0f, 1.0f);
+        tensor_random(y, 0.0f, 1.0f);
+
+        float expected = network_train_step(reference, x, y, NETWORK_LOSS_MSE, opts[4]);
+        for (size_t n = 0; n < 4; n++) {
+            assert(network_train_step(networks[n], x, y, NETWORK_LOSS_MSE, opts[n]) == expected);
+            assert(memcmp(networks[n]->params->values, reference->params->values,
+                          reference->params->count * sizeof(float)) == 0);
+        }
+    }
+
+    tensor_destroy(x);
+    tensor_destroy(y);
+    for (size_t n = 0; n < 4; n++) {
+        network_destroy(networks[n]);
+        adam_destroy(opts[n]);
+    }
+    adam_destroy(opts[4]);
+    network_destroy(reference);
+    printf("✓\n");
+}
+
+/* A deep stack of equal layers keeps about 2 sqrt(N) outputs instead of N. */
+void test_checkpoint_memory() {
+    printf("Testing checkpointed memory plan... ");
+    size_t depth = 16, width = 64, batch = 32;
+    size_t sizes[] = {1, NETWORK_CHECKPOINT_SQRT};
+    size_t bytes[2];
+    for (size_t n = 0; n < 2; n++) {
+        network_t *network = network_create();
+        for (size_t i = 0; i < depth; i++) network_add_dense(network, width, width, ACTIVATION_RELU);
+        assert(network_checkpoint(network, sizes[n]) && network_build(network, batch));
+        bytes[n] = network->arena_bytes;
+        network_destroy(network);
+    }
+
+    size_t output = batch * width * sizeof(float);
+    assert(bytes[0] >= depth * output);
+    assert(bytes[1] <= (2 * 4 + 3) * output);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running Network Tests\n");
+
+    test_network_matches_layers();
+    test_network_memory_plan();
+    test_network_checkpointing();
+    test_checkpoint_memory();
+
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/profile.h"
+#include "../include/network.h"
+#include "../include/threadpool.h"
+
+#define TRACE_PATH "test_profile_trace.json"
+
+static char* read_file(const char *path) {
+    FILE *file = fopen(path, "r");
+    assert(file);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = (char*)malloc((size_t)size + 1);
+    assert(fread(text, 1, (size_t)size, file) == (size_t)size);
+    text[size] = '\0';
+    fclose(file);
+    return text;
+}
+
+static size_t count_occurrences(const char *text, const char *needle) {
+    size_t count = 0;
+    for (const char *p = strstr(text, needle); p; p = strstr(p + 1, needle)) count++;
+    return count;
+}
+
+static uint64_t total_calls(void) {
+    uint64_t calls = 0;
+    for (int op = 0; op < PROFILE_NUM_OPS; op++) calls += profile_query((profile_op_t)op).calls;
+    return calls;
+}
+
+/* Compiled out, the ops leave nothing behind and the trace is empty. */
+void test_profile_disabled() {
+    printf("Testing profiler compiled out... ");
+    tensor_t *a = tensor_create(8, 16);
+    tensor_t *b = tensor_create(16, 4);
+    tensor_t *c = tensor_create(8, 4);
+    tensor_matmul_into(a, b, c);
+    tensor_relu(c, c);
+
+    assert(total_calls() == 0);
+    assert(profile_query(PROFILE_TENSOR_CREATE).allocated == 0.0);
+    assert(profile_write_trace(TRACE_PATH));
+    char *trace = read_file(TRACE_PATH);
+    assert(strstr(trace, "\"traceEvents\": [") && !strstr(trace, "\"ph\": \"X\""));
+
+    free(trace);
+    remove(TRACE_PATH);
+    tensor_destroy(a);
+    tensor_destroy(b);
+    tensor_destroy(c);
+    printf("✓\n");
+}
+
+void test_profile_counters() {
+    printf("Testing per-op counters... ");
+    tensor_t *a = tensor_create(8, 16);
+    tensor_t *b = tensor_create(16, 4);
+    tensor_t *c = tensor_create(8, 4);
+    profile_reset();
+
+    tensor_matmul_into(a, b, c);
+    tensor_matmul_into(a, b, c);
+    tensor_add(c, c, c);
+    tensor_matmul_into(b, b, c);    /* rejected: not recorded */
+    tensor_t *d = tensor_create(3, 5);
+
+    profile_stats_t mm = profile_query(PROFILE_TENSOR_MATMUL);
+    assert(mm.calls == 2 && mm.flops == 2.0 * 2 * 8 * 16 * 4);
+    assert(mm.bytes == 2.0 * (8 * 16 + 16 * 4 + 8 * 4) * sizeof(float));
+    assert(mm.seconds > 0.0 && mm.self_seconds == mm.seconds);
+
+    profile_stats_t add = profile_query(PROFILE_TENSOR_ADD);
+    assert(add.calls == 1 && add.flops == 32.0 && add.bytes == 3.0 * 32 * sizeof(float));
+
+    profile_stats_t create = profile_query(PROFILE_TENSOR_CREATE);
+    assert(create.calls == 1 && create.allocated == sizeof(tensor_t) + 15 * sizeof(float));
+    assert(total_calls() == 4 && profile_dropped_events() == 0);
+
+    profile_reset();
+    assert(total_calls() == 0);
+
+    tensor_destroy(a);
+    tensor_destroy(b);
+    tensor_destroy(c);
+    tensor_destroy(d);
+    printf("✓\n");
+}
+
+/* Nested ops count in their caller's total but not its self time. */
+void test_profile_nesting() {
+    printf("Testing inclusive and self time... ");
+    network_t *network = network_create();
+    network_add_dense(network, 32, 64, ACTIVATION_RELU);
+    network_add_dense(network, 64, 8, ACTIVATION_SIGMOID);
+    assert(network_build(network, 16));
+    adam_optimizer_t *opt = adam_create(0.01f, 2);
+    tensor_t *x = tensor_create(16, 32);
+    tensor_t *y = tensor_create(16, 8);
+    tensor_fill(x, 0.5f);
+    profile_reset();
+
+    for (int step = 0; step < 3; step++) network_train_step(network, x, y, NETWORK_LOSS_MSE, opt);
+
+    profile_stats_t forward = profile_query(PROFILE_LAYER_FORWARD);
+    profile_stats_t backward = profile_query(PROFILE_LAYER_BACKWARD);
+    profile_stats_t tn = profile_query(PROFILE_TENSOR_MATMUL_TN);
+    profile_stats_t adam = profile_query(PROFILE_ADAM_STEP);
+    assert(forward.calls == 6 && backward.calls == 6 && tn.calls == 6 && adam.calls == 3);
+    assert(forward.flops == 3.0 * ((2 * 32 + 2) * 16 * 64 + (2 * 64 + 2) * 16 * 8));
+    assert(backward.self_seconds + tn.seconds <= backward.seconds * 1.0001);
+    assert(adam.flops == 12.0 * 3 * network->params->count);
+    assert(profile_query(PROFILE_LOSS_MSE_WITH_GRAD).calls == 3);
+    assert(profile_query(PROFILE_LOSS_MSE).calls == 0);
+    assert(profile_query(PROFILE_TENSOR_CREATE).calls == 0);
+
+    tensor_destroy(x);
+    tensor_destroy(y);
+    adam_destroy(opt);
+    network_destroy(network);
+    printf("✓\n");
+}
+
+static void add_task(void *arg, size_t begin, size_t end) {
+    tensor_t *t = (tensor_t*)arg;
+    for (size_t i = begin; i < end; i++) {
+        tensor_t row = tensor_rows(t, i, 1);
+        tensor_add(&row, &row, &row);
+    }
+}
+
+/* Ops run on pool threads land in those threads' buffers; the query sums
+ * them and the trace gives each thread its own track. */
+void test_profile_threads_and_trace() {
+    printf("Testing per-thread buffers and trace export... ");
+    threadpool_init(4);
+    tensor_t *t = tensor_create(64, 8);
+    profile_reset();
+
+    threadpool_parallel_for(64, 1, add_task, t);
+    assert(profile_query(PROFILE_TENSOR_ADD).calls == 64);
+
+    assert(profile_write_trace(TRACE_PATH));
+    char *trace = read_file(TRACE_PATH);
+    assert(strncmp(trace, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [", 42) == 0);
+    assert(count_occurrences(trace, "\"ph\": \"X\"") == 64);
+    assert(count_occurrences(trace, "\"name\": \"tensor_add\"") == 64);
+    assert(count_occurrences(trace, "\"args\": {\"flops\": 8, \"bytes\": 96}") == 64);
+    assert(count_occurrences(trace, "\"ph\": \"M\"") >= 1);
+    free(trace);
+    remove(TRACE_PATH);
+
+    /* A full event buffer drops events, not counts. */
+    profile_reset();
+    tensor_t row = tensor_rows(t, 0, 1);
+    for (int i = 0; i < PROFILE_MAX_EVENTS + 10; i++) tensor_scale(&row, 1.0f);
+    assert(profile_query(PROFILE_TENSOR_SCALE).calls == PROFILE_MAX_EVENTS + 10);
+    assert(profile_dropped_events() == 10);
+
+    tensor_destroy(t);
+    threadpool_init(0);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running Profiler Tests\n");
+
+    if (!profile_enabled()) {
+        test_profile_disabled();
+    } else {
+        test_profile_counters();
+        test_profile_nesting();
+        test_profile_threads_and_trace();
+    }
+
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "../include/quant.h"
+#include "../include/threadpool.h"
+
+/* Input widths that are not multiples of 4 and output widths that are not
+ * multiples of QUANT_PANEL, so every layer has padded K groups and a partial
+ * panel. Output columns span a 16x range of magnitudes, which one scale per
+ * tensor would flatten to a few int8 steps in the smallest. */
+static void build_quant_layers(dense_layer_t **layers) {
+    layers[0] = layer_create(13, 70, ACTIVATION_RELU);
+    layers[1] = layer_create(70, 37, ACTIVATION_NONE);
+    layers[2] = layer_create(37, 5, ACTIVATION_SIGMOID);
+    for (int i = 0; i < 3; i++) {
+        tensor_t *w = layers[i]->weights;
+        for (size_t r = 0; r < w->rows; r++) {
+            for (size_t c = 0; c < w->cols; c++) w->data[r * w->cols + c] *= (float)(1 << (c % 5)) / 16.0f;
+        }
+        layer_sync_weights(layers[i]);
+        tensor_random(layers[i]->bias, -0.2f, 0.2f);
+    }
+}
+
+void test_quant_kernels_agree() {
+    printf("Testing int8 kernels are exact across ISAs... ");
+    dense_layer_t *layers[3];
+    build_quant_layers(layers);
+    quant_model_t *model = quant_model_create(layers, 3);
+    assert(model != NULL && model->layers[0].k_padded == 16);
+
+    tensor_t *x = tensor_create(7, 13);
+    tensor_t *reference = tensor_create(7, 5);
+    tensor_t *out = tensor_create(7, 5);
+    tensor_random(x, -2.0f, 2.0f);
+
+    gemm_isa_t best = gemm_get_isa();
+    gemm_set_isa(GEMM_ISA_SCALAR);
+    assert(quant_get_kernel() == QUANT_KERNEL_SCALAR);
+    assert(quant_forward(model, x, reference));
+
+    gemm_isa_t isas[] = {GEMM_ISA_AVX2, GEMM_ISA_AVX512};
+    for (size_t i = 0; i < 2; i++) {
+        gemm_set_isa(isas[i]);
+        assert(quant_forward(model, x, out));
+        assert(memcmp(out->data, reference->data, 7 * 5 * sizeof(float)) == 0);
+    }
+    gemm_set_isa(best);
+
+    tensor_destroy(x);
+    tensor_destroy(reference);
+    tensor_destroy(out);
+    quant_model_destroy(model);
+    for (int i = 0; i < 3; i++) layer_destroy(layers[i]);
+    printf("✓\n");
+}
+
+void test_quant_close_to_fp32() {
+    printf("Testing int8 inference against fp32... ");
+    dense_layer_t *layers[3];
+    build_quant_layers(layers);
+    inference_model_t *fp32 = inference_model_create(layers, 3);
+    quant_model_t *model = quant_model_from_inference(fp32);
+
+    tensor_t *x = tensor_create(64, 13);
+    tensor_t *expected = tensor_create(64, 5);
+    tensor_t *out = tensor_create(64, 5);
+    tensor_random(x, -1.0f, 1.0f);
+    assert(inference_forward(fp32, x, expected, NULL));
+    assert(quant_forward(model, x, out));
+
+    for (size_t i = 0; i < 64 * 5; i++) {
+        assert(fabsf(out->data[i] - expected->data[i]) < 0.02f);
+    }
+
+    tensor_destroy(x);
+    tensor_destroy(expected);
+    tensor_destroy(out);
+    quant_model_destroy(model);
+    inference_model_destroy(fp32);
+    for (int i = 0; i < 3; i++) layer_destroy(layers[i]);
+    printf("✓\n");
+}
+
+void test_quant_calibration_report() {
+    printf("Testing calibration report... ");
+    dense_layer_t *layers[3];
+    build_quant_layers(layers);
+    quant_model_t *model = quant_model_create(layers, 3);
+
+    /* Targets are the fp32 model's own one-hot predictions. */
+    tensor_t *x = tensor_create(200, 13);
+    tensor_t *targets = tensor_create(200, 5);
+    tensor_random(x, -1.0f, 1.0f);
+    inference_model_t *fp32 = inference_model_create(layers, 3);
+    assert(inference_forward(fp32, x, targets, NULL));
+    for (size_t i = 0; i < 200; i++) {
+        float *row = targets->data + i * 5;
+        size_t best = 0;
+        for (size_t j = 1; j < 5; j++) if (row[j] > row[best]) best = j;
+        for (size_t j = 0; j < 5; j++) row[j] = j == best ? 1.0f : 0.0f;
+    }
+
+    quant_report_t report;
+    assert(quant_calibrate(model, layers, 3, x, targets, &report));
+    assert(report.samples == 200);
+    assert(report.fp32_accuracy == 1.0f);
+    assert(report.int8_accuracy == report.agreement);
+    assert(report.accuracy_delta == report.int8_accuracy - report.fp32_accuracy);
+    assert(report.agreement > 0.9f);
+    assert(report.mean_abs_error <= report.max_abs_error && report.max_abs_error < 0.02f);
+
+    tensor_destroy(x);
+    tensor_destroy(targets);
+    inference_model_destroy(fp32);
+    quant_model_destroy(model);
+    for (int i = 0; i < 3; i++) layer_destroy(layers[i]);
+    printf("✓\n");
+}
+
+/* A linear single-output head gives logits, so its class is the sign; the
+ * 0/1 targets are read at 0.5 as before. */
+void test_quant_calibration_logits() {
+    printf("Testing calibration of a logit head... ");
+    dense_layer_t *layers[2] = {layer_create(13, 24, ACTIVATION_RELU), layer_create(24, 1, ACTIVATION_NONE)};
+    quant_model_t *model = quant_model_create(layers, 2);
+    inference_model_t *fp32 = inference_model_create(layers, 2);
+
+    tensor_t *x = tensor_create(200, 13);
+    tensor_t *targets = tensor_create(200, 1);
+    tensor_random(x, -1.0f, 1.0f);
+    assert(inference_forward(fp32, x, targets, NULL));
+    size_t between = 0;
+    for (size_t i = 0; i < 200; i++) {
+        float logit = targets->data[i];
+        between += logit > 0.0f && logit <= 0.5f;
+        targets->data[i] = logit > 0.0f ? 1.0f : 0.0f;
+    }
+    assert(between > 0);
+
+    quant_report_t report;
+    assert(quant_calibrate(model, layers, 2, x, targets, &report));
+    assert(report.fp32_accuracy == 1.0f && report.agreement > 0.9f);
+
+    tensor_destroy(x);
+    tensor_destroy(targets);
+    inference_model_destroy(fp32);
+    quant_model_destroy(model);
+    for (int i = 0; i < 2; i++) layer_destroy(layers[i]);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running Quantization Tests\n");
+    threadpool_init(4);
+
+    test_quant_kernels_agree();
+    test_quant_close_to_fp32();
+    test_quant_calibration_report();
+    test_quant_calibration_logits();
+
+    threadpool_shutdown();
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/rng.h"
+#include "../include/layer.h"
+#include "../include/gemm.h"
+#include "../include/threadpool.h"
+
+#define TWO_PI 6.28318530717958648
+
+static int same_bits(const tensor_t *a, const tensor_t *b) {
+    for (size_t i = 0; i < a->rows; i++) {
+        if (memcmp(a->data + i * a->stride, b->data + i * b->stride, a->cols * sizeof(float)) != 0) return 0;
+    }
+    return 1;
+}
+
+/* Word j of block 8 * g + l is element 32 * g + 8 * j + l of a fill. */
+static uint32_t fill_word(uint64_t seed, uint64_t stream, size_t index) {
+    uint64_t block = index / 32 * 8 + index % 8;
+    uint32_t key[2] = {(uint32_t)seed, (uint32_t)(seed >> 32)};
+    uint32_t words[4] = {(uint32_t)block, (uint32_t)(block >> 32), (uint32_t)stream, (uint32_t)(stream >> 32)};
+    rng_philox4x32(words, key);
+    return words[index % 32 / 8];
+}
+
+void test_philox_known_answers() {
+    printf("Testing Philox4x32-10 known answers... ");
+    /* From the Random123 distribution's kat_vectors. */
+    static const uint32_t cases[3][10] = {
+        {0, 0, 0, 0, 0, 0, 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+        {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+         0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+        {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0,
+         0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1},
+    };
+    for (size_t c = 0; c < 3; c++) {
+        uint32_t counter[4] = {cases[c][0], cases[c][1], cases[c][2], cases[c][3]};
+        rng_philox4x32(counter, cases[c] + 4);
+        assert(memcmp(counter, cases[c] + 6, sizeof(counter)) == 0);
+    }
+
+    /* The sequential reader walks blocks 0, 1, ... of its stream. */
+    rng_t rng;
+    rng_init(&rng, 0x1234567890ull, 9);
+    for (uint64_t block = 0; block < 3; block++) {
+        uint32_t key[2] = {0x34567890u, 0x12u};
+        uint32_t words[4] = {(uint32_t)block, 0, 9, 0};
+        rng_philox4x32(words, key);
+        for (size_t j = 0; j < 4; j++) assert(rng_u32(&rng) == words[j]);
+    }
+    for (int i = 0; i < 1000; i++) assert(rng_below(&rng, 7) < 7);
+    printf("✓\n");
+}
+
+/* A fill is a function of (seed, stream, index) only: the same for every
+ * thread count, ISA and stride, and different across streams. */
+void test_fill_reproducible() {
+    printf("Testing fills across threads, ISAs and views... ");
+    size_t rows = 301, cols = 997;
+    tensor_t *reference = tensor_create(rows, cols);
+    tensor_t *other = tensor_create(rows, cols);
+    tensor_t *wide = tensor_create(rows, cols + 13);
+    tensor_t view = tensor_view(wide->data + 5, rows, cols, cols + 13);
+
+    for (int normal = 0; normal < 2; normal++) {
+        threadpool_init(1);
+        if (normal) rng_fill_normal(reference, 0.5f, 2.0f, 42, 7);
+        else rng_fill_uniform(reference, -3.0f, 5.0f, 42, 7);
+
+        threadpool_init(3);
+        gemm_isa_t isa = gemm_get_isa();
+        for (int pass = 0; pass < 2; pass++) {
+            if (pass) gemm_set_isa(GEMM_ISA_SCALAR);
+            if (normal) {
+                rng_fill_normal(other, 0.5f, 2.0f, 42, 7);
+                rng_fill_normal(&view, 0.5f, 2.0f, 42, 7);
+            } else {
+                rng_fill_uniform(other, -3.0f, 5.0f, 42, 7);
+                rng_fill_uniform(&view, -3.0f, 5.0f, 42, 7);
+            }
+            assert(same_bits(other, reference));
+            assert(same_bits(&view, reference));
+        }
+        gemm_set_isa(isa);
+
+        if (normal) rng_fill_normal(other, 0.5f, 2.0f, 42, 8);
+        else rng_fill_uniform(other, -3.0f, 5.0f, 43, 7);
+        size_t equal = 0;
+        for (size_t i = 0; i < rows * cols; i++) equal += other->data[i] == reference->data[i];
+        assert(equal < rows * cols / 1000);
+    }
+
+    /* Uniform values are the fill words scaled. */
+    rng_fill_uniform(reference, -3.0f, 5.0f, 42, 7);
+    for (size_t i = 0; i < 5000; i++) {
+        float u = (float)(fill_word(42, 7, i) >> 8) * 0x1p-24f;
+        assert(reference->data[i] == -3.0f + u * 8.0f);
+    }
+
+    threadpool_init(0);
+    tensor_destroy(reference);
+    tensor_destroy(other);
+    tensor_destroy(wide);
+    printf("✓\n");
+}
+
+/* Every normal draw against Box-Muller in double precision from the same
+ * words, and the moments of a million draws. */
+void test_normal_distribution() {
+    printf("Testing normal and uniform distributions... ");
+    size_t n = 1 << 20;
+    tensor_t *z = tensor_create(1024, n / 1024);
+    rng_fill_normal(z, 0.0f, 1.0f, 3, 0);
+
+    double sum = 0.0, sum2 = 0.0, sum4 = 0.0, worst = 0.0;
+    size_t within = 0;
+    for (size_t i = 0; i < n; i++) {
+        size_t pair = i % 32 < 16 ? 0 : 16, lane = i % 8;
+        size_t base = i / 32 * 32 + pair + lane;
+        double u1 = (double)((fill_word(3, 0, base) >> 8) + 1) * 0x1p-24;
+        /* The angle keeps the top 24 bits of its word. */
+        double angle = TWO_PI * (double)(fill_word(3, 0, base + 8) >> 8) * 0x1p-24;
+        double r = sqrt(-2.0 * log(u1));
+        double expected = i % 16 < 8 ? r * cos(angle) : r * sin(angle);
+        double error = fabs(z->data[i] - expected);
+        if (error > worst) worst = error;
+
+        double v = z->data[i];
+        sum += v;
+        sum2 += v * v;
+        sum4 += v * v * v * v;
+        within += fabs(v) < 1.0;
+        assert(fabs(v) < 5.8);
+    }
+    assert(worst < 4e-6);
+    double mean = sum / n, var = sum2 / n - mean * mean;
+    assert(fabs(mean) < 0.005 && fabs(var - 1.0) < 0.01);
+    assert(fabs(sum4 / n - 3.0) < 0.05);
+    assert(fabs((double)within / n - 0.682689) < 0.003);
+
+    rng_fill_uniform(z, -1.0f, 3.0f, 3, 1);
+    sum = 0.0;
+    size_t below = 0;
+    for (size_t i = 0; i < n; i++) {
+        assert(z->data[i] >= -1.0f && z->data[i] < 3.0f);
+        sum += z->data[i];
+        below += z->data[i] < 0.0f;
+    }
+    assert(fabs(sum / n - 1.0) < 0.01);
+    assert(fabs((double)below / n - 0.25) < 0.003);
+
+    tensor_destroy(z);
+    printf("✓\n");
+}
+
+/* tensor_random and the initializers replay under the same global seed. */
+void test_global_seed() {
+    printf("Testing the global seed and He initialization... ");
+    rng_set_seed(2024);
+    dense_layer_t *first = layer_create(512, 256, ACTIVATION_RELU);
+    layer_he_init(first);
+
+    rng_set_seed(2024);
+    dense_layer_t *second = layer_create(512, 256, ACTIVATION_RELU);
+    assert(same_bits(first->weights, second->weights) == 0);
+    layer_he_init(second);
+    assert(same_bits(first->weights, second->weights));
+
+    double sum2 = 0.0;
+    size_t count = 512 * 256;
+    for (size_t i = 0; i < count; i++) sum2 += (double)first->weights->data[i] * first->weights->data[i];
+    assert(fabs(sqrt(sum2 / count) - sqrt(2.0 / 512)) < 0.01 * sqrt(2.0 / 512));
+
+    rng_set_seed(RNG_DEFAULT_SEED);
+    assert(rng_seed() == RNG_DEFAULT_SEED && rng_next_stream() == 0 && rng_next_stream() == 1);
+
+    layer_destroy(first);
+    layer_destroy(second);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running RNG Tests\n");
+    threadpool_init(0);
+
+    test_philox_known_answers();
+    test_fill_reproducible();
+    test_normal_distribution();
+    test_global_seed();
+
+    threadpool_shutdown();
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}
@@ -0,0 +1,245 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/server.h"
+#include "../include/threadpool.h"
+
+#define IN 12
+#define OUT 5
+#define CLIENTS 8
+#define REQUESTS 40
+
+static char socket_path[64];
+
+typedef struct {
+    inference_model_t *model;
+    dense_layer_t *layers[2];
+    server_t *server;
+    pthread_t thread;
+} fixture_t;
+
+static void* run_server(void *arg) {
+    fixture_t *f = (fixture_t*)arg;
+    assert(server_run(f->server));
+    return NULL;
+}
+
+static void start(fixture_t *f, size_t max_batch, unsigned max_wait_us) {
+    f->layers[0] = layer_create(IN, 32, ACTIVATION_RELU);
+    f->layers[1] = layer_create(32, OUT, ACTIVATION_SIGMOID);
+    tensor_random(f->layers[0]->bias, -0.5f, 0.5f);
+    f->model = inference_model_create(f->layers, 2);
+    snprintf(socket_path, sizeof(socket_path), "/tmp/tiny_nn_test_%d.sock", (int)getpid());
+    server_config_t config = {socket_path, max_batch, max_wait_us};
+    f->server = server_create(f->model, &config);
+    assert(f->server);
+    assert(pthread_create(&f->thread, NULL, run_server, f) == 0);
+}
+
+static void stop(fixture_t *f) {
+    server_stop(f->server);
+    pthread_join(f->thread, NULL);
+    server_destroy(f->server);
+    assert(access(socket_path, F_OK) != 0);
+    inference_model_destroy(f->model);
+    layer_destroy(f->layers[0]);
+    layer_destroy(f->layers[1]);
+}
+
+/* Row r of request id, so every reply can be checked against a local run. */
+static void fill_input(float *x, uint32_t id, size_t rows) {
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t j = 0; j < IN; j++) x[r * IN + j] = sinf((float)(id * 131 + r * 17 + j));
+    }
+}
+
+static int matches_local(const inference_model_t *model, const float *x, const float *y, size_t rows) {
+    tensor_t *input = tensor_wrap((float*)x, rows, IN);
+    tensor_t *expected = tensor_create(rows, OUT);
+    assert(inference_forward(model, input, expected, NULL));
+    int ok = 1;
+    for (size_t i = 0; i < rows * OUT; i++) ok &= fabsf(expected->data[i] - y[i]) < 1e-5f;
+    tensor_destroy(input);
+    tensor_destroy(expected);
+    return ok;
+}
+
+void test_server_roundtrip() {
+    printf("Testing server request round trip... ");
+    fixture_t f;
+    start(&f, 16, 50);
+    int fd = server_connect(socket_path);
+    assert(fd >= 0);
+
+    float x[3 * IN], y[3 * OUT];
+    for (uint32_t id = 1; id <= 3; id++) {
+        fill_input(x, id, id);
+        assert(server_infer(fd, id, x, id, IN, y, OUT));
+        assert(matches_local(f.model, x, y, id));
+    }
+
+    server_stats_t stats;
+    server_get_stats(f.server, &stats);
+    assert(stats.requests == 3 && stats.rows == 6 && stats.errors == 0);
+
+    close(fd);
+    stop(&f);
+    printf("✓\n");
+}
+
+typedef struct {
+    const inference_model_t *model;
+    uint32_t client;
+    int failures;
+} client_t;
+
+static void* client_main(void *arg) {
+    client_t *c = (client_t*)arg;
+    int fd = server_connect(socket_path);
+    if (fd < 0) {
+        c->failures = REQUESTS;
+        return NULL;
+    }
+    float x[IN], y[OUT];
+    for (uint32_t i = 0; i < REQUESTS; i++) {
+        uint32_t id = c->client * REQUESTS + i;
+        fill_input(x, id, 1);
+        if (!server_infer(fd, id, x, 1, IN, y, OUT) || !matches_local(c->model, x, y, 1)) c->failures++;
+    }
+    close(fd);
+    return NULL;
+}
+
+/* Concurrent single-row clients are answered correctly from shared batches
+ * that never exceed the limit. */
+void test_server_dynamic_batching() {
+    printf("Testing dynamic batching under concurrent clients... ");
+    fixture_t f;
+    start(&f, CLIENTS, 2000);
+
+    pthread_t threads[CLIENTS];
+    client_t clients[CLIENTS];
+    for (uint32_t i = 0; i < CLIENTS; i++) {
+        clients[i] = (client_t){f.model, i, 0};
+        assert(pthread_create(&threads[i], NULL, client_main, &clients[i]) == 0);
+    }
+    for (int i = 0; i < CLIENTS; i++) {
+        pthread_join(threads[i], NULL);
+        assert(clients[i].failures == 0);
+    }
+
+    server_stats_t stats;
+    server_get_stats(f.server, &stats);
+    assert(stats.requests == CLIENTS * REQUESTS && stats.rows == stats.requests);
+    assert(stats.batches < stats.requests && stats.max_batch_rows <= CLIENTS);
+    uint64_t latencies = 0, batches = 0;
+    for (int b = 0; b < SERVER_LATENCY_BUCKETS; b++) latencies += stats.latency[b];
+    for (int b = 0; b < SERVER_BATCH_BUCKETS; b++) batches += stats.batch_rows[b];
+    assert(latencies == stats.requests && batches == stats.batches);
+    assert(server_latency_percentile(&stats, 50.0) <= server_latency_percentile(&stats, 99.0));
+
+    /* The same numbers over the socket. */
+    int fd = server_connect(socket_path);
+    char json[4096], expected[64];
+    assert(server_query_stats(fd, json, sizeof(json)));
+    snprintf(expected, sizeof(expected), "{\"requests\": %d, ", CLIENTS * REQUESTS);
+    assert(strncmp(json, expected, strlen(expected)) == 0);
+    assert(strstr(json, "\"batch_rows_histogram\": [["));
+    assert(!server_query_stats(fd, json, 8));
+    assert(server_query_stats(fd, json, sizeof(json)));
+
+    close(fd);
+    stop(&f);
+    printf("✓\n");
+}
+
+void test_server_rejects_bad_requests() {
+    printf("Testing malformed request handling... ");
+    fixture_t f;
+    start(&f, 4, 50);
+    float x[8 * IN], y[8 * OUT];
+    fill_input(x, 0, 8);
+
+    int fd = server_connect(socket_path);
+    assert(!server_infer(fd, 1, x, 1, IN - 1, y, OUT));
+    close(fd);
+    fd = server_connect(socket_path);
+    assert(!server_infer(fd, 2, x, 8, IN, y, OUT));
+    close(fd);
+
+    /* The server is still healthy. */
+    fd = server_connect(socket_path);
+    assert(server_infer(fd, 3, x, 4, IN, y, OUT) && matches_local(f.model, x, y, 4));
+    close(fd);
+
+    server_stats_t stats;
+    server_get_stats(f.server, &stats);
+    assert(stats.errors == 2 && stats.requests == 1);
+    stop(&f);
+    printf("✓\n");
+}
+
+/* Sends full-size requests and never reads a reply, until the server hangs
+ * up. */
+static void* stalled_main(void *arg) {
+    int fd = *(int*)arg;
+    float x[4 * IN];
+    fill_input(x, 0, 4);
+    server_frame_t frame = {SERVER_REQUEST, 0, 4, IN};
+    while (send(fd, &frame, sizeof(frame), MSG_NOSIGNAL) == (ssize_t)sizeof(frame) &&
+           send(fd, x, sizeof(x), MSG_NOSIGNAL) == (ssize_t)sizeof(x)) {
+        frame.id++;
+    }
+    return NULL;
+}
+
+/* A client whose replies back up in its socket only holds up its own
+ * connection. */
+void test_server_slow_reader() {
+    printf("Testing a client that stops reading replies... ");
+    fixture_t f;
+    start(&f, 4, 50);
+    int stalled = server_connect(socket_path);
+    assert(stalled >= 0);
+    pthread_t writer;
+    assert(pthread_create(&writer, NULL, stalled_main, &stalled) == 0);
+    /* Long enough for the stalled connection's replies to fill its socket. */
+    struct timespec pause = {0, 200 * 1000 * 1000};
+    nanosleep(&pause, NULL);
+
+    int fd = server_connect(socket_path);
+    struct timeval timeout = {5, 0};
+    assert(setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0);
+    float x[2 * IN], y[2 * OUT];
+    for (uint32_t id = 1; id <= 20; id++) {
+        fill_input(x, id, 2);
+        assert(server_infer(fd, id, x, 2, IN, y, OUT) && matches_local(f.model, x, y, 2));
+    }
+    close(fd);
+
+    stop(&f);
+    pthread_join(writer, NULL);
+    close(stalled);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running Server Tests\n");
+    threadpool_init(0);
+
+    test_server_roundtrip();
+    test_server_dynamic_batching();
+    test_server_rejects_bad_requests();
+    test_server_slow_reader();
+
+    threadpool_shutdown();
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}
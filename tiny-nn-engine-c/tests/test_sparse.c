@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/sparse.h"
+#include "../include/network.h"
+#include "../include/optimizer.h"
+#include "../include/threadpool.h"
+
+#define LIBSVM_PATH "test_sparse.svm"
+
+/* A batch where roughly one entry in density is nonzero. */
+static tensor_t* random_sparse_dense(size_t rows, size_t cols, int density) {
+    tensor_t *t = tensor_create(rows, cols);
+    for (size_t i = 0; i < rows * cols; i++) {
+        if (rand() % density == 0) t->data[i] = (float)(rand() % 200 - 100) / 50.0f;
+    }
+    return t;
+}
+
+static int close_to(const tensor_t *a, const tensor_t *b, float tolerance) {
+    if (a->rows != b->rows || a->cols != b->cols) return 0;
+    for (size_t i = 0; i < a->rows; i++) {
+        for (size_t j = 0; j < a->cols; j++) {
+            float x = a->data[i * a->stride + j], y = b->data[i * b->stride + j];
+            if (fabsf(x - y) > tolerance * (1.0f + fabsf(y))) return 0;
+        }
+    }
+    return 1;
+}
+
+void test_sparse_conversion() {
+    printf("Testing CSR conversion and row views... ");
+    float values[] = {0, 2, 0, 0,
+                      0, 0, 0, 0,
+                      1, 0, 0, -3};
+    tensor_t *dense = tensor_wrap(values, 3, 4);
+    sparse_tensor_t *sparse = sparse_from_dense(dense);
+    assert(sparse && sparse->rows == 3 && sparse->cols == 4 && sparse_nnz(sparse) == 3);
+    assert(sparse->row_ptr[1] == 1 && sparse->row_ptr[2] == 1 && sparse->row_ptr[3] == 3);
+    assert(sparse->col_idx[0] == 1 && sparse->col_idx[1] == 0 && sparse->col_idx[2] == 3);
+
+    tensor_t *back = tensor_create(3, 4);
+    sparse_to_dense(sparse, back);
+    assert(memcmp(back->data, values, sizeof(values)) == 0);
+
+    sparse_tensor_t rows = sparse_rows(sparse, 1, 2);
+    assert(rows.rows == 2 && sparse_nnz(&rows) == 2);
+    tensor_t tail = tensor_rows(back, 1, 2);
+    tensor_t *part = tensor_create(2, 4);
+    sparse_to_dense(&rows, part);
+    assert(memcmp(part->data, tail.data, 8 * sizeof(float)) == 0);
+
+    tensor_destroy(dense);
+    tensor_destroy(back);
+    tensor_destroy(part);
+    sparse_destroy(sparse);
+    printf("✓\n");
+}
+
+void test_sparse_matmul() {
+    printf("Testing sparse x dense matmul... ");
+    tensor_t *a = random_sparse_dense(37, 300, 20);
+    tensor_t *b = tensor_create(300, 29);
+    tensor_random(b, -1.0f, 1.0f);
+    sparse_tensor_t *s = sparse_from_dense(a);
+
+    tensor_t *expected = tensor_matmul(a, b);
+    tensor_t *result = tensor_create(37, 29);
+    tensor_fill(result, 7.0f);
+    sparse_matmul_into(s, b, result);
+    assert(close_to(result, expected, 1e-5f));
+
+    /* A row view multiplies like the matching dense rows. */
+    sparse_tensor_t view = sparse_rows(s, 10, 5);
+    tensor_t out = tensor_rows(result, 0, 5);
+    tensor_t want = tensor_rows(expected, 10, 5);
+    sparse_matmul_into(&view, b, &out);
+    assert(close_to(&out, &want, 1e-5f));
+
+    tensor_destroy(a);
+    tensor_destroy(b);
+    tensor_destroy(expected);
+    tensor_destroy(result);
+    sparse_destroy(s);
+    printf("✓\n");
+}
+
+/* A sparse-input layer matches the same layer fed the dense batch, also for
+ * a second batch over other features, whose gradient must not keep stale
+ * rows from the first. */
+void test_sparse_layer() {
+    printf("Testing sparse layer forward, backward and SGD... ");
+    const size_t in = 500, out = 24, batch = 16;
+    dense_layer_t *dense = layer_create(in, out, ACTIVATION_SIGMOID);
+    dense_layer_t *sparse = layer_create(in, out, ACTIVATION_SIGMOID);
+    tensor_random(dense->bias, -0.5f, 0.5f);
+    tensor_copy_data(sparse->weights, dense->weights);
+    tensor_copy_data(sparse->bias, dense->bias);
+    sgd_optimizer_t *opt = sgd_create(0.1f);
+
+    for (int round = 0; round < 3; round++) {
+        tensor_t *x = random_sparse_dense(batch, in, 50);
+        sparse_tensor_t *xs = sparse_from_dense(x);
+        tensor_t *grad = tensor_create(batch, out);
+        tensor_random(grad, -1.0f, 1.0f);
+
+        tensor_t *y_dense = layer_forward(dense, x);
+        tensor_t *y_sparse = layer_forward_sparse(sparse, xs);
+        assert(close_to(y_sparse, y_dense, 1e-5f));
+
+        tensor_t *grad_input = layer_backward(dense, grad);
+        assert(layer_backward(sparse, grad) == NULL);
+        assert(sparse->sparse_grad && sparse->num_grad_rows <= sparse_nnz(xs));
+        assert(close_to(sparse->grad_weights, dense->grad_weights, 1e-5f));
+        assert(close_to(sparse->grad_bias, dense->grad_bias, 1e-5f));
+
+        sgd_step(opt, dense);
+        sgd_step(opt, sparse);
+        assert(close_to(sparse->weights, dense->weights, 1e-5f));
+
+        tensor_destroy(grad_input);
+        tensor_destroy(grad);
+        tensor_destroy(x);
+        sparse_destroy(xs);
+    }
+
+    /* Going back to dense input uses the full gradient again. */
+    tensor_t *x = random_sparse_dense(batch, in, 3);
+    tensor_t *grad = tensor_create(batch, out);
+    tensor_fill(grad, 0.25f);
+    layer_forward(sparse, x);
+    tensor_destroy(layer_backward(sparse, grad));
+    assert(!sparse->sparse_grad);
+
+    tensor_destroy(x);
+    tensor_destroy(grad);
+    sgd_destroy(opt);
+    layer_destroy(dense);
+    layer_destroy(sparse);
+    printf("✓\n");
+}
+
+/* A built network takes a sparse batch straight into its first layer. */
+void test_sparse_network() {
+    printf("Testing sparse input through a network... ");
+    const size_t in = 300, batch = 12;
+    network_t *network = network_create();
+    network_add_dense(network, in, 32, ACTIVATION_RELU);
+    network_add_dense(network, 32, 3, ACTIVATION_SIGMOID);
+    assert(network_build(network, batch));
+
+    tensor_t *x = random_sparse_dense(batch, in, 30);
+    sparse_tensor_t *xs = sparse_from_dense(x);
+    tensor_t *y = tensor_create(batch, 3);
+    for (size_t i = 0; i < batch * 3; i++) y->data[i] = (float)(i % 2);
+
+    tensor_t *expected = tensor_copy(network_forward(network, x));
+    float dense_loss = network_loss(network, y, NETWORK_LOSS_BCE);
+    assert(network_backward(network, NULL));
+    tensor_t *dense_grads[4];
+    for (size_t i = 0; i < 2; i++) {
+        dense_grads[2 * i] = tensor_copy(network->layers[i]->grad_weights);
+        dense_grads[2 * i + 1] = tensor_copy(network->layers[i]->grad_bias);
+    }
+
+    /* Dirty the gradient so the sparse pass has to clear it. */
+    tensor_fill(network->layers[0]->grad_weights, 1.0f);
+    const tensor_t *output = network_forward_sparse(network, xs);
+    assert(output && close_to(output, expected, 1e-5f));
+    assert(fabsf(network_loss(network, y, NETWORK_LOSS_BCE) - dense_loss) < 1e-5f);
+    assert(network_backward(network, NULL) == NULL);
+    for (size_t i = 0; i < 2; i++) {
+        assert(close_to(network->layers[i]->grad_weights, dense_grads[2 * i], 1e-5f));
+        assert(close_to(network->layers[i]->grad_bias, dense_grads[2 * i + 1], 1e-5f));
+    }
+
+    /* Adam trains from sparse batches like any other. */
+    adam_optimizer_t *adam = adam_create(0.01f, 2);
+    float first = 0.0f, last = 0.0f;
+    for (int step = 0; step < 50; step++) {
+        network_forward_sparse(network, xs);
+        last = network_loss(network, y, NETWORK_LOSS_BCE);
+        if (step == 0) first = last;
+        network_backward(network, NULL);
+        adam_step_params(adam, network->params);
+    }
+    assert(last < first);
+
+    for (size_t i = 0; i < 4; i++) tensor_destroy(dense_grads[i]);
+    adam_destroy(adam);
+    tensor_destroy(expected);
+    tensor_destroy(x);
+    tensor_destroy(y);
+    sparse_destroy(xs);
+    network_destroy(network);
+    printf("✓\n");
+}
+
+void test_sparse_libsvm() {
+    printf("Testing libsvm loader... ");
+    FILE *file = fopen(LIBSVM_PATH, "w");
+    assert(file);
+    fputs("1 3:0.5 10:2\n"
+          "\n"
+          "-1 1:1 2:0 7:-4.25   # comment\n"
+          "0\n"
+          "0.5 4:1e-3\n", file);
+    fclose(file);
+
+    tensor_t *targets = NULL;
+    sparse_tensor_t *s = sparse_load_libsvm(LIBSVM_PATH, 0, &targets);
+    assert(s && targets);
+    assert(s->rows == 4 && s->cols == 10 && sparse_nnz(s) == 5);
+    assert(targets->rows == 4 && targets->data[0] == 1.0f && targets->data[1] == -1.0f);
+    assert(targets->data[2] == 0.0f && targets->data[3] == 0.5f);
+    size_t row_ptr[] = {0, 2, 4, 4, 5};
+    uint32_t cols[] = {2, 9, 0, 6, 3};
+    float values[] = {0.5f, 2.0f, 1.0f, -4.25f, 1e-3f};
+    assert(memcmp(s->row_ptr, row_ptr, sizeof(row_ptr)) == 0);
+    assert(memcmp(s->col_idx, cols, sizeof(cols)) == 0);
+    assert(memcmp(s->values, values, sizeof(values)) == 0);
+    sparse_destroy(s);
+    tensor_destroy(targets);
+
+    s = sparse_load_libsvm(LIBSVM_PATH, 64, &targets);
+    assert(s && s->cols == 64);
+    sparse_destroy(s);
+    tensor_destroy(targets);
+
+    /* Indices past num_features, out of order or zero are rejected. */
+    assert(!sparse_load_libsvm(LIBSVM_PATH, 8, &targets));
+    file = fopen(LIBSVM_PATH, "w");
+    fputs("1 5:1 3:1\n", file);
+    fclose(file);
+    assert(!sparse_load_libsvm(LIBSVM_PATH, 0, &targets));
+    assert(!sparse_load_libsvm("does_not_exist.svm", 0, &targets));
+
+    remove(LIBSVM_PATH);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running Sparse Tests\n");
+    srand(7);
+    threadpool_init(0);
+
+    test_sparse_conversion();
+    test_sparse_matmul();
+    test_sparse_layer();
+    test_sparse_network();
+    test_sparse_libsvm();
+
+    threadpool_shutdown();
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}
@@ -1,7 +1,12 @@
 #include <stdio.h>
 #include <assert.h>
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
 #include "../include/tensor.h"
+#include "../include/gemm.h"
+#include "../include/threadpool.h"
+#include "../include/loss.h"
 
 #define EPSILON 1e-5f
 
@@ -11,6 +16,8 @@ void test_tensor_creation() {
     assert(t != NULL);
     assert(t->rows == 3);
     assert(t->cols == 4);
+    assert(t->stride == 4 && t->owns_data);
+    assert((uintptr_t)t->data % 64 == 0);
     tensor_destroy(t);
     printf("✓\n");
 }
@@ -69,6 +76,159 @@ void test_tensor_matmul() {
     printf("✓\n");
 }
 
+void test_tensor_matmul_blocked() {
+    printf("Testing blocked matrix multiplication... ");
+    size_t shapes[][3] = {{1, 1, 1}, {7, 5, 3}, {37, 53, 61}, {130, 70, 300}, {9, 257, 33}};
+    gemm_isa_t best = gemm_get_isa();
+    
+    for (int isa = GEMM_ISA_SCALAR; isa <= (int)best; isa++) {
+        gemm_set_isa((gemm_isa_t)isa);
+        for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+            size_t m = shapes[s][0], k = shapes[s][1], n = shapes[s][2];
+            tensor_t *a = tensor_create(m, k);
+            tensor_t *b = tensor_create(k, n);
+            tensor_random(a, -1.0f, 1.0f);
+            tensor_random(b, -1.0f, 1.0f);
+            
+            tensor_t *result = tensor_matmul(a, b);
+            for (size_t i = 0; i < m; i++) {
+                for (size_t j = 0; j < n; j++) {
+                    float expected = 0.0f;
+                    for (size_t p = 0; p < k; p++) {
+                        expected += a->data[i * k + p] * b->data[p * n + j];
+                    }
+                    assert(fabsf(result->data[i * n + j] - expected) < 1e-3f);
+                }
+            }
+            
+            tensor_destroy(a);
+            tensor_destroy(b);
+            tensor_destroy(result);
+        }
+    }
+    
+    gemm_set_isa(best);
+    printf("✓\n");
+}
+
+void test_tensor_matmul_transposed() {
+    printf("Testing transposed matrix multiplication... ");
+    size_t shapes[][3] = {{3, 2, 4}, {70, 130, 45}, {300, 17, 90}};
+    
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        size_t m = shapes[s][0], k = shapes[s][1], n = shapes[s][2];
+        tensor_t *a = tensor_create(m, k);
+        tensor_t *b = tensor_create(k, n);
+        tensor_random(a, -1.0f, 1.0f);
+        tensor_random(b, -1.0f, 1.0f);
+        tensor_t *a_T = tensor_transpose(a);
+        tensor_t *b_T = tensor_transpose(b);
+        
+        tensor_t *expected = tensor_matmul(a, b);
+        tensor_t *tn = tensor_matmul_tn(a_T, b);
+        tensor_t *nt = tensor_matmul_nt(a, b_T);
+        assert(tn->rows == m && tn->cols == n);
+        assert(nt->rows == m && nt->cols == n);
+        for (size_t i = 0; i < m * n; i++) {
+            assert(fabsf(tn->data[i] - expected->data[i]) < 1e-3f);
+            assert(fabsf(nt->data[i] - expected->data[i]) < 1e-3f);
+        }
+        
+        tensor_destroy(a);
+        tensor_destroy(b);
+        tensor_destroy(a_T);
+        tensor_destroy(b_T);
+        tensor_destroy(expected);
+        tensor_destroy(tn);
+        tensor_destroy(nt);
+    }
+    
+    printf("✓\n");
+}
+
+void test_parallel_determinism() {
+    printf("Testing thread-count independent results... ");
+    tensor_t *a = tensor_create(300, 200);
+    tensor_t *b = tensor_create(200, 260);
+    tensor_t *t = tensor_create(300, 260);
+    tensor_random(a, -1.0f, 1.0f);
+    tensor_random(b, -1.0f, 1.0f);
+    tensor_random(t, 0.0f, 1.0f);
+    
+    size_t thread_counts[] = {1, 3, 4};
+    tensor_t *reference = NULL;
+    float reference_loss = 0.0f;
+    for (int c = 0; c < 3; c++) {
+        threadpool_init(thread_counts[c]);
+        tensor_t *result = tensor_matmul(a, b);
+        tensor_sigmoid(result, result);
+        float loss = loss_binary_crossentropy(result, t);
+        
+        if (!reference) {
+            reference = result;
+            reference_loss = loss;
+            continue;
+        }
+        assert(loss == reference_loss);
+        for (size_t i = 0; i < result->rows * result->cols; i++) {
+            assert(result->data[i] == reference->data[i]);
+        }
+        tensor_destroy(result);
+    }
+    threadpool_shutdown();
+    
+    tensor_destroy(a);
+    tensor_destroy(b);
+    tensor_destroy(t);
+    tensor_destroy(reference);
+    printf("✓\n");
+}
+
+void test_gemm_fused_epilogue() {
+    printf("Testing fused GEMM epilogues... ");
+    size_t shapes[][3] = {{4, 2, 3}, {37, 300, 45}, {130, 64, 70}};
+    gemm_activation_t acts[] = {GEMM_ACT_NONE, GEMM_ACT_RELU, GEMM_ACT_SIGMOID};
+    gemm_isa_t best = gemm_get_isa();
+    
+    for (int isa = GEMM_ISA_SCALAR; isa <= (int)best; isa++) {
+        gemm_set_isa((gemm_isa_t)isa);
+        for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+            size_t m = shapes[s][0], k = shapes[s][1], n = shapes[s][2];
+            tensor_t *a = tensor_create(m, k);
+            tensor_t *b = tensor_create(k, n);
+            tensor_t *bias = tensor_create(1, n);
+            tensor_t *fused = tensor_create(m, n);
+            tensor_random(a, -1.0f, 1.0f);
+            tensor_random(b, -1.0f, 1.0f);
+            tensor_random(bias, -1.0f, 1.0f);
+            tensor_t *plain = tensor_matmul(a, b);
+            
+            for (int act = 0; act < 3; act++) {
+                gemm_epilogue_t ep = {bias->data, acts[act]};
+                gemm_sgemm_fused(GEMM_NO_TRANS, GEMM_NO_TRANS, m, n, k, 1.0f, a->data, k,
+                                 b->data, n, 0.0f, fused->data, n, &ep);
+                for (size_t i = 0; i < m; i++) {
+                    for (size_t j = 0; j < n; j++) {
+                        float z = plain->data[i * n + j] + bias->data[j];
+                        if (acts[act] == GEMM_ACT_RELU) z = fmaxf(0.0f, z);
+                        if (acts[act] == GEMM_ACT_SIGMOID) z = 1.0f / (1.0f + expf(-z));
+                        assert(fabsf(fused->data[i * n + j] - z) < 1e-3f);
+                    }
+                }
+            }
+            
+            tensor_destroy(a);
+            tensor_destroy(b);
+            tensor_destroy(bias);
+            tensor_destroy(fused);
+            tensor_destroy(plain);
+        }
+    }
+    
+    gemm_set_isa(best);
+    printf("✓\n");
+}
+
 void test_tensor_relu() {
     printf("Testing ReLU activation... ");
     tensor_t *input = tensor_create(1, 4);
@@ -89,6 +249,80 @@ void test_tensor_relu() {
     printf("✓\n");
 }
 
+void test_tensor_views() {
+    printf("Testing strided tensor views... ");
+    tensor_t *t = tensor_create(6, 10);
+    for (size_t i = 0; i < 60; i++) t->data[i] = (float)i;
+
+    tensor_t rows = tensor_rows(t, 2, 3);
+    assert(rows.rows == 3 && rows.cols == 10 && rows.data == t->data + 20 && !rows.owns_data);
+    assert(tensor_is_contiguous(&rows));
+
+    /* A 4 x 3 column block: writes through it land only inside the block. */
+    tensor_t block = tensor_block(t, 1, 4, 5, 3);
+    assert(block.stride == 10 && !tensor_is_contiguous(&block));
+    tensor_fill(&block, -1.0f);
+    for (size_t i = 0; i < 6; i++) {
+        for (size_t j = 0; j < 10; j++) {
+            int inside = i >= 1 && i < 5 && j >= 5 && j < 8;
+            assert(t->data[i * 10 + j] == (inside ? -1.0f : (float)(i * 10 + j)));
+        }
+    }
+
+    tensor_t *copy = tensor_copy(&block);
+    assert(copy->stride == 3 && copy->data[11] == -1.0f);
+    tensor_t *sum = tensor_create(4, 3);
+    tensor_t left = tensor_block(t, 2, 4, 0, 3);
+    tensor_add(&left, copy, sum);
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 3; j++) assert(sum->data[i * 3 + j] == (float)((i + 2) * 10 + j) - 1.0f);
+    }
+
+    /* Matmul on views agrees with matmul on contiguous copies. */
+    tensor_t a_view = tensor_block(t, 0, 5, 1, 4);
+    tensor_t b_view = tensor_block(t, 2, 4, 6, 2);
+    tensor_t *a = tensor_copy(&a_view);
+    tensor_t *b = tensor_copy(&b_view);
+    tensor_t *expected = tensor_matmul(a, b);
+    float out_data[5 * 7];
+    tensor_t out = tensor_view(out_data, 5, 2, 7);
+    tensor_matmul_into(&a_view, &b_view, &out);
+    for (size_t i = 0; i < 5; i++) {
+        for (size_t j = 0; j < 2; j++) assert(out_data[i * 7 + j] == expected->data[i * 2 + j]);
+    }
+
+    /* Loss over a column block equals the loss over its packed copy. */
+    tensor_t predictions = tensor_block(t, 0, 6, 2, 3);
+    tensor_t targets = tensor_block(t, 0, 6, 6, 3);
+    tensor_t *p = tensor_copy(&predictions);
+    tensor_t *q = tensor_copy(&targets);
+    assert(loss_mse(&predictions, &targets) == loss_mse(p, q));
+    tensor_t *grad = tensor_create(6, 3);
+    tensor_t *packed_grad = tensor_create(6, 3);
+    loss_mse_derivative(&predictions, &targets, grad);
+    loss_mse_derivative(p, q, packed_grad);
+    assert(memcmp(grad->data, packed_grad->data, 18 * sizeof(float)) == 0);
+
+    /* Wrapped memory is left alone by tensor_destroy. */
+    tensor_t *wrapped = tensor_wrap_strided(t->data, 3, 4, 10);
+    assert(wrapped && !wrapped->owns_data);
+    tensor_destroy(wrapped);
+    assert(tensor_wrap_strided(t->data, 3, 4, 2) == NULL);
+    assert(t->data[0] == 0.0f);
+
+    tensor_destroy(grad);
+    tensor_destroy(packed_grad);
+    tensor_destroy(p);
+    tensor_destroy(q);
+    tensor_destroy(a);
+    tensor_destroy(b);
+    tensor_destroy(expected);
+    tensor_destroy(sum);
+    tensor_destroy(copy);
+    tensor_destroy(t);
+    printf("✓\n");
+}
+
 int main() {
     printf("\n Running Tensor Tests\n");
     
@@ -96,7 +330,12 @@ int main() {
     test_tensor_fill();
     test_tensor_add();
     test_tensor_matmul();
+    test_tensor_matmul_blocked();
+    test_tensor_matmul_transposed();
+    test_gemm_fused_epilogue();
     test_tensor_relu();
+    test_tensor_views();
+    test_parallel_determinism();
     
     printf("\nAll tests passed!\n\n");
     return 0;
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "../include/trainer.h"
+#include "../include/threadpool.h"
+
+#define DEPTH 3
+#define BATCH 48
+
+static const size_t widths[DEPTH + 1] = {12, 40, 24, 3};
+
+/* Every call builds the same initial model from a saved parameter block. */
+static network_t* build_network(const float *initial) {
+    network_t *network = network_create();
+    for (size_t i = 0; i < DEPTH; i++) {
+        activation_type_t act = i + 1 == DEPTH ? ACTIVATION_SIGMOID : ACTIVATION_RELU;
+        assert(network_add_dense(network, widths[i], widths[i + 1], act) != NULL);
+    }
+    assert(network_build(network, BATCH));
+    if (initial) memcpy(network->params->values, initial, network->params->count * sizeof(float));
+    return network;
+}
+
+typedef struct {
+    tensor_t *x[4];
+    tensor_t *y[4];
+} batches_t;
+
+/* Four batches, the last two short and uneven across workers. */
+static void make_batches(batches_t *data) {
+    size_t rows[4] = {BATCH, BATCH, 29, 3};
+    for (int b = 0; b < 4; b++) {
+        data->x[b] = tensor_create(rows[b], widths[0]);
+        data->y[b] = tensor_create(rows[b], widths[DEPTH]);
+        tensor_random(data->x[b], -1.0f, 1.0f);
+        tensor_random(data->y[b], 0.0f, 1.0f);
+    }
+}
+
+static void free_batches(batches_t *data) {
+    for (int b = 0; b < 4; b++) {
+        tensor_destroy(data->x[b]);
+        tensor_destroy(data->y[b]);
+    }
+}
+
+/* Trains for three passes over the batches; returns the model, writes the losses. */
+static network_t* train(const float *initial, const batches_t *data, size_t workers, float *losses) {
+    network_t *network = build_network(initial);
+    adam_optimizer_t *opt = adam_create(0.01f, DEPTH);
+    trainer_t *trainer = workers ? trainer_create(network, workers) : NULL;
+
+    for (int step = 0; step < 12; step++) {
+        const tensor_t *x = data->x[step % 4], *y = data->y[step % 4];
+        losses[step] = trainer ? trainer_step(trainer, x, y, NETWORK_LOSS_BCE, opt)
+                               : network_train_step(network, x, y, NETWORK_LOSS_BCE, opt);
+    }
+
+    trainer_destroy(trainer);
+    adam_destroy(opt);
+    return network;
+}
+
+void test_trainer_single_worker() {
+    printf("Testing one-worker trainer against network_train_step... ");
+    network_t *init = build_network(NULL);
+    batches_t data;
+    make_batches(&data);
+    float expected[12], losses[12];
+
+    network_t *reference = train(init->params->values, &data, 0, expected);
+    network_t *trained = train(init->params->values, &data, 1, losses);
+    assert(memcmp(losses, expected, sizeof(losses)) == 0);
+    assert(memcmp(trained->params->values, reference->params->values,
+                  reference->params->count * sizeof(float)) == 0);
+
+    network_destroy(reference);
+    network_destroy(trained);
+    network_destroy(init);
+    free_batches(&data);
+    printf("✓\n");
+}
+
+/* Five workers: results may differ from one worker by rounding only, and
+ * must not depend on how many pool threads run them. */
+void test_trainer_reproducible() {
+    printf("Testing data-parallel reproducibility... ");
+    network_t *init = build_network(NULL);
+    batches_t data;
+    make_batches(&data);
+    float expected[12], first[12], second[12];
+
+    network_t *reference = train(init->params->values, &data, 0, expected);
+    threadpool_init(1);
+    network_t *a = train(init->params->values, &data, 5, first);
+    threadpool_init(4);
+    network_t *b = train(init->params->values, &data, 5, second);
+    threadpool_init(0);
+
+    assert(memcmp(first, second, sizeof(first)) == 0);
+    assert(memcmp(a->params->values, b->params->values, a->params->count * sizeof(float)) == 0);
+    for (int step = 0; step < 12; step++) assert(fabsf(first[step] - expected[step]) < 1e-5f);
+    for (size_t i = 0; i < a->params->count; i++) {
+        assert(fabsf(a->params->values[i] - reference->params->values[i]) < 1e-4f);
+    }
+
+    network_destroy(reference);
+    network_destroy(a);
+    network_destroy(b);
+    network_destroy(init);
+    free_batches(&data);
+    printf("✓\n");
+}
+
+void test_trainer_replicas_share_weights() {
+    printf("Testing replicas share parameters... ");
+    network_t *network = build_network(NULL);
+    assert(param_arena_set_precision(network->params, network->layers, DEPTH, PRECISION_BF16));
+    trainer_t *trainer = trainer_create(network, 3);
+    assert(trainer && trainer->num_workers == 3 && trainer->workers[0] == network);
+
+    for (size_t w = 1; w < 3; w++) {
+        network_t *replica = trainer->workers[w];
+        assert(replica->max_batch == BATCH / 3 && !replica->params->owns_values);
+        assert(replica->params->values == network->params->values);
+        assert(replica->params->grads != network->params->grads);
+        for (size_t i = 0; i < DEPTH; i++) {
+            assert(replica->layers[i]->weights->data == network->layers[i]->weights->data);
+            assert(replica->layers[i]->half_weights == network->layers[i]->half_weights);
+        }
+    }
+    assert(!param_arena_set_precision(trainer->workers[1]->params, trainer->workers[1]->layers,
+                                      DEPTH, PRECISION_FP32));
+
+    trainer_destroy(trainer);
+    network_destroy(network);
+    printf("✓\n");
+}
+
+/* Four workers of 12 rows on a learnable target: t = sigmoid of a fixed
+ * mix of the inputs. Updates race, so only convergence is checked. */
+void test_trainer_hogwild() {
+    printf("Testing Hogwild SGD convergence... ");
+    threadpool_init(4);
+    network_t *network = build_network(NULL);
+    trainer_t *trainer = trainer_create(network, 4);
+    sgd_optimizer_t *settings = sgd_create_momentum(0.5f, 0.9f, 0.0f);
+
+    size_t samples = 600;
+    tensor_t *x = tensor_create(samples, widths[0]);
+    tensor_t *y = tensor_create(samples, widths[DEPTH]);
+    tensor_random(x, -1.0f, 1.0f);
+    for (size_t i = 0; i < samples; i++) {
+        for (size_t j = 0; j < widths[DEPTH]; j++) {
+            float z = 0.0f;
+            for (size_t k = 0; k < widths[0]; k++) {
+                z += (k % (j + 2) ? 0.5f : -0.5f) * x->data[i * widths[0] + k];
+            }
+            y->data[i * widths[DEPTH] + j] = 1.0f / (1.0f + expf(-2.0f * z));
+        }
+    }
+
+    /* Workers skip the shared panels during the pass, so they are left as
+     * they were and packing is back on afterwards. */
+    trainer_stats_t first, stats;
+    layer_packed_t *packed = network->layers[0]->packed_weights;
+    uint64_t packed_version = packed->version;
+    assert(trainer_hogwild_epoch(trainer, x, y, 12, NETWORK_LOSS_MSE, settings, &first));
+    assert(first.batches == 50 && first.samples == samples && first.seconds >= 0.0);
+    assert(packed->version == packed_version && trainer->workers[3]->layers[0]->packing);
+    for (int epoch = 0; epoch < 40; epoch++) {
+        assert(trainer_hogwild_epoch(trainer, x, y, 7, NETWORK_LOSS_MSE, settings, &stats));
+    }
+    assert(stats.batches == 86 && isfinite(stats.loss));
+    assert(stats.loss < 0.5f * first.loss);
+
+    /* Batches must fit a replica. */
+    assert(!trainer_hogwild_epoch(trainer, x, y, 13, NETWORK_LOSS_MSE, settings, &stats));
+    assert(!trainer_hogwild_epoch(trainer, x, y, 0, NETWORK_LOSS_MSE, settings, &stats));
+
+    tensor_destroy(x);
+    tensor_destroy(y);
+    sgd_destroy(settings);
+    trainer_destroy(trainer);
+    network_destroy(network);
+    threadpool_init(0);
+    printf("✓\n");
+}
+
+int main() {
+    printf("\n Running Trainer Tests\n");
+
+    test_trainer_single_worker();
+    test_trainer_reproducible();
+    test_trainer_replicas_share_weights();
+    test_trainer_hogwild();
+
+    printf("\nAll tests passed!\n\n");
+    return 0;
+}